@@ -2,6 +2,10 @@
 #include "board.h"
 #include "display.h"
 #include "system_info.h"
+#include "system_profiler.h"
+#include "cpu_governor.h"
+#include "task_stack.h"
+#include "task_stack_recorder.h"
 #include "audio_codec.h"
 #include "mqtt_protocol.h"
 #include "websocket_protocol.h"
@@ -376,7 +380,7 @@ void Application::Start() {
     xTaskCreate([](void* arg) {
         ((Application*)arg)->MainEventLoop();
         vTaskDelete(NULL);
-    }, "main_event_loop", 2048 * 4, this, 3, &main_event_loop_task_handle_);
+    }, "main_event_loop", TASK_STACK_MAIN_EVENT_LOOP, this, 3, &main_event_loop_task_handle_);
 
     /* Start the clock timer to update the status bar */
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
@@ -531,6 +535,12 @@ void Application::Start() {
     bool protocol_started = protocol_->Start();
 
     SystemInfo::PrintHeapStats();
+#if CONFIG_USE_SYSTEM_PROFILER
+    SystemProfiler::GetInstance().Start(CONFIG_SYSTEM_PROFILER_INTERVAL);
+#endif
+#if CONFIG_USE_CPU_GOVERNOR
+    CpuGovernor::GetInstance().Start(CONFIG_CPU_GOVERNOR_REPORT_INTERVAL);
+#endif
     SetDeviceState(kDeviceStateIdle);
 
     has_server_time_ = ota.HasServerTime();
@@ -608,6 +618,11 @@ void Application::MainEventLoop() {
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
             }
+#if CONFIG_USE_TASK_STACK_RECORDER
+            if (clock_ticks_ % CONFIG_TASK_STACK_RECORDER_INTERVAL == 0) {
+                TaskStackRecorder::GetInstance().Sample();
+            }
+#endif
         }
     }
 }
@@ -699,8 +714,12 @@ void Application::SetDeviceState(DeviceState state) {
 
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
+#if CONFIG_USE_AUDIO_DTX
+                // Silence is only suppressed in realtime mode, the other modes rely on the server VAD
+                audio_service_.EnableDtx(listening_mode_ == kListeningModeRealtime);
+#endif
                 // Send the start listening command
-                protocol_->SendStartListening(listening_mode_);
+                protocol_->SendStartListening(listening_mode_, audio_service_.IsDtxEnabled());
                 audio_service_.EnableVoiceProcessing(true);
                 audio_service_.EnableWakeWordDetection(false);
             }
@@ -729,6 +748,7 @@ void Application::Reboot() {
     }
     protocol_.reset();
     audio_service_.Stop();
+    Settings::Flush();
 
     vTaskDelay(pdMS_TO_TICKS(1000));
     esp_restart();
@@ -759,6 +779,8 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
 
     board.SetPowerSaveMode(false);
     audio_service_.Stop();
+    // Make sure pending settings are on flash before the long-running upgrade starts
+    Settings::Flush();
     vTaskDelay(pdMS_TO_TICKS(1000));
 
     bool upgrade_success = ota.StartUpgradeFromUrl(upgrade_url, [display](int progress, size_t speed) {
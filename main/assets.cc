@@ -157,6 +157,7 @@ bool Assets::Apply() {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
                 return false;
             }
+            text_font->EnableGlyphCache();
             if (light_theme != nullptr) {
                 light_theme->set_text_font(text_font);
             }
@@ -1,6 +1,9 @@
 #include "audio_service.h"
+#include "task_stack.h"
+#include "cpu_governor.h"
 #include <esp_log.h>
 #include <cstring>
+#include <cmath>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -17,8 +20,22 @@
 
 #define TAG "AudioService"
 
+// RMS of the frame scaled so that loud speech (RMS 4096 and above) is 255
+static uint8_t PcmLevel(const std::vector<int16_t>& pcm) {
+    if (pcm.empty()) {
+        return 0;
+    }
+    int64_t sum = 0;
+    for (int16_t sample : pcm) {
+        sum += (int32_t)sample * sample;
+    }
+    int rms = (int)sqrtf((float)sum / pcm.size());
+    return rms >= 4096 ? 255 : rms / 16;
+}
 
-AudioService::AudioService() {
+AudioService::AudioService()
+    : dtx_gate_(DTX_HANGOVER_MS / OPUS_FRAME_DURATION_MS, DTX_PRE_ROLL_MS / OPUS_FRAME_DURATION_MS,
+        DTX_SID_INTERVAL_MS / OPUS_FRAME_DURATION_MS) {
     event_group_ = xEventGroupCreate();
 }
 
@@ -85,28 +102,28 @@ void AudioService::Start() {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioInputTask();
         vTaskDelete(NULL);
-    }, "audio_input", 2048 * 3, this, 8, &audio_input_task_handle_, 0);
+    }, "audio_input", TASK_STACK_AUDIO_INPUT, this, 8, &audio_input_task_handle_, 0);
 
     /* Start the audio output task */
     xTaskCreate([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
         vTaskDelete(NULL);
-    }, "audio_output", 2048 * 2, this, 4, &audio_output_task_handle_);
+    }, "audio_output", TASK_STACK_AUDIO_OUTPUT, this, 4, &audio_output_task_handle_);
 #else
     /* Start the audio input task */
     xTaskCreate([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioInputTask();
         vTaskDelete(NULL);
-    }, "audio_input", 2048 * 2, this, 8, &audio_input_task_handle_);
+    }, "audio_input", TASK_STACK_AUDIO_INPUT, this, 8, &audio_input_task_handle_);
 
     /* Start the audio output task */
     xTaskCreate([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
         vTaskDelete(NULL);
-    }, "audio_output", 2048, this, 4, &audio_output_task_handle_);
+    }, "audio_output", TASK_STACK_AUDIO_OUTPUT, this, 4, &audio_output_task_handle_);
 #endif
 
     /* Start the opus codec task */
@@ -114,7 +131,7 @@ void AudioService::Start() {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->OpusCodecTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_codec", TASK_STACK_OPUS_CODEC, this, 2, &opus_codec_task_handle_);
 }
 
 void AudioService::Stop() {
@@ -231,6 +248,7 @@ void AudioService::AudioInputTask() {
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    CpuGovernor::PerformanceLock performance;
                     wake_word_->Feed(data);
                     continue;
                 }
@@ -243,6 +261,7 @@ void AudioService::AudioInputTask() {
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    CpuGovernor::PerformanceLock performance;
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -259,6 +278,9 @@ void AudioService::AudioInputTask() {
 void AudioService::AudioOutputTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+        if (audio_playback_queue_.empty()) {
+            output_level_ = 0;
+        }
         audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
         if (service_stopped_) {
             break;
@@ -274,6 +296,7 @@ void AudioService::AudioOutputTask() {
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
+        output_level_ = PcmLevel(task->pcm);
         codec_->OutputData(task->pcm);
 
         /* Update the last output time */
@@ -316,15 +339,19 @@ void AudioService::OpusCodecTask() {
             task->timestamp = packet->timestamp;
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
+            bool decoded;
+            {
+                CpuGovernor::PerformanceLock performance;
+                decoded = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
                 // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+                if (decoded && opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
                     int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
                     std::vector<int16_t> resampled(target_size);
                     output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
                     task->pcm = std::move(resampled);
                 }
-
+            }
+            if (decoded) {
                 lock.lock();
                 audio_playback_queue_.push_back(std::move(task));
                 audio_queue_cv_.notify_all();
@@ -346,17 +373,27 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            bool encoded;
+            {
+                CpuGovernor::PerformanceLock performance;
+                encoded = opus_encoder_->Encode(std::move(task->pcm), packet->payload);
+            }
+            if (!encoded) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
             }
 
             if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+                /* The DTX gate numbers the frames, and may hold back or drop silent ones */
+                std::vector<std::unique_ptr<AudioStreamPacket>> packets;
                 {
                     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
+                    dtx_gate_.Process(std::move(packet), task->voice, packets);
+                    for (auto& p : packets) {
+                        audio_send_queue_.push_back(std::move(p));
+                    }
                 }
-                if (callbacks_.on_send_queue_available) {
+                if (!packets.empty() && callbacks_.on_send_queue_available) {
                     callbacks_.on_send_queue_available();
                 }
             } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
@@ -394,6 +431,11 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
 
+    /* The VAD state is reported before the frame it was detected in is output */
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        task->voice = voice_detected_;
+    }
+
     /* If the task is to send queue, we need to set the timestamp */
     if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
         if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
@@ -484,12 +526,23 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
         /* We should make sure no audio is playing */
         ResetDecoder();
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            dtx_gate_.Reset();
+        }
         audio_input_need_warmup_ = true;
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
         audio_processor_->Stop();
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        auto& stats = dtx_gate_.statistics();
+        if (dtx_gate_.enabled() && stats.frames > 0) {
+            ESP_LOGI(TAG, "DTX sent %lu of %lu frames and %lu SID frames, %lu of %lu bytes",
+                stats.sent_frames, stats.frames, stats.sid_frames, stats.output_bytes, stats.input_bytes);
+        }
     }
 }
 
@@ -514,6 +567,20 @@ void AudioService::EnableDeviceAec(bool enable) {
     }
 
     audio_processor_->EnableDeviceAec(enable);
+
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    device_aec_enabled_ = enable;
+    dtx_gate_.SetEnabled(dtx_requested_ && !device_aec_enabled_);
+}
+
+void AudioService::EnableDtx(bool enable) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    dtx_requested_ = enable;
+    // The AFE runs no VAD while device AEC is on, nothing would open the gate again
+    dtx_gate_.SetEnabled(dtx_requested_ && !device_aec_enabled_);
+    if (enable && device_aec_enabled_) {
+        ESP_LOGW(TAG, "DTX is not available with device AEC");
+    }
 }
 
 void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
@@ -624,6 +691,11 @@ bool AudioService::IsIdle() {
     return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
 }
 
+AudioQueueDepth AudioService::GetQueueDepth() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    return {(int)audio_encode_queue_.size(), (int)audio_decode_queue_.size(), (int)audio_playback_queue_.size()};
+}
+
 void AudioService::ResetDecoder() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     opus_decoder_->ResetState();
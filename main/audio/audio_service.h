@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <deque>
+#include <atomic>
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
@@ -21,6 +22,8 @@
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
+#include "dtx_gate.h"
+#include "cpu_governor_policy.h"
 #include "protocol.h"
 
 
@@ -46,6 +49,11 @@
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
 
+// Discontinuous transmission of the uplink in realtime mode, see dtx_gate.h
+#define DTX_HANGOVER_MS 600
+#define DTX_PRE_ROLL_MS 300
+#define DTX_SID_INTERVAL_MS 960
+
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
@@ -70,6 +78,7 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    bool voice = false;
 };
 
 struct DebugStatistics {
@@ -91,7 +100,10 @@ public:
     std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
     const std::string& GetLastWakeWord() const;
     bool IsVoiceDetected() const { return voice_detected_; }
+    // Loudness of the audio being played, 0 (silence) to 255
+    uint8_t GetOutputLevel() const { return output_level_; }
     bool IsIdle();
+    AudioQueueDepth GetQueueDepth();
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
     bool IsAfeWakeWord();
@@ -100,6 +112,8 @@ public:
     void EnableVoiceProcessing(bool enable);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    void EnableDtx(bool enable);
+    bool IsDtxEnabled() const { return dtx_gate_.enabled(); }
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
@@ -139,12 +153,16 @@ private:
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
     // For server AEC
     std::deque<uint32_t> timestamp_queue_;
+    DtxGate dtx_gate_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
+    bool device_aec_enabled_ = false;
+    bool dtx_requested_ = false;
+    std::atomic<uint8_t> output_level_{0};
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
@@ -0,0 +1,89 @@
+#include "dtx_gate.h"
+
+DtxGate::DtxGate(int hangover, int pre_roll, int sid_interval)
+    : hangover_(hangover), pre_roll_(pre_roll), sid_interval_(sid_interval > 0 ? sid_interval : 1) {
+    Reset();
+}
+
+void DtxGate::Reset() {
+    // A stream opens like the end of an utterance, so the first frames go out until the hangover runs out
+    sending_ = true;
+    hangover_left_ = hangover_;
+    frames_since_sid_ = 0;
+    sequence_ = 0;
+    held_.clear();
+    statistics_ = Statistics();
+}
+
+void DtxGate::SetEnabled(bool enabled) {
+    enabled_ = enabled;
+}
+
+void DtxGate::Process(std::unique_ptr<AudioStreamPacket> packet, bool voice,
+    std::vector<std::unique_ptr<AudioStreamPacket>>& output) {
+    statistics_.frames++;
+    statistics_.input_bytes += packet->payload.size();
+    packet->sequence = sequence_++;
+
+    if (!enabled_) {
+        // Frames held before the gate was disabled still go out in order
+        while (!held_.empty()) {
+            Send(std::move(held_.front()), output);
+            held_.pop_front();
+        }
+        sending_ = true;
+        Send(std::move(packet), output);
+        return;
+    }
+
+    if (voice) {
+        if (!sending_) {
+            while (!held_.empty()) {
+                Send(std::move(held_.front()), output);
+                held_.pop_front();
+            }
+            sending_ = true;
+        }
+        hangover_left_ = hangover_;
+        Send(std::move(packet), output);
+        return;
+    }
+
+    if (sending_) {
+        if (hangover_left_ > 0) {
+            hangover_left_--;
+            Send(std::move(packet), output);
+            return;
+        }
+        sending_ = false;
+        frames_since_sid_ = 0;
+    }
+
+    held_.push_back(std::move(packet));
+    if ((int)held_.size() > pre_roll_) {
+        auto oldest = std::move(held_.front());
+        held_.pop_front();
+        Suppress(std::move(oldest), output);
+    }
+}
+
+void DtxGate::Send(std::unique_ptr<AudioStreamPacket> packet, std::vector<std::unique_ptr<AudioStreamPacket>>& output) {
+    statistics_.sent_frames++;
+    statistics_.output_bytes += packet->payload.size();
+    output.push_back(std::move(packet));
+}
+
+void DtxGate::Suppress(std::unique_ptr<AudioStreamPacket> packet, std::vector<std::unique_ptr<AudioStreamPacket>>& output) {
+    bool sid = frames_since_sid_ == 0;
+    frames_since_sid_ = (frames_since_sid_ + 1) % sid_interval_;
+    if (!sid || packet->payload.empty()) {
+        return;
+    }
+
+    // Keep the TOC byte with the frame count code cleared: one frame, zero bytes long
+    packet->payload.resize(1);
+    packet->payload[0] &= 0xfc;
+    statistics_.sid_frames++;
+    statistics_.output_bytes += 1;
+    output.push_back(std::move(packet));
+}
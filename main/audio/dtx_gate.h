@@ -0,0 +1,66 @@
+#ifndef DTX_GATE_H
+#define DTX_GATE_H
+
+#include <memory>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+#include "protocol.h"
+
+/*
+ * Discontinuous transmission of the uplink, driven by the VAD state of each frame.
+ *
+ * Speech frames are sent as is. When the VAD falls, `hangover` more frames are sent so that
+ * trailing consonants and the start of the pause still reach the server. Then frames are
+ * suppressed, but the last `pre_roll` of them are held back: the VAD rises a few frames
+ * after the speech starts, and the held frames are sent first so the onset is not clipped.
+ *
+ * Every frame gets a sequence number, its index since Reset(). Suppressed frames leave gaps
+ * in it. The first suppressed frame and then every `sid_interval`th one are replaced by a
+ * SID packet: the TOC byte of the Opus packet alone, which Opus decoders treat like the
+ * DTX packets of the Opus encoder and fill with comfort noise. A server that sees a gap
+ * after a SID knows the device is silent, a gap after any other packet means loss.
+ */
+class DtxGate {
+public:
+    struct Statistics {
+        uint32_t frames = 0;
+        uint32_t sent_frames = 0;
+        uint32_t sid_frames = 0;
+        uint32_t input_bytes = 0;
+        uint32_t output_bytes = 0;
+    };
+
+    DtxGate(int hangover, int pre_roll, int sid_interval);
+
+    // Starts a new stream: sequence numbers restart at 0, held frames are dropped
+    void Reset();
+    // When disabled every frame is sent, with its sequence number
+    void SetEnabled(bool enabled);
+    bool enabled() const { return enabled_; }
+
+    // Takes one encoded frame and the VAD state it was captured with, and appends the
+    // packets to send now to output, oldest first
+    void Process(std::unique_ptr<AudioStreamPacket> packet, bool voice,
+        std::vector<std::unique_ptr<AudioStreamPacket>>& output);
+
+    const Statistics& statistics() const { return statistics_; }
+
+private:
+    const int hangover_;
+    const int pre_roll_;
+    const int sid_interval_;
+    bool enabled_ = false;
+    bool sending_ = true;
+    int hangover_left_ = 0;
+    int frames_since_sid_ = 0;
+    uint32_t sequence_ = 0;
+    std::deque<std::unique_ptr<AudioStreamPacket>> held_;
+    Statistics statistics_;
+
+    void Send(std::unique_ptr<AudioStreamPacket> packet, std::vector<std::unique_ptr<AudioStreamPacket>>& output);
+    void Suppress(std::unique_ptr<AudioStreamPacket> packet, std::vector<std::unique_ptr<AudioStreamPacket>>& output);
+};
+
+#endif // DTX_GATE_H
@@ -1,4 +1,5 @@
 #include "afe_audio_processor.h"
+#include "task_stack.h"
 #include <esp_log.h>
 
 #define PROCESSOR_RUNNING 0x01
@@ -71,7 +72,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
         auto this_ = (AfeAudioProcessor*)arg;
         this_->AudioProcessorTask();
         vTaskDelete(NULL);
-    }, "audio_communication", 4096, this, 3, NULL);
+    }, "audio_communication", TASK_STACK_AUDIO_COMMUNICATION, this, 3, NULL);
 }
 
 AfeAudioProcessor::~AfeAudioProcessor() {
@@ -1,5 +1,7 @@
 #include "afe_wake_word.h"
 #include "audio_service.h"
+#include "task_stack.h"
+#include "task_stack_recorder.h"
 
 #include <esp_log.h>
 #include <sstream>
@@ -85,7 +87,7 @@ bool AfeWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list) {
         auto this_ = (AfeWakeWord*)arg;
         this_->AudioDetectionTask();
         vTaskDelete(NULL);
-    }, "audio_detection", 4096, this, 3, nullptr);
+    }, "audio_detection", TASK_STACK_AUDIO_DETECTION, this, 3, nullptr);
 
     return true;
 }
@@ -157,7 +159,7 @@ void AfeWakeWord::StoreWakeWordData(const int16_t* data, size_t samples) {
 }
 
 void AfeWakeWord::EncodeWakeWordData() {
-    const size_t stack_size = 4096 * 7;
+    const size_t stack_size = TASK_STACK_ENCODE_WAKE_WORD;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
         wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
@@ -193,6 +195,9 @@ void AfeWakeWord::EncodeWakeWordData() {
             this_->wake_word_opus_.push_back(std::vector<uint8_t>());
             this_->wake_word_cv_.notify_all();
         }
+#if CONFIG_USE_TASK_STACK_RECORDER
+        TaskStackRecorder::GetInstance().RecordCurrentTask();
+#endif
         vTaskDelete(NULL);
     }, "encode_wake_word", stack_size, this, 2, wake_word_encode_task_stack_, wake_word_encode_task_buffer_);
 }
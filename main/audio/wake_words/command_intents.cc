@@ -0,0 +1,195 @@
+#include "command_intents.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+
+namespace {
+
+class ActionParser {
+public:
+    explicit ActionParser(const std::string& text) : text_(text) {}
+
+    bool Parse(std::string& tool, IntentArguments& arguments) {
+        SkipSpaces();
+        if (!ReadName(tool, true)) {
+            return false;
+        }
+        SkipSpaces();
+        if (Accept('(')) {
+            SkipSpaces();
+            if (!Accept(')')) {
+                do {
+                    SkipSpaces();
+                    std::string name;
+                    IntentValue value;
+                    if (!ReadName(name, false)) {
+                        return false;
+                    }
+                    SkipSpaces();
+                    if (!Accept('=')) {
+                        return false;
+                    }
+                    SkipSpaces();
+                    if (!ReadValue(value) || !arguments.emplace(name, value).second) {
+                        return false;
+                    }
+                    SkipSpaces();
+                } while (Accept(','));
+                if (!Accept(')')) {
+                    return false;
+                }
+            }
+            SkipSpaces();
+        }
+        return pos_ == text_.size();
+    }
+
+private:
+    const std::string& text_;
+    size_t pos_ = 0;
+
+    void SkipSpaces() {
+        while (pos_ < text_.size() && isspace((unsigned char)text_[pos_])) {
+            pos_++;
+        }
+    }
+
+    bool Accept(char c) {
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    // Tool names may contain dots and dashes, argument names may not
+    bool ReadName(std::string& name, bool tool) {
+        size_t start = pos_;
+        while (pos_ < text_.size()) {
+            char c = text_[pos_];
+            if (isalnum((unsigned char)c) || c == '_' || (tool && (c == '.' || c == '-'))) {
+                pos_++;
+            } else {
+                break;
+            }
+        }
+        name = text_.substr(start, pos_ - start);
+        return !name.empty();
+    }
+
+    bool ReadValue(IntentValue& value) {
+        if (pos_ >= text_.size()) {
+            return false;
+        }
+        char c = text_[pos_];
+        if (c == '"' || c == '\'') {
+            pos_++;
+            std::string s;
+            while (pos_ < text_.size() && text_[pos_] != c) {
+                if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) {
+                    pos_++;
+                }
+                s.push_back(text_[pos_++]);
+            }
+            if (!Accept(c)) {
+                return false;
+            }
+            value = s;
+            return true;
+        }
+        if (c == '+' || c == '-' || isdigit((unsigned char)c)) {
+            bool negative = c == '-';
+            if (c == '+' || c == '-') {
+                pos_++;
+            }
+            size_t start = pos_;
+            long long n = 0;
+            while (pos_ < text_.size() && isdigit((unsigned char)text_[pos_])) {
+                n = n * 10 + (text_[pos_++] - '0');
+                if (n > (long long)INT_MAX + 1) {
+                    return false;
+                }
+            }
+            if (pos_ == start) {
+                return false;
+            }
+            n = negative ? -n : n;
+            if (n > INT_MAX || n < INT_MIN) {
+                return false;
+            }
+            value = (int)n;
+            return true;
+        }
+        std::string word;
+        if (!ReadName(word, false)) {
+            return false;
+        }
+        if (word == "true" || word == "false") {
+            value = word == "true";
+            return true;
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+bool ParseIntentAction(const std::string& action, std::string& tool, IntentArguments& arguments) {
+    tool.clear();
+    arguments.clear();
+    return ActionParser(action).Parse(tool, arguments) && tool != "wake";
+}
+
+bool CommandIntentTable::Add(const std::string& text, const std::string& action, float threshold, int cooldown_ms) {
+    CommandIntent intent;
+    intent.text = text;
+    intent.threshold = std::max(threshold, detection_threshold_);
+    intent.cooldown_ms = cooldown_ms;
+    bool ok = true;
+    if (action == "wake") {
+        intent.wake = true;
+    } else if (!ParseIntentAction(action, intent.tool, intent.arguments)) {
+        intent.tool.clear();
+        intent.arguments.clear();
+        ok = false;
+    }
+    intents_.push_back(std::move(intent));
+    return ok;
+}
+
+const CommandIntent* CommandIntentTable::Get(int command_id) const {
+    if (command_id < 1 || command_id > (int)intents_.size()) {
+        return nullptr;
+    }
+    return &intents_[command_id - 1];
+}
+
+IntentDecision CommandIntentTable::Dispatch(int command_id, float probability, int64_t now_ms) {
+    if (command_id < 1 || command_id > (int)intents_.size()) {
+        return kIntentNone;
+    }
+    auto& intent = intents_[command_id - 1];
+    if (intent.wake) {
+        return kIntentWake;
+    }
+    if (intent.tool.empty()) {
+        return kIntentCloud;
+    }
+    if (probability < intent.threshold) {
+        return kIntentNone;
+    }
+    if (intent.has_run && now_ms - intent.last_run_ms < intent.cooldown_ms) {
+        return kIntentCooldown;
+    }
+    return kIntentLocal;
+}
+
+void CommandIntentTable::StartCooldown(int command_id, int64_t now_ms) {
+    if (command_id < 1 || command_id > (int)intents_.size()) {
+        return;
+    }
+    auto& intent = intents_[command_id - 1];
+    intent.has_run = true;
+    intent.last_run_ms = now_ms;
+}
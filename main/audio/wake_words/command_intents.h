@@ -0,0 +1,75 @@
+#ifndef COMMAND_INTENTS_H
+#define COMMAND_INTENTS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+/*
+ * What to do when MultiNet recognizes a command word, from the `action` of the command in
+ * the multinet_model section of the assets index.json:
+ *
+ *   "wake"                                       start a conversation, as a wake word does
+ *   "self.audio_speaker.set_volume(volume=80)"   call an MCP tool on the device itself
+ *   "self.otto.action(action='walk', steps=3)"   string arguments in single or double quotes
+ *   "self.lamp.turn_on"                          a tool without arguments
+ *
+ * A tool command runs locally when MultiNet is at least `threshold` sure of it, and at most
+ * once per `cooldown` milliseconds after a successful call. Below its threshold it is ignored, like a word MultiNet
+ * did not detect. When the action cannot be parsed, or the tool does not exist on the
+ * board, the command text goes to the cloud like a wake word.
+ *
+ * MultiNet reports nothing below its own detection threshold, the `threshold` of the
+ * multinet_model section, so command thresholds below it are raised to it.
+ */
+
+using IntentValue = std::variant<bool, int, std::string>;
+using IntentArguments = std::map<std::string, IntentValue>;
+
+// Parses a tool call action. False if it is not one, tool and arguments are then undefined
+bool ParseIntentAction(const std::string& action, std::string& tool, IntentArguments& arguments);
+
+enum IntentDecision {
+    kIntentNone,        // Unknown command id, or a tool command below its threshold
+    kIntentWake,        // Start a conversation
+    kIntentLocal,       // Call the tool on the device
+    kIntentCloud,       // Not a tool call, send the text to the cloud
+    kIntentCooldown,    // Ran moments ago, ignore the repeat
+};
+
+struct CommandIntent {
+    std::string text;
+    bool wake = false;
+    std::string tool;           // Empty if the action is neither "wake" nor a tool call
+    IntentArguments arguments;
+    float threshold = 0.0f;
+    int cooldown_ms = 0;
+    int64_t last_run_ms = 0;
+    bool has_run = false;
+};
+
+class CommandIntentTable {
+public:
+    // Commands added afterwards have at least this threshold, set it to the MultiNet one
+    void SetDetectionThreshold(float threshold) { detection_threshold_ = threshold; }
+    // Adds the command with the next id, MultiNet ids start at 1. False if the action is
+    // not understood, the command then falls back to the cloud
+    bool Add(const std::string& text, const std::string& action, float threshold, int cooldown_ms);
+    void Clear() { intents_.clear(); }
+    size_t size() const { return intents_.size(); }
+
+    // Decides what to do with a recognized command
+    IntentDecision Dispatch(int command_id, float probability, int64_t now_ms);
+    // After a local decision, once the tool call was accepted. A call that failed and went
+    // to the cloud instead leaves the command free to run again
+    void StartCooldown(int command_id, int64_t now_ms);
+    const CommandIntent* Get(int command_id) const;
+
+private:
+    std::vector<CommandIntent> intents_;
+    float detection_threshold_ = 0.0f;
+};
+
+#endif // COMMAND_INTENTS_H
@@ -1,7 +1,10 @@
 #include "custom_wake_word.h"
 #include "audio_service.h"
+#include "task_stack.h"
+#include "task_stack_recorder.h"
 #include "system_info.h"
 #include "assets.h"
+#include "mcp_server.h"
 
 #include <esp_log.h>
 #include <esp_mn_iface.h>
@@ -12,6 +15,9 @@
 
 #define TAG "CustomWakeWord"
 
+// A local command is not run again within this time unless index.json sets its cooldown
+#define DEFAULT_COMMAND_COOLDOWN_MS 1500
+
 
 CustomWakeWord::CustomWakeWord()
     : wake_word_pcm_(), wake_word_opus_() {
@@ -65,6 +71,7 @@ void CustomWakeWord::ParseWakenetModelConfig() {
         if (cJSON_IsNumber(threshold)) {
             threshold_ = threshold->valuedouble;
         }
+        intents_.SetDetectionThreshold(threshold_);
         if (cJSON_IsArray(commands)) {
             for (int i = 0; i < cJSON_GetArraySize(commands); i++) {
                 cJSON* command = cJSON_GetArrayItem(commands, i);
@@ -72,9 +79,12 @@ void CustomWakeWord::ParseWakenetModelConfig() {
                     cJSON* command_name = cJSON_GetObjectItem(command, "command");
                     cJSON* text = cJSON_GetObjectItem(command, "text");
                     cJSON* action = cJSON_GetObjectItem(command, "action");
+                    cJSON* command_threshold = cJSON_GetObjectItem(command, "threshold");
+                    cJSON* cooldown = cJSON_GetObjectItem(command, "cooldown");
                     if (cJSON_IsString(command_name) && cJSON_IsString(text) && cJSON_IsString(action)) {
-                        commands_.push_back({command_name->valuestring, text->valuestring, action->valuestring});
-                        ESP_LOGI(TAG, "Command: %s, Text: %s, Action: %s", command_name->valuestring, text->valuestring, action->valuestring);
+                        AddCommand(command_name->valuestring, text->valuestring, action->valuestring,
+                            cJSON_IsNumber(command_threshold) ? command_threshold->valuedouble : threshold_,
+                            cJSON_IsNumber(cooldown) ? cooldown->valueint : DEFAULT_COMMAND_COOLDOWN_MS);
                     }
                 }
             }
@@ -83,17 +93,32 @@ void CustomWakeWord::ParseWakenetModelConfig() {
     cJSON_Delete(root);
 }
 
+void CustomWakeWord::AddCommand(const std::string& command, const std::string& text, const std::string& action,
+    float threshold, int cooldown_ms) {
+    commands_.push_back({command, text, action});
+    if (!intents_.Add(text, action, threshold, cooldown_ms)) {
+        ESP_LOGW(TAG, "Command %s: action '%s' is not understood, it will go to the cloud", text.c_str(), action.c_str());
+    }
+    if (threshold < threshold_) {
+        ESP_LOGW(TAG, "Command %s: threshold %.2f is below the detection threshold, using %.2f", text.c_str(),
+            threshold, threshold_);
+    }
+    ESP_LOGI(TAG, "Command: %s, Text: %s, Action: %s", command.c_str(), text.c_str(), action.c_str());
+}
+
 
 bool CustomWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list) {
     codec_ = codec;
     commands_.clear();
+    intents_.Clear();
 
     if (models_list == nullptr) {
         language_ = "cn";
         models_ = esp_srmodel_init("model");
 #ifdef CONFIG_CUSTOM_WAKE_WORD
         threshold_ = CONFIG_CUSTOM_WAKE_WORD_THRESHOLD / 100.0f;
-        commands_.push_back({CONFIG_CUSTOM_WAKE_WORD, CONFIG_CUSTOM_WAKE_WORD_DISPLAY, "wake"});
+        intents_.SetDetectionThreshold(threshold_);
+        AddCommand(CONFIG_CUSTOM_WAKE_WORD, CONFIG_CUSTOM_WAKE_WORD_DISPLAY, "wake", threshold_, 0);
 #endif
     } else {
         models_ = models_list;
@@ -169,14 +194,24 @@ void CustomWakeWord::Feed(const std::vector<int16_t>& data) {
         for (int i = 0; i < mn_result->num && running_; i++) {
             ESP_LOGI(TAG, "Custom wake word detected: command_id=%d, string=%s, prob=%f", 
                     mn_result->command_id[i], mn_result->string, mn_result->prob[i]);
-            auto& command = commands_[mn_result->command_id[i] - 1];
-            if (command.action == "wake") {
-                last_detected_wake_word_ = command.text;
-                running_ = false;
-                
-                if (wake_word_detected_callback_) {
-                    wake_word_detected_callback_(last_detected_wake_word_);
-                }
+            int command_id = mn_result->command_id[i];
+            auto decision = intents_.Dispatch(command_id, mn_result->prob[i], esp_timer_get_time() / 1000);
+            auto intent = intents_.Get(command_id);
+            if (decision == kIntentNone || decision == kIntentCooldown) {
+                continue;
+            }
+            // Local commands skip the cloud, unless the tool is missing on this board
+            if (decision == kIntentLocal && McpServer::GetInstance().CallTool(intent->tool, intent->arguments)) {
+                intents_.StartCooldown(command_id, esp_timer_get_time() / 1000);
+                ESP_LOGI(TAG, "Local command: %s -> %s", intent->text.c_str(), intent->tool.c_str());
+                continue;
+            }
+
+            last_detected_wake_word_ = intent->text;
+            running_ = false;
+            
+            if (wake_word_detected_callback_) {
+                wake_word_detected_callback_(last_detected_wake_word_);
             }
         }
         multinet_->clean(multinet_model_data_);
@@ -203,7 +238,7 @@ void CustomWakeWord::StoreWakeWordData(const std::vector<int16_t>& data) {
 }
 
 void CustomWakeWord::EncodeWakeWordData() {
-    const size_t stack_size = 4096 * 7;
+    const size_t stack_size = TASK_STACK_ENCODE_WAKE_WORD;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
         wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
@@ -239,6 +274,9 @@ void CustomWakeWord::EncodeWakeWordData() {
             this_->wake_word_opus_.push_back(std::vector<uint8_t>());
             this_->wake_word_cv_.notify_all();
         }
+#if CONFIG_USE_TASK_STACK_RECORDER
+        TaskStackRecorder::GetInstance().RecordCurrentTask();
+#endif
         vTaskDelete(NULL);
     }, "encode_wake_word", stack_size, this, 2, wake_word_encode_task_stack_, wake_word_encode_task_buffer_);
 }
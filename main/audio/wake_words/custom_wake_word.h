@@ -16,6 +16,7 @@
 
 #include "audio_codec.h"
 #include "wake_word.h"
+#include "command_intents.h"
 
 class CustomWakeWord : public WakeWord {
 public:
@@ -48,6 +49,8 @@ private:
     int duration_ = 3000;
     float threshold_ = 0.2;
     std::deque<Command> commands_;
+    // What each command does, by MultiNet command id
+    CommandIntentTable intents_;
  
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
     AudioCodec* codec_ = nullptr;
@@ -64,6 +67,8 @@ private:
 
     void StoreWakeWordData(const std::vector<int16_t>& data);
     void ParseWakenetModelConfig();
+    void AddCommand(const std::string& command, const std::string& text, const std::string& action,
+        float threshold, int cooldown_ms);
 };
 
 #endif
@@ -0,0 +1,259 @@
+#include "afsk_dsp.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "esp_log.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TAG "AUDIO_WIFI_CONFIG"
+
+namespace audio_wifi_config
+{
+    // Damping of the sliding DFT. The oldest sample of a 64 sample window is weighted
+    // 0.9999^63 = 0.994, and an error in the bin fades out within a few seconds
+    static const double kDetectorDamping = 0.9999;
+    // The fixed-point bin keeps 4 fraction bits, so rounding stays far below one input step
+    static const int kFixedStateShift = 4;
+    static const int kFixedCoefficientShift = 30;
+
+    static size_t GreatestCommonDivisor(size_t a, size_t b) {
+        while (b != 0) {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    static inline int16_t SaturateToInt16(int32_t value) {
+        if (value > INT16_MAX) {
+            return INT16_MAX;
+        }
+        if (value < INT16_MIN) {
+            return INT16_MIN;
+        }
+        return static_cast<int16_t>(value);
+    }
+
+    // PolyphaseDecimator implementation
+    PolyphaseDecimator::PolyphaseDecimator(size_t input_rate, size_t output_rate, bool fixed_point,
+                                           size_t taps_per_phase)
+        : taps_per_phase_(taps_per_phase), fixed_point_(fixed_point) {
+        size_t divisor = GreatestCommonDivisor(input_rate, output_rate);
+        interpolation_ = output_rate / divisor;
+        decimation_ = input_rate / divisor;
+
+        // Hamming windowed sinc at the upsampled rate, cut off at 90% of the lower Nyquist frequency
+        size_t length = interpolation_ * taps_per_phase_;
+        double upsampled_rate = static_cast<double>(input_rate) * interpolation_;
+        double cutoff = 0.45 * static_cast<double>(std::min(input_rate, output_rate)) / upsampled_rate;
+        std::vector<double> prototype(length);
+        double sum = 0.0;
+        for (size_t n = 0; n < length; ++n) {
+            double t = static_cast<double>(n) - (length - 1) / 2.0;
+            double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * M_PI * cutoff * t) / (2.0 * M_PI * cutoff * t);
+            double window = 0.54 - 0.46 * std::cos(2.0 * M_PI * n / (length - 1));
+            prototype[n] = sinc * window;
+            sum += prototype[n];
+        }
+
+        // Every phase sees one input sample in L of the zero-stuffed signal, so the DC gain is L
+        taps_.resize(length);
+        fixed_taps_.resize(length);
+        for (size_t phase = 0; phase < interpolation_; ++phase) {
+            for (size_t m = 0; m < taps_per_phase_; ++m) {
+                double tap = prototype[phase + (taps_per_phase_ - 1 - m) * interpolation_] * interpolation_ / sum;
+                taps_[phase * taps_per_phase_ + m] = static_cast<float>(tap);
+                fixed_taps_[phase * taps_per_phase_ + m] = static_cast<int16_t>(std::lround(tap * 32768.0));
+            }
+        }
+
+        history_.resize(2 * taps_per_phase_);
+        float_history_.resize(2 * taps_per_phase_);
+        Reset();
+    }
+
+    void PolyphaseDecimator::Reset() {
+        std::fill(history_.begin(), history_.end(), 0);
+        std::fill(float_history_.begin(), float_history_.end(), 0.0f);
+        history_position_ = 0;
+        phase_ = 0;
+    }
+
+    size_t PolyphaseDecimator::MaxOutputSize(size_t count) const {
+        return (count * interpolation_ + decimation_ - 1) / decimation_ + 1;
+    }
+
+    size_t PolyphaseDecimator::Process(const int16_t *input, size_t count, int16_t *output) {
+        size_t written = 0;
+        for (size_t i = 0; i < count; ++i) {
+            // Each path keeps only the history it reads, the float one converts every sample once
+            if (fixed_point_) {
+                history_[history_position_] = input[i];
+                history_[history_position_ + taps_per_phase_] = input[i];
+            } else {
+                float_history_[history_position_] = input[i];
+                float_history_[history_position_ + taps_per_phase_] = input[i];
+            }
+            if (++history_position_ == taps_per_phase_) {
+                history_position_ = 0;
+            }
+
+            // Outputs falling on this input sample, one filter phase each
+            while (phase_ < interpolation_) {
+                if (fixed_point_) {
+                    const int16_t *window = &history_[history_position_];
+                    const int16_t *taps = &fixed_taps_[phase_ * taps_per_phase_];
+                    int32_t acc = 1 << 14;
+                    for (size_t m = 0; m < taps_per_phase_; ++m) {
+                        acc += static_cast<int32_t>(taps[m]) * window[m];
+                    }
+                    output[written++] = SaturateToInt16(acc >> 15);
+                } else {
+                    const float *window = &float_history_[history_position_];
+                    const float *taps = &taps_[phase_ * taps_per_phase_];
+                    // Four independent sums, so the multiply-adds do not wait on each other
+                    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    size_t m = 0;
+                    for (; m + 4 <= taps_per_phase_; m += 4) {
+                        acc[0] += taps[m] * window[m];
+                        acc[1] += taps[m + 1] * window[m + 1];
+                        acc[2] += taps[m + 2] * window[m + 2];
+                        acc[3] += taps[m + 3] * window[m + 3];
+                    }
+                    for (; m < taps_per_phase_; ++m) {
+                        acc[0] += taps[m] * window[m];
+                    }
+                    float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+                    output[written++] = SaturateToInt16(static_cast<int32_t>(std::lrint(sum)));
+                }
+                phase_ += decimation_;
+            }
+            phase_ -= interpolation_;
+        }
+        return written;
+    }
+
+    // FrequencyDetector implementation
+    FrequencyDetector::FrequencyDetector(float frequency, size_t window_size, bool fixed_point)
+        : window_size_(window_size), fixed_point_(fixed_point) {
+        double angular_frequency = 2.0 * M_PI * frequency;
+        double leave_gain = std::pow(kDetectorDamping, static_cast<double>(window_size_));
+        double rotate_re = kDetectorDamping * std::cos(angular_frequency);
+        double rotate_im = kDetectorDamping * std::sin(angular_frequency);
+        double leave_re = leave_gain * std::cos(angular_frequency * window_size_);
+        double leave_im = leave_gain * std::sin(angular_frequency * window_size_);
+
+        rotate_re_ = static_cast<float>(rotate_re);
+        rotate_im_ = static_cast<float>(rotate_im);
+        leave_re_ = static_cast<float>(leave_re);
+        leave_im_ = static_cast<float>(leave_im);
+
+        const double one = static_cast<double>(1 << kFixedCoefficientShift);
+        fixed_rotate_re_ = static_cast<int32_t>(std::lround(rotate_re * one));
+        fixed_rotate_im_ = static_cast<int32_t>(std::lround(rotate_im * one));
+        fixed_leave_re_ = static_cast<int32_t>(std::lround(leave_re * one));
+        fixed_leave_im_ = static_cast<int32_t>(std::lround(leave_im * one));
+
+        Reset();
+    }
+
+    void FrequencyDetector::Reset() {
+        state_re_ = 0.0f;
+        state_im_ = 0.0f;
+        fixed_state_re_ = 0;
+        fixed_state_im_ = 0;
+    }
+
+    void FrequencyDetector::ProcessSample(int16_t sample, int16_t leaving_sample) {
+        // S[n] = x[n] + r * e^(jw) * S[n-1] - r^N * e^(jwN) * x[n-N]
+        if (fixed_point_) {
+            const int64_t round = int64_t(1) << (kFixedCoefficientShift - 1);
+            int64_t leaving = static_cast<int64_t>(leaving_sample) << kFixedStateShift;
+            int64_t re = static_cast<int64_t>(fixed_rotate_re_) * fixed_state_re_ -
+                         static_cast<int64_t>(fixed_rotate_im_) * fixed_state_im_ - fixed_leave_re_ * leaving;
+            int64_t im = static_cast<int64_t>(fixed_rotate_re_) * fixed_state_im_ +
+                         static_cast<int64_t>(fixed_rotate_im_) * fixed_state_re_ - fixed_leave_im_ * leaving;
+            fixed_state_re_ = static_cast<int32_t>((re + round) >> kFixedCoefficientShift) +
+                              (static_cast<int32_t>(sample) << kFixedStateShift);
+            fixed_state_im_ = static_cast<int32_t>((im + round) >> kFixedCoefficientShift);
+            return;
+        }
+
+        float x = sample;
+        float leaving = leaving_sample;
+        float re = x + rotate_re_ * state_re_ - rotate_im_ * state_im_ - leave_re_ * leaving;
+        float im = rotate_re_ * state_im_ + rotate_im_ * state_re_ - leave_im_ * leaving;
+        state_re_ = re;
+        state_im_ = im;
+    }
+
+    float FrequencyDetector::GetAmplitude() const {
+        float re = state_re_;
+        float im = state_im_;
+        if (fixed_point_) {
+            re = static_cast<float>(fixed_state_re_) / (1 << kFixedStateShift);
+            im = static_cast<float>(fixed_state_im_) / (1 << kFixedStateShift);
+        }
+        return std::sqrt(re * re + im * im) / (static_cast<float>(window_size_) / 2.0f);
+    }
+
+    // AudioSignalProcessor implementation
+    AudioSignalProcessor::AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
+                                             size_t bit_rate, size_t window_size, bool fixed_point)
+        : window_(window_size),
+          samples_per_bit_(sample_rate / bit_rate),
+          mark_detector_(static_cast<float>(mark_frequency) / static_cast<float>(sample_rate), window_size,
+                         fixed_point),
+          space_detector_(static_cast<float>(space_frequency) / static_cast<float>(sample_rate), window_size,
+                          fixed_point) {
+        if (sample_rate % bit_rate != 0) {
+            // On ESP32 we can continue execution, but log the error
+            ESP_LOGW(TAG, "Sample rate %zu is not divisible by bit rate %zu", sample_rate, bit_rate);
+        }
+        Reset();
+    }
+
+    void AudioSignalProcessor::Reset() {
+        std::fill(window_.begin(), window_.end(), 0);
+        window_position_ = 0;
+        window_fill_ = 0;
+        output_sample_count_ = 0;
+        mark_detector_.Reset();
+        space_detector_.Reset();
+    }
+
+    void AudioSignalProcessor::ProcessAudioSamples(const int16_t *samples, size_t count,
+                                                   std::vector<float> &probabilities) {
+        for (size_t i = 0; i < count; ++i) {
+            int16_t sample = samples[i];
+            int16_t leaving_sample = window_[window_position_];
+            window_[window_position_] = sample;
+            if (++window_position_ == window_.size()) {
+                window_position_ = 0;
+            }
+            mark_detector_.ProcessSample(sample, leaving_sample);
+            space_detector_.ProcessSample(sample, leaving_sample);
+
+            if (window_fill_ < window_.size()) {
+                window_fill_++;  // Just fill the window, don't decide yet
+                continue;
+            }
+
+            // A decision every bit period, on the last window_size samples
+            if (++output_sample_count_ >= samples_per_bit_) {
+                float mark_amplitude = mark_detector_.GetAmplitude();   // Mark amplitude
+                float space_amplitude = space_detector_.GetAmplitude(); // Space amplitude
+
+                // Avoid division by zero
+                float mark_probability = mark_amplitude /
+                                       (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
+                probabilities.push_back(mark_probability);
+                output_sample_count_ = 0;  // Reset output counter
+            }
+        }
+    }
+}
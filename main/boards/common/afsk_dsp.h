@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Audio signal processing constants for WiFi configuration via audio
+const size_t kAudioSampleRate = 6400;
+const size_t kMarkFrequency = 1800;
+const size_t kSpaceFrequency = 1500;
+const size_t kBitRate = 100;
+const size_t kWindowSize = 64;
+
+namespace audio_wifi_config
+{
+    /**
+     * Polyphase FIR resampler by L/M, used to bring the 16 kHz microphone input down to
+     * kAudioSampleRate. The low-pass filter removes everything above the output Nyquist
+     * frequency before decimation, so noise above 3.2 kHz no longer folds onto the Mark and
+     * Space tones. Only the filter phase of each output sample is computed.
+     *
+     * 24 taps per phase keep the folding bands more than 50dB down at a cost close to the
+     * naive decimation. The fixed-point path uses Q15 taps and 32-bit accumulators, for
+     * targets without an FPU.
+     */
+    class PolyphaseDecimator
+    {
+    private:
+        size_t interpolation_;              // L
+        size_t decimation_;                 // M
+        size_t taps_per_phase_;             // K, the prototype filter has L * K taps
+        bool fixed_point_;
+        std::vector<float> taps_;           // L phases of K taps, each in history order (oldest first)
+        std::vector<int16_t> fixed_taps_;   // The same in Q15
+        std::vector<int16_t> history_;      // Last K input samples, written twice so a window is contiguous
+        std::vector<float> float_history_;  // The same as float, for the float path
+        size_t history_position_;           // Oldest sample of the window
+        size_t phase_;                      // Upsampled position of the next output, relative to the last input
+
+    public:
+        /**
+         * Constructor
+         * @param input_rate Input sampling rate
+         * @param output_rate Output sampling rate, below input_rate * L
+         * @param fixed_point Filter in Q15 instead of float
+         * @param taps_per_phase Filter length per polyphase branch
+         */
+        PolyphaseDecimator(size_t input_rate, size_t output_rate, bool fixed_point = false,
+                           size_t taps_per_phase = 24);
+
+        /**
+         * Clear the filter history
+         */
+        void Reset();
+
+        /**
+         * Maximum number of output samples for count input samples
+         */
+        size_t MaxOutputSize(size_t count) const;
+
+        /**
+         * Filter and resample input samples
+         * @param input Input samples
+         * @param count Number of input samples
+         * @param output At least MaxOutputSize(count) samples
+         * @return Number of output samples written
+         */
+        size_t Process(const int16_t *input, size_t count, int16_t *output);
+    };
+
+    /**
+     * Sliding DFT for single frequency detection: the DFT bin of the last window_size
+     * samples is updated in O(1) per sample, and its amplitude can be read after any sample.
+     * The recursion is slightly damped (r < 1) so rounding errors decay instead of building up.
+     *
+     * The fixed-point path keeps the bin in 32-bit integers with Q30 coefficients.
+     */
+    class FrequencyDetector
+    {
+    private:
+        size_t window_size_;           // Window size for analysis
+        bool fixed_point_;
+        float rotate_re_;              // r * e^(jw), applied to the bin every sample
+        float rotate_im_;
+        float leave_re_;               // r^N * e^(jwN), applied to the sample leaving the window
+        float leave_im_;
+        float state_re_;               // Current bin
+        float state_im_;
+        int32_t fixed_rotate_re_;      // Q30 coefficients of the fixed-point path
+        int32_t fixed_rotate_im_;
+        int32_t fixed_leave_re_;
+        int32_t fixed_leave_im_;
+        int32_t fixed_state_re_;
+        int32_t fixed_state_im_;
+
+    public:
+        /**
+         * Constructor
+         * @param frequency Normalized frequency (f / fs)
+         * @param window_size Window size for analysis
+         * @param fixed_point Use the integer recursion
+         */
+        FrequencyDetector(float frequency, size_t window_size, bool fixed_point = false);
+
+        /**
+         * Reset the detector state
+         */
+        void Reset();
+
+        /**
+         * Slide the window by one sample
+         * @param sample Sample entering the window
+         * @param leaving_sample Sample leaving the window, window_size samples older
+         */
+        void ProcessSample(int16_t sample, int16_t leaving_sample);
+
+        /**
+         * Calculate current amplitude
+         * @return Amplitude value
+         */
+        float GetAmplitude() const;
+    };
+
+    /**
+     * Audio signal processor for Mark/Space frequency pair detection
+     * Processes audio signals to extract digital data using AFSK demodulation
+     */
+    class AudioSignalProcessor
+    {
+    private:
+        std::vector<int16_t> window_;                // Last window_size samples, a fixed ring
+        size_t window_position_;                     // Oldest sample of the window
+        size_t window_fill_;                         // Samples received until the window is full
+        size_t output_sample_count_;                 // Output sample counter
+        size_t samples_per_bit_;                     // Samples per bit threshold
+        FrequencyDetector mark_detector_;            // Mark frequency detector
+        FrequencyDetector space_detector_;           // Space frequency detector
+
+    public:
+        /**
+         * Constructor
+         * @param sample_rate Audio sampling rate
+         * @param mark_frequency Mark frequency for digital '1'
+         * @param space_frequency Space frequency for digital '0'
+         * @param bit_rate Data transmission bit rate
+         * @param window_size Analysis window size
+         * @param fixed_point Use the fixed-point detectors
+         */
+        AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
+                           size_t bit_rate, size_t window_size, bool fixed_point = false);
+
+        /**
+         * Reset the window and the detectors
+         */
+        void Reset();
+
+        /**
+         * Process input audio samples
+         * @param samples Input audio samples
+         * @param count Number of samples
+         * @param probabilities Mark probability values (0.0 to 1.0) are appended, one per bit
+         */
+        void ProcessAudioSamples(const int16_t *samples, size_t count, std::vector<float> &probabilities);
+    };
+}
@@ -0,0 +1,532 @@
+#include "afsk_frame.h"
+#include <algorithm>
+#include "esp_log.h"
+
+#define TAG "AUDIO_WIFI_CONFIG"
+
+namespace audio_wifi_config
+{
+    static const uint8_t kFrameStartByte = 0x01;
+    static const uint8_t kFrameVersionMark = 0x20;      // Second preamble byte is 0x20 | version
+    static const size_t kFrameHeaderParitySize = 6;
+    static const size_t kFrameBlockDataSize = 16;
+    static const size_t kFrameBlockParitySize = 8;
+    static const size_t kFrameMaxBlockCount =
+        (kFrameMaxPayloadSize + 2 + kFrameBlockDataSize - 1) / kFrameBlockDataSize;
+
+    // GF(256) with the polynomial x^8 + x^4 + x^3 + x^2 + 1, exp is doubled to skip the modulo
+    struct GaloisField
+    {
+        uint8_t exp[512];
+        uint8_t log[256];
+
+        GaloisField() {
+            int x = 1;
+            for (int i = 0; i < 255; ++i) {
+                exp[i] = static_cast<uint8_t>(x);
+                log[x] = static_cast<uint8_t>(i);
+                x <<= 1;
+                if (x & 0x100) {
+                    x ^= 0x11d;
+                }
+            }
+            for (int i = 255; i < 512; ++i) {
+                exp[i] = exp[i - 255];
+            }
+            log[0] = 0;
+        }
+
+        uint8_t Multiply(uint8_t a, uint8_t b) const {
+            return (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+        }
+
+        // b must not be 0
+        uint8_t Divide(uint8_t a, uint8_t b) const {
+            return a == 0 ? 0 : exp[log[a] + 255 - log[b]];
+        }
+
+        uint8_t Power(int e) const {
+            e %= 255;
+            return exp[e < 0 ? e + 255 : e];
+        }
+    };
+
+    static const GaloisField &GetGaloisField() {
+        static const GaloisField field;
+        return field;
+    }
+
+    // ReedSolomon implementation
+    ReedSolomon::ReedSolomon(size_t parity_size)
+        : parity_size_(std::min(parity_size, kMaxParitySize)) {
+        const GaloisField &gf = GetGaloisField();
+        // g(x) = (x - a^0)(x - a^1)...(x - a^(parity - 1))
+        std::fill(generator_, generator_ + kMaxParitySize + 1, 0);
+        generator_[0] = 1;
+        for (size_t i = 0; i < parity_size_; ++i) {
+            uint8_t root = gf.Power(static_cast<int>(i));
+            for (size_t j = i + 1; j > 0; --j) {
+                generator_[j] ^= gf.Multiply(generator_[j - 1], root);
+            }
+        }
+    }
+
+    void ReedSolomon::Encode(const uint8_t *data, size_t size, uint8_t *parity) const {
+        const GaloisField &gf = GetGaloisField();
+        std::fill(parity, parity + parity_size_, 0);
+        for (size_t i = 0; i < size; ++i) {
+            uint8_t feedback = data[i] ^ parity[0];
+            std::copy(parity + 1, parity + parity_size_, parity);
+            parity[parity_size_ - 1] = 0;
+            if (feedback != 0) {
+                for (size_t j = 0; j < parity_size_; ++j) {
+                    parity[j] ^= gf.Multiply(feedback, generator_[j + 1]);
+                }
+            }
+        }
+    }
+
+    int ReedSolomon::Decode(uint8_t *codeword, size_t size) const {
+        const GaloisField &gf = GetGaloisField();
+        if (size <= parity_size_ || size > 255) {
+            return -1;
+        }
+
+        // Syndromes S_j = c(a^j)
+        uint8_t syndromes[kMaxParitySize];
+        bool has_errors = false;
+        for (size_t j = 0; j < parity_size_; ++j) {
+            uint8_t root = gf.Power(static_cast<int>(j));
+            uint8_t s = 0;
+            for (size_t i = 0; i < size; ++i) {
+                s = gf.Multiply(s, root) ^ codeword[i];
+            }
+            syndromes[j] = s;
+            has_errors |= s != 0;
+        }
+        if (!has_errors) {
+            return 0;
+        }
+
+        // Berlekamp-Massey: error locator polynomial, lowest degree first
+        uint8_t locator[kMaxParitySize + 1] = {1};
+        uint8_t previous[kMaxParitySize + 1] = {1};
+        uint8_t saved[kMaxParitySize + 1];
+        size_t degree = 0;
+        size_t shift = 1;
+        uint8_t previous_discrepancy = 1;
+        for (size_t r = 0; r < parity_size_; ++r) {
+            uint8_t discrepancy = syndromes[r];
+            for (size_t i = 1; i <= degree; ++i) {
+                discrepancy ^= gf.Multiply(locator[i], syndromes[r - i]);
+            }
+            if (discrepancy == 0) {
+                shift++;
+                continue;
+            }
+            uint8_t scale = gf.Divide(discrepancy, previous_discrepancy);
+            bool grow = 2 * degree <= r;
+            if (grow) {
+                std::copy(locator, locator + kMaxParitySize + 1, saved);
+            }
+            for (size_t i = 0; i + shift <= parity_size_; ++i) {
+                locator[i + shift] ^= gf.Multiply(scale, previous[i]);
+            }
+            if (grow) {
+                degree = r + 1 - degree;
+                std::copy(saved, saved + kMaxParitySize + 1, previous);
+                previous_discrepancy = discrepancy;
+                shift = 1;
+            } else {
+                shift++;
+            }
+        }
+        if (2 * degree > parity_size_) {
+            return -1;
+        }
+
+        // Error evaluator polynomial: S(x) * locator(x) mod x^parity
+        uint8_t evaluator[kMaxParitySize];
+        for (size_t k = 0; k < parity_size_; ++k) {
+            uint8_t v = 0;
+            for (size_t i = 0; i <= std::min(k, degree); ++i) {
+                v ^= gf.Multiply(syndromes[k - i], locator[i]);
+            }
+            evaluator[k] = v;
+        }
+
+        // Chien search for the roots a^-p, p = size - 1 - i, then Forney for the error values
+        size_t found = 0;
+        for (size_t i = 0; i < size; ++i) {
+            int position = static_cast<int>(size - 1 - i);
+            uint8_t x_inverse = gf.Power(-position);
+            uint8_t value = 0;
+            uint8_t power = 1;
+            for (size_t k = 0; k <= degree; ++k) {
+                value ^= gf.Multiply(locator[k], power);
+                power = gf.Multiply(power, x_inverse);
+            }
+            if (value != 0) {
+                continue;
+            }
+
+            uint8_t numerator = 0;
+            power = 1;
+            for (size_t k = 0; k < parity_size_; ++k) {
+                numerator ^= gf.Multiply(evaluator[k], power);
+                power = gf.Multiply(power, x_inverse);
+            }
+            // Formal derivative: only the odd terms remain in GF(2^m)
+            uint8_t denominator = 0;
+            uint8_t x_inverse_squared = gf.Multiply(x_inverse, x_inverse);
+            power = 1;
+            for (size_t k = 1; k <= degree; k += 2) {
+                denominator ^= gf.Multiply(locator[k], power);
+                power = gf.Multiply(power, x_inverse_squared);
+            }
+            if (denominator == 0) {
+                return -1;
+            }
+            codeword[i] ^= gf.Multiply(gf.Power(position), gf.Divide(numerator, denominator));
+            found++;
+        }
+        if (found != degree) {
+            return -1;
+        }
+        return static_cast<int>(found);
+    }
+
+    uint16_t CalculateCrc16(const uint8_t *data, size_t size) {
+        uint16_t crc = 0xffff;
+        for (size_t i = 0; i < size; ++i) {
+            crc ^= static_cast<uint16_t>(data[i]) << 8;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    static size_t GetFrameBlockCount(size_t payload_size) {
+        return (payload_size + 2 + kFrameBlockDataSize - 1) / kFrameBlockDataSize;
+    }
+
+    size_t GetFrameBodySize(size_t payload_size) {
+        return payload_size + 2 + GetFrameBlockCount(payload_size) * kFrameBlockParitySize;
+    }
+
+    // Data byte j goes to block j % blocks, so the blocks differ in size by at most one byte
+    static size_t GetFrameBlockDataSize(size_t data_size, size_t blocks, size_t block) {
+        return (data_size - block + blocks - 1) / blocks;
+    }
+
+    std::vector<uint8_t> EncodeFrame(const std::string &text) {
+        if (text.size() > kFrameMaxPayloadSize) {
+            return {};
+        }
+        std::vector<uint8_t> frame = {kFrameStartByte, static_cast<uint8_t>(kFrameVersionMark | kFrameVersion)};
+
+        uint8_t header[kFrameHeaderSize] = {static_cast<uint8_t>(text.size()), 0};
+        ReedSolomon(kFrameHeaderParitySize).Encode(header, kFrameHeaderSize - kFrameHeaderParitySize,
+                                                   header + kFrameHeaderSize - kFrameHeaderParitySize);
+        frame.insert(frame.end(), header, header + kFrameHeaderSize);
+
+        std::vector<uint8_t> data(text.begin(), text.end());
+        uint16_t crc = CalculateCrc16(data.data(), data.size());
+        data.push_back(static_cast<uint8_t>(crc >> 8));
+        data.push_back(static_cast<uint8_t>(crc));
+
+        size_t blocks = GetFrameBlockCount(text.size());
+        uint8_t codewords[kFrameMaxBlockCount][kFrameBlockDataSize + kFrameBlockParitySize];
+        ReedSolomon code(kFrameBlockParitySize);
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t data_size = GetFrameBlockDataSize(data.size(), blocks, b);
+            for (size_t k = 0; k < data_size; ++k) {
+                codewords[b][k] = data[k * blocks + b];
+            }
+            code.Encode(codewords[b], data_size, codewords[b] + data_size);
+        }
+
+        // Interleave: byte r of every block, then byte r + 1
+        for (size_t r = 0; r < kFrameBlockDataSize + kFrameBlockParitySize; ++r) {
+            for (size_t b = 0; b < blocks; ++b) {
+                if (r < GetFrameBlockDataSize(data.size(), blocks, b) + kFrameBlockParitySize) {
+                    frame.push_back(codewords[b][r]);
+                }
+            }
+        }
+        return frame;
+    }
+
+    bool DecodeFrameHeader(uint8_t *header, size_t *payload_size) {
+        if (ReedSolomon(kFrameHeaderParitySize).Decode(header, kFrameHeaderSize) < 0) {
+            return false;
+        }
+        // No flags are defined in this version
+        if (header[0] > kFrameMaxPayloadSize || header[1] != 0) {
+            return false;
+        }
+        *payload_size = header[0];
+        return true;
+    }
+
+    bool DecodeFrameBody(const uint8_t *body, size_t payload_size, std::string *text, int *corrected) {
+        if (payload_size > kFrameMaxPayloadSize) {
+            return false;
+        }
+        size_t data_size = payload_size + 2;
+        size_t blocks = GetFrameBlockCount(payload_size);
+        uint8_t codewords[kFrameMaxBlockCount][kFrameBlockDataSize + kFrameBlockParitySize];
+        for (size_t r = 0; r < kFrameBlockDataSize + kFrameBlockParitySize; ++r) {
+            for (size_t b = 0; b < blocks; ++b) {
+                if (r < GetFrameBlockDataSize(data_size, blocks, b) + kFrameBlockParitySize) {
+                    codewords[b][r] = *body++;
+                }
+            }
+        }
+
+        ReedSolomon code(kFrameBlockParitySize);
+        uint8_t data[kFrameMaxPayloadSize + 2];
+        int total_corrected = 0;
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t block_data_size = GetFrameBlockDataSize(data_size, blocks, b);
+            int result = code.Decode(codewords[b], block_data_size + kFrameBlockParitySize);
+            if (result < 0) {
+                return false;
+            }
+            total_corrected += result;
+            for (size_t k = 0; k < block_data_size; ++k) {
+                data[k * blocks + b] = codewords[b][k];
+            }
+        }
+        if (corrected != nullptr) {
+            *corrected = total_corrected;
+        }
+
+        uint16_t crc = static_cast<uint16_t>(data[payload_size] << 8 | data[payload_size + 1]);
+        if (CalculateCrc16(data, payload_size) != crc) {
+            return false;
+        }
+        text->assign(reinterpret_cast<const char *>(data), payload_size);
+        return true;
+    }
+
+    // Default start and end transmission identifiers
+    // \x01\x02 = 00000001 00000010
+    const std::vector<uint8_t> kDefaultStartTransmissionPattern = {
+        0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0};
+
+    // \x03\x04 = 00000011 00000100
+    const std::vector<uint8_t> kDefaultEndTransmissionPattern = {
+        0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0};
+
+    // \x01\x21 = 00000001 00100001
+    const std::vector<uint8_t> kFramePreamblePattern = {
+        0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    // AudioDataBuffer implementation
+    AudioDataBuffer::AudioDataBuffer()
+        : current_state_(DataReceptionState::kInactive),
+          start_of_transmission_(kDefaultStartTransmissionPattern),
+          end_of_transmission_(kDefaultEndTransmissionPattern),
+          enable_checksum_validation_(true),
+          frame_payload_size_(0),
+          frame_bit_count_(0) {
+        identifier_buffer_size_ = std::max({start_of_transmission_.size(), end_of_transmission_.size(),
+                                            kFramePreamblePattern.size()});
+        max_bit_buffer_size_ = 776;  // Preset bit buffer size, 776 bits = (32 + 1 + 63 + 1) * 8 = 776
+
+        bit_buffer_.reserve(std::max(max_bit_buffer_size_,
+                                     (kFrameHeaderSize + GetFrameBodySize(kFrameMaxPayloadSize)) * 8));
+    }
+
+    AudioDataBuffer::AudioDataBuffer(size_t max_byte_size, const std::vector<uint8_t> &start_identifier,
+                                   const std::vector<uint8_t> &end_identifier, bool enable_checksum)
+        : current_state_(DataReceptionState::kInactive),
+          start_of_transmission_(start_identifier),
+          end_of_transmission_(end_identifier),
+          enable_checksum_validation_(enable_checksum),
+          frame_payload_size_(0),
+          frame_bit_count_(0) {
+        identifier_buffer_size_ = std::max({start_of_transmission_.size(), end_of_transmission_.size(),
+                                            kFramePreamblePattern.size()});
+        max_bit_buffer_size_ = max_byte_size * 8;  // Bit buffer size in bytes
+
+        bit_buffer_.reserve(std::max(max_bit_buffer_size_,
+                                     (kFrameHeaderSize + GetFrameBodySize(kFrameMaxPayloadSize)) * 8));
+    }
+
+    uint8_t AudioDataBuffer::CalculateChecksum(const std::string &text) {
+        uint8_t checksum = 0;
+        for (char character : text) {
+            checksum += static_cast<uint8_t>(character);
+        }
+        return checksum;
+    }
+
+    void AudioDataBuffer::ClearBuffers() {
+        identifier_buffer_.clear();
+        bit_buffer_.clear();
+        frame_bit_count_ = 0;
+    }
+
+    bool AudioDataBuffer::ProcessFrameBit(uint8_t bit) {
+        bit_buffer_.push_back(bit);
+        if (frame_bit_count_ == 0) {
+            if (bit_buffer_.size() < kFrameHeaderSize * 8) {
+                return false;
+            }
+            // The header gives the frame length
+            std::vector<uint8_t> header = ConvertBitsToBytes(bit_buffer_);
+            if (!DecodeFrameHeader(header.data(), &frame_payload_size_)) {
+                ESP_LOGW(TAG, "Invalid frame header, waiting for the next frame");
+                ClearBuffers();
+                current_state_ = DataReceptionState::kInactive;
+                return false;
+            }
+            frame_bit_count_ = (kFrameHeaderSize + GetFrameBodySize(frame_payload_size_)) * 8;
+            return false;
+        }
+        if (bit_buffer_.size() < frame_bit_count_) {
+            return false;
+        }
+
+        std::vector<uint8_t> bytes = ConvertBitsToBytes(bit_buffer_);
+        ClearBuffers();
+        current_state_ = DataReceptionState::kInactive;
+
+        std::string text;
+        int corrected = 0;
+        if (!DecodeFrameBody(bytes.data() + kFrameHeaderSize, frame_payload_size_, &text, &corrected)) {
+            ESP_LOGW(TAG, "Frame of %zu bytes could not be corrected", frame_payload_size_);
+            return false;
+        }
+        ESP_LOGI(TAG, "Frame of %zu bytes received, %d bytes corrected", frame_payload_size_, corrected);
+        decoded_text = text;
+        return true;
+    }
+
+    bool AudioDataBuffer::ProcessProbabilityData(const std::vector<float> &probabilities, float threshold) {
+        for (float probability : probabilities) {
+            uint8_t bit = (probability > threshold) ? 1 : 0;
+
+            if (identifier_buffer_.size() >= identifier_buffer_size_) {
+                identifier_buffer_.pop_front();  // Maintain buffer size
+            }
+            identifier_buffer_.push_back(bit);
+
+            // Process received bit based on state machine
+            switch (current_state_) {
+            case DataReceptionState::kInactive:
+                if (identifier_buffer_.size() >= start_of_transmission_.size()) {
+                    current_state_ = DataReceptionState::kWaiting;  // Enter waiting state
+                    ESP_LOGI(TAG, "Entering Waiting state");
+                }
+                break;
+
+            case DataReceptionState::kWaiting:
+                // Waiting state, possibly waiting for transmission end
+                if (identifier_buffer_.size() >= start_of_transmission_.size()) {
+                    std::vector<uint8_t> identifier_snapshot(identifier_buffer_.begin(), identifier_buffer_.end());
+                    if (identifier_snapshot == start_of_transmission_)
+                    {
+                        ClearBuffers();                                // Clear buffers
+                        current_state_ = DataReceptionState::kReceiving;  // Enter receiving state
+                        ESP_LOGI(TAG, "Entering Receiving state");
+                    } else if (identifier_snapshot == kFramePreamblePattern) {
+                        ClearBuffers();
+                        current_state_ = DataReceptionState::kReceivingFrame;  // FEC frame of this version
+                        ESP_LOGI(TAG, "Entering Receiving state, FEC frame version %d", kFrameVersion);
+                    }
+                }
+                break;
+
+            case DataReceptionState::kReceivingFrame:
+                if (ProcessFrameBit(bit)) {
+                    return true;
+                }
+                break;
+
+            case DataReceptionState::kReceiving:
+                bit_buffer_.push_back(bit);
+                if (identifier_buffer_.size() >= end_of_transmission_.size()) {
+                    std::vector<uint8_t> identifier_snapshot(identifier_buffer_.begin(), identifier_buffer_.end());
+                    if (identifier_snapshot == end_of_transmission_) {
+                        current_state_ = DataReceptionState::kInactive;  // Enter inactive state
+
+                        // Convert bits to bytes
+                        std::vector<uint8_t> bytes = ConvertBitsToBytes(bit_buffer_);
+
+                        uint8_t received_checksum = 0;
+                        size_t minimum_length = 0;
+
+                        if (enable_checksum_validation_) {
+                            // If checksum is required, last byte is checksum
+                            minimum_length = 1 + start_of_transmission_.size() / 8;
+                            if (bytes.size() >= minimum_length)
+                            {
+                                received_checksum = bytes[bytes.size() - start_of_transmission_.size() / 8 - 1];
+                            }
+                        } else {
+                            minimum_length = start_of_transmission_.size() / 8;
+                        }
+
+                        if (bytes.size() < minimum_length) {
+                            ClearBuffers();
+                            ESP_LOGW(TAG, "Data too short, clearing buffer");
+                            return false;  // Data too short, return failure
+                        }
+
+                        // Extract text data (remove trailing identifier part)
+                        std::vector<uint8_t> text_bytes(
+                            bytes.begin(), bytes.begin() + bytes.size() - minimum_length);
+
+                        std::string result(text_bytes.begin(), text_bytes.end());
+
+                        // Validate checksum if required
+                        if (enable_checksum_validation_) {
+                            uint8_t calculated_checksum = CalculateChecksum(result);
+                            if (calculated_checksum != received_checksum) {
+                                // Checksum mismatch
+                                ESP_LOGW(TAG, "Checksum mismatch: expected %d, got %d", 
+                                        received_checksum, calculated_checksum);
+                                ClearBuffers();
+                                return false;
+                            }
+                        }
+
+                        ClearBuffers();
+                        decoded_text = result;
+                        return true;  // Return success
+                    } else if (bit_buffer_.size() >= max_bit_buffer_size_) {
+                        // If not end identifier and bit buffer is full, reset
+                        ClearBuffers();
+                        ESP_LOGW(TAG, "Buffer overflow, clearing buffer");
+                        current_state_ = DataReceptionState::kInactive;  // Reset state machine
+                    }
+                }
+                break;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<uint8_t> AudioDataBuffer::ConvertBitsToBytes(const std::vector<uint8_t> &bits) const {
+        std::vector<uint8_t> bytes;
+
+        // Ensure number of bits is a multiple of 8
+        size_t complete_bytes_count = bits.size() / 8;
+        bytes.reserve(complete_bytes_count);
+
+        for (size_t i = 0; i < complete_bytes_count; ++i) {
+            uint8_t byte_value = 0;
+            for (size_t j = 0; j < 8; ++j) {
+                byte_value |= bits[i * 8 + j] << (7 - j);
+            }
+            bytes.push_back(byte_value);
+        }
+
+        return bytes;
+    }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace audio_wifi_config
+{
+    /*
+     * FEC frame format for acoustic provisioning, version 1:
+     *
+     *   preamble  0x01 0x21        0x01 0x02 starts the legacy format, 0x20 | version an FEC frame
+     *   header    length, flags    followed by 6 Reed-Solomon parity bytes, corrects 3 byte errors
+     *   body      payload and its CRC-16, split round-robin into blocks of up to 16 bytes,
+     *             each followed by 8 Reed-Solomon parity bytes (corrects 4 byte errors per block).
+     *             The blocks are sent interleaved byte by byte, so a burst of noise is spread
+     *             over all of them.
+     *
+     * Bytes are sent most significant bit first. There is no end identifier, the header
+     * gives the length. A receiver ignores preambles of versions it does not know, as
+     * older firmware ignores FEC frames. scripts/acoustic_check/afsk_encode.py and
+     * scripts/sonic_wifi_config.html build the same frames.
+     */
+    const uint8_t kFrameVersion = 1;
+    const size_t kFrameHeaderSize = 8;            // Including its parity
+    const size_t kFrameMaxPayloadSize = 96;       // 32 bytes SSID, newline, 63 bytes password
+
+    /**
+     * Systematic Reed-Solomon code over GF(256), polynomial 0x11d, roots a^0 .. a^(parity - 1).
+     * Codewords of up to 255 bytes are the data followed by the parity bytes.
+     */
+    class ReedSolomon
+    {
+    public:
+        static const size_t kMaxParitySize = 32;
+
+        /**
+         * Constructor
+         * @param parity_size Number of parity bytes, corrects parity_size / 2 byte errors
+         */
+        explicit ReedSolomon(size_t parity_size);
+
+        /**
+         * Calculate the parity bytes of data
+         * @param data Data bytes
+         * @param size Number of data bytes, at most 255 - parity_size
+         * @param parity parity_size bytes
+         */
+        void Encode(const uint8_t *data, size_t size, uint8_t *parity) const;
+
+        /**
+         * Correct a codeword in place
+         * @param codeword Data followed by parity bytes
+         * @param size Codeword size
+         * @return Number of corrected bytes, -1 if there are too many errors
+         */
+        int Decode(uint8_t *codeword, size_t size) const;
+
+    private:
+        size_t parity_size_;
+        uint8_t generator_[kMaxParitySize + 1];  // Generator polynomial, highest degree first
+    };
+
+    /**
+     * CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xffff)
+     */
+    uint16_t CalculateCrc16(const uint8_t *data, size_t size);
+
+    /**
+     * Build an FEC frame
+     * @param text Payload, at most kFrameMaxPayloadSize bytes
+     * @return Frame bytes including the preamble, empty if the payload is too long
+     */
+    std::vector<uint8_t> EncodeFrame(const std::string &text);
+
+    /**
+     * Number of body bytes after the header, for a payload size
+     */
+    size_t GetFrameBodySize(size_t payload_size);
+
+    /**
+     * Correct and check a frame header
+     * @param header kFrameHeaderSize bytes following the preamble, corrected in place
+     * @param payload_size Payload size from the header
+     * @return false if the header is uncorrectable or not supported
+     */
+    bool DecodeFrameHeader(uint8_t *header, size_t *payload_size);
+
+    /**
+     * Deinterleave, correct and check a frame body
+     * @param body GetFrameBodySize(payload_size) bytes following the header
+     * @param payload_size Payload size from the header
+     * @param text Decoded payload
+     * @param corrected Number of corrected bytes, may be nullptr
+     * @return false if a block is uncorrectable or the CRC does not match
+     */
+    bool DecodeFrameBody(const uint8_t *body, size_t payload_size, std::string *text, int *corrected);
+
+    /**
+     * Data reception state machine states
+     */
+    enum class DataReceptionState
+    {
+        kInactive,       // Waiting for start signal
+        kWaiting,        // Detected potential start, waiting for confirmation
+        kReceiving,      // Actively receiving legacy data, until the end identifier
+        kReceivingFrame  // Actively receiving an FEC frame, until its header gives the length
+    };
+
+    /**
+     * Data buffer for managing audio-to-digital data conversion
+     * Handles the complete process from audio signal to decoded text data.
+     * Both the legacy format (start identifier, text, checksum, end identifier) and
+     * FEC frames (versioned preamble, see EncodeFrame) are received.
+     */
+    class AudioDataBuffer
+    {
+    private:
+        DataReceptionState current_state_;       // Current reception state
+        std::deque<uint8_t> identifier_buffer_;  // Buffer for start/end identifier detection
+        size_t identifier_buffer_size_;          // Identifier buffer size
+        std::vector<uint8_t> bit_buffer_;        // Buffer for storing bit stream
+        size_t max_bit_buffer_size_;             // Maximum bit buffer size
+        const std::vector<uint8_t> start_of_transmission_;  // Start-of-transmission identifier
+        const std::vector<uint8_t> end_of_transmission_;    // End-of-transmission identifier
+        bool enable_checksum_validation_;       // Whether to validate checksum
+        size_t frame_payload_size_;             // Payload size from the FEC frame header
+        size_t frame_bit_count_;                // Total FEC frame bits after the preamble, 0 until the header is decoded
+
+    public:
+        std::optional<std::string> decoded_text; // Successfully decoded text data
+
+        /**
+         * Default constructor using predefined start and end identifiers
+         */
+        AudioDataBuffer();
+
+        /**
+         * Constructor with custom parameters
+         * @param max_byte_size Expected maximum data size in bytes
+         * @param start_identifier Start-of-transmission identifier
+         * @param end_identifier End-of-transmission identifier
+         * @param enable_checksum Whether to enable checksum validation
+         */
+        AudioDataBuffer(size_t max_byte_size, const std::vector<uint8_t> &start_identifier,
+                      const std::vector<uint8_t> &end_identifier, bool enable_checksum = false);
+
+        /**
+         * Process probability data and attempt to decode
+         * @param probabilities Vector of Mark probabilities
+         * @param threshold Decision threshold for bit detection
+         * @return true if complete data was successfully received and decoded
+         */
+        bool ProcessProbabilityData(const std::vector<float> &probabilities, float threshold = 0.5f);
+
+        /**
+         * Calculate checksum for ASCII text
+         * @param text Input text string
+         * @return Checksum value (0-255)
+         */
+        static uint8_t CalculateChecksum(const std::string &text);
+
+    private:
+        /**
+         * Convert bit vector to byte vector
+         * @param bits Input bit vector
+         * @return Converted byte vector
+         */
+        std::vector<uint8_t> ConvertBitsToBytes(const std::vector<uint8_t> &bits) const;
+
+        /**
+         * Clear all buffers and reset state
+         */
+        void ClearBuffers();
+
+        /**
+         * Store one bit of an FEC frame, decode the header and then the frame once complete
+         * @return true if the frame was decoded
+         */
+        bool ProcessFrameBit(uint8_t bit);
+    };
+
+    // Default start and end transmission identifiers
+    extern const std::vector<uint8_t> kDefaultStartTransmissionPattern;
+    extern const std::vector<uint8_t> kDefaultEndTransmissionPattern;
+
+    // Preamble of version kFrameVersion FEC frames
+    extern const std::vector<uint8_t> kFramePreamblePattern;
+}
@@ -3,6 +3,18 @@
 
 #include <string>
 
+// How a photo is cut and compressed before it is uploaded for explanation
+struct PhotoOptions {
+    // Longest side of the uploaded image in pixels, 0 keeps the captured size
+    int max_size = 0;
+    int quality = 80;
+    // Crop rectangle in percent of the frame, a zero width or height keeps the whole frame
+    int crop_x = 0;
+    int crop_y = 0;
+    int crop_width = 0;
+    int crop_height = 0;
+};
+
 class Camera {
 public:
     virtual void SetExplainUrl(const std::string& url, const std::string& token) = 0;
@@ -10,6 +22,10 @@ public:
     virtual bool SetHMirror(bool enabled) = 0;
     virtual bool SetVFlip(bool enabled) = 0;
     virtual std::string Explain(const std::string& question) = 0;
+    // Cameras that cannot scale or crop upload the full photo
+    virtual std::string Explain(const std::string& question, const PhotoOptions& options) { return Explain(question); }
+    // Follows the board power save mode, background capture stops while it is on
+    virtual void SetPowerSaveMode(bool enabled) {}
 };
 
 #endif // CAMERA_H
@@ -0,0 +1,184 @@
+#include "camera_buffer_pool.h"
+#include "arena_allocator.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "CameraBufferPool"
+
+// Converted and rotated frames count against the camera memory region
+static MemoryRegion& camera_region() {
+    static MemoryRegion* region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_CAMERA);
+    return *region;
+}
+
+const uint8_t* FrameLease::data() const {
+    return slot_ ? slot_->data : nullptr;
+}
+
+size_t FrameLease::size() const {
+    return slot_ ? slot_->size : 0;
+}
+
+uint32_t FrameLease::index() const {
+    return slot_ ? slot_->index : 0;
+}
+
+int64_t FrameLease::timestamp_us() const {
+    return slot_ ? slot_->timestamp_us : 0;
+}
+
+FrameLease::Slot::~Slot() {
+    pool->Requeue(index);
+}
+
+CameraBufferPool::CameraBufferPool(DequeueFunc dequeue, QueueFunc queue)
+    : dequeue_(std::move(dequeue)), queue_(std::move(queue)) {
+}
+
+void CameraBufferPool::AddBuffer(const void* start, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back({(const uint8_t*)start, length});
+}
+
+FrameLease CameraBufferPool::Acquire(int skip) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // With every buffer out of the queue, VIDIOC_DQBUF would wait forever
+    if (std::all_of(buffers_.begin(), buffers_.end(), [](const Buffer& b) { return b.leased; })) {
+        ESP_LOGE(TAG, "No buffer queued, %u leased", (unsigned)buffers_.size());
+        stats_.errors++;
+        return FrameLease();
+    }
+
+    for (int i = 0; i <= skip; i++) {
+        uint32_t index = 0;
+        size_t bytesused = 0;
+        int64_t timestamp_us = 0;
+        if (!dequeue_(index, bytesused, timestamp_us)) {
+            ESP_LOGE(TAG, "Dequeue failed");
+            stats_.errors++;
+            return FrameLease();
+        }
+        stats_.dequeued++;
+        if (index >= buffers_.size()) {
+            ESP_LOGE(TAG, "Dequeued unknown buffer %u", (unsigned)index);
+            stats_.errors++;
+            return FrameLease();
+        }
+
+        if (i < skip) {
+            if (queue_(index)) {
+                stats_.requeued++;
+            } else {
+                stats_.errors++;
+            }
+            stats_.skipped++;
+            continue;
+        }
+
+        auto& buffer = buffers_[index];
+        buffer.leased = true;
+        stats_.leased++;
+        FrameLease lease;
+        lease.slot_ = std::make_shared<FrameLease::Slot>();
+        lease.slot_->pool = this;
+        lease.slot_->index = index;
+        lease.slot_->data = buffer.start;
+        lease.slot_->size = std::min(bytesused, buffer.length);
+        lease.slot_->timestamp_us = timestamp_us;
+        return lease;
+    }
+    return FrameLease();
+}
+
+FrameLease CameraBufferPool::AcquireFresh() {
+    int queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued = std::count_if(buffers_.begin(), buffers_.end(), [](const Buffer& b) { return !b.leased; });
+    }
+    return Acquire(queued);
+}
+
+void CameraBufferPool::Requeue(uint32_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_[index].leased = false;
+    if (queue_(index)) {
+        stats_.requeued++;
+    } else {
+        ESP_LOGE(TAG, "Queue buffer %u failed", (unsigned)index);
+        stats_.errors++;
+    }
+}
+
+bool CameraBufferPool::leased(uint32_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index < buffers_.size() && buffers_[index].leased;
+}
+
+CameraBufferPool::Stats CameraBufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+CameraFrame::~CameraFrame() {
+    lease_.Release();
+    for (auto& storage : storage_) {
+        camera_region().Free(storage.data);
+    }
+}
+
+void CameraFrame::Use(FrameLease lease, uint16_t width, uint16_t height, uint32_t format) {
+    lease_ = std::move(lease);
+    current_ = -1;
+    len_ = lease_.size();
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    stats_.in_place++;
+}
+
+uint8_t* CameraFrame::Reserve(size_t len) {
+    // Never the storage the current frame is read from
+    reserved_ = current_ == 0 ? 1 : 0;
+    auto& storage = storage_[reserved_];
+    if (storage.capacity < len) {
+        camera_region().Free(storage.data);
+        // Aligned for the PPA and cache writeback of the rotated frame
+        storage.data = (uint8_t*)camera_region().Allocate(len, 64);
+        storage.capacity = storage.data != nullptr ? len : 0;
+        stats_.allocations++;
+        if (storage.data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes for the camera frame", (unsigned)len);
+            reserved_ = -1;
+            return nullptr;
+        }
+    }
+    return storage.data;
+}
+
+void CameraFrame::UseReserved(size_t len, uint16_t width, uint16_t height, uint32_t format) {
+    lease_.Release();
+    current_ = reserved_;
+    reserved_ = -1;
+    len_ = current_ >= 0 ? len : 0;
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    stats_.converted++;
+}
+
+void CameraFrame::Clear() {
+    lease_.Release();
+    current_ = -1;
+    reserved_ = -1;
+    len_ = 0;
+    format_ = 0;
+}
+
+const uint8_t* CameraFrame::data() const {
+    if (current_ >= 0) {
+        return storage_[current_].data;
+    }
+    return lease_.data();
+}
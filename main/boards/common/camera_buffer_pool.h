@@ -0,0 +1,150 @@
+#ifndef CAMERA_BUFFER_POOL_H
+#define CAMERA_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CameraBufferPool;
+
+/**
+ * A dequeued V4L2 capture buffer, read in place from its mmap mapping. Copies of a
+ * lease share the buffer, it is queued back to the driver when the last copy is
+ * released or destroyed.
+ */
+class FrameLease {
+public:
+    FrameLease() = default;
+
+    bool valid() const { return slot_ != nullptr; }
+    const uint8_t* data() const;
+    size_t size() const;
+    uint32_t index() const;
+    // When the driver captured the frame
+    int64_t timestamp_us() const;
+    void Release() { slot_.reset(); }
+
+private:
+    friend class CameraBufferPool;
+
+    struct Slot {
+        CameraBufferPool* pool;
+        uint32_t index;
+        const uint8_t* data;
+        size_t size;
+        int64_t timestamp_us;
+        ~Slot();
+    };
+
+    std::shared_ptr<Slot> slot_;
+};
+
+/**
+ * The mmap buffers of a V4L2 capture device. The driver is reached through the
+ * dequeue and queue functions only (VIDIOC_DQBUF and VIDIOC_QBUF on the device),
+ * so the pool runs the same against the fake device in scripts/camera_lease_test.
+ * Leases may be released from any task, the pool must outlive them.
+ */
+class CameraBufferPool {
+public:
+    // Fills the index, the bytes used and the capture time of the next filled buffer
+    using DequeueFunc = std::function<bool(uint32_t& index, size_t& bytesused, int64_t& timestamp_us)>;
+    using QueueFunc = std::function<bool(uint32_t index)>;
+
+    struct Stats {
+        uint32_t dequeued = 0;
+        uint32_t requeued = 0;
+        uint32_t skipped = 0;       // Stale frames queued back without being leased
+        uint32_t leased = 0;
+        uint32_t errors = 0;
+    };
+
+    CameraBufferPool(DequeueFunc dequeue, QueueFunc queue);
+
+    // Buffers are added in the order of their V4L2 index
+    void AddBuffer(const void* start, size_t length);
+    size_t buffer_count() const { return buffers_.size(); }
+
+    // Dequeue skip + 1 frames and lease the last one, the older frames are queued back
+    // at once. Returns an invalid lease if the driver fails or every buffer is leased.
+    FrameLease Acquire(int skip = 0);
+    // Lease a frame captured after this call. Every queued buffer may hold a frame filled
+    // since it was queued, so one frame is skipped per queued buffer.
+    FrameLease AcquireFresh();
+    bool leased(uint32_t index) const;
+    Stats stats() const;
+
+private:
+    friend struct FrameLease::Slot;
+
+    struct Buffer {
+        const uint8_t* start;
+        size_t length;
+        bool leased = false;
+    };
+
+    void Requeue(uint32_t index);
+
+    DequeueFunc dequeue_;
+    QueueFunc queue_;
+    std::vector<Buffer> buffers_;
+    mutable std::mutex mutex_;
+    Stats stats_;
+};
+
+/**
+ * The frame kept for the preview and Explain(). It is either a lease on the sensor
+ * buffer, used as is, or the output of a conversion (byte swap, rotation) in storage
+ * that is kept for the next frames. Two storage buffers let a conversion read the
+ * output of the previous one.
+ */
+class CameraFrame {
+public:
+    struct Stats {
+        uint32_t in_place = 0;      // Frames read from the sensor buffer
+        uint32_t converted = 0;     // Conversions written to storage
+        uint32_t allocations = 0;   // Storage (re)allocations
+    };
+
+    CameraFrame() = default;
+    CameraFrame(const CameraFrame&) = delete;
+    CameraFrame& operator=(const CameraFrame&) = delete;
+    ~CameraFrame();
+
+    void Use(FrameLease lease, uint16_t width, uint16_t height, uint32_t format);
+    // Storage for the output of a conversion of the current frame, which stays readable
+    uint8_t* Reserve(size_t len);
+    // The conversion written to the reserved storage is now the frame, the lease is released
+    void UseReserved(size_t len, uint16_t width, uint16_t height, uint32_t format);
+    // Drop the frame and release its lease, the storage is kept
+    void Clear();
+
+    const uint8_t* data() const;
+    size_t len() const { return len_; }
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+    uint32_t format() const { return format_; }
+    const FrameLease& lease() const { return lease_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Storage {
+        uint8_t* data = nullptr;
+        size_t capacity = 0;
+    };
+
+    FrameLease lease_;
+    Storage storage_[2];
+    int current_ = -1;      // Storage holding the frame, -1 for the lease
+    int reserved_ = -1;
+    size_t len_ = 0;
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    uint32_t format_ = 0;
+    Stats stats_;
+};
+
+#endif // CAMERA_BUFFER_POOL_H
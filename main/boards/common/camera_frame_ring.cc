@@ -0,0 +1,82 @@
+#include "camera_frame_ring.h"
+
+#include <cstdlib>
+
+CameraFrameRing::CameraFrameRing(size_t depth, uint8_t settle_delta, int settle_count, int max_settle_frames)
+    : depth_(depth > 0 ? depth : 1), settle_delta_(settle_delta), settle_count_(settle_count),
+      max_settle_frames_(max_settle_frames) {
+}
+
+void CameraFrameRing::Push(FrameLease lease, int64_t timestamp_us, uint8_t brightness) {
+    // The evicted lease is released after the lock, it queues its buffer back to the driver
+    Frame evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frames_.size() >= depth_) {
+            evicted = std::move(frames_.front());
+            frames_.pop_front();
+        }
+        frames_.push_back({std::move(lease), timestamp_us, brightness});
+        stats_.pushed++;
+
+        frames_since_clear_++;
+        if (!settled_) {
+            if (has_last_ && abs((int)brightness - (int)last_brightness_) <= settle_delta_) {
+                stable_steps_++;
+            } else {
+                stable_steps_ = 0;
+            }
+            if (stable_steps_ >= settle_count_ || frames_since_clear_ >= max_settle_frames_) {
+                settled_ = true;
+                stats_.settle_frames = frames_since_clear_;
+            }
+        }
+        has_last_ = true;
+        last_brightness_ = brightness;
+    }
+}
+
+bool CameraFrameRing::Newest(int64_t now_us, int64_t max_age_us, Frame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frames_.empty()) {
+        return false;
+    }
+    if (!settled_) {
+        stats_.unsettled++;
+        return false;
+    }
+    auto& newest = frames_.back();
+    if (now_us - newest.timestamp_us > max_age_us) {
+        return false;
+    }
+    frame = newest;
+    stats_.served++;
+    return true;
+}
+
+void CameraFrameRing::Clear() {
+    std::deque<Frame> released;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        released.swap(frames_);
+        frames_since_clear_ = 0;
+        stable_steps_ = 0;
+        settled_ = false;
+        has_last_ = false;
+    }
+}
+
+bool CameraFrameRing::settled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return settled_;
+}
+
+size_t CameraFrameRing::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_.size();
+}
+
+CameraFrameRing::Stats CameraFrameRing::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
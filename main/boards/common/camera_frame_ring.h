@@ -0,0 +1,67 @@
+#ifndef CAMERA_FRAME_RING_H
+#define CAMERA_FRAME_RING_H
+
+#include "camera_buffer_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/**
+ * The most recent frames of a camera captured in the background at a low rate, so a
+ * photo is taken without waiting for fresh frames. Frames are kept as leases on their
+ * V4L2 buffers; pushing a frame into a full ring releases the oldest one.
+ *
+ * After a start or a pause the sensor exposure may still be moving. The ring watches the
+ * mean brightness of the frames and only serves them once it stopped changing, or after
+ * max_settle_frames frames in scenes that never settle. Times are in microseconds of
+ * any monotonic clock, so the ring runs the same in scripts/camera_ring_test.
+ */
+class CameraFrameRing {
+public:
+    struct Frame {
+        FrameLease lease;
+        int64_t timestamp_us = 0;
+        uint8_t brightness = 0;
+    };
+
+    struct Stats {
+        uint32_t pushed = 0;
+        uint32_t served = 0;
+        uint32_t unsettled = 0;     // Requests refused while the exposure was settling
+        uint32_t settle_frames = 0; // Frames it took to settle after the last clear
+    };
+
+    // Brightness steps of at most settle_delta over settle_count frames mean settled
+    explicit CameraFrameRing(size_t depth, uint8_t settle_delta = 4, int settle_count = 2,
+        int max_settle_frames = 8);
+
+    void Push(FrameLease lease, int64_t timestamp_us, uint8_t brightness);
+    // The newest frame if the exposure settled and it is not older than max_age_us
+    bool Newest(int64_t now_us, int64_t max_age_us, Frame& frame);
+    // Release every frame and watch the exposure settle again
+    void Clear();
+
+    bool settled() const;
+    size_t size() const;
+    size_t depth() const { return depth_; }
+    Stats stats() const;
+
+private:
+    size_t depth_;
+    uint8_t settle_delta_;
+    int settle_count_;
+    int max_settle_frames_;
+
+    mutable std::mutex mutex_;
+    std::deque<Frame> frames_;
+    int frames_since_clear_ = 0;
+    int stable_steps_ = 0;
+    bool settled_ = false;
+    bool has_last_ = false;
+    uint8_t last_brightness_ = 0;
+    Stats stats_;
+};
+
+#endif // CAMERA_FRAME_RING_H
@@ -6,14 +6,20 @@
 #include <unistd.h>
 #include "board.h"
 #include "display.h"
+#include "arena_allocator.h"
 #include "esp_imgfx_color_convert.h"
 #include "esp_video_device.h"
 #include "esp_video_init.h"
+#include "jpg/image_scale.h"
 #include "jpg/image_to_jpeg.h"
 #include "linux/videodev2.h"
 #include "lvgl_display.h"
 #include "mcp_server.h"
 #include "system_info.h"
+#include "task_stack.h"
+#include "task_stack_recorder.h"
+#include <esp_pthread.h>
+#include <esp_timer.h>
 
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_DEBUG_MODE
 #undef LOG_LOCAL_LEVEL
@@ -45,11 +51,18 @@
 #include <errno.h>
 #include <esp_heap_caps.h>
 #include <esp_log.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
 #define TAG "Esp32Camera"
 
+// The JPEG stream of Explain() is sent in 8KB chunks, the encoder runs at most 32KB ahead of the upload
+static const size_t kJpegSlotCount = 4;
+static const size_t kJpegSlotSize = 8 * 1024;
+// Heap rounding and alignment of each block in the camera region
+static const size_t kCameraRegionSlack = 1024;
+
 #if defined(CONFIG_CAMERA_SENSOR_SWAP_PIXEL_BYTE_ORDER) || defined(CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP)
 #warning \
     "CAMERA_SENSOR_SWAP_PIXEL_BYTE_ORDER or CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP is enabled, which may cause image corruption in YUV422 format!"
@@ -90,7 +103,11 @@ static void log_available_video_devices() {
 #define CAM_PRINT_FOURCC(pixelformat) (void)0;
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_DEBUG_MODE
 
-Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
+Esp32Camera::Esp32Camera(const esp_video_init_config_t& config)
+    : buffer_pool_([this](uint32_t& index, size_t& bytesused, int64_t& timestamp_us) {
+                       return DequeueBuffer(index, bytesused, timestamp_us);
+                   },
+                   [this](uint32_t index) { return QueueBuffer(index); }) {
     if (esp_video_init(&config) != ESP_OK) {
         ESP_LOGE(TAG, "esp_video_init failed");
         return;
@@ -260,16 +277,29 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
     }
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-    frame_.width = setformat.fmt.pix.height;
-    frame_.height = setformat.fmt.pix.width;
+    frame_width_ = setformat.fmt.pix.height;
+    frame_height_ = setformat.fmt.pix.width;
 #else
-    frame_.width = setformat.fmt.pix.width;
-    frame_.height = setformat.fmt.pix.height;
+    frame_width_ = setformat.fmt.pix.width;
+    frame_height_ = setformat.fmt.pix.height;
 #endif
 
+    // Both storage buffers of frame_ may hold a full RGB888 frame, the YUYV to RGB888 to RGB565
+    // rotation of the PPA path needs both at once, and the Explain() upload ring comes on top
+    size_t converted_len = (size_t)frame_width_ * frame_height_ * 3;
+    size_t camera_budget = 2 * (converted_len + kCameraRegionSlack) +
+        kJpegSlotCount * kJpegSlotSize + kCameraRegionSlack;
+    MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_CAMERA)->SetBudget(camera_budget);
+    ESP_LOGI(TAG, "Camera memory budget %u bytes for %dx%d", (unsigned)camera_budget, frame_width_, frame_height_);
+
     // 申请缓冲并mmap
     struct v4l2_requestbuffers req = {};
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    // The ring, the frame kept by Capture() and one buffer left for the driver to fill
+    req.count = CONFIG_XIAOZHI_CAMERA_FRAME_RING_DEPTH + 2;
+#else
     req.count = strcmp(video_device_name, ESP_VIDEO_MIPI_CSI_DEVICE_NAME) == 0 ? 2 : 1;
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
     if (ioctl(video_fd_, VIDIOC_REQBUFS, &req) != 0) {
@@ -302,6 +332,7 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
         }
         mmap_buffers_[i].start = start;
         mmap_buffers_[i].length = buf.length;
+        buffer_pool_.AddBuffer(start, buf.length);
 
         if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
             ESP_LOGE(TAG, "VIDIOC_QBUF failed");
@@ -353,9 +384,31 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
     ESP_LOGI(TAG, "Camera init success");
     streaming_on_ = true;
 #endif  // CONFIG_ESP_VIDEO_ENABLE_ISP_VIDEO_DEVICE
+
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    if (mmap_buffers_.size() < CONFIG_XIAOZHI_CAMERA_FRAME_RING_DEPTH + 2) {
+        ESP_LOGW(TAG, "Frame ring disabled, the driver gave %u buffers", (unsigned)mmap_buffers_.size());
+    } else {
+        xTaskCreate([](void* arg) {
+            static_cast<Esp32Camera*>(arg)->FrameRingTask();
+        }, "camera_ring", TASK_STACK_CAMERA_RING, this, 2, &frame_ring_task_);
+    }
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
 }
 
 Esp32Camera::~Esp32Camera() {
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    if (frame_ring_task_ != nullptr) {
+        vTaskDelete(frame_ring_task_);
+        frame_ring_task_ = nullptr;
+    }
+    frame_ring_.Clear();
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    if (encoder_thread_.joinable()) {
+        encoder_thread_.join();
+    }
+    // Give the leased buffer back while the device still streams
+    frame_.Clear();
     if (streaming_on_ && video_fd_ >= 0) {
         int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         ioctl(video_fd_, VIDIOC_STREAMOFF, &type);
@@ -373,6 +426,122 @@ Esp32Camera::~Esp32Camera() {
     esp_video_deinit();
 }
 
+bool Esp32Camera::DequeueBuffer(uint32_t& index, size_t& bytesused, int64_t& timestamp_us) {
+    struct v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(video_fd_, VIDIOC_DQBUF, &buf) != 0) {
+        ESP_LOGE(TAG, "VIDIOC_DQBUF failed, errno=%d(%s)", errno, strerror(errno));
+        return false;
+    }
+    index = buf.index;
+    bytesused = buf.bytesused;
+    // The dequeue time on esp_timer, the clock of the frame ring. The buffer timestamp may be
+    // on the wall clock, which jumps with SNTP.
+    timestamp_us = esp_timer_get_time();
+    return true;
+}
+
+bool Esp32Camera::QueueBuffer(uint32_t index) {
+    struct v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
+        ESP_LOGE(TAG, "VIDIOC_QBUF failed, errno=%d(%s)", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+// Mean luma of about 256 pixels spread over the frame, enough to see the exposure move
+static uint8_t SampleBrightness(const uint8_t* data, size_t len, v4l2_pix_fmt_t format) {
+    size_t bytes_per_pixel;
+    switch (format) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YUV422P:
+        case V4L2_PIX_FMT_RGB565:
+            bytes_per_pixel = 2;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            bytes_per_pixel = 3;
+            break;
+        default:
+            // GREY, and the Y bytes dominate YUV420
+            bytes_per_pixel = 1;
+            break;
+    }
+    size_t pixels = len / bytes_per_pixel;
+    if (data == nullptr || pixels == 0) {
+        return 0;
+    }
+    size_t step = MAX(pixels / 256, 1);
+    uint32_t sum = 0;
+    uint32_t count = 0;
+    for (size_t i = 0; i < pixels; i += step) {
+        const uint8_t* p = data + i * bytes_per_pixel;
+        switch (format) {
+            case V4L2_PIX_FMT_RGB565: {
+                uint16_t v = p[0] | (p[1] << 8);
+                uint32_t r = (v >> 11) << 3;
+                uint32_t g = ((v >> 5) & 0x3F) << 2;
+                uint32_t b = (v & 0x1F) << 3;
+                sum += (r * 77 + g * 150 + b * 29) >> 8;
+                break;
+            }
+            case V4L2_PIX_FMT_RGB24:
+                sum += (p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8;
+                break;
+            default:
+                // Y of YUYV is the first byte of every pixel
+                sum += p[0];
+                break;
+        }
+        count++;
+    }
+    return sum / count;
+}
+
+void Esp32Camera::FrameRingTask() {
+    const TickType_t period = pdMS_TO_TICKS(1000 / CONFIG_XIAOZHI_CAMERA_FRAME_RING_FPS);
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true) {
+        if (!streaming_on_) {
+            // The ISP is still warming up
+            vTaskDelay(pdMS_TO_TICKS(100));
+            last_wake = xTaskGetTickCount();
+            continue;
+        }
+        if (frame_ring_paused_) {
+            // Give the buffers back to the driver and sleep until SetPowerSaveMode(false)
+            frame_ring_.Clear();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            last_wake = xTaskGetTickCount();
+            continue;
+        }
+
+        // The queued buffers were filled up to a period ago
+        FrameLease lease = buffer_pool_.AcquireFresh();
+        if (lease.valid()) {
+            int64_t timestamp_us = lease.timestamp_us();
+            uint8_t brightness = SampleBrightness(lease.data(), lease.size(), sensor_format_);
+            frame_ring_.Push(std::move(lease), timestamp_us, brightness);
+        }
+        xTaskDelayUntil(&last_wake, period);
+    }
+}
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+
+void Esp32Camera::SetPowerSaveMode(bool enabled) {
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    frame_ring_paused_ = enabled;
+    if (frame_ring_task_ != nullptr) {
+        xTaskNotifyGive(frame_ring_task_);
+    }
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+}
+
 void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token) {
     explain_url_ = url;
     explain_token_ = token;
@@ -387,353 +556,284 @@ bool Esp32Camera::Capture() {
         return false;
     }
 
-    for (int i = 0; i < 3; i++) {
-        struct v4l2_buffer buf = {};
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        if (ioctl(video_fd_, VIDIOC_DQBUF, &buf) != 0) {
-            ESP_LOGE(TAG, "VIDIOC_DQBUF failed");
-            return false;
-        }
-        if (i == 2) {
-            // 保存帧副本到PSRAM
-            if (frame_.data) {
-                heap_caps_free(frame_.data);
-                frame_.data = nullptr;
-                frame_.format = 0;
-            }
-            frame_.len = buf.bytesused;
-            frame_.data = (uint8_t*)heap_caps_malloc(frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (!frame_.data) {
-                ESP_LOGE(TAG, "alloc frame copy failed");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                return false;
-            }
+    // The previous frame gives its buffer back first, a DVP camera has only one
+    frame_.Clear();
+    FrameLease lease;
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    // The newest frame of the ring is taken at once, once the exposure settled after a pause
+    CameraFrameRing::Frame ring_frame;
+    int64_t now = esp_timer_get_time();
+    if (!frame_ring_paused_ &&
+        frame_ring_.Newest(now, 2 * 1000000 / CONFIG_XIAOZHI_CAMERA_FRAME_RING_FPS, ring_frame)) {
+        lease = std::move(ring_frame.lease);
+        ESP_LOGI(TAG, "Frame from the ring, %d ms old", (int)((now - ring_frame.timestamp_us) / 1000));
+    }
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    if (!lease.valid()) {
+        // The queued buffers hold stale frames, filled before this call
+        lease = buffer_pool_.AcquireFresh();
+    }
+    if (!lease.valid()) {
+        return false;
+    }
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-            ESP_LOGW(TAG, "mmap_buffers_[buf.index].length = %d, sensor_width = %d, sensor_height = %d",
-                     mmap_buffers_[buf.index].length, sensor_width_, sensor_height_);
+    uint16_t sensor_width = sensor_width_;
+    uint16_t sensor_height = sensor_height_;
 #else
-            ESP_LOGW(TAG, "mmap_buffers_[buf.index].length = %d, frame.width = %d, frame.height = %d",
-                     mmap_buffers_[buf.index].length, frame_.width, frame_.height);
+    uint16_t sensor_width = frame_width_;
+    uint16_t sensor_height = frame_height_;
 #endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-            ESP_LOG_BUFFER_HEXDUMP(TAG, mmap_buffers_[buf.index].start, MIN(mmap_buffers_[buf.index].length, 256),
-                                   ESP_LOG_DEBUG);
-
-            switch (sensor_format_) {
-                case V4L2_PIX_FMT_RGB565:
-                case V4L2_PIX_FMT_RGB24:
-                case V4L2_PIX_FMT_YUYV:
-                case V4L2_PIX_FMT_YUV420:
-                case V4L2_PIX_FMT_GREY:
-#ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                {
-                    auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                    auto dst16 = (uint16_t*)frame_.data;
-                    size_t count = (size_t)mmap_buffers_[buf.index].length / 2;
-                    for (size_t i = 0; i < count; i++) {
-                        dst16[i] = __builtin_bswap16(src16[i]);
-                    }
-                }
-#else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start,
-                           MIN(mmap_buffers_[buf.index].length, frame_.len));
-#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    frame_.format = sensor_format_;
-                    break;
-                case V4L2_PIX_FMT_YUV422P: {
-                    // 这个格式是 422 YUYV，不是 planer
-                    frame_.format = V4L2_PIX_FMT_YUYV;
+    ESP_LOGW(TAG, "mmap_buffers_[%u].length = %d, bytesused = %d, sensor_width = %d, sensor_height = %d",
+             (unsigned)lease.index(), mmap_buffers_[lease.index()].length, lease.size(), sensor_width, sensor_height);
+    ESP_LOG_BUFFER_HEXDUMP(TAG, lease.data(), MIN(lease.size(), 256), ESP_LOG_DEBUG);
+
+    // The frame is read from the mmap buffer, it is only copied when the bytes have to be swapped
+    v4l2_pix_fmt_t format;
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    {
-                        auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                        auto dst16 = (uint16_t*)frame_.data;
-                        size_t count = (size_t)mmap_buffers_[buf.index].length / 2;
-                        for (size_t i = 0; i < count; i++) {
-                            dst16[i] = __builtin_bswap16(src16[i]);
-                        }
-                    }
+    bool swap_bytes = true;
 #else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start,
-                           MIN(mmap_buffers_[buf.index].length, frame_.len));
+    bool swap_bytes = false;
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    break;
-                }
-                case V4L2_PIX_FMT_RGB565X: {
-                    // 大端序的 RGB565 需要转换为小端序
-                    // 目前 esp_video 的大小端都会返回格式为 RGB565，不会返回格式为 RGB565X，此 case 用于未来版本兼容
-                    auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                    auto dst16 = (uint16_t*)frame_.data;
-                    size_t pixel_count = (size_t)frame_.width * (size_t)frame_.height;
-                    for (size_t i = 0; i < pixel_count; i++) {
-                        dst16[i] = __builtin_bswap16(src16[i]);
-                    }
-                    frame_.format = V4L2_PIX_FMT_RGB565;
-                    break;
-                }
-                default:
-                    ESP_LOGE(TAG, "unsupported sensor format: 0x%08x", sensor_format_);
-                    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                        ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                    }
-                    return false;
-            }
+    switch (sensor_format_) {
+        case V4L2_PIX_FMT_RGB565:
+        case V4L2_PIX_FMT_RGB24:
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_GREY:
+            format = sensor_format_;
+            break;
+        case V4L2_PIX_FMT_YUV422P:
+            // 这个格式是 422 YUYV，不是 planer
+            format = V4L2_PIX_FMT_YUYV;
+            break;
+        case V4L2_PIX_FMT_RGB565X:
+            // 大端序的 RGB565 需要转换为小端序
+            // 目前 esp_video 的大小端都会返回格式为 RGB565，不会返回格式为 RGB565X，此 case 用于未来版本兼容
+            format = V4L2_PIX_FMT_RGB565;
+            swap_bytes = true;
+            break;
+        default:
+            ESP_LOGE(TAG, "unsupported sensor format: 0x%08x", sensor_format_);
+            return false;
+    }
+
+    if (swap_bytes) {
+        // The mmap buffer stays read only, the swapped frame goes to the frame storage
+        auto dst16 = (uint16_t*)frame_.Reserve(lease.size());
+        if (dst16 == nullptr) {
+            return false;
+        }
+        auto src16 = (const uint16_t*)lease.data();
+        size_t count = lease.size() / 2;
+        for (size_t i = 0; i < count; i++) {
+            dst16[i] = __builtin_bswap16(src16[i]);
+        }
+        frame_.UseReserved(lease.size(), sensor_width, sensor_height, format);
+        lease.Release();
+    } else {
+        frame_.Use(std::move(lease), sensor_width, sensor_height, format);
+    }
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
 #ifndef CONFIG_SOC_PPA_SUPPORTED
-            uint8_t* rotate_dst =
-                (uint8_t*)heap_caps_aligned_alloc(64, frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (rotate_dst == nullptr) {
-                ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                return false;
-            }
-            uint8_t* rotate_src = (uint8_t*)frame_.data;
-
-            esp_imgfx_rotate_cfg_t rotate_cfg = {
-                .in_res =
-                    {
-                        .width = static_cast<int16_t>(sensor_width_),
-                        .height = static_cast<int16_t>(sensor_height_),
-                    },
-                .degree = IMAGE_ROTATION_ANGLE,
-            };
-            switch (frame_.format) {
-                case V4L2_PIX_FMT_RGB565:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
-                    break;
-                case V4L2_PIX_FMT_YUYV:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
-                    break;
-                case V4L2_PIX_FMT_GREY:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_Y;
-                    break;
-                case V4L2_PIX_FMT_RGB24:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
-                    break;
-                default:
-                    ESP_LOGE(TAG, "unsupported sensor format: 0x%08x", sensor_format_);
-                    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                        ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                    }
-                    return false;
-            }
-            esp_imgfx_rotate_handle_t rotate_handle = nullptr;
-            esp_imgfx_err_t imgfx_err = esp_imgfx_rotate_open(&rotate_cfg, &rotate_handle);
-            if (imgfx_err != ESP_IMGFX_ERR_OK || rotate_handle == nullptr) {
-                ESP_LOGE(TAG, "esp_imgfx_rotate_create failed");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                return false;
-            }
+    esp_imgfx_rotate_cfg_t rotate_cfg = {
+        .in_res =
+            {
+                .width = static_cast<int16_t>(sensor_width_),
+                .height = static_cast<int16_t>(sensor_height_),
+            },
+        .degree = IMAGE_ROTATION_ANGLE,
+    };
+    switch (frame_.format()) {
+        case V4L2_PIX_FMT_RGB565:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            break;
+        case V4L2_PIX_FMT_GREY:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_Y;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
+            break;
+        default:
+            ESP_LOGE(TAG, "unsupported sensor format: 0x%08x", sensor_format_);
+            frame_.Clear();
+            return false;
+    }
 
-            esp_imgfx_data_t rotate_input_data = {
-                .data = rotate_src,
-                .data_len = frame_.len,
-            };
-            esp_imgfx_data_t rotate_output_data = {
-                .data = rotate_dst,
-                .data_len = frame_.len,
-            };
+    // Rotated straight from the sensor buffer into the frame storage kept across captures
+    size_t rotate_len = frame_.len();
+    uint8_t* rotate_dst = frame_.Reserve(rotate_len);
+    if (rotate_dst == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
+        frame_.Clear();
+        return false;
+    }
 
-            imgfx_err = esp_imgfx_rotate_process(rotate_handle, &rotate_input_data, &rotate_output_data);
-            if (imgfx_err != ESP_IMGFX_ERR_OK) {
-                ESP_LOGE(TAG, "esp_imgfx_rotate_process failed");
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                esp_imgfx_rotate_close(rotate_handle);
-                rotate_handle = nullptr;
-                return false;
-            }
+    esp_imgfx_rotate_handle_t rotate_handle = nullptr;
+    esp_imgfx_err_t imgfx_err = esp_imgfx_rotate_open(&rotate_cfg, &rotate_handle);
+    if (imgfx_err != ESP_IMGFX_ERR_OK || rotate_handle == nullptr) {
+        ESP_LOGE(TAG, "esp_imgfx_rotate_create failed");
+        frame_.Clear();
+        return false;
+    }
 
-            frame_.data = rotate_dst;
+    esp_imgfx_data_t rotate_input_data = {
+        .data = const_cast<uint8_t*>(frame_.data()),
+        .data_len = rotate_len,
+    };
+    esp_imgfx_data_t rotate_output_data = {
+        .data = rotate_dst,
+        .data_len = rotate_len,
+    };
 
-            heap_caps_free(rotate_src);
-            rotate_src = nullptr;
+    imgfx_err = esp_imgfx_rotate_process(rotate_handle, &rotate_input_data, &rotate_output_data);
+    esp_imgfx_rotate_close(rotate_handle);
+    rotate_handle = nullptr;
+    if (imgfx_err != ESP_IMGFX_ERR_OK) {
+        ESP_LOGE(TAG, "esp_imgfx_rotate_process failed");
+        frame_.Clear();
+        return false;
+    }
 
-            esp_imgfx_rotate_close(rotate_handle);
-            rotate_handle = nullptr;
+    // The sensor buffer is queued back here, before the preview is converted
+    frame_.UseReserved(rotate_len, frame_width_, frame_height_, frame_.format());
 #else   // CONFIG_SOC_PPA_SUPPORTED
-            uint8_t* rotate_src = nullptr;
-
-            ppa_srm_color_mode_t ppa_color_mode;
-            switch (frame_.format) {
-                case V4L2_PIX_FMT_RGB565:
-                    rotate_src = (uint8_t*)frame_.data;
-                    ppa_color_mode = PPA_SRM_COLOR_MODE_RGB565;
-                    break;
-                case V4L2_PIX_FMT_RGB24:
-                    rotate_src = (uint8_t*)frame_.data;
-                    ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
-                    break;
-                case V4L2_PIX_FMT_YUYV: {
-                    ESP_LOGW(TAG, "YUYV format is not supported for PPA rotation, using software conversion to RGB888");
-                    rotate_src = (uint8_t*)heap_caps_malloc(frame_.width * frame_.height * 3,
-                                                            MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                    if (rotate_src == nullptr) {
-                        ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
-                        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                            ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                        }
-                        return false;
-                    }
-                    esp_imgfx_color_convert_cfg_t convert_cfg = {
-                        .in_res = {.width = static_cast<int16_t>(frame_.width),
-                                   .height = static_cast<int16_t>(frame_.height)},
-                        .in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
-                        .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888,
-                    };
-                    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
-                    esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
-                    if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
-                        ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
-                        heap_caps_free(rotate_src);
-                        rotate_src = nullptr;
-                        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                            ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                        }
-                        return false;
-                    }
-                    esp_imgfx_data_t convert_input_data = {
-                        .data = frame_.data,
-                        .data_len = frame_.len,
-                    };
-                    esp_imgfx_data_t convert_output_data = {
-                        .data = rotate_src,
-                        .data_len = static_cast<uint32_t>(frame_.width * frame_.height * 3),
-                    };
-                    err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
-                    if (err != ESP_IMGFX_ERR_OK) {
-                        ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
-                        heap_caps_free(rotate_src);
-                        rotate_src = nullptr;
-                        esp_imgfx_color_convert_close(convert_handle);
-                        convert_handle = nullptr;
-                        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                            ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                        }
-                        return false;
-                    }
-                    esp_imgfx_color_convert_close(convert_handle);
-                    convert_handle = nullptr;
-                    ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
-                    heap_caps_free(frame_.data);
-                    frame_.data = rotate_src;
-                    frame_.len = frame_.width * frame_.height * 3;
-                    break;
-                }
-                default:
-                    ESP_LOGE(TAG, "unsupported sensor format for PPA rotation: 0x%08x", sensor_format_);
-                    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                        ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                    }
-                    return false;
-            }
-
-            uint8_t* rotate_dst = (uint8_t*)heap_caps_malloc(
-                frame_.width * frame_.height * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT | MALLOC_CAP_CACHE_ALIGNED);
-            if (rotate_dst == nullptr) {
+    ppa_srm_color_mode_t ppa_color_mode;
+    switch (frame_.format()) {
+        case V4L2_PIX_FMT_RGB565:
+            ppa_color_mode = PPA_SRM_COLOR_MODE_RGB565;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
+            break;
+        case V4L2_PIX_FMT_YUYV: {
+            ESP_LOGW(TAG, "YUYV format is not supported for PPA rotation, using software conversion to RGB888");
+            size_t rgb_len = (size_t)sensor_width_ * sensor_height_ * 3;
+            uint8_t* rgb = frame_.Reserve(rgb_len);
+            if (rgb == nullptr) {
                 ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
+                frame_.Clear();
                 return false;
             }
-
-            ppa_client_handle_t ppa_client = nullptr;
-            ppa_client_config_t client_cfg = {
-                .oper_type = PPA_OPERATION_SRM,
-                .max_pending_trans_num = 1,
+            esp_imgfx_color_convert_cfg_t convert_cfg = {
+                .in_res = {.width = static_cast<int16_t>(sensor_width_),
+                           .height = static_cast<int16_t>(sensor_height_)},
+                .in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+                .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888,
             };
-            esp_err_t err = ppa_register_client(&client_cfg, &ppa_client);
-            if (err != ESP_OK || ppa_client == nullptr) {
-                ESP_LOGE(TAG, "ppa_register_client failed: %d", (int)err);
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
+            esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+            esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
+            if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+                frame_.Clear();
                 return false;
             }
-
-            ppa_srm_rotation_angle_t ppa_angle = IMAGE_ROTATION_ANGLE;
-
-            ppa_srm_oper_config_t srm_cfg = {};
-            srm_cfg.in.buffer = (void*)rotate_src;
-            srm_cfg.in.pic_w = sensor_width_;
-            srm_cfg.in.pic_h = sensor_height_;
-            srm_cfg.in.block_w = sensor_width_;
-            srm_cfg.in.block_h = sensor_height_;
-            srm_cfg.in.block_offset_x = 0;
-            srm_cfg.in.block_offset_y = 0;
-            srm_cfg.in.srm_cm = ppa_color_mode;
-
-            srm_cfg.out.buffer = (void*)rotate_dst;
-            srm_cfg.out.buffer_size = frame_.len;
-            srm_cfg.out.pic_w = frame_.width;
-            srm_cfg.out.pic_h = frame_.height;
-            srm_cfg.out.block_offset_x = 0;
-            srm_cfg.out.block_offset_y = 0;
-            srm_cfg.out.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
-
-            // 等比例缩放 1.0
-            srm_cfg.scale_x = 1.0f;
-            srm_cfg.scale_y = 1.0f;
-            srm_cfg.rotation_angle = ppa_angle;
-            srm_cfg.mode = PPA_TRANS_MODE_BLOCKING;
-            srm_cfg.user_data = nullptr;
-
-            err = ppa_do_scale_rotate_mirror(ppa_client, &srm_cfg);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "ppa_do_scale_rotate_mirror failed: %d", (int)err);
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
-                (void)ppa_unregister_client(ppa_client);
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
+            esp_imgfx_data_t convert_input_data = {
+                .data = const_cast<uint8_t*>(frame_.data()),
+                .data_len = static_cast<uint32_t>(frame_.len()),
+            };
+            esp_imgfx_data_t convert_output_data = {
+                .data = rgb,
+                .data_len = static_cast<uint32_t>(rgb_len),
+            };
+            err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
+            esp_imgfx_color_convert_close(convert_handle);
+            convert_handle = nullptr;
+            if (err != ESP_IMGFX_ERR_OK) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                frame_.Clear();
                 return false;
             }
+            frame_.UseReserved(rgb_len, sensor_width_, sensor_height_, V4L2_PIX_FMT_RGB24);
+            ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
+            break;
+        }
+        default:
+            ESP_LOGE(TAG, "unsupported sensor format for PPA rotation: 0x%08x", sensor_format_);
+            frame_.Clear();
+            return false;
+    }
 
-            (void)ppa_unregister_client(ppa_client);
+    // The PPA reads the sensor buffer (or the RGB888 conversion) and writes the frame storage
+    size_t rotate_len = (size_t)frame_width_ * frame_height_ * 2;
+    uint8_t* rotate_dst = frame_.Reserve(rotate_len);
+    if (rotate_dst == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
+        frame_.Clear();
+        return false;
+    }
 
-            frame_.data = rotate_dst;
-            frame_.len = frame_.width * frame_.height * 2;
-            frame_.format = V4L2_PIX_FMT_RGB565;
-            heap_caps_free(rotate_src);
-            rotate_src = nullptr;
-#endif  // CONFIG_SOC_PPA_SUPPORTED
-#endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-        }
+    ppa_client_handle_t ppa_client = nullptr;
+    ppa_client_config_t client_cfg = {
+        .oper_type = PPA_OPERATION_SRM,
+        .max_pending_trans_num = 1,
+    };
+    esp_err_t err = ppa_register_client(&client_cfg, &ppa_client);
+    if (err != ESP_OK || ppa_client == nullptr) {
+        ESP_LOGE(TAG, "ppa_register_client failed: %d", (int)err);
+        frame_.Clear();
+        return false;
+    }
 
-        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-            ESP_LOGE(TAG, "VIDIOC_QBUF failed");
-        }
+    ppa_srm_rotation_angle_t ppa_angle = IMAGE_ROTATION_ANGLE;
+
+    ppa_srm_oper_config_t srm_cfg = {};
+    srm_cfg.in.buffer = (void*)frame_.data();
+    srm_cfg.in.pic_w = sensor_width_;
+    srm_cfg.in.pic_h = sensor_height_;
+    srm_cfg.in.block_w = sensor_width_;
+    srm_cfg.in.block_h = sensor_height_;
+    srm_cfg.in.block_offset_x = 0;
+    srm_cfg.in.block_offset_y = 0;
+    srm_cfg.in.srm_cm = ppa_color_mode;
+
+    srm_cfg.out.buffer = (void*)rotate_dst;
+    srm_cfg.out.buffer_size = rotate_len;
+    srm_cfg.out.pic_w = frame_width_;
+    srm_cfg.out.pic_h = frame_height_;
+    srm_cfg.out.block_offset_x = 0;
+    srm_cfg.out.block_offset_y = 0;
+    srm_cfg.out.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+
+    // 等比例缩放 1.0
+    srm_cfg.scale_x = 1.0f;
+    srm_cfg.scale_y = 1.0f;
+    srm_cfg.rotation_angle = ppa_angle;
+    srm_cfg.mode = PPA_TRANS_MODE_BLOCKING;
+    srm_cfg.user_data = nullptr;
+
+    err = ppa_do_scale_rotate_mirror(ppa_client, &srm_cfg);
+    (void)ppa_unregister_client(ppa_client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ppa_do_scale_rotate_mirror failed: %d", (int)err);
+        frame_.Clear();
+        return false;
     }
 
+    frame_.UseReserved(rotate_len, frame_width_, frame_height_, V4L2_PIX_FMT_RGB565);
+#endif  // CONFIG_SOC_PPA_SUPPORTED
+#endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
+
     // 显示预览图片
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
     if (display != nullptr) {
-        if (!frame_.data) {
+        if (!frame_.data()) {
             ESP_LOGE(TAG, "frame.data is null");
             return false;
         }
-        uint16_t w = frame_.width;
-        uint16_t h = frame_.height;
-        size_t lvgl_image_size = frame_.len;
+        uint16_t w = frame_.width();
+        uint16_t h = frame_.height();
+        size_t lvgl_image_size = frame_.len();
         size_t stride = ((w * 2) + 3) & ~3;  // 4字节对齐
         lv_color_format_t color_format = LV_COLOR_FORMAT_RGB565;
         uint8_t* data = nullptr;
 
-        switch (frame_.format) {
+        // The display keeps the preview, so it gets its own copy converted from the frame
+        switch (frame_.format()) {
             // LVGL 显示 YUV 系的图像似乎都有问题，暂时转换为 RGB565 显示
             case V4L2_PIX_FMT_YUYV:
             case V4L2_PIX_FMT_YUV420:
@@ -745,9 +845,9 @@ bool Esp32Camera::Capture() {
                     return false;
                 }
                 esp_imgfx_color_convert_cfg_t convert_cfg = {
-                    .in_res = {.width = static_cast<int16_t>(frame_.width),
-                               .height = static_cast<int16_t>(frame_.height)},
-                    .in_pixel_fmt = static_cast<esp_imgfx_pixel_fmt_t>(frame_.format),
+                    .in_res = {.width = static_cast<int16_t>(frame_.width()),
+                               .height = static_cast<int16_t>(frame_.height())},
+                    .in_pixel_fmt = static_cast<esp_imgfx_pixel_fmt_t>(frame_.format()),
                     .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE,
                     .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
                 };
@@ -760,8 +860,8 @@ bool Esp32Camera::Capture() {
                     return false;
                 }
                 esp_imgfx_data_t convert_input_data = {
-                    .data = frame_.data,
-                    .data_len = frame_.len,
+                    .data = const_cast<uint8_t*>(frame_.data()),
+                    .data_len = static_cast<uint32_t>(frame_.len()),
                 };
                 esp_imgfx_data_t convert_output_data = {
                     .data = data,
@@ -788,12 +888,12 @@ bool Esp32Camera::Capture() {
                     ESP_LOGE(TAG, "Failed to allocate memory for preview image");
                     return false;
                 }
-                memcpy(data, frame_.data, frame_.len);
-                lvgl_image_size = frame_.len;  // fallthrough 时兼顾 YUYV 与 RGB565
+                memcpy(data, frame_.data(), MIN(frame_.len(), (size_t)w * h * 2));
+                lvgl_image_size = w * h * 2;
                 break;
 
             default:
-                ESP_LOGE(TAG, "unsupported frame format: 0x%08lx", frame_.format);
+                ESP_LOGE(TAG, "unsupported frame format: 0x%08lx", frame_.format());
                 return false;
         }
 
@@ -847,7 +947,7 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * 实现特点：
  * - 使用独立线程编码JPEG，与主线程分离
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
- * - 通过队列机制实现编码线程和发送线程的数据同步
+ * - 编码线程直接写入固定的环形缓冲区槽位，发送线程原地发送，槽位用满时编码线程等待
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
  *
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
@@ -861,33 +961,84 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
 std::string Esp32Camera::Explain(const std::string& question) {
+    PhotoOptions options;
+    options.max_size = CONFIG_XIAOZHI_CAMERA_PHOTO_MAX_SIZE;
+    options.quality = CONFIG_XIAOZHI_CAMERA_PHOTO_QUALITY;
+    return Explain(question, options);
+}
+
+std::string Esp32Camera::Explain(const std::string& question, const PhotoOptions& options) {
     if (explain_url_.empty()) {
         throw std::runtime_error("Image explain URL or token is not set");
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
-        throw std::runtime_error("Failed to create JPEG queue");
+    if (!jpeg_ring_) {
+        jpeg_ring_ = std::make_unique<JpegChunkRing>(kJpegSlotCount, kJpegSlotSize);
     }
+    if (!jpeg_ring_->valid()) {
+        throw std::runtime_error("Failed to allocate JPEG chunk ring");
+    }
+    auto ring = jpeg_ring_.get();
+    ring->Reset();
 
     // We spawn a thread to encode the image to JPEG using optimized encoder (cost about 500ms and 8KB SRAM)
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        uint16_t w = frame_.width ? frame_.width : 320;
-        uint16_t h = frame_.height ? frame_.height : 240;
-        v4l2_pix_fmt_t enc_fmt = frame_.format;
-        image_to_jpeg_cb(
-            frame_.data, frame_.len, w, h, enc_fmt, 80,
+    auto pthread_cfg = esp_pthread_get_default_config();
+    pthread_cfg.stack_size = TASK_STACK_JPEG_ENCODER;
+    pthread_cfg.thread_name = "jpeg_encoder";
+    esp_pthread_set_cfg(&pthread_cfg);
+    // The encoder holds its own lease, the sensor buffer stays out of the driver until it is done
+    encoder_thread_ = std::thread([this, ring, options, lease = frame_.lease()]() mutable {
+        uint16_t w = frame_.width() ? frame_.width() : 320;
+        uint16_t h = frame_.height() ? frame_.height() : 240;
+        v4l2_pix_fmt_t enc_fmt = frame_.format();
+
+        // Crop and downscale while encoding, the vision model does not need the full resolution
+        jpeg_crop_t crop = {0, 0, w, h};
+        if (options.crop_width > 0 && options.crop_height > 0) {
+            crop.x = w * options.crop_x / 100;
+            crop.y = h * options.crop_y / 100;
+            crop.width = std::max(1, w * options.crop_width / 100);
+            crop.height = std::max(1, h * options.crop_height / 100);
+        }
+        uint16_t out_w = crop.width, out_h = crop.height;
+        if (image_scale_supported(enc_fmt)) {
+            image_scale_fit(crop.width, crop.height, options.max_size, &out_w, &out_h);
+        } else if (crop.width != w || crop.height != h || options.max_size > 0) {
+            ESP_LOGW(TAG, "Cannot scale format 0x%08lx, uploading the full frame", (unsigned long)enc_fmt);
+            crop = {0, 0, w, h};
+            out_w = w;
+            out_h = h;
+        }
+        ESP_LOGI(TAG, "Encoding %ux%u+%u+%u of %ux%u to %ux%u, quality %d", crop.width, crop.height, crop.x, crop.y,
+                 w, h, out_w, out_h, options.quality);
+
+        bool ok = image_to_jpeg_crop_cb(
+            const_cast<uint8_t*>(frame_.data()), frame_.len(), w, h, enc_fmt, &crop, out_w, out_h, options.quality,
             [](void* arg, size_t index, const void* data, size_t len) -> size_t {
-                auto jpeg_queue = (QueueHandle_t)arg;
-                JpegChunk chunk = {.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM), .len = len};
-                memcpy(chunk.data, data, len);
-                xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-                return len;
+                auto ring = (JpegChunkRing*)arg;
+                if (data == nullptr) {
+                    return 0;  // The end of the stream, committed by Finish()
+                }
+                // Waits while every slot is being sent, returning 0 stops the encoder
+                return ring->Append(data, len) ? len : 0;
             },
-            jpeg_queue);
+            ring);
+        ring->Finish(ok);
+        lease.Release();
+#if CONFIG_USE_TASK_STACK_RECORDER
+        TaskStackRecorder::GetInstance().RecordCurrentTask();
+#endif
     });
+    // Later threads created by this task get the default configuration again
+    pthread_cfg = esp_pthread_get_default_config();
+    esp_pthread_set_cfg(&pthread_cfg);
+
+    // Stops the encoder, which may be waiting for a slot, before the upload gives up
+    auto abort_upload = [this, ring](const char* message) {
+        ring->Cancel();
+        encoder_thread_.join();
+        throw std::runtime_error(message);
+    };
 
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(3);
@@ -904,18 +1055,7 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
-        encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
-        throw std::runtime_error("Failed to connect to explain URL");
+        abort_upload("Failed to connect to explain URL");
     }
 
     {
@@ -925,7 +1065,9 @@ std::string Esp32Camera::Explain(const std::string& question) {
         question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
         question_field += "\r\n";
         question_field += question + "\r\n";
-        http->Write(question_field.c_str(), question_field.size());
+        if (http->Write(question_field.c_str(), question_field.size()) < 0) {
+            abort_upload("Failed to upload photo");
+        }
     }
     {
         // 第二块：文件字段头部
@@ -934,28 +1076,29 @@ std::string Esp32Camera::Explain(const std::string& question) {
         file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
         file_header += "Content-Type: image/jpeg\r\n";
         file_header += "\r\n";
-        http->Write(file_header.c_str(), file_header.size());
+        if (http->Write(file_header.c_str(), file_header.size()) < 0) {
+            abort_upload("Failed to upload photo");
+        }
     }
 
-    // 第三块：JPEG数据
+    // 第三块：JPEG数据，直接从环形缓冲区的槽位发送
     size_t total_sent = 0;
-    while (true) {
-        JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to receive JPEG chunk");
-            break;
+    const uint8_t* chunk = nullptr;
+    size_t chunk_len = 0;
+    while (ring->Front(chunk, chunk_len)) {
+        if (http->Write((const char*)chunk, chunk_len) < 0) {
+            ESP_LOGE(TAG, "Failed to send JPEG chunk after %u bytes", (unsigned)total_sent);
+            abort_upload("Failed to upload photo");
         }
-        if (chunk.data == nullptr) {
-            break;  // The last chunk
-        }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        total_sent += chunk_len;
+        ring->Pop();
     }
     // Wait for the encoder thread to finish
     encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
+    if (!ring->complete()) {
+        ESP_LOGE(TAG, "Failed to encode JPEG after %u bytes", (unsigned)total_sent);
+        throw std::runtime_error("Failed to encode photo");
+    }
 
     {
         // 第四块：multipart尾部
@@ -977,6 +1120,6 @@ std::string Esp32Camera::Explain(const std::string& question) {
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
     ESP_LOGI(TAG, "Explain image size=%d bytes, compressed size=%d, remain stack size=%d, question=%s\n%s",
-             (int)frame_.len, (int)total_sent, (int)remain_stack_size, question.c_str(), result.c_str());
+             (int)frame_.len(), (int)total_sent, (int)remain_stack_size, question.c_str(), result.c_str());
     return result;
 }
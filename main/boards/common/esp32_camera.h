@@ -3,44 +3,57 @@
 
 #ifndef CONFIG_IDF_TARGET_ESP32
 #include <lvgl.h>
+#include <atomic>
 #include <thread>
 #include <memory>
 #include <vector>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/task.h>
 
 #include "camera.h"
+#include "camera_buffer_pool.h"
+#include "camera_frame_ring.h"
+#include "jpeg_chunk_ring.h"
 #include "jpg/image_to_jpeg.h"
 #include "esp_video_init.h"
 
-struct JpegChunk {
-    uint8_t* data;
-    size_t len;
-};
-
 class Esp32Camera : public Camera {
 private:
-    struct FrameBuffer {
-        uint8_t *data = nullptr;
-        size_t len = 0;
-        uint16_t width = 0;
-        uint16_t height = 0;
-        v4l2_pix_fmt_t format = 0;
-    } frame_;
     v4l2_pix_fmt_t sensor_format_ = 0;
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
     uint16_t sensor_width_ = 0;
     uint16_t sensor_height_ = 0;
 #endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
+    // Size of the captured frame, after rotation
+    uint16_t frame_width_ = 0;
+    uint16_t frame_height_ = 0;
     int video_fd_ = -1;
     bool streaming_on_ = false;
     struct MmapBuffer { void *start = nullptr; size_t length = 0; };
     std::vector<MmapBuffer> mmap_buffers_;
+    // Declared before frame_, which may still lease one of its buffers
+    CameraBufferPool buffer_pool_;
+    CameraFrame frame_;
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    CameraFrameRing frame_ring_{CONFIG_XIAOZHI_CAMERA_FRAME_RING_DEPTH};
+    TaskHandle_t frame_ring_task_ = nullptr;
+    // Paused until the board leaves power save mode
+    std::atomic<bool> frame_ring_paused_{true};
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
     std::string explain_url_;
     std::string explain_token_;
+    // Allocated by the first Explain() and reused, the encoder thread is joined before it is destroyed
+    std::unique_ptr<JpegChunkRing> jpeg_ring_;
     std::thread encoder_thread_;
 
+    bool DequeueBuffer(uint32_t& index, size_t& bytesused, int64_t& timestamp_us);
+    bool QueueBuffer(uint32_t index);
+#if CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+    void FrameRingTask();
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING
+
 public:
     Esp32Camera(const esp_video_init_config_t& config);
     ~Esp32Camera();
@@ -51,6 +64,8 @@ public:
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
     virtual std::string Explain(const std::string& question);
+    virtual std::string Explain(const std::string& question, const PhotoOptions& options) override;
+    virtual void SetPowerSaveMode(bool enabled) override;
 };
 
 #endif // ndef CONFIG_IDF_TARGET_ESP32
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "jpeg_chunk_ring.h"
+#include "arena_allocator.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "JpegChunkRing"
+
+static MemoryRegion& camera_region() {
+    static MemoryRegion* region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_CAMERA);
+    return *region;
+}
+
+JpegChunkRing::JpegChunkRing(size_t slot_count, size_t slot_size)
+    : slot_count_(slot_count > 0 ? slot_count : 1), slot_size_(slot_size > 0 ? slot_size : 1),
+      lengths_(slot_count_, 0) {
+    // The photo upload is part of the camera's memory budget
+    storage_ = (uint8_t*)camera_region().Allocate(slot_count_ * slot_size_, 16);
+    stats_.allocations++;
+    if (storage_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u slots of %u bytes", (unsigned)slot_count_, (unsigned)slot_size_);
+    }
+}
+
+JpegChunkRing::~JpegChunkRing() {
+    camera_region().Free(storage_);
+}
+
+void JpegChunkRing::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    head_ = 0;
+    committed_ = 0;
+    fill_ = 0;
+    finished_ = false;
+    failed_ = false;
+    cancelled_ = false;
+}
+
+bool JpegChunkRing::Append(const void* data, size_t len) {
+    auto src = (const uint8_t*)data;
+    do {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (committed_ == slot_count_ && !cancelled_) {
+                stats_.producer_waits++;
+                cv_.wait(lock, [this]() { return committed_ < slot_count_ || cancelled_; });
+            }
+            if (cancelled_ || storage_ == nullptr) {
+                return false;
+            }
+            index = (head_ + committed_) % slot_count_;
+        }
+
+        // The slot after the committed ones belongs to the encoder, it is filled without the lock
+        size_t n = std::min(len, slot_size_ - fill_);
+        if (n > 0) {
+            memcpy(slot(index) + fill_, src, n);
+            fill_ += n;
+            src += n;
+            len -= n;
+        }
+
+        if (fill_ == slot_size_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lengths_[index] = fill_;
+            committed_++;
+            fill_ = 0;
+            stats_.chunks++;
+            stats_.bytes += slot_size_;
+            stats_.peak_committed = std::max<uint32_t>(stats_.peak_committed, committed_);
+            cv_.notify_all();
+        }
+    } while (len > 0);
+    return true;
+}
+
+void JpegChunkRing::Finish(bool ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A partial slot is only filled while a slot is free, so it can always be committed
+    if (ok && !cancelled_ && fill_ > 0) {
+        size_t index = (head_ + committed_) % slot_count_;
+        lengths_[index] = fill_;
+        committed_++;
+        stats_.chunks++;
+        stats_.bytes += fill_;
+        stats_.peak_committed = std::max<uint32_t>(stats_.peak_committed, committed_);
+    }
+    if (ok && !cancelled_) {
+        stats_.streams++;
+    }
+    fill_ = 0;
+    finished_ = true;
+    failed_ = !ok;
+    cv_.notify_all();
+}
+
+bool JpegChunkRing::Front(const uint8_t*& data, size_t& len) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return committed_ > 0 || finished_ || cancelled_; });
+    if (cancelled_ || failed_ || committed_ == 0) {
+        return false;
+    }
+    data = slot(head_);
+    len = lengths_[head_];
+    return true;
+}
+
+void JpegChunkRing::Pop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (committed_ > 0) {
+        head_ = (head_ + 1) % slot_count_;
+        committed_--;
+    }
+    cv_.notify_all();
+}
+
+void JpegChunkRing::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cancelled_) {
+        cancelled_ = true;
+        stats_.cancelled++;
+    }
+    cv_.notify_all();
+}
+
+bool JpegChunkRing::complete() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_ && !failed_ && !cancelled_;
+}
+
+JpegChunkRing::Stats JpegChunkRing::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,84 @@
+#ifndef JPEG_CHUNK_RING_H
+#define JPEG_CHUNK_RING_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Fixed slots carrying a JPEG stream from the encoder task to the HTTP upload. The slots
+ * are allocated once and reused for every photo, so the stream costs no allocation per
+ * chunk and at most slot_count * slot_size bytes however large the image is.
+ *
+ * The encoder appends its output into the slot it is filling and commits the slot when
+ * it is full. It waits for the uploader when every slot is committed, which paces the
+ * encoder to the network. The uploader writes committed slots straight from the ring
+ * and gives each one back once it is sent.
+ *
+ * Either side may stop the stream: the encoder with Finish(false), the uploader with
+ * Cancel(). The other side returns at once, so a failed upload never leaves the encoder
+ * blocked on a full ring. Runs the same in scripts/jpeg_chunk_ring_test.
+ */
+class JpegChunkRing {
+public:
+    struct Stats {
+        uint32_t streams = 0;           // Images encoded completely
+        uint32_t chunks = 0;
+        uint32_t bytes = 0;
+        uint32_t producer_waits = 0;    // Appends that waited for a slot to be sent
+        uint32_t peak_committed = 0;    // Most slots waiting to be sent at once
+        uint32_t cancelled = 0;
+        uint32_t allocations = 0;
+    };
+
+    JpegChunkRing(size_t slot_count, size_t slot_size);
+    JpegChunkRing(const JpegChunkRing&) = delete;
+    JpegChunkRing& operator=(const JpegChunkRing&) = delete;
+    ~JpegChunkRing();
+
+    // False if the slots could not be allocated
+    bool valid() const { return storage_ != nullptr; }
+    size_t slot_count() const { return slot_count_; }
+    size_t slot_size() const { return slot_size_; }
+
+    // Start a new stream, neither side may be using the ring
+    void Reset();
+
+    // Encoder side. Append returns false once the stream is cancelled.
+    bool Append(const void* data, size_t len);
+    // Commit the last slot and end the stream, ok = false marks an encoder failure
+    void Finish(bool ok);
+
+    // Uploader side. Waits for the next committed slot, returns false at the end of the
+    // stream. The slot stays valid until Pop().
+    bool Front(const uint8_t*& data, size_t& len);
+    void Pop();
+    // Stop the stream, both sides return at once
+    void Cancel();
+
+    // True when the encoder finished the whole image and the stream was not cancelled
+    bool complete() const;
+    Stats stats() const;
+
+private:
+    uint8_t* slot(size_t index) const { return storage_ + index * slot_size_; }
+
+    size_t slot_count_;
+    size_t slot_size_;
+    uint8_t* storage_ = nullptr;
+    std::vector<size_t> lengths_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t head_ = 0;           // Oldest committed slot
+    size_t committed_ = 0;
+    size_t fill_ = 0;           // Bytes in the slot after the committed ones
+    bool finished_ = false;
+    bool failed_ = false;
+    bool cancelled_ = false;
+    Stats stats_;
+};
+
+#endif // JPEG_CHUNK_RING_H
@@ -2,6 +2,7 @@
 
 #include "application.h"
 #include "display.h"
+#include "system_profiler.h"
 #include "assets/lang_config.h"
 
 #include <esp_log.h>
@@ -107,7 +108,11 @@ std::string Ml307Board::GetBoardJson() {
 }
 
 void Ml307Board::SetPowerSaveMode(bool enabled) {
-    // TODO: Implement power save mode for ML307
+    // Through the instance, a dual network board owns the camera, not this board
+    auto camera = Board::GetInstance().GetCamera();
+    if (camera != nullptr) {
+        camera->SetPowerSaveMode(enabled);
+    }
 }
 
 std::string Ml307Board::GetDeviceStatusJson() {
@@ -189,6 +194,13 @@ std::string Ml307Board::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+#if CONFIG_SYSTEM_PROFILER_IN_DEVICE_STATUS
+    auto profile = SystemProfiler::GetInstance().GetSummaryJson();
+    if (profile != nullptr) {
+        cJSON_AddItemToObject(root, "profile", profile);
+    }
+#endif
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
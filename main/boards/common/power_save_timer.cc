@@ -1,6 +1,7 @@
 #include "power_save_timer.h"
 #include "application.h"
 #include "settings.h"
+#include "cpu_governor.h"
 
 #include <esp_log.h>
 
@@ -20,6 +21,9 @@ PowerSaveTimer::PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep, int secon
         .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&timer_args, &power_save_timer_));
+#if CONFIG_USE_CPU_GOVERNOR
+    CpuGovernor::GetInstance().SetMaxFrequency(cpu_max_freq_);
+#endif
 }
 
 PowerSaveTimer::~PowerSaveTimer() {
@@ -89,16 +93,22 @@ void PowerSaveTimer::PowerSaveCheck() {
                     codec->EnableInput(false);
                 }
 
+#if CONFIG_USE_CPU_GOVERNOR
+                CpuGovernor::GetInstance().SetSleepMode(true);
+#else
                 esp_pm_config_t pm_config = {
                     .max_freq_mhz = cpu_max_freq_,
                     .min_freq_mhz = 40,
                     .light_sleep_enable = true,
                 };
                 esp_pm_configure(&pm_config);
+#endif
             }
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        // Boards shut down into deep sleep, which skips the shutdown handlers that flush settings
+        Settings::Flush();
         on_shutdown_request_();
     }
 }
@@ -110,12 +120,16 @@ void PowerSaveTimer::WakeUp() {
         in_sleep_mode_ = false;
 
         if (cpu_max_freq_ != -1) {
+#if CONFIG_USE_CPU_GOVERNOR
+            CpuGovernor::GetInstance().SetSleepMode(false);
+#else
             esp_pm_config_t pm_config = {
                 .max_freq_mhz = cpu_max_freq_,
                 .min_freq_mhz = cpu_max_freq_,
                 .light_sleep_enable = false,
             };
             esp_pm_configure(&pm_config);
+#endif
 
             // Enable wake word detection
             auto& app = Application::GetInstance();
@@ -118,6 +118,8 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        // Deep sleep skips the shutdown handlers that flush settings
+        Settings::Flush();
         esp_deep_sleep_start();
     }
 }
@@ -3,6 +3,7 @@
 #include "display.h"
 #include "application.h"
 #include "system_info.h"
+#include "system_profiler.h"
 #include "settings.h"
 #include "assets/lang_config.h"
 
@@ -159,6 +160,11 @@ std::string WifiBoard::GetBoardJson() {
 void WifiBoard::SetPowerSaveMode(bool enabled) {
     auto& wifi_station = WifiStation::GetInstance();
     wifi_station.SetPowerSaveMode(enabled);
+    // Through the instance, a dual network board owns the camera, not this board
+    auto camera = Board::GetInstance().GetCamera();
+    if (camera != nullptr) {
+        camera->SetPowerSaveMode(enabled);
+    }
 }
 
 void WifiBoard::ResetWifiConfiguration() {
@@ -260,6 +266,13 @@ std::string WifiBoard::GetDeviceStatusJson() {
         cJSON_AddItemToObject(root, "chip", chip);
     }
 
+#if CONFIG_SYSTEM_PROFILER_IN_DEVICE_STATUS
+    auto profile = SystemProfiler::GetInstance().GetSummaryJson();
+    if (profile != nullptr) {
+        cJSON_AddItemToObject(root, "profile", profile);
+    }
+#endif
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
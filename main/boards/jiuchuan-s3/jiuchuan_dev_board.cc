@@ -16,6 +16,7 @@
 #include "esp_lcd_panel_gc9301.h"
 
 #include "power_save_timer.h"
+#include "settings.h"
 #include "power_manager.h"
 #include "power_controller.h"
 #include "gpio_manager.h"
@@ -106,6 +107,7 @@ private:
                 ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(PWR_BUTTON_GPIO, 0));
                 ESP_ERROR_CHECK(rtc_gpio_pullup_en(PWR_BUTTON_GPIO));  // 内部上拉
                 ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(PWR_BUTTON_GPIO));
+                Settings::Flush();
                 esp_deep_sleep_start();
             }
         }
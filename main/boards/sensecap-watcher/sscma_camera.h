@@ -68,6 +68,8 @@ public:
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
     virtual std::string Explain(const std::string& question);
+    // The image comes JPEG encoded from the SSCMA module, it is uploaded as is
+    using Camera::Explain;
 
 };
 
@@ -0,0 +1,174 @@
+#include "cpu_governor.h"
+#include "application.h"
+#include "device_state_event.h"
+
+#include <cstdio>
+#include <string>
+#include <esp_log.h>
+
+#define TAG "CpuGovernor"
+
+static int64_t NowMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+CpuGovernor::CpuGovernor() : policy_(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ) {
+}
+
+void CpuGovernor::SetMaxFrequency(int max_freq_mhz) {
+    if (started_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_freq_mhz_ = max_freq_mhz;
+    if (max_freq_mhz_ != -1) {
+        policy_ = CpuGovernorPolicy(max_freq_mhz_);
+    }
+}
+
+void CpuGovernor::Start(int report_interval_seconds) {
+    if (started_) {
+        return;
+    }
+    // Boards without a power save timer, or that pass -1 to it, do not use power management
+    if (max_freq_mhz_ == -1) {
+        ESP_LOGI(TAG, "No CPU maximum from the board, CPU governor disabled");
+        return;
+    }
+    auto ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cpu_governor", &performance_lock_);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Power management not supported, CPU governor disabled");
+        return;
+    }
+    ESP_ERROR_CHECK(ret);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<CpuGovernor*>(arg);
+            self->SampleQueues();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "cpu_governor",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sample_timer_));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        report_interval_ms_ = report_interval_seconds * 1000;
+        last_report_ms_ = NowMs();
+        policy_.ResetResidency(last_report_ms_);
+        policy_.OnStateChanged(Application::GetInstance().GetDeviceState(), last_report_ms_);
+        Apply();
+    }
+    DeviceStateEventManager::GetInstance().RegisterStateChangeCallback([this](DeviceState previous, DeviceState current) {
+        OnStateChanged(current);
+    });
+    ESP_ERROR_CHECK(esp_timer_start_periodic(sample_timer_, CPU_GOVERNOR_SAMPLE_INTERVAL_MS * 1000));
+    started_ = true;
+    ESP_LOGI(TAG, "CPU governor started, max %d MHz", max_freq_mhz_);
+}
+
+void CpuGovernor::OnStateChanged(DeviceState state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = NowMs();
+    ESP_LOGD(TAG, "trace %lld state %s", now, CpuGovernorPolicy::GetStateName(state));
+    if (policy_.OnStateChanged(state, now)) {
+        Apply();
+    }
+}
+
+void CpuGovernor::SetSleepMode(bool sleep) {
+    if (!started_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = NowMs();
+    ESP_LOGD(TAG, "trace %lld sleep %d", now, sleep);
+    // No sampling in sleep mode, the timer would wake the CPU from light sleep
+    if (sleep) {
+        esp_timer_stop(sample_timer_);
+    } else {
+        esp_timer_start_periodic(sample_timer_, CPU_GOVERNOR_SAMPLE_INTERVAL_MS * 1000);
+    }
+    if (policy_.OnSleepMode(sleep, now)) {
+        Apply();
+    }
+}
+
+void CpuGovernor::SampleQueues() {
+    auto depth = Application::GetInstance().GetAudioService().GetQueueDepth();
+    bool report;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = NowMs();
+        // Only samples under pressure and the first one after matter to the policy, log just those
+        bool under_pressure = CpuGovernorPolicy::IsUnderPressure(depth);
+        if (under_pressure || under_pressure_) {
+            ESP_LOGD(TAG, "trace %lld queue %d %d %d", now, depth.encode, depth.decode, depth.playback);
+        }
+        under_pressure_ = under_pressure;
+        if (policy_.OnQueueDepth(depth, now)) {
+            Apply();
+        }
+        report = now - last_report_ms_ >= report_interval_ms_;
+    }
+    if (report) {
+        LogResidency();
+    }
+}
+
+void CpuGovernor::LogResidency() {
+    if (!started_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = NowMs();
+    auto residency = policy_.GetResidency(now);
+    int64_t total = now - last_report_ms_;
+    std::string line;
+    for (auto& [freq, ms] : residency) {
+        char item[32];
+        snprintf(item, sizeof(item), " %dMHz %d%%", freq, total > 0 ? (int)(ms * 100 / total) : 0);
+        line += item;
+    }
+    ESP_LOGI(TAG, "Residency over %lld s:%s", total / 1000, line.c_str());
+    policy_.ResetResidency(now);
+    last_report_ms_ = now;
+}
+
+bool CpuGovernor::Acquire() {
+    if (!started_) {
+        return false;
+    }
+    esp_pm_lock_acquire(performance_lock_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    policy_.OnPerformanceLock(true, NowMs());
+    return true;
+}
+
+void CpuGovernor::Release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        policy_.OnPerformanceLock(false, NowMs());
+    }
+    esp_pm_lock_release(performance_lock_);
+}
+
+void CpuGovernor::Apply() {
+    auto& profile = policy_.profile();
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = profile.max_freq_mhz,
+        .min_freq_mhz = profile.min_freq_mhz,
+        .light_sleep_enable = profile.light_sleep,
+    };
+    auto ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set CPU %d-%d MHz: %s", profile.min_freq_mhz, profile.max_freq_mhz,
+            esp_err_to_name(ret));
+        return;
+    }
+    ESP_LOGD(TAG, "CPU %d-%d MHz%s", profile.min_freq_mhz, profile.max_freq_mhz,
+        profile.light_sleep ? ", light sleep" : "");
+}
@@ -0,0 +1,72 @@
+#ifndef _CPU_GOVERNOR_H_
+#define _CPU_GOVERNOR_H_
+
+#include <atomic>
+#include <mutex>
+
+#include <esp_pm.h>
+#include <esp_timer.h>
+
+#include "cpu_governor_policy.h"
+
+#define CPU_GOVERNOR_SAMPLE_INTERVAL_MS 200
+
+// Sets the esp_pm frequency range and light sleep from CpuGovernorPolicy, driven
+// by device state changes, the AudioService queues and the power save timer.
+// Needs CONFIG_PM_ENABLE and a board maximum from SetMaxFrequency(), until
+// Start() succeeds every call does nothing.
+class CpuGovernor {
+public:
+    static CpuGovernor& GetInstance() {
+        static CpuGovernor instance;
+        return instance;
+    }
+    CpuGovernor(const CpuGovernor&) = delete;
+    CpuGovernor& operator=(const CpuGovernor&) = delete;
+
+    // The board's PowerSaveTimer sets its cpu_max_freq, -1 leaves esp_pm alone
+    void SetMaxFrequency(int max_freq_mhz);
+    void Start(int report_interval_seconds = 60);
+    // Called by PowerSaveTimer instead of configuring esp_pm itself
+    void SetSleepMode(bool sleep);
+    void LogResidency();
+
+    // Runs the CPU at the maximum frequency while in scope, for the audio
+    // codec and front end work that has a deadline
+    class PerformanceLock {
+    public:
+        PerformanceLock() : acquired_(CpuGovernor::GetInstance().Acquire()) {}
+        ~PerformanceLock() {
+            if (acquired_) {
+                CpuGovernor::GetInstance().Release();
+            }
+        }
+        PerformanceLock(const PerformanceLock&) = delete;
+        PerformanceLock& operator=(const PerformanceLock&) = delete;
+
+    private:
+        bool acquired_;
+    };
+
+private:
+    CpuGovernor();
+    ~CpuGovernor() = default;
+
+    bool Acquire();
+    void Release();
+    void OnStateChanged(DeviceState state);
+    void SampleQueues();
+    void Apply();
+
+    std::mutex mutex_;
+    CpuGovernorPolicy policy_;
+    esp_pm_lock_handle_t performance_lock_ = nullptr;
+    esp_timer_handle_t sample_timer_ = nullptr;
+    std::atomic<bool> started_{false};
+    int max_freq_mhz_ = -1;
+    bool under_pressure_ = false;
+    int report_interval_ms_ = 60000;
+    int64_t last_report_ms_ = 0;
+};
+
+#endif // _CPU_GOVERNOR_H_
@@ -0,0 +1,116 @@
+#include "cpu_governor_policy.h"
+
+#include <algorithm>
+
+#define CPU_GOVERNOR_SLEEP_FREQ_MHZ 40
+
+CpuGovernorPolicy::CpuGovernorPolicy(int max_freq_mhz, int boost_hold_ms)
+    : max_freq_mhz_(max_freq_mhz), boost_hold_ms_(boost_hold_ms) {
+    profile_ = {max_freq_mhz_, GetStateFloor(state_), false};
+}
+
+int CpuGovernorPolicy::GetStateFloor(DeviceState state) const {
+    int floor;
+    switch (state) {
+    case kDeviceStateIdle:
+    case kDeviceStateSpeaking:
+        floor = 160;
+        break;
+    case kDeviceStateFatalError:
+        floor = 40;
+        break;
+    default:
+        floor = max_freq_mhz_;
+        break;
+    }
+    return std::min(floor, max_freq_mhz_);
+}
+
+const char* CpuGovernorPolicy::GetStateName(DeviceState state) {
+    static const char* const names[] = {
+        "unknown", "starting", "configuring", "idle", "connecting", "listening",
+        "speaking", "upgrading", "activating", "audio_testing", "fatal_error",
+    };
+    if (state < 0 || state > kDeviceStateFatalError) {
+        return "invalid_state";
+    }
+    return names[state];
+}
+
+bool CpuGovernorPolicy::IsUnderPressure(const AudioQueueDepth& depth) {
+    return depth.encode >= 2 || (depth.decode > 0 && depth.playback == 0);
+}
+
+bool CpuGovernorPolicy::OnStateChanged(DeviceState state, int64_t now_ms) {
+    Account(now_ms);
+    state_ = state;
+    return Update();
+}
+
+bool CpuGovernorPolicy::OnQueueDepth(const AudioQueueDepth& depth, int64_t now_ms) {
+    Account(now_ms);
+    if (sleeping_) {
+        return false;
+    }
+    if (IsUnderPressure(depth)) {
+        boosted_ = true;
+        boost_until_ms_ = now_ms + boost_hold_ms_;
+    } else if (boosted_ && now_ms >= boost_until_ms_) {
+        boosted_ = false;
+    }
+    return Update();
+}
+
+bool CpuGovernorPolicy::OnSleepMode(bool sleep, int64_t now_ms) {
+    Account(now_ms);
+    sleeping_ = sleep;
+    if (sleeping_) {
+        boosted_ = false;
+    }
+    return Update();
+}
+
+void CpuGovernorPolicy::OnPerformanceLock(bool acquired, int64_t now_ms) {
+    Account(now_ms);
+    if (acquired) {
+        locks_++;
+    } else if (locks_ > 0) {
+        locks_--;
+    }
+}
+
+bool CpuGovernorPolicy::Update() {
+    CpuProfile profile;
+    if (sleeping_) {
+        profile = {max_freq_mhz_, std::min(CPU_GOVERNOR_SLEEP_FREQ_MHZ, max_freq_mhz_), true};
+    } else if (boosted_) {
+        profile = {max_freq_mhz_, max_freq_mhz_, false};
+    } else {
+        profile = {max_freq_mhz_, GetStateFloor(state_), false};
+    }
+    if (profile == profile_) {
+        return false;
+    }
+    profile_ = profile;
+    return true;
+}
+
+void CpuGovernorPolicy::Account(int64_t now_ms) {
+    if (accounted_ms_ >= 0 && now_ms > accounted_ms_) {
+        int freq = locks_ > 0 ? profile_.max_freq_mhz : profile_.min_freq_mhz;
+        residency_[freq] += now_ms - accounted_ms_;
+    }
+    if (accounted_ms_ < 0 || now_ms > accounted_ms_) {
+        accounted_ms_ = now_ms;
+    }
+}
+
+std::map<int, int64_t> CpuGovernorPolicy::GetResidency(int64_t now_ms) {
+    Account(now_ms);
+    return residency_;
+}
+
+void CpuGovernorPolicy::ResetResidency(int64_t now_ms) {
+    residency_.clear();
+    accounted_ms_ = now_ms;
+}
@@ -0,0 +1,89 @@
+#ifndef _CPU_GOVERNOR_POLICY_H_
+#define _CPU_GOVERNOR_POLICY_H_
+
+#include <cstdint>
+#include <map>
+
+#include "device_state.h"
+
+// What esp_pm_configure is given: the CPU runs at min_freq_mhz unless a
+// performance lock is held, then it runs at max_freq_mhz
+struct CpuProfile {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep;
+
+    bool operator==(const CpuProfile& other) const {
+        return max_freq_mhz == other.max_freq_mhz && min_freq_mhz == other.min_freq_mhz &&
+            light_sleep == other.light_sleep;
+    }
+    bool operator!=(const CpuProfile& other) const { return !(*this == other); }
+};
+
+// Packets and tasks waiting in the AudioService queues
+struct AudioQueueDepth {
+    int encode;
+    int decode;
+    int playback;
+};
+
+/*
+ * Picks the CPU profile from the device state, the audio queue depth and the
+ * power save sleep mode. It keeps no clock of its own, every event carries
+ * its time, so traces replay on the host (scripts/cpu_governor_test).
+ *
+ *   Starting, Connecting, Upgrading...   max floor, short and busy
+ *   Idle                                 160MHz floor, WakeNet runs on the AFE fetch task
+ *   Listening                            max floor, AFE and encoding run all the time
+ *   Speaking                             160MHz floor, decoding holds a performance lock
+ *   FatalError                           40MHz floor
+ *   Audio queues backing up              max floor for at least boost_hold_ms
+ *   Sleep mode                           40MHz floor and light sleep, whatever the state
+ *
+ * Floors are capped at the maximum frequency. The On* methods return true when
+ * the profile changed and has to be applied.
+ */
+class CpuGovernorPolicy {
+public:
+    CpuGovernorPolicy(int max_freq_mhz, int boost_hold_ms = 1000);
+
+    bool OnStateChanged(DeviceState state, int64_t now_ms);
+    bool OnQueueDepth(const AudioQueueDepth& depth, int64_t now_ms);
+    bool OnSleepMode(bool sleep, int64_t now_ms);
+    // Performance locks are counted, time with any lock held runs at max
+    void OnPerformanceLock(bool acquired, int64_t now_ms);
+
+    const CpuProfile& profile() const { return profile_; }
+    DeviceState state() const { return state_; }
+    bool boosted() const { return boosted_; }
+    bool sleeping() const { return sleeping_; }
+
+    // Milliseconds spent per CPU frequency up to now_ms, estimated from the floor
+    // and the performance locks. Light sleep time counts at the floor
+    std::map<int, int64_t> GetResidency(int64_t now_ms);
+    void ResetResidency(int64_t now_ms);
+
+    int GetStateFloor(DeviceState state) const;
+    // Names used in the traces
+    static const char* GetStateName(DeviceState state);
+    // Too much to encode, or packets to decode but nothing left to play
+    static bool IsUnderPressure(const AudioQueueDepth& depth);
+
+private:
+    bool Update();
+    void Account(int64_t now_ms);
+
+    int max_freq_mhz_;
+    int boost_hold_ms_;
+    DeviceState state_ = kDeviceStateUnknown;
+    bool boosted_ = false;
+    int64_t boost_until_ms_ = 0;
+    bool sleeping_ = false;
+    int locks_ = 0;
+    CpuProfile profile_;
+
+    int64_t accounted_ms_ = -1;
+    std::map<int, int64_t> residency_;
+};
+
+#endif // _CPU_GOVERNOR_POLICY_H_
@@ -20,10 +20,13 @@
 #include <freertos/task.h>
 
 // Project headers
+#include "application.h"
 #include "assets.h"
 #include "assets/lang_config.h"
 #include "board.h"
+#include "emote_frame_scheduler.h"
 #include "gfx.h"
+#include "task_stack.h"
 
 LV_FONT_DECLARE(BUILTIN_TEXT_FONT);
 
@@ -50,6 +53,16 @@ static const char* TAG = "EmoteDisplay";
 #define ICON_WIFI_OK             "icon_wifi"
 #define ICON_LISTEN              "listen"
 
+// Animation layers stepped by the frame scheduler
+enum AnimLayer : int {
+    kLayerEye = 0,
+    kLayerListen,
+    kLayerCount
+};
+
+#define LISTEN_ANIM_FPS          20
+#define AUDIO_SYNC_FPS           20
+
 using FlushIoReadyCallback = std::function<bool(esp_lcd_panel_io_handle_t, esp_lcd_panel_io_event_data_t*, void*)>;
 using FlushCallback = std::function<void(gfx_handle_t, int, int, int, int, const void*)>;
 
@@ -123,6 +136,18 @@ char StringToGfxAlign(const std::string &align_str)
     return GFX_ALIGN_DEFAULT;
 }
 
+// Number of frames of an EAF (or older AAF) animation, 0 if the header is not recognized
+static uint16_t EafFrameCount(const AssetData &asset)
+{
+    const auto* header = static_cast<const uint8_t*>(asset.data);
+    if (!header || asset.size < 8 || header[0] != 0x89 ||
+        (std::memcmp(header + 1, "EAF", 3) != 0 && std::memcmp(header + 1, "AAF", 3) != 0)) {
+        return 0;
+    }
+    uint32_t frames = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+    return frames > 0xFFFF ? 0 : frames;
+}
+
 // ============================================================================
 // EmoteEngine Class Declaration
 // ============================================================================
@@ -136,6 +161,13 @@ public:
     void SetEyes(const std::string &emoji_name, const bool repeat, const int fps, EmoteDisplay* const display);
     void SetIcon(const std::string &icon_name, EmoteDisplay* const display);
 
+    // Animations are stepped frame by frame by the pacer task, so that they keep their pace
+    // under load and nothing is redrawn while they stand still. Call with the display locked.
+    void PlayAnimation(const AnimLayer layer, const AssetData &asset, const int fps, const bool repeat);
+    void StopAnimation(const AnimLayer layer);
+    void SetAudioSync(const bool enable);
+    void SetPowerSave(const bool on);
+
     void* GetEngineHandle() const
     {
         return engine_handle_;
@@ -146,7 +178,24 @@ public:
     static void OnFlush(const gfx_handle_t handle, const int x_start, const int y_start, const int x_end, const int y_end, const void* const color_data);
 
 private:
+    struct LayerState {
+        gfx_obj_t* obj = nullptr;
+        AssetData asset;
+        uint16_t frame_count = 0;   // 0 while the engine plays the animation itself
+        int fps = 0;
+        bool repeat = false;
+    };
+
+    void StartLayer(const AnimLayer layer);
+    void ShowFrame(const int layer, const uint16_t frame);
+    void PacerTask();
+
     gfx_handle_t engine_handle_;
+    FrameScheduler scheduler_{kLayerCount};
+    LayerState layers_[kLayerCount];
+    TaskHandle_t pacer_task_ = nullptr;
+    bool audio_sync_ = false;
+    bool power_save_ = false;
 };
 
 // ============================================================================
@@ -160,19 +209,21 @@ static void SetUIDisplayMode(const UIDisplayMode mode, EmoteDisplay* const displ
         return;
     }
 
+    EmoteEngine* const engine = display->GetEngine();
     gfx_obj_set_visible(g_obj_anim_listen, false);
     gfx_obj_set_visible(g_obj_label_clock, false);
     gfx_obj_set_visible(g_obj_label_toast, false);
+    if (engine && mode != UIDisplayMode::SHOW_LISTENING) {
+        engine->StopAnimation(kLayerListen);
+    }
 
     // Show the selected control
     switch (mode) {
     case UIDisplayMode::SHOW_LISTENING: {
         gfx_obj_set_visible(g_obj_anim_listen, true);
         const AssetData emoji_data = display->GetIconData(ICON_LISTEN);
-        if (emoji_data.data) {
-            gfx_anim_set_src(g_obj_anim_listen, emoji_data.data, emoji_data.size);
-            gfx_anim_set_segment(g_obj_anim_listen, 0, 0xFFFF, 20, true);
-            gfx_anim_start(g_obj_anim_listen);
+        if (emoji_data.data && engine) {
+            engine->PlayAnimation(kLayerListen, emoji_data, LISTEN_ANIM_FPS, true);
         }
         break;
     }
@@ -295,18 +346,130 @@ EmoteEngine::EmoteEngine(const esp_lcd_panel_handle_t panel, const esp_lcd_panel
         SetupUI(engine_handle_, display);
         gfx_emote_unlock(engine_handle_);
     }
+    layers_[kLayerEye].obj = g_obj_anim_eye;
+    layers_[kLayerListen].obj = g_obj_anim_listen;
 
     RegisterCallbacks(panel_io, engine_handle_);
+
+    // Below the gfx task, so that a busy engine makes the pacer skip frames instead of queueing them
+    xTaskCreate([](void* arg) {
+        static_cast<EmoteEngine*>(arg)->PacerTask();
+    }, "emote_pacer", TASK_STACK_EMOTE_PACER, this, 4, &pacer_task_);
 }
 
 EmoteEngine::~EmoteEngine()
 {
+    if (pacer_task_) {
+        // The pacer only touches the engine with the lock held
+        gfx_emote_lock(engine_handle_);
+        vTaskDelete(pacer_task_);
+        pacer_task_ = nullptr;
+        gfx_emote_unlock(engine_handle_);
+    }
     if (engine_handle_) {
         gfx_emote_deinit(engine_handle_);
         engine_handle_ = nullptr;
     }
 }
 
+void EmoteEngine::PlayAnimation(const AnimLayer layer, const AssetData &asset, const int fps, const bool repeat)
+{
+    auto &state = layers_[layer];
+    if (state.frame_count > 0) {
+        const auto &stats = scheduler_.stats(layer);
+        ESP_LOGD(TAG, "Layer %d: %lu frames, %lu dropped, max late %lld us", layer,
+                 stats.frames, stats.dropped, stats.max_late_us);
+    }
+    state.asset = asset;
+    // Frames of "lack" animations depend on the previous frame and cannot be shown on their own
+    state.frame_count = asset.lack ? 0 : EafFrameCount(asset);
+    state.fps = fps;
+    state.repeat = repeat;
+    gfx_anim_set_src(state.obj, asset.data, asset.size);
+    StartLayer(layer);
+}
+
+void EmoteEngine::StartLayer(const AnimLayer layer)
+{
+    auto &state = layers_[layer];
+    if (power_save_ || !state.asset.data) {
+        scheduler_.Stop(layer);
+        return;
+    }
+    if (state.frame_count == 0) {
+        scheduler_.Stop(layer);
+        gfx_anim_set_segment(state.obj, 0, 0xFFFF, state.fps, state.repeat);
+        gfx_anim_start(state.obj);
+        return;
+    }
+    if (layer == kLayerEye && audio_sync_) {
+        scheduler_.FollowLevel(layer, state.frame_count, AUDIO_SYNC_FPS, esp_timer_get_time());
+    } else {
+        scheduler_.Play(layer, state.frame_count, state.fps, state.repeat, esp_timer_get_time());
+    }
+    if (pacer_task_) {
+        xTaskNotifyGive(pacer_task_);
+    }
+}
+
+void EmoteEngine::StopAnimation(const AnimLayer layer)
+{
+    scheduler_.Stop(layer);
+    gfx_anim_stop(layers_[layer].obj);
+}
+
+void EmoteEngine::SetAudioSync(const bool enable)
+{
+    if (audio_sync_ != enable) {
+        audio_sync_ = enable;
+        StartLayer(kLayerEye);
+    }
+}
+
+void EmoteEngine::SetPowerSave(const bool on)
+{
+    power_save_ = on;
+    if (on) {
+        scheduler_.StopAll();
+        gfx_anim_stop(g_obj_anim_eye);
+        gfx_anim_stop(g_obj_anim_listen);
+    } else {
+        StartLayer(kLayerEye);
+    }
+}
+
+void EmoteEngine::ShowFrame(const int layer, const uint16_t frame)
+{
+    auto &state = layers_[layer];
+    gfx_anim_set_segment(state.obj, frame, frame, state.fps, false);
+    gfx_anim_start(state.obj);
+}
+
+void EmoteEngine::PacerTask()
+{
+    auto &audio_service = Application::GetInstance().GetAudioService();
+    int64_t deadline = FrameScheduler::kIdle;
+    while (true) {
+        // Sleep until the next frame is due, or until an animation changes when all of them stand still
+        TickType_t wait = portMAX_DELAY;
+        if (deadline != FrameScheduler::kIdle) {
+            const int64_t delay_us = deadline - esp_timer_get_time();
+            wait = delay_us > 0 ? pdMS_TO_TICKS((delay_us + 999) / 1000) : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // Waits for the frame being rendered, frames that fall due meanwhile are dropped
+        gfx_emote_lock(engine_handle_);
+        if (audio_sync_) {
+            scheduler_.SetLevel(audio_service.GetOutputLevel());
+        }
+        deadline = scheduler_.Run(esp_timer_get_time(), [this](int layer, uint16_t frame) {
+            ShowFrame(layer, frame);
+        });
+        gfx_emote_unlock(engine_handle_);
+    }
+}
+
 void EmoteEngine::SetEyes(const std::string &emoji_name, const bool repeat, const int fps, EmoteDisplay* const display)
 {
     if (!engine_handle_) {
@@ -322,10 +485,8 @@ void EmoteEngine::SetEyes(const std::string &emoji_name, const bool repeat, cons
     const AssetData emoji_data = display->GetEmojiData(emoji_name);
     if (emoji_data.data) {
         DisplayLockGuard lock(display);
-        gfx_anim_set_src(g_obj_anim_eye, emoji_data.data, emoji_data.size);
-        gfx_anim_set_segment(g_obj_anim_eye, 0, 0xFFFF, fps, repeat);
         gfx_obj_set_visible(g_obj_anim_eye, true);
-        gfx_anim_start(g_obj_anim_eye);
+        PlayAnimation(kLayerEye, emoji_data, fps, repeat);
     } else {
         ESP_LOGW(TAG, "SetEyes: No emoji data found for %s", emoji_name.c_str());
     }
@@ -437,6 +598,9 @@ void EmoteDisplay::SetStatus(const char* const status)
 
     DisplayLockGuard lock(this);
 
+#if CONFIG_EMOTE_AUDIO_SYNC
+    engine_->SetAudioSync(std::strcmp(status, Lang::Strings::SPEAKING) == 0);
+#endif
     if (std::strcmp(status, Lang::Strings::LISTENING) == 0) {
         SetUIDisplayMode(UIDisplayMode::SHOW_LISTENING, this);
         engine_->SetEyes("happy", true, 20, this);
@@ -503,11 +667,7 @@ void EmoteDisplay::SetPowerSaveMode(bool on)
 
     DisplayLockGuard lock(this);
     ESP_LOGI(TAG, "SetPowerSaveMode: %s", on ? "ON" : "OFF");
-    if (on) {
-        gfx_anim_stop(g_obj_anim_eye);
-    } else {
-        gfx_anim_start(g_obj_anim_eye);
-    }
+    engine_->SetPowerSave(on);
 }
 
 void EmoteDisplay::SetPreviewImage(const void* image)
@@ -0,0 +1,102 @@
+#include "emote_frame_scheduler.h"
+
+namespace emote {
+
+FrameScheduler::FrameScheduler(size_t layer_count) : layers_(layer_count)
+{
+}
+
+void FrameScheduler::Start(Layer& layer, Mode mode, uint16_t frame_count, int fps, bool loop, int64_t now_us)
+{
+    layer.stats = LayerStats();
+    if (frame_count == 0 || fps <= 0) {
+        layer.mode = Mode::kStopped;
+        return;
+    }
+    layer.mode = mode;
+    // A single looping frame never changes, show it once
+    layer.loop = loop && frame_count > 1;
+    layer.frame_count = frame_count;
+    layer.shown = -1;
+    layer.start_us = now_us;
+    layer.period_us = 1000000 / fps;
+    layer.next = 0;
+}
+
+void FrameScheduler::Play(int layer, uint16_t frame_count, int fps, bool loop, int64_t now_us)
+{
+    Start(layers_[layer], Mode::kClock, frame_count, fps, loop, now_us);
+}
+
+void FrameScheduler::FollowLevel(int layer, uint16_t frame_count, int fps, int64_t now_us)
+{
+    Start(layers_[layer], Mode::kLevel, frame_count, fps, true, now_us);
+}
+
+void FrameScheduler::Stop(int layer)
+{
+    layers_[layer].mode = Mode::kStopped;
+}
+
+void FrameScheduler::StopAll()
+{
+    for (auto& layer : layers_) {
+        layer.mode = Mode::kStopped;
+    }
+}
+
+bool FrameScheduler::playing(int layer) const
+{
+    return layers_[layer].mode != Mode::kStopped;
+}
+
+int64_t FrameScheduler::Run(int64_t now_us, const std::function<void(int layer, uint16_t frame)>& show)
+{
+    for (size_t i = 0; i < layers_.size(); i++) {
+        auto& layer = layers_[i];
+        if (layer.mode == Mode::kStopped || now_us < layer.deadline()) {
+            continue;
+        }
+
+        // The frame that should be on screen now, every deadline in between was missed
+        uint32_t due = (uint32_t)((now_us - layer.start_us) / layer.period_us);
+        int32_t frame;
+        if (layer.mode == Mode::kLevel) {
+            frame = (level_ * (layer.frame_count - 1) + 127) / 255;
+        } else if (!layer.loop && due >= layer.frame_count - 1u) {
+            due = layer.frame_count - 1;
+            frame = due;
+        } else {
+            frame = due % layer.frame_count;
+        }
+        layer.stats.dropped += due - layer.next;
+        layer.next = due + 1;
+
+        if (frame != layer.shown) {
+            int64_t late = now_us - (layer.start_us + (int64_t)due * layer.period_us);
+            if (late > layer.stats.max_late_us) {
+                layer.stats.max_late_us = late;
+            }
+            layer.stats.frames++;
+            layer.shown = frame;
+            show((int)i, (uint16_t)frame);
+        }
+        if (layer.mode == Mode::kClock && !layer.loop && frame == layer.frame_count - 1) {
+            layer.mode = Mode::kStopped;
+        }
+    }
+    return NextDeadline();
+}
+
+int64_t FrameScheduler::NextDeadline() const
+{
+    int64_t deadline = kIdle;
+    for (auto& layer : layers_) {
+        if (layer.mode != Mode::kStopped && layer.deadline() < deadline) {
+            deadline = layer.deadline();
+        }
+    }
+    return deadline;
+}
+
+} // namespace emote
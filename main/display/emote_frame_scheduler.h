@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace emote {
+
+/**
+ * Decides when each animation layer of the emote display shows its next frame.
+ * Frame deadlines are anchored to the start of the animation, so a layer that is
+ * served late skips the frames it missed instead of slowing down, and the skipped
+ * frames are counted. A layer can also follow an audio level instead of the clock,
+ * then it only shows a frame when the level moves to another frame. When no layer
+ * is playing there is no deadline and the caller can sleep until the next change.
+ *
+ * Times are in microseconds from any monotonic clock, so the scheduler runs the same
+ * on the device and in the host simulation under scripts/emote_frame_test.
+ */
+class FrameScheduler {
+public:
+    static constexpr int64_t kIdle = INT64_MAX;
+
+    struct LayerStats {
+        uint32_t frames = 0;        // Frames shown
+        uint32_t dropped = 0;       // Frames skipped because the layer was served late
+        int64_t max_late_us = 0;    // Worst delay of a shown frame after its deadline
+    };
+
+    explicit FrameScheduler(size_t layer_count);
+
+    // Play frames 0 to frame_count - 1 at fps, from frame 0 now. Without loop the layer
+    // stops on the last frame.
+    void Play(int layer, uint16_t frame_count, int fps, bool loop, int64_t now_us);
+    // Show the frame that matches the level set with SetLevel(), checked fps times a second
+    void FollowLevel(int layer, uint16_t frame_count, int fps, int64_t now_us);
+    void Stop(int layer);
+    void StopAll();
+    // 0 is silence and frame 0, 255 the last frame
+    void SetLevel(uint8_t level) { level_ = level; }
+
+    // Show the frames that are due through show(layer, frame) and return the next deadline
+    int64_t Run(int64_t now_us, const std::function<void(int layer, uint16_t frame)>& show);
+    int64_t NextDeadline() const;
+    bool idle() const { return NextDeadline() == kIdle; }
+    bool playing(int layer) const;
+
+    // Counted from the last Play() or FollowLevel() of the layer
+    const LayerStats& stats(int layer) const { return layers_[layer].stats; }
+
+private:
+    enum class Mode : uint8_t {
+        kStopped,
+        kClock,
+        kLevel,
+    };
+
+    struct Layer {
+        Mode mode = Mode::kStopped;
+        bool loop = false;
+        uint16_t frame_count = 0;
+        int32_t shown = -1;         // Frame on screen, -1 before the first one
+        int64_t start_us = 0;
+        int64_t period_us = 0;
+        uint32_t next = 0;          // Sequence number of the next frame, its deadline is start + next * period
+        LayerStats stats;
+
+        int64_t deadline() const { return start_us + (int64_t)next * period_us; }
+    };
+
+    void Start(Layer& layer, Mode mode, uint16_t frame_count, int fps, bool loop, int64_t now_us);
+
+    std::vector<Layer> layers_;
+    uint8_t level_ = 0;
+};
+
+} // namespace emote
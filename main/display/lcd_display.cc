@@ -11,12 +11,19 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
+#include <esp_heap_caps.h>
 #include <cstring>
 
 #include "board.h"
 
 #define TAG "LcdDisplay"
 
+// Draw buffer band height limits for SPI panels
+#define LCD_DRAW_BUFFER_MIN_LINES 10
+#define LCD_DRAW_BUFFER_MAX_LINES 60
+// Internal DMA capable RAM that must stay free for Wi-Fi, I2S and other drivers
+#define LCD_DRAW_BUFFER_DMA_RESERVE (64 * 1024)
+
 LV_FONT_DECLARE(BUILTIN_TEXT_FONT);
 LV_FONT_DECLARE(BUILTIN_ICON_FONT);
 LV_FONT_DECLARE(font_awesome_30_4);
@@ -61,6 +68,20 @@ void LcdDisplay::InitializeLcdThemes() {
     theme_manager.RegisterTheme("dark", dark_theme);
 }
 
+// Lines per draw buffer so that two DMA capable bands fit in the internal RAM left after
+// the reserve. Returns 0 if even the minimum double buffer does not fit.
+static int GetDrawBufferLines(int width, int height) {
+    size_t line_size = width * sizeof(uint16_t);
+    size_t free_size = heap_caps_get_free_size(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (free_size <= LCD_DRAW_BUFFER_DMA_RESERVE) {
+        return 0;
+    }
+    size_t budget = std::min((free_size - LCD_DRAW_BUFFER_DMA_RESERVE) / 2, largest_block);
+    int lines = std::min<int>(budget / line_size, std::min(height, LCD_DRAW_BUFFER_MAX_LINES));
+    return lines >= LCD_DRAW_BUFFER_MIN_LINES ? lines : 0;
+}
+
 LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height)
     : panel_io_(panel_io), panel_(panel) {
     width_ = width;
@@ -132,13 +153,20 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 #endif
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
+    // With two bands LVGL renders into one while the other is sent by SPI DMA, the port
+    // signals flush ready from the transfer done callback. Fall back to one band when RAM is short.
+    int buffer_lines = GetDrawBufferLines(width_, height_);
+    bool double_buffer = buffer_lines > 0;
+    if (!double_buffer) {
+        buffer_lines = 20;
+    }
+    ESP_LOGI(TAG, "Adding LCD display, %s buffer of %d lines", double_buffer ? "double" : "single", buffer_lines);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = static_cast<uint32_t>(width_ * buffer_lines),
+        .double_buffer = double_buffer,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -164,6 +192,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    EnableFlushStats();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -195,6 +224,37 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD display");
+#if CONFIG_LCD_RGB_PSRAM_FRAME_BUFFER
+    // Two full frame draw buffers in PSRAM, on top of the panel's frame buffers. LVGL only
+    // redraws the dirty areas and the panel is never stalled by a partial band
+    const lvgl_port_display_cfg_t display_cfg = {
+        .io_handle = panel_io_,
+        .panel_handle = panel_,
+        .buffer_size = static_cast<uint32_t>(width_ * height_),
+        .double_buffer = true,
+        .hres = static_cast<uint32_t>(width_),
+        .vres = static_cast<uint32_t>(height_),
+        .rotation = {
+            .swap_xy = swap_xy,
+            .mirror_x = mirror_x,
+            .mirror_y = mirror_y,
+        },
+        .flags = {
+            .buff_dma = 0,
+            .buff_spiram = 1,
+            .swap_bytes = 0,
+            .full_refresh = 0,
+            .direct_mode = 1,
+        },
+    };
+
+    const lvgl_port_display_rgb_cfg_t rgb_cfg = {
+        .flags = {
+            .bb_mode = true,
+            .avoid_tearing = false,
+        }
+    };
+#else
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
@@ -221,12 +281,14 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
             .avoid_tearing = true,
         }
     };
+#endif
     
     display_ = lvgl_port_add_disp_rgb(&display_cfg, &rgb_cfg);
     if (display_ == nullptr) {
         ESP_LOGE(TAG, "Failed to add RGB display");
         return;
     }
+    EnableFlushStats();
     
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -280,6 +342,7 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    EnableFlushStats();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -317,6 +380,8 @@ LcdDisplay::~LcdDisplay() {
     if (emoji_box_ != nullptr) {
         lv_obj_del(emoji_box_);
     }
+    // The message list owns objects inside content_
+    chat_message_list_.reset();
     if (content_ != nullptr) {
         lv_obj_del(content_);
     }
@@ -350,6 +415,26 @@ void LcdDisplay::Unlock() {
 }
 
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
+#if CONFIG_IDF_TARGET_ESP32P4
+#define  MAX_MESSAGES 40
+#else
+#define  MAX_MESSAGES 20
+#endif
+
+static ChatBubbleStyle GetChatBubbleStyle(LvglTheme* lvgl_theme) {
+    ChatBubbleStyle style;
+    style.font = lvgl_theme->text_font()->font();
+    style.user_bubble_color = lvgl_theme->user_bubble_color();
+    style.assistant_bubble_color = lvgl_theme->assistant_bubble_color();
+    style.system_bubble_color = lvgl_theme->system_bubble_color();
+    style.text_color = lvgl_theme->text_color();
+    style.system_text_color = lvgl_theme->system_text_color();
+    style.border_color = lvgl_theme->border_color();
+    style.padding = lvgl_theme->spacing(4);
+    style.row_gap = lvgl_theme->spacing(4);
+    return style;
+}
+
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
 
@@ -399,8 +484,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, lvgl_theme->spacing(4), 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Chat messages are bound to a fixed pool of bubbles in SetChatMessage
     chat_message_label_ = nullptr;
+    chat_message_list_ = std::make_unique<ChatMessageList>(content_, GetChatBubbleStyle(lvgl_theme), MAX_MESSAGES);
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -467,50 +553,25 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(emoji_label_, FONT_AWESOME_MICROCHIP_AI);
 }
-#if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
-#else
-#define  MAX_MESSAGES 20
-#endif
+
+static ChatRole ChatRoleFromString(const char* role) {
+    if (strcmp(role, "user") == 0) {
+        return ChatRole::kUser;
+    } else if (strcmp(role, "system") == 0) {
+        return ChatRole::kSystem;
+    }
+    return ChatRole::kAssistant;
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+    if (chat_message_list_ == nullptr) {
         return;
     }
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
-    }
-    
+
     // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
     if (strcmp(role, "system") == 0) {
-        if (child_count > 0) {
-            // 获取最后一个消息容器
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // 获取容器内的气泡
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // 检查气泡类型是否为系统消息
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // 如果最后一个消息也是系统消息，则删除它
-                        lv_obj_del(last_container);
-                    }
-                }
-            }
-        }
+        chat_message_list_->RemoveLastSystemMessage();
     } else {
         // 隐藏居中显示的 AI logo
         lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
@@ -521,233 +582,22 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
         return;
     }
 
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    auto text_font = lvgl_theme->text_font()->font();
-
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
-
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
-
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
-    }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
-
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
-    }
-    
-    // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    // The list rebinds a recycled bubble to the message and scrolls to it
+    chat_message_list_->AddMessage(ChatRoleFromString(role), content);
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
     DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+    if (chat_message_list_ == nullptr) {
         return;
     }
 
     if (image == nullptr) {
         return;
     }
-    
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    // Create a message bubble for image preview
-    lv_obj_t* img_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(img_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(img_bubble, 0, 0);
-    lv_obj_set_style_pad_all(img_bubble, lvgl_theme->spacing(4), 0);
-    
-    // Set image bubble background color (similar to system message)
-    lv_obj_set_style_bg_color(img_bubble, lvgl_theme->assistant_bubble_color(), 0);
-    lv_obj_set_style_bg_opa(img_bubble, LV_OPA_70, 0);
-    
-    // 设置自定义属性标记气泡类型
-    lv_obj_set_user_data(img_bubble, (void*)"image");
-
-    // Create the image object inside the bubble
-    lv_obj_t* preview_image = lv_image_create(img_bubble);
-    
-    // Calculate appropriate size for the image
-    lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
-    lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
-    
-    // Calculate zoom factor to fit within maximum dimensions
-    auto img_dsc = image->image_dsc();
-    lv_coord_t img_width = img_dsc->header.w;
-    lv_coord_t img_height = img_dsc->header.h;
-    if (img_width == 0 || img_height == 0) {
-        img_width = max_width;
-        img_height = max_height;
-        ESP_LOGW(TAG, "Invalid image dimensions: %ld x %ld, using default dimensions: %ld x %ld", img_width, img_height, max_width, max_height);
-    }
-    
-    lv_coord_t zoom_w = (max_width * 256) / img_width;
-    lv_coord_t zoom_h = (max_height * 256) / img_height;
-    lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
-    
-    // Ensure zoom doesn't exceed 256 (100%)
-    if (zoom > 256) zoom = 256;
-    
-    // Set image properties
-    lv_image_set_src(preview_image, img_dsc);
-    lv_image_set_scale(preview_image, zoom);
-    
-    // Add event handler to clean up LvglImage when image is deleted
-    // We need to transfer ownership of the unique_ptr to the event callback
-    LvglImage* raw_image = image.release(); // 释放智能指针的所有权
-    lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
-        LvglImage* img = (LvglImage*)lv_event_get_user_data(e);
-        if (img != nullptr) {
-            delete img; // 通过删除 LvglImage 对象来正确释放内存
-        }
-    }, LV_EVENT_DELETE, (void*)raw_image);
-    
-    // Calculate actual scaled image dimensions
-    lv_coord_t scaled_width = (img_width * zoom) / 256;
-    lv_coord_t scaled_height = (img_height * zoom) / 256;
-    
-    // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
-    lv_obj_set_width(img_bubble, scaled_width + 16);
-    lv_obj_set_height(img_bubble, scaled_height + 16);
-    
-    // Don't grow in flex layout
-    lv_obj_set_style_flex_grow(img_bubble, 0, 0);
-    
-    // Center the image within the bubble
-    lv_obj_center(preview_image);
-    
-    // Left align the image bubble like assistant messages
-    lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
-    // Auto-scroll to the image bubble
-    lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
+    // The list keeps the image alive until its message leaves the history
+    chat_message_list_->AddImage(std::move(image));
 }
 #else
 void LcdDisplay::SetupUI() {
@@ -945,12 +795,12 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     DisplayLockGuard lock(this);
     if (image->IsGif()) {
         // Create new GIF controller
-        gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
+        gif_controller_ = std::make_unique<LvglGif>(image->image_dsc(), emotion);
         
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
             gif_controller_->SetFrameCallback([this]() {
-                lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
+                gif_controller_->InvalidateChangedArea(emoji_image_);
             });
             
             // Set initial frame and start animation
@@ -972,8 +822,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
 
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     // Wechat message style中，如果emotion是neutral，则不显示
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (strcmp(emotion, "neutral") == 0 && child_count > 0) {
+    if (strcmp(emotion, "neutral") == 0 && chat_message_list_ != nullptr && chat_message_list_->size() > 0) {
         // Stop GIF animation if running
         if (gif_controller_) {
             gif_controller_->Stop();
@@ -1038,69 +887,8 @@ void LcdDisplay::SetTheme(Theme* theme) {
 
     // If we have the chat message style, update all message bubbles
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
-    // Iterate through all children of content (message containers or bubbles)
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    for (uint32_t i = 0; i < child_count; i++) {
-        lv_obj_t* obj = lv_obj_get_child(content_, i);
-        if (obj == nullptr) continue;
-        
-        lv_obj_t* bubble = nullptr;
-        
-        // 检查这个对象是容器还是气泡
-        // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-        // 如果是气泡（助手消息），则直接使用
-        if (lv_obj_get_child_cnt(obj) > 0) {
-            // 可能是容器，检查它是否为用户或系统消息容器
-            // 用户和系统消息容器是透明的
-            lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-            if (bg_opa == LV_OPA_TRANSP) {
-                // 这是用户或系统消息的容器
-                bubble = lv_obj_get_child(obj, 0);
-            } else {
-                // 这可能是助手消息的气泡自身
-                bubble = obj;
-            }
-        } else {
-            // 没有子元素，可能是其他UI元素，跳过
-            continue;
-        }
-        
-        if (bubble == nullptr) continue;
-        
-        // 使用保存的用户数据来识别气泡类型
-        void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-        if (bubble_type_ptr != nullptr) {
-            const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-            
-            // 根据气泡类型应用正确的颜色
-            if (strcmp(bubble_type, "user") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->user_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "assistant") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->assistant_bubble_color(), 0); 
-            } else if (strcmp(bubble_type, "system") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "image") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            }
-            
-            // Update border color
-            lv_obj_set_style_border_color(bubble, lvgl_theme->border_color(), 0);
-            
-            // Update text color for the message
-            if (lv_obj_get_child_cnt(bubble) > 0) {
-                lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                if (text != nullptr) {
-                    // 根据气泡类型设置文本颜色
-                    if (strcmp(bubble_type, "system") == 0) {
-                        lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
-                    } else {
-                        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
-                    }
-                }
-            }
-        } else {
-            ESP_LOGW(TAG, "child[%lu] Bubble type is not found", i);
-        }
+    if (chat_message_list_ != nullptr) {
+        chat_message_list_->SetStyle(GetChatBubbleStyle(lvgl_theme));
     }
 #else
     // Simple UI mode - just update the main chat message
@@ -0,0 +1,351 @@
+#include "chat_message_list.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "ChatMessageList"
+
+ChatMessageList::ChatMessageList(lv_obj_t* content, const ChatBubbleStyle& style, size_t capacity)
+    : content_(content), style_(style), records_(capacity) {
+    top_spacer_ = lv_obj_create(content_);
+    lv_obj_remove_style_all(top_spacer_);
+    lv_obj_add_flag(top_spacer_, LV_OBJ_FLAG_HIDDEN);
+    CreateRows();
+    bottom_spacer_ = lv_obj_create(content_);
+    lv_obj_remove_style_all(bottom_spacer_);
+    lv_obj_add_flag(bottom_spacer_, LV_OBJ_FLAG_HIDDEN);
+
+    lv_obj_add_event_cb(content_, [](lv_event_t* e) {
+        auto self = static_cast<ChatMessageList*>(lv_event_get_user_data(e));
+        self->OnScroll();
+    }, LV_EVENT_SCROLL, this);
+}
+
+ChatMessageList::~ChatMessageList() {
+    lv_obj_remove_event_cb_with_user_data(content_, nullptr, this);
+    for (auto& row : rows_) {
+        lv_obj_del(row.row);
+    }
+    lv_obj_del(top_spacer_);
+    lv_obj_del(bottom_spacer_);
+}
+
+void ChatMessageList::CreateRows() {
+    // Enough rows to fill the chat area with one line messages, plus one row
+    // partially visible at each edge while scrolling
+    lv_obj_update_layout(content_);
+    int32_t visible_height = lv_obj_get_content_height(content_);
+    if (visible_height <= 0) {
+        visible_height = lv_display_get_vertical_resolution(lv_obj_get_display(content_));
+    }
+    int32_t min_row_height = style_.font->line_height + 2 * style_.padding + style_.row_gap;
+    size_t pool_size = std::min<size_t>(visible_height / min_row_height + 2, records_.size());
+
+    rows_.resize(pool_size);
+    for (auto& row : rows_) {
+        row.row = lv_obj_create(content_);
+        lv_obj_remove_style_all(row.row);
+        lv_obj_set_size(row.row, lv_display_get_horizontal_resolution(lv_obj_get_display(content_)), LV_SIZE_CONTENT);
+        lv_obj_remove_flag(row.row, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row.row, LV_OBJ_FLAG_HIDDEN);
+
+        row.bubble = lv_obj_create(row.row);
+        lv_obj_set_style_radius(row.bubble, 8, 0);
+        lv_obj_set_scrollbar_mode(row.bubble, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_remove_flag(row.bubble, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_set_style_border_width(row.bubble, 0, 0);
+        lv_obj_set_style_pad_all(row.bubble, style_.padding, 0);
+        lv_obj_set_style_bg_opa(row.bubble, LV_OPA_70, 0);
+
+        row.label = lv_label_create(row.bubble);
+        lv_label_set_long_mode(row.label, LV_LABEL_LONG_WRAP);
+        lv_label_set_text_static(row.label, "");
+
+        row.image = lv_image_create(row.bubble);
+        lv_obj_add_flag(row.image, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+ChatMessageList::Record& ChatMessageList::RecordAt(uint32_t sequence) {
+    return records_[(first_ + (sequence - first_sequence_)) % records_.size()];
+}
+
+ChatMessageList::Record& ChatMessageList::PushRecord() {
+    if (count_ == records_.size()) {
+        // Drop the oldest record, no row may keep pointing at its image
+        auto& oldest = records_[first_];
+        for (auto& row : rows_) {
+            if (row.sequence == first_sequence_) {
+                lv_image_set_src(row.image, nullptr);
+                UnbindRow(row);
+            }
+        }
+        if (oldest.image) {
+            lv_image_cache_drop(oldest.image->image_dsc());
+            oldest.image.reset();
+        }
+        first_ = (first_ + 1) % records_.size();
+        first_sequence_++;
+        count_--;
+    }
+    auto& record = records_[(first_ + count_) % records_.size()];
+    count_++;
+    stats_.messages++;
+    return record;
+}
+
+void ChatMessageList::MeasureRecord(Record& record) {
+    auto display = lv_obj_get_display(content_);
+    int32_t hor_res = lv_display_get_horizontal_resolution(display);
+    int32_t ver_res = lv_display_get_vertical_resolution(display);
+
+    if (record.role == ChatRole::kImage) {
+        int32_t max_width = hor_res * 70 / 100;
+        int32_t max_height = ver_res * 50 / 100;
+        auto img_dsc = record.image->image_dsc();
+        int32_t img_width = img_dsc->header.w;
+        int32_t img_height = img_dsc->header.h;
+        if (img_width == 0 || img_height == 0) {
+            ESP_LOGW(TAG, "Invalid image dimensions: %ld x %ld, using default dimensions: %ld x %ld",
+                img_width, img_height, max_width, max_height);
+            img_width = max_width;
+            img_height = max_height;
+        }
+        int32_t zoom = std::min(max_width * 256 / img_width, max_height * 256 / img_height);
+        record.scale = std::min<int32_t>(zoom, 256);
+        // The bubble is 8 pixels larger than the image on each side
+        record.bubble_width = img_width * record.scale / 256 + 16;
+        record.height = img_height * record.scale / 256 + 16;
+        return;
+    }
+
+    int32_t max_width = hor_res * 85 / 100 - 16;
+    int32_t text_width = lv_text_get_width(record.text.c_str(), record.text.size(), style_.font, 0);
+    record.bubble_width = std::clamp<int32_t>(text_width, 20, max_width);
+
+    lv_point_t size;
+    lv_text_get_size(&size, record.text.c_str(), style_.font, 0, 0, record.bubble_width, LV_TEXT_FLAG_NONE);
+    record.height = size.y + 2 * style_.padding;
+}
+
+void ChatMessageList::ApplyRowStyle(Row& row, ChatRole role) {
+    if (row.styled && row.role == role) {
+        return;
+    }
+    row.role = role;
+    row.styled = true;
+
+    lv_color_t bubble_color = style_.assistant_bubble_color;
+    lv_color_t text_color = style_.text_color;
+    if (role == ChatRole::kUser) {
+        bubble_color = style_.user_bubble_color;
+    } else if (role == ChatRole::kSystem) {
+        bubble_color = style_.system_bubble_color;
+        text_color = style_.system_text_color;
+    }
+    lv_obj_set_style_bg_color(row.bubble, bubble_color, 0);
+    lv_obj_set_style_border_color(row.bubble, style_.border_color, 0);
+    lv_obj_set_style_text_color(row.label, text_color, 0);
+
+    // User messages sit on the right, system messages in the middle, the rest on the left
+    if (role == ChatRole::kUser) {
+        lv_obj_align(row.bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (role == ChatRole::kSystem) {
+        lv_obj_align(row.bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        lv_obj_align(row.bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+
+    if (role == ChatRole::kImage) {
+        lv_obj_add_flag(row.label, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_remove_flag(row.image, LV_OBJ_FLAG_HIDDEN);
+        lv_label_set_text_static(row.label, "");
+    } else {
+        lv_obj_add_flag(row.image, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_remove_flag(row.label, LV_OBJ_FLAG_HIDDEN);
+        lv_image_set_src(row.image, nullptr);
+        lv_obj_set_size(row.bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    }
+}
+
+void ChatMessageList::UnbindRow(Row& row) {
+    if (row.sequence != UINT32_MAX) {
+        lv_obj_add_flag(row.row, LV_OBJ_FLAG_HIDDEN);
+        row.sequence = UINT32_MAX;
+    }
+}
+
+void ChatMessageList::BindRow(Row& row, uint32_t sequence) {
+    if (sequence >= first_sequence_ + count_) {
+        UnbindRow(row);
+        return;
+    }
+    if (row.sequence == sequence) {
+        return;
+    }
+
+    auto& record = RecordAt(sequence);
+    ApplyRowStyle(row, record.role);
+    if (record.role == ChatRole::kImage) {
+        lv_image_set_src(row.image, record.image->image_dsc());
+        lv_image_set_scale(row.image, record.scale);
+        lv_obj_set_size(row.bubble, record.bubble_width, record.height);
+        lv_obj_center(row.image);
+    } else {
+        lv_label_set_text(row.label, record.text.c_str());
+        lv_obj_set_width(row.label, record.bubble_width);
+    }
+    if (row.sequence == UINT32_MAX) {
+        lv_obj_remove_flag(row.row, LV_OBJ_FLAG_HIDDEN);
+    }
+    row.sequence = sequence;
+    stats_.binds++;
+}
+
+void ChatMessageList::SetWindow(uint32_t start) {
+    // Move the rows that stay bound instead of rebinding all of them
+    size_t pool_size = rows_.size();
+    if (start > window_start_ && start - window_start_ < pool_size) {
+        size_t shift = start - window_start_;
+        for (size_t i = 0; i < shift; i++) {
+            lv_obj_move_to_index(rows_[i].row, -2);
+        }
+        std::rotate(rows_.begin(), rows_.begin() + shift, rows_.end());
+    } else if (start < window_start_ && window_start_ - start < pool_size) {
+        size_t shift = window_start_ - start;
+        for (size_t i = 0; i < shift; i++) {
+            lv_obj_move_to_index(rows_[pool_size - 1 - i].row, 1);
+        }
+        std::rotate(rows_.begin(), rows_.end() - shift, rows_.end());
+    }
+    window_start_ = start;
+    for (size_t i = 0; i < pool_size; i++) {
+        BindRow(rows_[i], start + i);
+    }
+    UpdateSpacers();
+}
+
+void ChatMessageList::UpdateSpacers() {
+    // The flex layout adds a row gap after a visible spacer, so each spacer is
+    // the height of its records plus the gaps between them
+    auto set_spacer = [this](lv_obj_t* spacer, uint32_t begin, uint32_t end) {
+        if (begin >= end) {
+            lv_obj_add_flag(spacer, LV_OBJ_FLAG_HIDDEN);
+            return;
+        }
+        int32_t height = -style_.row_gap;
+        for (uint32_t sequence = begin; sequence < end; sequence++) {
+            height += RecordAt(sequence).height + style_.row_gap;
+        }
+        lv_obj_set_height(spacer, height);
+        lv_obj_remove_flag(spacer, LV_OBJ_FLAG_HIDDEN);
+    };
+    uint32_t end = first_sequence_ + count_;
+    uint32_t window_end = std::min<uint32_t>(window_start_ + rows_.size(), end);
+    set_spacer(top_spacer_, first_sequence_, window_start_);
+    set_spacer(bottom_spacer_, window_end, end);
+}
+
+void ChatMessageList::ScrollToLatest() {
+    updating_ = true;
+    uint32_t end = first_sequence_ + count_;
+    SetWindow(end > rows_.size() ? std::max<uint32_t>(end - rows_.size(), first_sequence_) : first_sequence_);
+    for (auto& row : rows_) {
+        if (row.sequence == end - 1) {
+            lv_obj_scroll_to_view(row.row, LV_ANIM_ON);
+            break;
+        }
+    }
+    updating_ = false;
+}
+
+void ChatMessageList::OnScroll() {
+    if (updating_ || count_ <= rows_.size()) {
+        return;
+    }
+
+    // Find the records inside the viewport from the record heights
+    int32_t view_top = lv_obj_get_scroll_y(content_) - lv_obj_get_style_pad_top(content_, 0);
+    int32_t view_bottom = view_top + lv_obj_get_height(content_);
+    uint32_t end = first_sequence_ + count_;
+    uint32_t visible_first = end - 1;
+    uint32_t visible_last = end - 1;
+    int32_t y = 0;
+    bool found_first = false;
+    for (uint32_t sequence = first_sequence_; sequence < end; sequence++) {
+        int32_t bottom = y + RecordAt(sequence).height;
+        if (!found_first && bottom >= view_top) {
+            visible_first = sequence;
+            found_first = true;
+        }
+        if (y > view_bottom) {
+            visible_last = sequence - 1;
+            break;
+        }
+        y = bottom + style_.row_gap;
+    }
+
+    if (visible_first >= window_start_ && visible_last < window_start_ + rows_.size()) {
+        return;
+    }
+    // Center the window on the visible records
+    uint32_t visible_count = visible_last - visible_first + 1;
+    uint32_t margin = rows_.size() > visible_count ? (rows_.size() - visible_count) / 2 : 0;
+    uint32_t start = visible_first > first_sequence_ + margin ? visible_first - margin : first_sequence_;
+    start = std::min<uint32_t>(start, end - rows_.size());
+    stats_.rebinds_on_scroll++;
+    updating_ = true;
+    SetWindow(start);
+    updating_ = false;
+}
+
+void ChatMessageList::AddMessage(ChatRole role, const char* text) {
+    auto& record = PushRecord();
+    record.role = role;
+    record.text = text;
+    record.image.reset();
+    MeasureRecord(record);
+    ScrollToLatest();
+}
+
+void ChatMessageList::AddImage(std::unique_ptr<LvglImage> image) {
+    auto& record = PushRecord();
+    record.role = ChatRole::kImage;
+    record.text.clear();
+    record.image = std::move(image);
+    MeasureRecord(record);
+    ScrollToLatest();
+}
+
+void ChatMessageList::RemoveLastSystemMessage() {
+    if (count_ == 0) {
+        return;
+    }
+    uint32_t last = first_sequence_ + count_ - 1;
+    if (RecordAt(last).role != ChatRole::kSystem) {
+        return;
+    }
+    count_--;
+    for (auto& row : rows_) {
+        if (row.sequence == last) {
+            UnbindRow(row);
+        }
+    }
+    uint32_t end = first_sequence_ + count_;
+    SetWindow(std::min(window_start_, end > rows_.size() ? end - (uint32_t)rows_.size() : first_sequence_));
+}
+
+void ChatMessageList::SetStyle(const ChatBubbleStyle& style) {
+    style_ = style;
+    for (size_t i = 0; i < count_; i++) {
+        MeasureRecord(RecordAt(first_sequence_ + i));
+    }
+    for (auto& row : rows_) {
+        lv_obj_set_style_pad_all(row.bubble, style_.padding, 0);
+        row.styled = false;
+        // Rebound below with the new font and colors
+        UnbindRow(row);
+    }
+    SetWindow(window_start_);
+}
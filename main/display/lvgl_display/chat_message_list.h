@@ -0,0 +1,115 @@
+#ifndef CHAT_MESSAGE_LIST_H
+#define CHAT_MESSAGE_LIST_H
+
+#include "lvgl_image.h"
+
+#include <lvgl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class ChatRole : uint8_t {
+    kUser,
+    kAssistant,
+    kSystem,
+    kImage,
+};
+
+// Colors and metrics of the chat bubbles, taken from the current theme
+struct ChatBubbleStyle {
+    const lv_font_t* font = nullptr;
+    lv_color_t user_bubble_color;
+    lv_color_t assistant_bubble_color;
+    lv_color_t system_bubble_color;
+    lv_color_t text_color;
+    lv_color_t system_text_color;
+    lv_color_t border_color;
+    int32_t padding = 8;    // Inside a bubble
+    int32_t row_gap = 8;    // Between bubbles
+};
+
+// Counters for profiling the list, all of them only ever grow
+struct ChatMessageListStats {
+    uint32_t messages = 0;
+    uint32_t binds = 0;         // Rows (re)bound to a message record
+    uint32_t rebinds_on_scroll = 0;
+};
+
+/**
+ * Virtualized chat history for the message style UI.
+ *
+ * Messages are kept as records in a ring of a fixed capacity. A fixed pool of
+ * row objects (row, bubble, label and image) is created once, large enough to
+ * cover the visible area, and bound to the records around the visible window.
+ * Records outside the window are represented by two spacers of the same
+ * height, so scrolling works over the whole history. Adding a message rebinds
+ * one recycled row in place instead of creating and deleting LVGL objects.
+ */
+class ChatMessageList {
+public:
+    ChatMessageList(lv_obj_t* content, const ChatBubbleStyle& style, size_t capacity);
+    ~ChatMessageList();
+    ChatMessageList(const ChatMessageList&) = delete;
+    ChatMessageList& operator=(const ChatMessageList&) = delete;
+
+    void AddMessage(ChatRole role, const char* text);
+    void AddImage(std::unique_ptr<LvglImage> image);
+    // Remove the newest record if it is a system message, used to collapse
+    // consecutive system messages into the latest one
+    void RemoveLastSystemMessage();
+    void SetStyle(const ChatBubbleStyle& style);
+
+    size_t size() const { return count_; }
+    size_t pool_size() const { return rows_.size(); }
+    const ChatMessageListStats& stats() const { return stats_; }
+
+private:
+    struct Record {
+        ChatRole role = ChatRole::kSystem;
+        std::string text;
+        std::unique_ptr<LvglImage> image;
+        int32_t bubble_width = 0;
+        int32_t height = 0;             // Height of the bubble, used for the spacers
+        int32_t scale = 256;            // Image scale, 256 is 100%
+    };
+
+    struct Row {
+        lv_obj_t* row = nullptr;        // Full width, transparent, aligns the bubble
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        lv_obj_t* image = nullptr;
+        uint32_t sequence = UINT32_MAX; // Sequence number of the bound record, hidden if none
+        ChatRole role = ChatRole::kSystem;
+        bool styled = false;
+    };
+
+    lv_obj_t* content_;
+    ChatBubbleStyle style_;
+    std::vector<Record> records_;
+    size_t first_ = 0;                  // Ring index of the oldest record
+    size_t count_ = 0;
+    uint32_t first_sequence_ = 0;       // Sequence number of the oldest record
+    std::vector<Row> rows_;             // In display order, bound to consecutive records
+    uint32_t window_start_ = 0;         // Sequence number bound to rows_[0]
+    lv_obj_t* top_spacer_ = nullptr;
+    lv_obj_t* bottom_spacer_ = nullptr;
+    ChatMessageListStats stats_;
+    bool updating_ = false;
+
+    Record& RecordAt(uint32_t sequence);
+    Record& PushRecord();
+    void MeasureRecord(Record& record);
+    void CreateRows();
+    void ApplyRowStyle(Row& row, ChatRole role);
+    void BindRow(Row& row, uint32_t sequence);
+    void UnbindRow(Row& row);
+    void SetWindow(uint32_t start);
+    void UpdateSpacers();
+    void ScrollToLatest();
+    void OnScroll();
+};
+
+#endif // CHAT_MESSAGE_LIST_H
@@ -0,0 +1,141 @@
+#include "gif_frame_cache.h"
+#include "arena_allocator.h"
+
+#include <cstring>
+#include <iterator>
+#include <esp_log.h>
+
+#define TAG "GifFrameCache"
+
+// GifFrameSequence
+
+GifFrameSequence::GifFrameSequence(uint16_t width, uint16_t height, size_t frame_size, int32_t loop_count)
+    : width_(width), height_(height), frame_size_(frame_size), loop_count_(loop_count) {
+}
+
+GifFrameSequence::~GifFrameSequence() {
+    for (auto& frame : frames_) {
+        memory_region_free(MEMORY_REGION_GIF_CACHE, frame.data);
+    }
+}
+
+bool GifFrameSequence::AddFrame(const uint8_t* canvas, uint16_t delay_ms, const GifRect& dirty) {
+    auto data = (uint8_t*)memory_region_malloc(MEMORY_REGION_GIF_CACHE, frame_size_);
+    if (data == nullptr) {
+        return false;
+    }
+    memcpy(data, canvas, frame_size_);
+    frames_.push_back({data, delay_ms, dirty});
+    return true;
+}
+
+void GifFrameSequence::SetFirstFrameDirty(const GifRect& dirty) {
+    if (!frames_.empty()) {
+        frames_[0].dirty = dirty;
+    }
+}
+
+// GifFrameCache
+
+GifFrameCache::GifFrameCache() {
+    region_ = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_GIF_CACHE);
+}
+
+size_t GifFrameCache::budget() const {
+    return region_ != nullptr ? region_->budget() : 0;
+}
+
+std::shared_ptr<const GifFrameSequence> GifFrameCache::Get(const std::string& key, const void* source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end() || it->second->source != source) {
+        misses_++;
+        return nullptr;
+    }
+    // Move to the front of the LRU list
+    entries_.splice(entries_.begin(), entries_, it->second);
+    hits_++;
+    return it->second->sequence;
+}
+
+void GifFrameCache::Put(const std::string& key, const void* source, std::shared_ptr<const GifFrameSequence> sequence) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (region_ == nullptr) {
+        return;
+    }
+    // The frames are in the region already, replacing an entry only drops the old sequence
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        Erase(it->second);
+    }
+
+    size_t bytes = sequence->bytes();
+    entries_.push_front({key, source, std::move(sequence)});
+    index_[key] = entries_.begin();
+    used_ += bytes;
+    ESP_LOGI(TAG, "Cached %s: %u frames, %u bytes (cached %u, region %u / %u)", key.c_str(),
+        entries_.front().sequence->frames().size(), bytes, used_, region_->used(), region_->budget());
+}
+
+bool GifFrameCache::AddFrame(GifFrameSequence& recording, const uint8_t* canvas, uint16_t delay_ms,
+    const GifRect& dirty) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A recording that cannot fit even alone is not worth evicting anything for
+    if (region_ == nullptr || recording.bytes() + recording.frame_size() > region_->budget()) {
+        return false;
+    }
+    // The region checks its budget against the block the heap hands out, which is rounded
+    // up from the frame size, so evict until the allocation itself succeeds
+    auto it = entries_.end();
+    while (!recording.AddFrame(canvas, delay_ms, dirty)) {
+        // Evicting a sequence that is playing would free nothing until the player lets go of it
+        while (it != entries_.begin() && std::prev(it)->sequence.use_count() > 1) {
+            --it;
+        }
+        if (it == entries_.begin()) {
+            return false;
+        }
+        --it;
+        ESP_LOGD(TAG, "Evict %s", it->key.c_str());
+        auto next = std::next(it);
+        Erase(it);
+        it = next;
+        evictions_++;
+    }
+    return true;
+}
+
+void GifFrameCache::Erase(std::list<Entry>::iterator it) {
+    used_ -= it->sequence->bytes();
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+uint32_t GifFrameCache::hits() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint32_t GifFrameCache::misses() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+void GifFrameCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    entries_.clear();
+    used_ = 0;
+}
+
+cJSON* GifFrameCache::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "budget", budget());
+    cJSON_AddNumberToObject(json, "used", used_);
+    cJSON_AddNumberToObject(json, "entries", entries_.size());
+    cJSON_AddNumberToObject(json, "hits", hits_);
+    cJSON_AddNumberToObject(json, "misses", misses_);
+    cJSON_AddNumberToObject(json, "evictions", evictions_);
+    return json;
+}
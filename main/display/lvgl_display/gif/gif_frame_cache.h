@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cJSON.h>
+
+struct GifRect {
+    uint16_t x, y, w, h;
+};
+
+struct GifFrame {
+    uint8_t* data;
+    uint16_t delay_ms;      // How long this frame stays on screen
+    GifRect dirty;          // Area that differs from the previous frame, the last one for the first frame
+};
+
+/**
+ * All frames of one GIF loop rendered to full canvases, so playing it back
+ * needs no LZW decoding. Frames are allocated from the gif_cache memory region.
+ */
+class GifFrameSequence {
+public:
+    GifFrameSequence(uint16_t width, uint16_t height, size_t frame_size, int32_t loop_count);
+    ~GifFrameSequence();
+    GifFrameSequence(const GifFrameSequence&) = delete;
+    GifFrameSequence& operator=(const GifFrameSequence&) = delete;
+
+    // Copy a rendered canvas, returns false if the memory region is out of budget.
+    // Recordings that go into the cache add their frames through GifFrameCache::AddFrame()
+    bool AddFrame(const uint8_t* canvas, uint16_t delay_ms, const GifRect& dirty);
+    // The first frame only knows its dirty area once the loop wraps around to it
+    void SetFirstFrameDirty(const GifRect& dirty);
+
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+    int32_t loop_count() const { return loop_count_; }
+    size_t frame_size() const { return frame_size_; }
+    size_t bytes() const { return frame_size_ * frames_.size(); }
+    const std::vector<GifFrame>& frames() const { return frames_; }
+
+private:
+    uint16_t width_;
+    uint16_t height_;
+    size_t frame_size_;
+    int32_t loop_count_;
+    std::vector<GifFrame> frames_;
+};
+
+class MemoryRegion;
+
+/**
+ * LRU cache of decoded emotion animations keyed by emotion name. Switching
+ * back to a cached emotion only swaps the frame pointers. Sequences that are
+ * still playing stay alive after eviction until the player releases them.
+ *
+ * The budget is the one of the gif_cache memory region, which also counts the
+ * sequence being recorded and evicted sequences that are still playing. A
+ * recorder adds frames through AddFrame(), which evicts sequences that nothing
+ * plays until the region accepts the frame.
+ */
+class GifFrameCache {
+public:
+    static GifFrameCache& GetInstance() {
+        static GifFrameCache instance;
+        return instance;
+    }
+    GifFrameCache(const GifFrameCache&) = delete;
+    GifFrameCache& operator=(const GifFrameCache&) = delete;
+
+    bool enabled() const { return region_ != nullptr; }
+    size_t budget() const;
+
+    // source identifies the GIF data, so a theme change with the same emotion name is a miss
+    std::shared_ptr<const GifFrameSequence> Get(const std::string& key, const void* source);
+    void Put(const std::string& key, const void* source, std::shared_ptr<const GifFrameSequence> sequence);
+    // Add a frame to a recording, evicting least recently used sequences that are not
+    // playing until the region accepts it. False if that is not possible
+    bool AddFrame(GifFrameSequence& recording, const uint8_t* canvas, uint16_t delay_ms, const GifRect& dirty);
+    void Clear();
+
+    uint32_t hits();
+    uint32_t misses();
+    // The caller owns the returned object
+    cJSON* GetStatsJson();
+
+private:
+    GifFrameCache();
+    ~GifFrameCache() = default;
+
+    struct Entry {
+        std::string key;
+        const void* source;
+        std::shared_ptr<const GifFrameSequence> sequence;
+    };
+
+    // Must be called with mutex_ held
+    void Erase(std::list<Entry>::iterator it);
+
+    MemoryRegion* region_ = nullptr;
+    std::mutex mutex_;
+    std::list<Entry> entries_;     // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t used_ = 0;              // Bytes of the cached sequences
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
+};
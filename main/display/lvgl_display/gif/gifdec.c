@@ -4,28 +4,25 @@
 #include <string.h>
 #include <stdbool.h>
 #include <esp_log.h>
+#include "arena_allocator.h"
 
 #define TAG "GIF"
 
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
 
-typedef struct Entry {
-    uint16_t length;
-    uint16_t prefix;
-    uint8_t  suffix;
-} Entry;
-
-typedef struct Table {
-    int bulk;
-    int nentries;
-    Entry * entries;
-} Table;
-
-#if LV_GIF_CACHE_DECODE_DATA
 #define LZW_MAXBITS                 12
 #define LZW_TABLE_SIZE              (1 << LZW_MAXBITS)
+
+#if LV_GIF_CACHE_DECODE_DATA
 #define LZW_CACHE_SIZE              (LZW_TABLE_SIZE * 4)
+#else
+struct _gd_LZW {
+    uint32_t offset[LZW_TABLE_SIZE];    /* Output offset the string of a code was emitted at */
+    uint16_t length[LZW_TABLE_SIZE];
+    uint8_t first[LZW_TABLE_SIZE];      /* First byte of the string */
+    uint8_t output[];                   /* Linear output of frames that are not contiguous in the canvas */
+};
 #endif
 
 static gd_GIF  * gif_open(gd_GIF * gif);
@@ -47,11 +44,41 @@ read_num(gd_GIF * gif)
     return bytes[0] + (((uint16_t) bytes[1]) << 8);
 }
 
+/* Bytes per pixel of the canvas, the A8 plane included */
+static uint8_t
+canvas_bpp(const gd_GIF * gif)
+{
+    switch(gif->color_format) {
+        case LV_COLOR_FORMAT_RGB565:
+            return 2;
+        case LV_COLOR_FORMAT_RGB565A8:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+/* Convert the current palette to RGB565 once, instead of for every pixel */
+static void
+convert_palette(gd_GIF * gif)
+{
+    if(gif->color_format == LV_COLOR_FORMAT_ARGB8888) return;
+    /* The GCT never changes, a LCT may differ for every frame */
+    if(gif->palette == gif->palette565_src && gif->palette == &gif->gct) return;
+
+    const uint8_t * color = gif->palette->colors;
+    for(int i = 0; i < 0x100; i++, color += 3) {
+        gif->palette565[i] = ((color[0] & 0xF8) << 8) | ((color[1] & 0xFC) << 3) | (color[2] >> 3);
+    }
+    gif->palette565_src = gif->palette;
+}
+
 gd_GIF *
 gd_open_gif_file(const char * fname)
 {
     gd_GIF gif_base;
     memset(&gif_base, 0, sizeof(gif_base));
+    gif_base.color_format = LV_COLOR_FORMAT_ARGB8888;
 
     bool res = f_gif_open(&gif_base, fname, true);
     if(!res) return NULL;
@@ -61,9 +88,16 @@ gd_open_gif_file(const char * fname)
 
 gd_GIF *
 gd_open_gif_data(const void * data)
+{
+    return gd_open_gif_data_cf(data, LV_COLOR_FORMAT_ARGB8888);
+}
+
+gd_GIF *
+gd_open_gif_data_cf(const void * data, lv_color_format_t color_format)
 {
     gd_GIF gif_base;
     memset(&gif_base, 0, sizeof(gif_base));
+    gif_base.color_format = color_format;
 
     bool res = f_gif_open(&gif_base, data, false);
     if(!res) return NULL;
@@ -71,6 +105,33 @@ gd_open_gif_data(const void * data)
     return gif_open(&gif_base);
 }
 
+/* Fill a rect of an RGB565 or RGB565A8 buffer, starting at pixel i, with a palette color */
+static void
+fill_rect_rgb565(gd_GIF * gif, uint8_t * buffer, int i, uint32_t w, uint32_t h, uint8_t index, uint8_t opa)
+{
+    uint16_t * dst = (uint16_t *) buffer + i;
+    uint16_t color = gif->palette565[index];
+    uint32_t j;
+
+    /* A rect as wide as the canvas is one contiguous run */
+    if(w == gif->width) {
+        w *= h;
+        h = 1;
+    }
+    for(j = 0; j < h; j++) {
+        for(uint32_t k = 0; k < w; k++) dst[k] = color;
+        dst += gif->width;
+    }
+
+    if(gif->color_format != LV_COLOR_FORMAT_RGB565A8) return;
+
+    uint8_t * alpha = &buffer[gif->width * gif->height * 2 + i];
+    for(j = 0; j < h; j++) {
+        memset(alpha, opa, w);
+        alpha += gif->width;
+    }
+}
+
 static gd_GIF * gif_open(gd_GIF * gif_base)
 {
     uint8_t sigver[3];
@@ -79,6 +140,14 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     uint8_t * bgcolor;
     int gct_sz;
     gd_GIF * gif = NULL;
+    uint8_t bpp;
+
+    if(gif_base->color_format != LV_COLOR_FORMAT_ARGB8888 && gif_base->color_format != LV_COLOR_FORMAT_RGB565 &&
+       gif_base->color_format != LV_COLOR_FORMAT_RGB565A8) {
+        ESP_LOGW(TAG, "unsupported color format %d", gif_base->color_format);
+        goto fail;
+    }
+    bpp = canvas_bpp(gif_base);
 
     /* Header */
     f_gif_read(gif_base, sigver, 3);
@@ -121,13 +190,13 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         ESP_LOGW(TAG, "Image dimensions are too large");
         goto fail;
     } 
-    gif = lv_malloc(sizeof(gd_GIF) + 5 * width * height + LZW_CACHE_SIZE);
+    gif = memory_region_malloc(MEMORY_REGION_GIF, sizeof(gd_GIF) + (bpp + 1) * width * height + LZW_CACHE_SIZE);
 #else
     if(0 == (INT_MAX - sizeof(gd_GIF)) / width / height / 5){
         ESP_LOGW(TAG, "Image dimensions are too large");
         goto fail;
     } 
-    gif = lv_malloc(sizeof(gd_GIF) + 5 * width * height);
+    gif = memory_region_malloc(MEMORY_REGION_GIF, sizeof(gd_GIF) + (bpp + 1) * width * height);
 #endif
     if(!gif) goto fail;
     memcpy(gif, gif_base, sizeof(gd_GIF));
@@ -138,9 +207,10 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     gif->gct.size = gct_sz;
     f_gif_read(gif, gif->gct.colors, 3 * gif->gct.size);
     gif->palette = &gif->gct;
+    convert_palette(gif);
     gif->bgindex = bgidx;
     gif->canvas = (uint8_t *) &gif[1];
-    gif->frame = &gif->canvas[4 * width * height];
+    gif->frame = &gif->canvas[bpp * width * height];
     if(gif->bgindex) {
         memset(gif->frame, gif->bgindex, gif->width * gif->height);
     }
@@ -149,18 +219,24 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     gif->lzw_cache = gif->frame + width * height;
     #endif
 
+    if(gif->color_format == LV_COLOR_FORMAT_ARGB8888) {
 #ifdef GIFDEC_FILL_BG
-    GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
+        GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
 #else
-    for(int i = 0; i < gif->width * gif->height; i++) {
-        gif->canvas[i * 4 + 0] = *(bgcolor + 2);
-        gif->canvas[i * 4 + 1] = *(bgcolor + 1);
-        gif->canvas[i * 4 + 2] = *(bgcolor + 0);
-        gif->canvas[i * 4 + 3] = 0x00;  // 初始化为透明，让第一帧根据自己的透明度设置来渲染
-    }
+        for(int i = 0; i < gif->width * gif->height; i++) {
+            gif->canvas[i * 4 + 0] = *(bgcolor + 2);
+            gif->canvas[i * 4 + 1] = *(bgcolor + 1);
+            gif->canvas[i * 4 + 2] = *(bgcolor + 0);
+            gif->canvas[i * 4 + 3] = 0x00;  // 初始化为透明，让第一帧根据自己的透明度设置来渲染
+        }
 #endif
+    }
+    else {
+        fill_rect_rgb565(gif, gif->canvas, 0, gif->width, gif->height, gif->bgindex, 0x00);
+    }
     gif->anim_start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     gif->loop_count = -1;
+    gif->frame_index = -1;
     goto ok;
 fail:
     f_gif_close(gif_base);
@@ -299,6 +375,7 @@ read_ext(gd_GIF * gif)
     }
 }
 
+#if LV_GIF_CACHE_DECODE_DATA
 static uint16_t
 get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *byte)
 {
@@ -328,7 +405,6 @@ get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *by
     return key;
 }
 
-#if LV_GIF_CACHE_DECODE_DATA
 /* Decompress image pixels.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
 static int
@@ -478,48 +554,6 @@ read_image_data(gd_GIF *gif, int interlace)
     return ret;
 }
 #else
-static Table *
-new_table(int key_size)
-{
-    int key;
-    int init_bulk = MAX(1 << (key_size + 1), 0x100);
-    Table * table = lv_malloc(sizeof(*table) + sizeof(Entry) * init_bulk);
-    if(table) {
-        table->bulk = init_bulk;
-        table->nentries = (1 << key_size) + 2;
-        table->entries = (Entry *) &table[1];
-        for(key = 0; key < (1 << key_size); key++)
-            table->entries[key] = (Entry) {
-            1, 0xFFF, key
-        };
-    }
-    return table;
-}
-
-/* Add table entry. Return value:
- *  0 on success
- *  +1 if key size must be incremented after this addition
- *  -1 if could not realloc table */
-static int
-add_entry(Table ** tablep, uint16_t length, uint16_t prefix, uint8_t suffix)
-{
-    Table * table = *tablep;
-    if(table->nentries == table->bulk) {
-        table->bulk *= 2;
-        table = lv_realloc(table, sizeof(*table) + sizeof(Entry) * table->bulk);
-        if(!table) return -1;
-        table->entries = (Entry *) &table[1];
-        *tablep = table;
-    }
-    table->entries[table->nentries] = (Entry) {
-        length, prefix, suffix
-    };
-    table->nentries++;
-    if((table->nentries & (table->nentries - 1)) == 0)
-        return 1;
-    return 0;
-}
-
 /* Compute output index of y-th input line, in frame of height h. */
 static int
 interlaced_line_index(int h, int y)
@@ -543,85 +577,140 @@ interlaced_line_index(int h, int y)
 }
 
 /* Decompress image pixels.
- * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
+ * Every code of the LZW table is a string that has been emitted before, so the table only keeps
+ * where that was and strings are copied from the decoded output instead of walking prefix chains.
+ * Frames that are not contiguous in gif->frame (sub-rects, interlacing) are decoded into a linear
+ * buffer first and copied row by row.
+ * Return 0 on success or -1 on out-of-memory or parse error. */
 static int
 read_image_data(gd_GIF * gif, int interlace)
 {
-    uint8_t sub_len, shift, byte;
-    int init_key_size, key_size, table_is_full = 0;
-    int frm_off, frm_size, str_len = 0, i, p, x, y;
-    uint16_t key, clear, stop;
-    int ret;
-    Table * table;
-    Entry entry = {0};
+    uint8_t block[0xFF];
+    uint8_t block_len = 0, block_pos = 0;
+    uint8_t min_code_size;
+    uint32_t acc = 0;
+    int acc_bits = 0, data_end = 0;
+    int code_size, code, prev = -1, next, clear, stop, direct;
+    uint32_t mask, pos = 0, prev_pos = 0, frm_size, len;
+    uint8_t * out;
+    gd_LZW * lzw;
     size_t start, end;
 
-    f_gif_read(gif, &byte, 1);
-    key_size = (int) byte;
+    f_gif_read(gif, &min_code_size, 1);
     start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     discard_sub_blocks(gif);
     end = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     f_gif_seek(gif, start, LV_FS_SEEK_SET);
-    clear = 1 << key_size;
-    stop = clear + 1;
-    table = new_table(key_size);
-    key_size++;
-    init_key_size = key_size;
-    sub_len = shift = 0;
-    key = get_key(gif, key_size, &sub_len, &shift, &byte); /* clear code */
-    frm_off = 0;
-    ret = 0;
+    if(min_code_size > LZW_MAXBITS - 1) {
+        ESP_LOGW(TAG, "invalid LZW code size %d", min_code_size);
+        return -1;
+    }
+
+    if(!gif->lzw) {
+        gif->lzw = memory_region_malloc(MEMORY_REGION_GIF, sizeof(gd_LZW) + gif->width * gif->height);
+        if(!gif->lzw) return -1;
+    }
+    lzw = gif->lzw;
+
     frm_size = gif->fw * gif->fh;
-    while(frm_off < frm_size) {
-        if(key == clear) {
-            key_size = init_key_size;
-            table->nentries = (1 << (key_size - 1)) + 2;
-            table_is_full = 0;
+    direct = !interlace && gif->fw == gif->width;
+    out = direct ? &gif->frame[gif->fy * gif->width] : lzw->output;
+
+    clear = 1 << min_code_size;
+    stop = clear + 1;
+    for(code = 0; code < clear; code++) {
+        lzw->length[code] = 1;
+        lzw->first[code] = code;
+    }
+    code_size = min_code_size + 1;
+    mask = (1 << code_size) - 1;
+    next = clear + 2;
+
+    while(pos < frm_size) {
+        /* Refill the bit accumulator, sub-blocks are read whole */
+        if(acc_bits < code_size) {
+            while(acc_bits <= 24) {
+                if(block_pos == block_len) {
+                    if(data_end) break;
+                    f_gif_read(gif, &block_len, 1);
+                    block_pos = 0;
+                    if(block_len == 0) {
+                        data_end = 1;
+                        break;
+                    }
+                    f_gif_read(gif, block, block_len);
+                }
+                acc |= (uint32_t) block[block_pos++] << acc_bits;
+                acc_bits += 8;
+            }
+            if(acc_bits < code_size) break;
         }
-        else if(!table_is_full) {
-            ret = add_entry(&table, str_len + 1, key, entry.suffix);
-            if(ret == -1) {
-                lv_free(table);
-                return -1;
+        code = acc & mask;
+        acc >>= code_size;
+        acc_bits -= code_size;
+
+        if(code == clear) {
+            code_size = min_code_size + 1;
+            mask = (1 << code_size) - 1;
+            next = clear + 2;
+            prev = -1;
+            continue;
+        }
+        if(code == stop) break;
+
+        if(prev >= 0) {
+            /* The new entry is the previous string plus the first byte of this one, the previous
+             * string was emitted right before this one so both are already in place. */
+            if(code > next || (code == next && next == LZW_TABLE_SIZE)) break;
+            if(next < LZW_TABLE_SIZE) {
+                lzw->offset[next] = prev_pos;
+                lzw->length[next] = lzw->length[prev] + 1;
+                lzw->first[next] = lzw->first[prev];
+                next++;
+                if(next == (int) mask + 1 && code_size < LZW_MAXBITS) {
+                    code_size++;
+                    mask = (1 << code_size) - 1;
+                }
+            }
+        }
+        else if(code >= clear) {
+            break;
+        }
+
+        len = lzw->length[code];
+        if(pos + len > frm_size) {
+            ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
+            return -1;
+        }
+        if(code < clear) {
+            out[pos] = code;
+        }
+        else {
+            const uint8_t * src = &out[lzw->offset[code]];
+            uint8_t * dst = &out[pos];
+            if(src + len <= dst) {
+                memcpy(dst, src, len);
             }
-            if(table->nentries == 0x1000) {
-                ret = 0;
-                table_is_full = 1;
+            else {
+                /* A code defined by this very step (KwKwK), the copy overlaps its own output */
+                for(uint32_t i = 0; i < len; i++) dst[i] = src[i];
             }
         }
-        key = get_key(gif, key_size, &sub_len, &shift, &byte);
-        if(key == clear) continue;
-        if(key == stop || key == 0x1000) break;
-        if(ret == 1) key_size++;
-        entry = table->entries[key];
-        str_len = entry.length;
-	if(frm_off + str_len > frm_size){
-		ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
-		lv_free(table);
-		return -1;
-	}
-        for(i = 0; i < str_len; i++) {
-            p = frm_off + entry.length - 1;
-            x = p % gif->fw;
-            y = p / gif->fw;
-            if(interlace)
-                y = interlaced_line_index((int) gif->fh, y);
-            gif->frame[(gif->fy + y) * gif->width + gif->fx + x] = entry.suffix;
-            if(entry.prefix == 0xFFF)
-                break;
-            else
-                entry = table->entries[entry.prefix];
+        prev = code;
+        prev_pos = pos;
+        pos += len;
+    }
+
+    if(!direct) {
+        for(uint32_t y = 0; y * gif->fw < pos; y++) {
+            int line = interlace ? interlaced_line_index((int) gif->fh, (int) y) : (int) y;
+            memcpy(&gif->frame[(gif->fy + line) * gif->width + gif->fx], &lzw->output[y * gif->fw],
+                   MIN(gif->fw, pos - y * gif->fw));
         }
-        frm_off += str_len;
-        if(key < table->nentries - 1 && !table_is_full)
-            table->entries[table->nentries - 1].suffix = entry.suffix;
     }
-    lv_free(table);
-    if(key == stop) f_gif_read(gif, &sub_len, 1);  /* Must be zero! */
     f_gif_seek(gif, end, LV_FS_SEEK_SET);
     return 0;
 }
-
 #endif
 
 /* Read image.
@@ -653,13 +742,57 @@ read_image(gd_GIF * gif)
     }
     else
         gif->palette = &gif->gct;
+    convert_palette(gif);
     /* Image Data. */
     return read_image_data(gif, interlace);
 }
 
+/* Render the frame rect into an RGB565 or RGB565A8 buffer, the A8 plane follows the RGB565 plane */
+static void
+render_frame_rect_rgb565(gd_GIF * gif, uint8_t * buffer)
+{
+    int i = gif->fy * gif->width + gif->fx;
+    uint16_t * dst = (uint16_t *) buffer + i;
+    const uint8_t * frame = &gif->frame[i];
+    uint16_t tindex = gif->gce.transparency ? gif->gce.tindex : 0x100;
+    int j, k;
+
+    for(j = 0; j < gif->fh; j++) {
+        for(k = 0; k < gif->fw; k++) {
+            if(frame[k] != tindex) {
+                dst[k] = gif->palette565[frame[k]];
+            }
+        }
+        dst += gif->width;
+        frame += gif->width;
+    }
+
+    if(gif->color_format != LV_COLOR_FORMAT_RGB565A8) return;
+
+    uint8_t * alpha = &buffer[gif->width * gif->height * 2 + i];
+    frame = &gif->frame[i];
+    for(j = 0; j < gif->fh; j++) {
+        if(tindex > 0xFF) {
+            memset(alpha, 0xFF, gif->fw);
+        }
+        else {
+            for(k = 0; k < gif->fw; k++) {
+                if(frame[k] != tindex) alpha[k] = 0xFF;
+            }
+        }
+        alpha += gif->width;
+        frame += gif->width;
+    }
+}
+
 static void
 render_frame_rect(gd_GIF * gif, uint8_t * buffer)
 {
+    if(gif->color_format != LV_COLOR_FORMAT_ARGB8888) {
+        render_frame_rect_rgb565(gif, buffer);
+        return;
+    }
+
     int i = gif->fy * gif->width + gif->fx;
 #ifdef GIFDEC_RENDER_FRAME
     GIFDEC_RENDER_FRAME(&buffer[i * 4], gif->fw, gif->fh, gif->width,
@@ -698,6 +831,10 @@ dispose(gd_GIF * gif)
             if(gif->gce.transparency) opa = 0x00;
 
             i = gif->fy * gif->width + gif->fx;
+            if(gif->color_format != LV_COLOR_FORMAT_ARGB8888) {
+                fill_rect_rgb565(gif, gif->canvas, i, gif->fw, gif->fh, gif->bgindex, opa);
+                break;
+            }
 #ifdef GIFDEC_FILL_BG
             GIFDEC_FILL_BG(&(gif->canvas[i * 4]), gif->fw, gif->fh, gif->width, bgcolor, opa);
 #else
@@ -721,18 +858,44 @@ dispose(gd_GIF * gif)
     }
 }
 
+/* Grow the dirty area to include the current frame rect */
+static void
+add_dirty_frame_rect(gd_GIF * gif)
+{
+    if(gif->fw == 0 || gif->fh == 0) return;
+    if(gif->dw == 0 || gif->dh == 0) {
+        gif->dx = gif->fx;
+        gif->dy = gif->fy;
+        gif->dw = gif->fw;
+        gif->dh = gif->fh;
+        return;
+    }
+    uint16_t x2 = MAX(gif->dx + gif->dw, gif->fx + gif->fw);
+    uint16_t y2 = MAX(gif->dy + gif->dh, gif->fy + gif->fh);
+    gif->dx = MIN(gif->dx, gif->fx);
+    gif->dy = MIN(gif->dy, gif->fy);
+    gif->dw = x2 - gif->dx;
+    gif->dh = y2 - gif->dy;
+}
+
 /* Return 1 if got a frame; 0 if got GIF trailer; -1 if error. */
 int
 gd_get_frame(gd_GIF * gif)
 {
     char sep;
 
+    /* Only a background restore changes the canvas when disposing, the other modes keep it */
+    gif->dw = gif->dh = 0;
+    if(gif->gce.disposal == 2) add_dirty_frame_rect(gif);
+
     dispose(gif);
     f_gif_read(gif, &sep, 1);
     while(sep != ',') {
         if(sep == ';') {
             f_gif_seek(gif, gif->anim_start, LV_FS_SEEK_SET);
+            gif->frame_index = -1;
             if(gif->loop_count == 1 || gif->loop_count < 0) {
+                add_dirty_frame_rect(gif);
                 return 0;
             }
             else if(gif->loop_count > 1) {
@@ -746,6 +909,8 @@ gd_get_frame(gd_GIF * gif)
     }
     if(read_image(gif) == -1)
         return -1;
+    add_dirty_frame_rect(gif);
+    gif->frame_index++;
     return 1;
 }
 
@@ -755,10 +920,17 @@ gd_render_frame(gd_GIF * gif, uint8_t * buffer)
     render_frame_rect(gif, buffer);
 }
 
+uint32_t
+gd_canvas_size(const gd_GIF * gif)
+{
+    return canvas_bpp(gif) * gif->width * gif->height;
+}
+
 void
 gd_rewind(gd_GIF * gif)
 {
     gif->loop_count = -1;
+    gif->frame_index = -1;
     f_gif_seek(gif, gif->anim_start, LV_FS_SEEK_SET);
 }
 
@@ -766,7 +938,10 @@ void
 gd_close_gif(gd_GIF * gif)
 {
     f_gif_close(gif);
-    lv_free(gif);
+#if !LV_GIF_CACHE_DECODE_DATA
+    if(gif->lzw) memory_region_free(MEMORY_REGION_GIF, gif->lzw);
+#endif
+    memory_region_free(MEMORY_REGION_GIF, gif);
 }
 
 static bool f_gif_open(gd_GIF * gif, const void * path, bool is_file)
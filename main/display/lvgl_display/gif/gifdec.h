@@ -24,6 +24,8 @@ typedef struct _gd_GCE {
 
 
 
+typedef struct _gd_LZW gd_LZW;
+
 typedef struct _gd_GIF {
     lv_fs_file_t fd;
     const char * data;
@@ -33,6 +35,7 @@ typedef struct _gd_GIF {
     uint16_t width, height;
     uint16_t depth;
     int32_t loop_count;
+    int32_t frame_index;    /* Index of the current frame in the loop, -1 before the first one */
     gd_GCE gce;
     gd_Palette * palette;
     gd_Palette lct, gct;
@@ -44,10 +47,16 @@ typedef struct _gd_GIF {
     void (*comment)(struct _gd_GIF * gif);
     void (*application)(struct _gd_GIF * gif, char id[8], char auth[3]);
     uint16_t fx, fy, fw, fh;
+    uint16_t dx, dy, dw, dh;        /* Canvas area changed by the last gd_get_frame and gd_render_frame */
     uint8_t bgindex;
     uint8_t * canvas, * frame;
+    lv_color_format_t color_format; /* ARGB8888, RGB565, or RGB565A8 (RGB565 plane followed by an A8 plane) */
+    const gd_Palette * palette565_src;
+    uint16_t palette565[0x100];     /* Current palette converted to RGB565, refreshed when the palette changes */
 #if LV_GIF_CACHE_DECODE_DATA
     uint8_t *lzw_cache;
+#else
+    gd_LZW * lzw;                   /* LZW table and scratch output, allocated on the first frame */
 #endif
 } gd_GIF;
 
@@ -55,6 +64,12 @@ gd_GIF * gd_open_gif_file(const char * fname);
 
 gd_GIF * gd_open_gif_data(const void * data);
 
+/* Open a GIF that renders straight into an RGB565 or RGB565A8 canvas instead of ARGB8888 */
+gd_GIF * gd_open_gif_data_cf(const void * data, lv_color_format_t color_format);
+
+/* Size of the canvas (and of a buffer passed to gd_render_frame) in bytes */
+uint32_t gd_canvas_size(const gd_GIF * gif);
+
 void gd_render_frame(gd_GIF * gif, uint8_t * buffer);
 
 int gd_get_frame(gd_GIF * gif);
@@ -4,29 +4,44 @@
 
 #define TAG "LvglGif"
 
-LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
+#if defined(CONFIG_GIF_COLOR_FORMAT_RGB565A8)
+#define GIF_COLOR_FORMAT LV_COLOR_FORMAT_RGB565A8
+#elif defined(CONFIG_GIF_COLOR_FORMAT_RGB565)
+#define GIF_COLOR_FORMAT LV_COLOR_FORMAT_RGB565
+#else
+#define GIF_COLOR_FORMAT LV_COLOR_FORMAT_ARGB8888
+#endif
+
+LvglGif::LvglGif(const lv_img_dsc_t* img_dsc, const char* cache_key)
     : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
     }
 
-    gif_ = gd_open_gif_data(img_dsc->data);
+    auto& cache = GifFrameCache::GetInstance();
+    if (cache_key != nullptr && cache.enabled()) {
+        cache_key_ = cache_key;
+        cache_source_ = img_dsc->data;
+        auto sequence = cache.Get(cache_key_, cache_source_);
+        if (sequence) {
+            SetupImageDsc(sequence->width(), sequence->height());
+            PlayFromSequence(sequence, sequence->loop_count());
+            loaded_ = true;
+            ESP_LOGD(TAG, "GIF %s played from cache", cache_key);
+            return;
+        }
+    }
+
+    gif_ = gd_open_gif_data_cf(img_dsc->data, GIF_COLOR_FORMAT);
     if (!gif_) {
         ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
         return;
     }
 
     // Setup LVGL image descriptor
-    memset(&img_dsc_, 0, sizeof(img_dsc_));
-    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
-    img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
-    img_dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
-    img_dsc_.header.w = gif_->width;
-    img_dsc_.header.h = gif_->height;
-    img_dsc_.header.stride = gif_->width * 4;
+    SetupImageDsc(gif_->width, gif_->height);
     img_dsc_.data = gif_->canvas;
-    img_dsc_.data_size = gif_->width * gif_->height * 4;
 
     // Render first frame
     if (gif_->canvas) {
@@ -42,6 +57,23 @@ LvglGif::~LvglGif() {
     Cleanup();
 }
 
+void LvglGif::SetupImageDsc(uint16_t width, uint16_t height) {
+    memset(&img_dsc_, 0, sizeof(img_dsc_));
+    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
+    img_dsc_.header.cf = GIF_COLOR_FORMAT;
+    img_dsc_.header.w = width;
+    img_dsc_.header.h = height;
+    if (GIF_COLOR_FORMAT == LV_COLOR_FORMAT_ARGB8888) {
+        img_dsc_.header.stride = width * 4;
+        img_dsc_.data_size = width * height * 4;
+    } else {
+        // RGB565A8 keeps its alpha plane after the RGB565 plane, with half the stride
+        img_dsc_.header.stride = width * 2;
+        img_dsc_.data_size = width * height * (GIF_COLOR_FORMAT == LV_COLOR_FORMAT_RGB565A8 ? 3 : 2);
+    }
+}
+
 // LvglImage interface implementation
 const lv_img_dsc_t* LvglGif::image_dsc() const {
     if (!loaded_) {
@@ -52,7 +84,7 @@ const lv_img_dsc_t* LvglGif::image_dsc() const {
 
 // Animation control methods
 void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_ || (!gif_ && !sequence_)) {
         ESP_LOGW(TAG, "GIF not loaded, cannot start");
         return;
     }
@@ -69,10 +101,10 @@ void LvglGif::Start() {
         last_call_ = lv_tick_get();
         lv_timer_resume(timer_);
         lv_timer_reset(timer_);
-        
+
         // Render first frame
         NextFrame();
-        
+
         ESP_LOGD(TAG, "GIF animation started");
     }
 }
@@ -86,7 +118,7 @@ void LvglGif::Pause() {
 }
 
 void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_ || (!gif_ && !sequence_)) {
         ESP_LOGW(TAG, "GIF not loaded, cannot resume");
         return;
     }
@@ -104,7 +136,12 @@ void LvglGif::Stop() {
         lv_timer_pause(timer_);
     }
 
-    if (gif_) {
+    if (sequence_) {
+        PlayFromSequence(sequence_, sequence_->loop_count());
+        ESP_LOGD(TAG, "GIF animation stopped and rewound");
+    } else if (gif_) {
+        // A partial recording cannot be continued after a rewind
+        recording_.reset();
         gd_rewind(gif_);
         NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
@@ -120,40 +157,167 @@ bool LvglGif::IsLoaded() const {
 }
 
 int32_t LvglGif::GetLoopCount() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return -1;
     }
-    return gif_->loop_count;
+    if (sequence_) {
+        return loops_left_;
+    }
+    return gif_ ? gif_->loop_count : -1;
 }
 
 void LvglGif::SetLoopCount(int32_t count) {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot set loop count");
         return;
     }
-    gif_->loop_count = count;
+    if (sequence_) {
+        loops_left_ = count;
+    } else if (gif_) {
+        gif_->loop_count = count;
+    }
 }
 
 uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->width;
+    return img_dsc_.header.w;
 }
 
 uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->height;
+    return img_dsc_.header.h;
 }
 
 void LvglGif::SetFrameCallback(std::function<void()> callback) {
     frame_callback_ = callback;
 }
 
+void LvglGif::SetChangedArea(const GifRect& rect) {
+    changed_area_.x1 = rect.x;
+    changed_area_.y1 = rect.y;
+    changed_area_.x2 = rect.x + rect.w - 1;
+    changed_area_.y2 = rect.y + rect.h - 1;
+}
+
+void LvglGif::InvalidateChangedArea(lv_obj_t* image) const {
+    lv_area_t coords;
+    lv_obj_get_coords(image, &coords);
+    // Only an unscaled image that exactly fits its object maps frame pixels 1:1 to the screen
+    if (lv_image_get_src(image) != &img_dsc_ || lv_image_get_scale(image) != LV_SCALE_NONE ||
+        lv_image_get_rotation(image) != 0 || lv_area_get_width(&coords) != img_dsc_.header.w ||
+        lv_area_get_height(&coords) != img_dsc_.header.h) {
+        lv_image_set_src(image, &img_dsc_);
+        return;
+    }
+    if (changed_area_.x2 < changed_area_.x1 || changed_area_.y2 < changed_area_.y1) {
+        return;
+    }
+
+    // Cached playback swaps the data pointer, do not let LVGL draw a stale cache entry
+    lv_image_cache_drop(&img_dsc_);
+    lv_area_t area = changed_area_;
+    lv_area_move(&area, coords.x1, coords.y1);
+    lv_obj_invalidate_area(image, &area);
+}
+
+void LvglGif::PlayFromSequence(std::shared_ptr<const GifFrameSequence> sequence, int32_t loops_left) {
+    sequence_ = std::move(sequence);
+    frame_pos_ = 0;
+    loops_left_ = loops_left;
+    img_dsc_.data = sequence_->frames()[0].data;
+    // Jumping to the first frame from anywhere, assume everything changed
+    SetChangedArea({0, 0, sequence_->width(), sequence_->height()});
+}
+
+void LvglGif::NextCachedFrame() {
+    auto& frames = sequence_->frames();
+    uint32_t elapsed = lv_tick_elaps(last_call_);
+    if (elapsed < frames[frame_pos_].delay_ms) {
+        return;
+    }
+    last_call_ = lv_tick_get();
+
+    if (frame_pos_ + 1 < frames.size()) {
+        frame_pos_++;
+    } else if (loops_left_ == 0 || loops_left_ > 1) {
+        // Same loop semantics as gd_get_frame: 0 loops forever, otherwise count down to 1
+        if (loops_left_ > 1) {
+            loops_left_--;
+        }
+        frame_pos_ = 0;
+    } else {
+        playing_ = false;
+        if (timer_) {
+            lv_timer_pause(timer_);
+        }
+        ESP_LOGD(TAG, "GIF animation completed");
+        return;
+    }
+
+    // Only a pointer swap, the frame was rendered when it was recorded
+    img_dsc_.data = frames[frame_pos_].data;
+    SetChangedArea(frames[frame_pos_].dirty);
+    if (frame_callback_) {
+        frame_callback_();
+    }
+}
+
+void LvglGif::RecordFrame(int has_next) {
+    if (has_next < 0) {
+        recording_.reset();
+        recording_failed_ = true;
+        return;
+    }
+
+    if (has_next == 1 && gif_->frame_index == 0) {
+        if (recording_ && !recording_->frames().empty()) {
+            // Back at the first frame, the whole loop is recorded. Publish it and stop decoding.
+            recording_->SetFirstFrameDirty({gif_->dx, gif_->dy, gif_->dw, gif_->dh});
+            std::shared_ptr<const GifFrameSequence> sequence = std::move(recording_);
+            GifFrameCache::GetInstance().Put(cache_key_, cache_source_, sequence);
+            int32_t loops_left = gif_->loop_count;
+            gd_close_gif(gif_);
+            gif_ = nullptr;
+            PlayFromSequence(sequence, loops_left);
+            // The first frame is what the decoder just rendered, so only the decoded area changed
+            SetChangedArea(sequence->frames()[0].dirty);
+            return;
+        }
+        recording_ = std::make_shared<GifFrameSequence>(gif_->width, gif_->height,
+            gd_canvas_size(gif_), gif_->loop_count);
+    }
+
+    if (!recording_) {
+        return;
+    }
+    if (has_next == 0) {
+        // Animation without looping, the last frame has been recorded already
+        GifFrameCache::GetInstance().Put(cache_key_, cache_source_, std::move(recording_));
+        return;
+    }
+    // Until the loop wraps, the first frame is only known to differ from the initial canvas
+    GifRect dirty = gif_->frame_index == 0 ? GifRect{0, 0, gif_->width, gif_->height}
+                                           : GifRect{gif_->dx, gif_->dy, gif_->dw, gif_->dh};
+    if (!GifFrameCache::GetInstance().AddFrame(*recording_, gif_->canvas, gif_->gce.delay * 10, dirty)) {
+        ESP_LOGW(TAG, "GIF %s does not fit in the frame cache", cache_key_.c_str());
+        recording_.reset();
+        recording_failed_ = true;
+    }
+}
+
 void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
+    if (!loaded_ || !playing_) {
+        return;
+    }
+    if (sequence_) {
+        NextCachedFrame();
+        return;
+    }
+    if (!gif_) {
         return;
     }
 
@@ -179,7 +343,13 @@ void LvglGif::NextFrame() {
     // Render current frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
-        
+        SetChangedArea({gif_->dx, gif_->dy, gif_->dw, gif_->dh});
+
+        // May close the decoder and switch to the recorded frames
+        if (!cache_key_.empty() && !recording_failed_) {
+            RecordFrame(has_next);
+        }
+
         // Call frame callback if set
         if (frame_callback_) {
             frame_callback_();
@@ -199,10 +369,12 @@ void LvglGif::Cleanup() {
         gd_close_gif(gif_);
         gif_ = nullptr;
     }
+    recording_.reset();
+    sequence_.reset();
 
     playing_ = false;
     loaded_ = false;
-    
+
     // Clear image descriptor
     memset(&img_dsc_, 0, sizeof(img_dsc_));
 }
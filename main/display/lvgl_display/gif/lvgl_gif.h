@@ -2,17 +2,26 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#include "gif_frame_cache.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
+#include <string>
 
 /**
  * C++ implementation of LVGL GIF widget
  * Provides GIF animation functionality using gifdec library
+ *
+ * With a cache key the first loop is decoded as usual and recorded into the
+ * GifFrameCache. From then on, and for every later LvglGif with the same key,
+ * frames are played back from the cache without decoding.
+ *
+ * The canvas LVGL draws is part of the gifdec state, which gd_open_gif_data_cf()
+ * allocates from the gif memory region, and cached frames come from the gif_cache region.
  */
 class LvglGif {
 public:
-    explicit LvglGif(const lv_img_dsc_t* img_dsc);
+    explicit LvglGif(const lv_img_dsc_t* img_dsc, const char* cache_key = nullptr);
     virtual ~LvglGif();
 
     // LvglImage interface implementation
@@ -69,6 +78,19 @@ public:
      */
     void SetFrameCallback(std::function<void()> callback);
 
+    /**
+     * Area of the image changed by the last frame, in image coordinates.
+     * Empty (x2 < x1) when the frame did not change any pixel.
+     */
+    const lv_area_t& changed_area() const { return changed_area_; }
+
+    /**
+     * Invalidate only the changed area of an image object showing this GIF, so
+     * LVGL re-renders and flushes just that region. Falls back to setting the
+     * source again when the image is scaled, rotated or not the GIF size.
+     */
+    void InvalidateChangedArea(lv_obj_t* image) const;
+
 private:
     // GIF decoder instance
     gd_GIF* gif_;
@@ -88,11 +110,29 @@ private:
     
     // Frame update callback
     std::function<void()> frame_callback_;
-    
+
+    // Area changed by the last frame
+    lv_area_t changed_area_ = {0, 0, -1, -1};
+
+    // Frame cache
+    std::string cache_key_;
+    const void* cache_source_ = nullptr;
+    std::shared_ptr<const GifFrameSequence> sequence_;   // Set when playing from the cache
+    std::shared_ptr<GifFrameSequence> recording_;        // First loop being recorded
+    bool recording_failed_ = false;
+    size_t frame_pos_ = 0;
+    int32_t loops_left_ = 0;
+
+    void SetupImageDsc(uint16_t width, uint16_t height);
+    void SetChangedArea(const GifRect& rect);
+
     /**
      * Update to next frame
      */
     void NextFrame();
+    void NextCachedFrame();
+    void RecordFrame(int has_next);
+    void PlayFromSequence(std::shared_ptr<const GifFrameSequence> sequence, int32_t loops_left);
     
     /**
      * Cleanup resources
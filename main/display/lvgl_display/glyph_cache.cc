@@ -0,0 +1,303 @@
+#include "glyph_cache.h"
+#include "arena_allocator.h"
+
+#include <cstring>
+#include <esp_log.h>
+
+#define TAG "GlyphCache"
+
+static bool IsBitmapGlyph(const lv_font_glyph_dsc_t* dsc) {
+    return dsc->format >= LV_FONT_GLYPH_FORMAT_A1 && dsc->format <= LV_FONT_GLYPH_FORMAT_A8;
+}
+
+static size_t HashKey(const void* font, uint32_t glyph) {
+    return (reinterpret_cast<uintptr_t>(font) >> 4) ^ (glyph * 0x9E3779B1u);
+}
+
+static const lv_font_t* AttachedFont(const lv_font_t* cached_font) {
+    return static_cast<const lv_font_t*>(cached_font->user_data);
+}
+
+GlyphCache::GlyphCache() {
+    region_ = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_GLYPH_CACHE);
+    if (region_ == nullptr) {
+        return;
+    }
+    // About one bucket per glyph, a CJK glyph with its entry is a few hundred bytes
+    size_t buckets = 64;
+    while (buckets < region_->budget() / 256) {
+        buckets *= 2;
+    }
+    buckets_.assign(buckets, nullptr);
+}
+
+size_t GlyphCache::budget() const {
+    return region_ != nullptr ? region_->budget() : 0;
+}
+
+uint32_t GlyphCache::hits() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint32_t GlyphCache::misses() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+lv_font_t* GlyphCache::AttachFont(const lv_font_t* font) {
+    // Fonts with raw A8 bitmaps in memory are drawn without decoding
+    if (!enabled() || font == nullptr || font->static_bitmap || font->get_glyph_bitmap == nullptr) {
+        return nullptr;
+    }
+    auto cached_font = new lv_font_t(*font);
+    cached_font->get_glyph_dsc = GetGlyphDsc;
+    cached_font->get_glyph_bitmap = GetGlyphBitmap;
+    cached_font->release_glyph = font->release_glyph != nullptr ? ReleaseGlyph : nullptr;
+    cached_font->user_data = const_cast<lv_font_t*>(font);
+    return cached_font;
+}
+
+void GlyphCache::DetachFont(lv_font_t* cached_font) {
+    if (cached_font == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto font = AttachedFont(cached_font);
+        for (size_t i = 0; i < buckets_.size(); i++) {
+            Entry** slot = &buckets_[i];
+            while (*slot != nullptr) {
+                if ((*slot)->key.font == font) {
+                    Remove(slot);
+                } else {
+                    slot = &(*slot)->chain;
+                }
+            }
+        }
+    }
+    delete cached_font;
+}
+
+size_t GlyphCache::Prefill(const lv_font_t* cached_font, const uint32_t* codepoints, size_t count) {
+    if (cached_font == nullptr || cached_font->get_glyph_bitmap != GetGlyphBitmap) {
+        return 0;
+    }
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        lv_font_glyph_dsc_t dsc;
+        memset(&dsc, 0, sizeof(dsc));
+        if (!GetGlyphDsc(cached_font, &dsc, codepoints[i], 0)) {
+            continue;
+        }
+        dsc.resolved_font = cached_font;
+        if (!IsBitmapGlyph(&dsc) || dsc.box_w == 0 || dsc.box_h == 0) {
+            continue;
+        }
+        // Stop once the region is full rather than evict glyphs prefilled a moment ago
+        size_t before;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (region_->used() + sizeof(Entry) + dsc.box_w * dsc.box_h > region_->budget()) {
+                break;
+            }
+            before = entries_;
+        }
+        // The same A8 buffer the label renderer decodes into
+        lv_draw_buf_t* draw_buf = lv_draw_buf_create(dsc.box_w, dsc.box_h, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+        if (draw_buf == nullptr) {
+            break;
+        }
+        DrawGlyph(&dsc, draw_buf, false);
+        lv_draw_buf_destroy(draw_buf);
+        std::lock_guard<std::mutex> lock(mutex_);
+        added += entries_ > before ? 1 : 0;
+    }
+    ESP_LOGI(TAG, "Prefilled %u glyphs, %u / %u bytes", added, region_->used(), region_->budget());
+    return added;
+}
+
+bool GlyphCache::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto attached = AttachedFont(font);
+    return attached->get_glyph_dsc(attached, dsc, letter, letter_next);
+}
+
+const void* GlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    return GetInstance().DrawGlyph(dsc, draw_buf, true);
+}
+
+void GlyphCache::ReleaseGlyph(const lv_font_t* font, lv_font_glyph_dsc_t* dsc) {
+    auto attached = AttachedFont(font);
+    dsc->resolved_font = attached;
+    attached->release_glyph(attached, dsc);
+    dsc->resolved_font = font;
+}
+
+const void* GlyphCache::DrawGlyph(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf, bool count) {
+    auto font = dsc->resolved_font;
+    auto attached = AttachedFont(font);
+    Key key = {attached, dsc->gid.index};
+    bool cacheable = draw_buf != nullptr && !dsc->req_raw_bitmap && IsBitmapGlyph(dsc);
+    if (cacheable) {
+        auto bitmap = Lookup(key, draw_buf, dsc->box_h);
+        if (bitmap != nullptr) {
+            return bitmap;
+        }
+    }
+
+    // The attached font reads its own descriptor through resolved_font
+    dsc->resolved_font = attached;
+    auto bitmap = attached->get_glyph_bitmap(dsc, draw_buf);
+    dsc->resolved_font = font;
+
+    if (cacheable && bitmap != nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count) {
+            misses_++;
+        }
+        if (bitmap == draw_buf || bitmap == draw_buf->data) {
+            Insert(key, draw_buf, dsc->box_h, bitmap == draw_buf->data);
+        } else {
+            bypasses_++;
+        }
+    }
+    return bitmap;
+}
+
+const void* GlyphCache::Lookup(const Key& key, lv_draw_buf_t* draw_buf, uint16_t height) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry** slot = Find(key);
+    if (slot == nullptr) {
+        return nullptr;
+    }
+    Entry* entry = *slot;
+    // A differently shaped buffer is decoded again and replaces the entry
+    size_t size = (size_t)entry->stride * entry->height;
+    if (entry->stride != draw_buf->header.stride || entry->height != height || size > draw_buf->data_size) {
+        return nullptr;
+    }
+    memcpy(draw_buf->data, entry->bitmap(), size);
+    MoveToFront(entry);
+    hits_++;
+    return entry->returns_data ? static_cast<const void*>(draw_buf->data) : draw_buf;
+}
+
+void GlyphCache::Insert(const Key& key, const lv_draw_buf_t* draw_buf, uint16_t height, bool returns_data) {
+    size_t size = (size_t)draw_buf->header.stride * height;
+    size_t bytes = sizeof(Entry) + size;
+    if (bytes > region_->budget() || size > draw_buf->data_size) {
+        bypasses_++;
+        return;
+    }
+    Entry** slot = Find(key);
+    if (slot != nullptr) {
+        Remove(slot);
+    }
+    EvictUntil(bytes);
+
+    // The heap rounds the block up and the region counts the rounded size, so the
+    // allocation can still be over budget after evicting for the requested size
+    auto entry = static_cast<Entry*>(region_->Allocate(bytes));
+    while (entry == nullptr && tail_ != nullptr) {
+        Remove(Find(tail_->key));
+        evictions_++;
+        entry = static_cast<Entry*>(region_->Allocate(bytes));
+    }
+    if (entry == nullptr) {
+        bypasses_++;
+        return;
+    }
+    entry->key = key;
+    entry->stride = draw_buf->header.stride;
+    entry->height = height;
+    entry->returns_data = returns_data;
+    memcpy(entry->bitmap(), draw_buf->data, size);
+
+    size_t bucket = HashKey(key.font, key.glyph) & (buckets_.size() - 1);
+    entry->chain = buckets_[bucket];
+    buckets_[bucket] = entry;
+    entry->prev = nullptr;
+    entry->next = head_;
+    if (head_ != nullptr) {
+        head_->prev = entry;
+    }
+    head_ = entry;
+    if (tail_ == nullptr) {
+        tail_ = entry;
+    }
+    entries_++;
+}
+
+GlyphCache::Entry** GlyphCache::Find(const Key& key) {
+    if (buckets_.empty()) {
+        return nullptr;
+    }
+    Entry** slot = &buckets_[HashKey(key.font, key.glyph) & (buckets_.size() - 1)];
+    while (*slot != nullptr) {
+        if ((*slot)->key.font == key.font && (*slot)->key.glyph == key.glyph) {
+            return slot;
+        }
+        slot = &(*slot)->chain;
+    }
+    return nullptr;
+}
+
+void GlyphCache::MoveToFront(Entry* entry) {
+    if (entry == head_) {
+        return;
+    }
+    Unlink(entry);
+    entry->prev = nullptr;
+    entry->next = head_;
+    head_->prev = entry;
+    head_ = entry;
+}
+
+void GlyphCache::Unlink(Entry* entry) {
+    if (entry->prev != nullptr) {
+        entry->prev->next = entry->next;
+    } else {
+        head_ = entry->next;
+    }
+    if (entry->next != nullptr) {
+        entry->next->prev = entry->prev;
+    } else {
+        tail_ = entry->prev;
+    }
+}
+
+void GlyphCache::Remove(Entry** slot) {
+    Entry* entry = *slot;
+    *slot = entry->chain;
+    Unlink(entry);
+    entries_--;
+    region_->Free(entry);
+}
+
+void GlyphCache::EvictUntil(size_t bytes_needed) {
+    while (tail_ != nullptr && region_->used() + bytes_needed > region_->budget()) {
+        Entry** slot = Find(tail_->key);
+        Remove(slot);
+        evictions_++;
+    }
+}
+
+void GlyphCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (tail_ != nullptr) {
+        Remove(Find(tail_->key));
+    }
+}
+
+cJSON* GlyphCache::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "budget", budget());
+    cJSON_AddNumberToObject(json, "used", region_ != nullptr ? region_->used() : 0);
+    cJSON_AddNumberToObject(json, "entries", entries_);
+    cJSON_AddNumberToObject(json, "hits", hits_);
+    cJSON_AddNumberToObject(json, "misses", misses_);
+    cJSON_AddNumberToObject(json, "evictions", evictions_);
+    cJSON_AddNumberToObject(json, "bypasses", bypasses_);
+    return json;
+}
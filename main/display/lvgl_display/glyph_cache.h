@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <lvgl.h>
+#include <cJSON.h>
+
+class MemoryRegion;
+
+/**
+ * LRU cache of decoded glyph bitmaps for fonts loaded from the assets partition.
+ * CBin fonts keep their glyphs packed in flash, so every draw of a character
+ * decodes it again. A font attached to the cache draws repeated characters by
+ * copying the bitmap decoded the first time. Bitmaps are allocated from the
+ * glyph_cache memory region and keyed by font (one per size) and glyph index.
+ * The region's used size, which counts what the heap allocated, is what the
+ * cache keeps within the budget.
+ */
+class GlyphCache {
+public:
+    static GlyphCache& GetInstance() {
+        static GlyphCache instance;
+        return instance;
+    }
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    bool enabled() const { return region_ != nullptr; }
+    size_t budget() const;
+
+    // A font with the metrics of font that draws through the cache, or nullptr if the cache
+    // is disabled or would not help. Release it with DetachFont() before font is deleted.
+    lv_font_t* AttachFont(const lv_font_t* font);
+    void DetachFont(lv_font_t* cached_font);
+    // Decode the glyphs of the codepoints into the cache, most frequent first, until the
+    // budget is full. Returns the number of glyphs added.
+    size_t Prefill(const lv_font_t* cached_font, const uint32_t* codepoints, size_t count);
+    void Clear();
+
+    uint32_t hits();
+    uint32_t misses();
+    // The caller owns the returned object
+    cJSON* GetStatsJson();
+
+private:
+    GlyphCache();
+    ~GlyphCache() = default;
+
+    struct Key {
+        const lv_font_t* font;
+        uint32_t glyph;
+    };
+    // Lives at the start of its bitmap's allocation. A chat screen touches hundreds of
+    // glyphs, so the bookkeeping stays in the glyph_cache region instead of internal RAM.
+    struct Entry {
+        Entry* prev;        // LRU list, most recently used first
+        Entry* next;
+        Entry* chain;       // Next entry in the same hash bucket
+        Key key;
+        uint32_t stride;
+        uint16_t height;
+        bool returns_data;  // The font returned draw_buf->data rather than draw_buf
+        uint8_t* bitmap() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    static void ReleaseGlyph(const lv_font_t* font, lv_font_glyph_dsc_t* dsc);
+
+    // Serve the bitmap from the cache or decode it with the attached font and keep it
+    const void* DrawGlyph(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf, bool count);
+    // Copy a cached bitmap into draw_buf, nullptr on a miss
+    const void* Lookup(const Key& key, lv_draw_buf_t* draw_buf, uint16_t height);
+    // The methods below must be called with mutex_ held
+    void Insert(const Key& key, const lv_draw_buf_t* draw_buf, uint16_t height, bool returns_data);
+    Entry** Find(const Key& key);
+    void MoveToFront(Entry* entry);
+    void Unlink(Entry* entry);
+    void Remove(Entry** slot);
+    void EvictUntil(size_t bytes_needed);
+
+    MemoryRegion* region_ = nullptr;
+    std::mutex mutex_;
+    Entry* head_ = nullptr;
+    Entry* tail_ = nullptr;
+    std::vector<Entry*> buckets_;
+    size_t entries_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
+    uint32_t bypasses_ = 0;     // Bitmaps the cache could not hold, drawn by the font itself
+};
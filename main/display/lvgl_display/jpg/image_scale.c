@@ -0,0 +1,296 @@
+#include "image_scale.h"
+
+#include <string.h>
+#include <linux/videodev2.h>
+
+// 输出像素 i 对应的源区域为 [start + i * src_len / dst_len, start + (i + 1) * src_len / dst_len)，
+// 输出不大于裁剪区域，所以每个区域至少一个像素。平均值按四舍五入取整，YUYV 先平均再转换为 RGB，
+// 颜色转换的次数只和输出像素数有关
+
+static inline uint8_t expand_5_to_8(uint32_t v) {
+    return (uint8_t)((v << 3) | (v >> 2));
+}
+
+static inline uint8_t expand_6_to_8(uint32_t v) {
+    return (uint8_t)((v << 2) | (v >> 4));
+}
+
+static inline uint8_t clamp_u8(int v) {
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+static inline int box_start(int start, int src_len, int dst_len, int i) {
+    return start + (int)((int64_t)i * src_len / dst_len);
+}
+
+// 依次给出输出列的源区域边界，不做除法：边界 = start + (i + 1) * src_len / dst_len
+typedef struct {
+    int next;       // 当前输出列的结束位置
+    int step;
+    int step_rem;
+    int rem;
+    int dst_len;
+} box_walker_t;
+
+static inline void box_walker_init(box_walker_t *w, int start, int src_len, int dst_len) {
+    w->step = src_len / dst_len;
+    w->step_rem = src_len % dst_len;
+    w->dst_len = dst_len;
+    w->next = start + w->step;
+    w->rem = w->step_rem;
+}
+
+static inline void box_walker_advance(box_walker_t *w) {
+    w->next += w->step;
+    w->rem += w->step_rem;
+    if (w->rem >= w->dst_len) {
+        w->rem -= w->dst_len;
+        w->next++;
+    }
+}
+
+static inline int channels_of(uint32_t format) {
+    return format == V4L2_PIX_FMT_GREY ? 1 : 3;
+}
+
+// 读取源像素的各通道：RGB565/RGB24 为 R G B，YUYV 为 Y Cb Cr，GREY 为 Y
+static inline void read_pixel(const image_scaler_t *s, const uint8_t *row, int x, uint32_t *c) {
+    switch (s->format) {
+        case V4L2_PIX_FMT_RGB565: {
+            uint32_t v = row[x * 2] | (uint32_t)row[x * 2 + 1] << 8;
+            c[0] = expand_5_to_8(v >> 11);
+            c[1] = expand_6_to_8((v >> 5) & 0x3F);
+            c[2] = expand_5_to_8(v & 0x1F);
+            break;
+        }
+        case V4L2_PIX_FMT_RGB24:
+            c[0] = row[x * 3];
+            c[1] = row[x * 3 + 1];
+            c[2] = row[x * 3 + 2];
+            break;
+        case V4L2_PIX_FMT_YUYV: {
+            const uint8_t *pair = row + (x & ~1) * 2;
+            c[0] = row[x * 2];
+            c[1] = pair[1];
+            c[2] = pair[3];
+            break;
+        }
+        default:
+            c[0] = row[x];
+            break;
+    }
+}
+
+// 区域平均的除数。区域小于 4096 像素时用倒数相乘代替除法：和不超过 256 * count，
+// ceil(2^32 / count) 的误差不会改变商
+typedef struct {
+    uint32_t count;
+    uint64_t inverse;   // 0 表示直接除
+} box_divisor_t;
+
+static inline void box_divisor_set(box_divisor_t *d, uint32_t count, bool use_inverse) {
+    d->count = count;
+    d->inverse = use_inverse && count < 4096 ? ((1ULL << 32) + count - 1) / count : 0;
+}
+
+static inline int box_average(uint32_t sum, const box_divisor_t *d) {
+    uint32_t n = sum + d->count / 2;
+    return (int)(d->inverse ? (uint32_t)((n * d->inverse) >> 32) : n / d->count);
+}
+
+// 区域的通道和写成输出像素
+static inline void write_pixel(uint32_t format, const uint32_t *sum, const box_divisor_t *d, uint8_t *dst) {
+    if (format == V4L2_PIX_FMT_GREY) {
+        dst[0] = (uint8_t)box_average(sum[0], d);
+        return;
+    }
+    int c0 = box_average(sum[0], d);
+    int c1 = box_average(sum[1], d);
+    int c2 = box_average(sum[2], d);
+    if (format != V4L2_PIX_FMT_YUYV) {
+        dst[0] = (uint8_t)c0;
+        dst[1] = (uint8_t)c1;
+        dst[2] = (uint8_t)c2;
+        return;
+    }
+    // JPEG (BT.601 全范围) YCbCr -> RGB，16 位定点
+    int cb = c1 - 128;
+    int cr = c2 - 128;
+    dst[0] = clamp_u8(c0 + ((91881 * cr + 32768) >> 16));
+    dst[1] = clamp_u8(c0 + ((-22554 * cb - 46802 * cr + 32768) >> 16));
+    dst[2] = clamp_u8(c0 + ((116130 * cb + 32768) >> 16));
+}
+
+static size_t row_stride(const image_scaler_t *s) {
+    switch (s->format) {
+        case V4L2_PIX_FMT_RGB24:
+            return (size_t)s->src_width * 3;
+        case V4L2_PIX_FMT_GREY:
+            return s->src_width;
+        default:
+            return (size_t)s->src_width * 2;
+    }
+}
+
+bool image_scale_supported(uint32_t format) {
+    return format == V4L2_PIX_FMT_RGB565 || format == V4L2_PIX_FMT_RGB24 || format == V4L2_PIX_FMT_YUYV ||
+           format == V4L2_PIX_FMT_GREY;
+}
+
+uint32_t image_scale_output_format(uint32_t format) {
+    return format == V4L2_PIX_FMT_GREY ? V4L2_PIX_FMT_GREY : V4L2_PIX_FMT_RGB24;
+}
+
+size_t image_scale_acc_size(uint16_t dst_width) {
+    return (size_t)dst_width * 3 * sizeof(uint32_t);
+}
+
+bool image_scale_init(image_scaler_t *scaler, const uint8_t *src, uint16_t src_width, uint16_t src_height,
+                      uint32_t format, uint16_t crop_x, uint16_t crop_y, uint16_t crop_width, uint16_t crop_height,
+                      uint16_t dst_width, uint16_t dst_height, uint32_t *acc) {
+    if (!image_scale_supported(format) || crop_width == 0 || crop_height == 0 || dst_width == 0 || dst_height == 0) {
+        return false;
+    }
+    if ((int)crop_x + crop_width > src_width || (int)crop_y + crop_height > src_height) {
+        return false;
+    }
+    if (dst_width > crop_width || dst_height > crop_height) {
+        return false;
+    }
+    scaler->src = src;
+    scaler->src_width = src_width;
+    scaler->src_height = src_height;
+    scaler->format = format;
+    scaler->crop_x = crop_x;
+    scaler->crop_y = crop_y;
+    scaler->crop_width = crop_width;
+    scaler->crop_height = crop_height;
+    scaler->dst_width = dst_width;
+    scaler->dst_height = dst_height;
+    scaler->acc = acc;
+    return true;
+}
+
+void image_scale_rows_ref(const image_scaler_t *s, int y, int lines, uint8_t *dst) {
+    int channels = channels_of(s->format);
+    size_t stride = row_stride(s);
+    for (int r = y; r < y + lines; r++) {
+        int y0 = box_start(s->crop_y, s->crop_height, s->dst_height, r);
+        int y1 = box_start(s->crop_y, s->crop_height, s->dst_height, r + 1);
+        for (int i = 0; i < s->dst_width; i++) {
+            int x0 = box_start(s->crop_x, s->crop_width, s->dst_width, i);
+            int x1 = box_start(s->crop_x, s->crop_width, s->dst_width, i + 1);
+            uint32_t sum[3] = {0, 0, 0};
+            for (int sy = y0; sy < y1; sy++) {
+                const uint8_t *row = s->src + (size_t)sy * stride;
+                for (int sx = x0; sx < x1; sx++) {
+                    uint32_t c[3];
+                    read_pixel(s, row, sx, c);
+                    for (int k = 0; k < channels; k++) {
+                        sum[k] += c[k];
+                    }
+                }
+            }
+            box_divisor_t d;
+            box_divisor_set(&d, (uint32_t)((y1 - y0) * (x1 - x0)), false);
+            write_pixel(s->format, sum, &d, dst);
+            dst += channels;
+        }
+    }
+}
+
+// 把一行源像素按输出列累加到 acc，源数据顺序读取一遍
+static void accumulate_row(const image_scaler_t *s, const uint8_t *row, uint32_t *acc) {
+    int end = s->crop_x + s->crop_width;
+    box_walker_t box;
+    box_walker_init(&box, s->crop_x, s->crop_width, s->dst_width);
+    switch (s->format) {
+        case V4L2_PIX_FMT_RGB565:
+            for (int x = s->crop_x; x < end; x++) {
+                if (x == box.next) {
+                    acc += 3;
+                    box_walker_advance(&box);
+                }
+                uint32_t v = row[x * 2] | (uint32_t)row[x * 2 + 1] << 8;
+                acc[0] += expand_5_to_8(v >> 11);
+                acc[1] += expand_6_to_8((v >> 5) & 0x3F);
+                acc[2] += expand_5_to_8(v & 0x1F);
+            }
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            for (int x = s->crop_x; x < end; x++) {
+                if (x == box.next) {
+                    acc += 3;
+                    box_walker_advance(&box);
+                }
+                const uint8_t *p = row + x * 3;
+                acc[0] += p[0];
+                acc[1] += p[1];
+                acc[2] += p[2];
+            }
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            for (int x = s->crop_x; x < end; x++) {
+                if (x == box.next) {
+                    acc += 3;
+                    box_walker_advance(&box);
+                }
+                const uint8_t *pair = row + (x & ~1) * 2;
+                acc[0] += row[x * 2];
+                acc[1] += pair[1];
+                acc[2] += pair[3];
+            }
+            break;
+        default:
+            for (int x = s->crop_x; x < end; x++) {
+                if (x == box.next) {
+                    acc += 1;
+                    box_walker_advance(&box);
+                }
+                acc[0] += row[x];
+            }
+            break;
+    }
+}
+
+void image_scale_rows(const image_scaler_t *s, int y, int lines, uint8_t *dst) {
+    int channels = channels_of(s->format);
+    size_t stride = row_stride(s);
+    for (int r = y; r < y + lines; r++) {
+        int y0 = box_start(s->crop_y, s->crop_height, s->dst_height, r);
+        int y1 = box_start(s->crop_y, s->crop_height, s->dst_height, r + 1);
+        memset(s->acc, 0, (size_t)s->dst_width * channels * sizeof(uint32_t));
+        for (int sy = y0; sy < y1; sy++) {
+            accumulate_row(s, s->src + (size_t)sy * stride, s->acc);
+        }
+        const uint32_t *acc = s->acc;
+        box_walker_t box;
+        box_walker_init(&box, s->crop_x, s->crop_width, s->dst_width);
+        // 一行里区域宽度只有 step 和 step + 1 两种
+        box_divisor_t narrow, wide;
+        box_divisor_set(&narrow, (uint32_t)((y1 - y0) * box.step), true);
+        box_divisor_set(&wide, (uint32_t)((y1 - y0) * (box.step + 1)), true);
+        int x0 = s->crop_x;
+        for (int i = 0; i < s->dst_width; i++) {
+            write_pixel(s->format, acc, box.next - x0 == box.step ? &narrow : &wide, dst);
+            acc += channels;
+            dst += channels;
+            x0 = box.next;
+            box_walker_advance(&box);
+        }
+    }
+}
+
+void image_scale_fit(uint16_t width, uint16_t height, uint16_t max_side, uint16_t *out_width, uint16_t *out_height) {
+    uint16_t longest = width > height ? width : height;
+    if (max_side == 0 || longest <= max_side) {
+        *out_width = width;
+        *out_height = height;
+        return;
+    }
+    // 四舍五入，短边至少 1 像素
+    uint32_t w = ((uint32_t)width * max_side + longest / 2) / longest;
+    uint32_t h = ((uint32_t)height * max_side + longest / 2) / longest;
+    *out_width = (uint16_t)(w > 0 ? w : 1);
+    *out_height = (uint16_t)(h > 0 ? h : 1);
+}
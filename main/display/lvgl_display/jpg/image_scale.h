@@ -0,0 +1,50 @@
+// image_scale.h - JPEG 编码前的裁剪和缩小
+// 按区域平均（box 滤波）缩小，同时完成像素格式转换：RGB565 小端、RGB888、YUYV 输出 RGB888，GREY 输出 GREY。
+// 逐行累加的实现（image_scale_rows）和逐像素的参考实现（_ref）输出必须逐字节一致
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const uint8_t *src;
+    uint16_t src_width;
+    uint16_t src_height;
+    uint32_t format;            // 源图像格式 V4L2_PIX_FMT_*
+    // 裁剪区域，源图像像素坐标
+    uint16_t crop_x;
+    uint16_t crop_y;
+    uint16_t crop_width;
+    uint16_t crop_height;
+    // 输出尺寸，不大于裁剪区域
+    uint16_t dst_width;
+    uint16_t dst_height;
+    uint32_t *acc;              // image_scale_acc_size() 字节的行累加缓冲区
+} image_scaler_t;
+
+// 支持的源格式：RGB565、RGB24、YUYV、GREY
+bool image_scale_supported(uint32_t format);
+// 输出格式：GREY 输入输出 GREY，其余输出 RGB24
+uint32_t image_scale_output_format(uint32_t format);
+size_t image_scale_acc_size(uint16_t dst_width);
+
+// 检查参数并填写 scaler，裁剪区域超出源图像或输出大于裁剪区域时返回 false
+bool image_scale_init(image_scaler_t *scaler, const uint8_t *src, uint16_t src_width, uint16_t src_height,
+                      uint32_t format, uint16_t crop_x, uint16_t crop_y, uint16_t crop_width, uint16_t crop_height,
+                      uint16_t dst_width, uint16_t dst_height, uint32_t *acc);
+
+// 输出第 [y, y + lines) 行到 dst，行间距为 dst_width * 输出每像素字节数
+void image_scale_rows(const image_scaler_t *scaler, int y, int lines, uint8_t *dst);
+void image_scale_rows_ref(const image_scaler_t *scaler, int y, int lines, uint8_t *dst);
+
+// 保持宽高比缩小到最长边不超过 max_side，max_side 为 0 或图像已经足够小时不缩小
+void image_scale_fit(uint16_t width, uint16_t height, uint16_t max_side, uint16_t *out_width, uint16_t *out_height);
+
+#ifdef __cplusplus
+}
+#endif
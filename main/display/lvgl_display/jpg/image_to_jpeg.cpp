@@ -3,6 +3,7 @@
 #include <esp_log.h>
 #include <stddef.h>
 #include <string.h>
+#include <mutex>
 
 #include "esp_jpeg_common.h"
 #include "esp_jpeg_enc.h"
@@ -10,153 +11,160 @@
 #include "driver/jpeg_encode.h"
 #endif
 #include "image_to_jpeg.h"
+#include "pixel_convert.h"
+#include "image_scale.h"
+#include "arena_allocator.h"
 
 #define TAG "image_to_jpeg"
 
-static void* malloc_psram(size_t size) {
-    void* p = malloc(size);
-    if (p)
-        return p;
-#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
-    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-#else
-    return NULL;
-#endif
+// MCU 行的临时缓冲区从 jpeg 内存区域分配（优先 PSRAM），避免占用内部 RAM 造成碎片
+static MemoryRegion& jpeg_region() {
+    static MemoryRegion* region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_JPEG);
+    return *region;
 }
 
-static __always_inline uint8_t expand_5_to_8(uint8_t v) {
-    return (uint8_t)((v << 3) | (v >> 2));
+// 整帧大小、编码完即释放的缓冲区来自不限额的 jpeg_frame 区域。它们的大小随图像变化，
+// 例如 800x600 的 RGB565 整帧编码需要 1.44MB 输入和 0.78MB 输出，超过 jpeg 区域的预算
+static MemoryRegion& frame_region() {
+    static MemoryRegion* region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_JPEG_FRAME);
+    return *region;
 }
 
-static __always_inline uint8_t expand_6_to_8(uint8_t v) {
-    return (uint8_t)((v << 2) | (v >> 4));
+static void* frame_buf_alloc(size_t size) {
+    // esp_new_jpeg 要求输入缓冲区 16 字节对齐
+    return frame_region().Allocate(size, 16);
 }
 
-static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
-                                             jpeg_pixel_format_t* out_fmt, int* out_size) {
-    // 直接支持的格式：GRAY、RGB888、YCbYCr(YUYV)
-    if (format == V4L2_PIX_FMT_GREY) {
-        int sz = (int)width * (int)height;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        memcpy(buf, src, sz);
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_GRAY;
-        if (out_size)
-            *out_size = sz;
-        return buf;
-    }
+static void frame_buf_free(void* p) {
+    frame_region().Free(p);
+}
 
-    // V4L2 YUYV (Y Cb Y Cr) 可直接作为 JPEG_PIXEL_FORMAT_YCbYCr 输入
-    if (format == V4L2_PIX_FMT_YUYV) {
-        int sz = (int)width * (int)height * 2;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        memcpy(buf, src, sz);
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+static size_t align16(size_t size) {
+    return (size + 15) & ~(size_t)15;
+}
+
+// 按 MCU 行编码时的转换缓冲区和输出缓冲区在两次编码之间保留，只在需要更大时重新分配，
+// 连续拍照或截图不再每次都向堆申请
+static std::mutex& scratch_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static MemoryArena& scratch_arena() {
+    static MemoryArena arena(jpeg_region());
+    return arena;
+}
+
+// 独占共享的临时缓冲区；另一个编码正在使用时退回到只属于本次调用的缓冲区
+class JpegScratch {
+public:
+    JpegScratch() : lock_(scratch_mutex(), std::try_to_lock), local_(jpeg_region()) {}
+    ~JpegScratch() { arena().Reset(); }
+
+    MemoryArena& arena() { return lock_.owns_lock() ? scratch_arena() : local_; }
+
+private:
+    std::unique_lock<std::mutex> lock_;
+    MemoryArena local_;
+};
+
+void image_to_jpeg_release_buffers(void) {
+    std::lock_guard<std::mutex> lock(scratch_mutex());
+    scratch_arena().Release();
+}
+
+// 软件编码器的输入格式：GRAY、YCbYCr(YUYV) 直接输入，其余格式转换为 RGB888
+static jpeg_pixel_format_t encoder_input_format(v4l2_pix_fmt_t format, int* bytes_per_pixel) {
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+            *bytes_per_pixel = 1;
+            return JPEG_PIXEL_FORMAT_GRAY;
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_YUV422P:
+            *bytes_per_pixel = 2;
+            return JPEG_PIXEL_FORMAT_YCbYCr;
+        default:
+            *bytes_per_pixel = 3;
+            return JPEG_PIXEL_FORMAT_RGB888;
     }
+}
 
-    // V4L2 UYVY (Cb Y Cr Y) -> 重排为 YUYV 再作为 YCbYCr 输入
-    if (format == V4L2_PIX_FMT_UYVY) {
-        int sz = (int)width * (int)height * 2;
-        const uint8_t* s = src;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        uint8_t* d = buf;
-        for (int i = 0; i < sz; i += 4) {
-            // src: Cb, Y0, Cr, Y1 -> dst: Y0, Cb, Y1, Cr
-            d[0] = s[1];
-            d[1] = s[0];
-            d[2] = s[3];
-            d[3] = s[2];
-            s += 4;
-            d += 4;
-        }
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+// 源数据已经是编码器格式且满足对齐要求时直接交给编码器，不再复制
+static bool can_encode_in_place(const uint8_t* src, v4l2_pix_fmt_t format) {
+    bool direct = format == V4L2_PIX_FMT_GREY || format == V4L2_PIX_FMT_YUYV || format == V4L2_PIX_FMT_RGB24;
+    return direct && ((uintptr_t)src & 15) == 0;
+}
+
+// 源图像按格式至少应有的字节数，未知格式返回 0
+static size_t source_size(uint16_t width, uint16_t height, v4l2_pix_fmt_t format) {
+    size_t pixels = (size_t)width * height;
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+            return pixels;
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_YUV422P:
+        case V4L2_PIX_FMT_RGB565:
+            return pixels * 2;
+        case V4L2_PIX_FMT_RGB24:
+            return pixels * 3;
+        default:
+            return 0;
     }
+}
 
-    // V4L2 YUV422P (YUV422 Planar) -> 重排为 YUYV (YCbYCr)
-    if (format == V4L2_PIX_FMT_YUV422P) {
-        int sz = (int)width * (int)height * 2;
-        const uint8_t* y_plane = src;
-        const uint8_t* u_plane = y_plane + (int)width * (int)height;
-        const uint8_t* v_plane = u_plane + ((int)width / 2) * (int)height;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        uint8_t* dst = buf;
-        for (int y = 0; y < height; y++) {
-            const uint8_t* y_row = y_plane + y * (int)width;
-            const uint8_t* u_row = u_plane + y * ((int)width / 2);
-            const uint8_t* v_row = v_plane + y * ((int)width / 2);
-            for (int x = 0; x < width; x += 2) {
-                uint8_t y0 = y_row[x + 0];
-                uint8_t y1 = y_row[x + 1];
-                uint8_t cb = u_row[x / 2];
-                uint8_t cr = v_row[x / 2];
-                dst[0] = y0;
-                dst[1] = cb;
-                dst[2] = y1;
-                dst[3] = cr;
-                dst += 4;
-            }
-        }
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+// 编码器按宽高读取源图像，数据不足一帧时拒绝编码，避免越界读
+static bool check_source_len(size_t src_len, uint16_t width, uint16_t height, v4l2_pix_fmt_t format) {
+    size_t need = source_size(width, height, format);
+    if (src_len < need) {
+        ESP_LOGE(TAG, "source too short for %ux%u format 0x%08x: %u < %u bytes", width, height, (unsigned)format,
+                 (unsigned)src_len, (unsigned)need);
+        return false;
     }
+    return true;
+}
 
-    // 其余格式转换为 RGB888
-    int rgb_size = (int)width * (int)height * 3;
-    uint8_t* rgb = (uint8_t*)jpeg_calloc_align(rgb_size, 16);
-    if (!rgb)
-        return NULL;
+// 取源图像的 [y, y + lines) 行作为编码器输入，需要转换时写入 dst
+static const uint8_t* fetch_rows(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
+                                 int y, int lines, uint8_t* dst) {
+    size_t pixels = (size_t)width * lines;
+    size_t first = (size_t)width * y;
+    if (can_encode_in_place(src, format)) {
+        return src + first * (format == V4L2_PIX_FMT_GREY ? 1 : format == V4L2_PIX_FMT_YUYV ? 2 : 3);
+    }
 
-    if (format == V4L2_PIX_FMT_RGB24) {
-        // V4L2_RGB24 即 RGB888
-        memcpy(rgb, src, rgb_size);
-    } else if (format == V4L2_PIX_FMT_RGB565) {
-        // RGB565 小端，需要转换为 RGB888
-        const uint8_t* p = src;
-        uint8_t* d = rgb;
-        int pixels = (int)width * (int)height;
-        for (int i = 0; i < pixels; i++) {
-            uint8_t lo = p[0];  // 低字节（LSB）
-            uint8_t hi = p[1];  // 高字节（MSB）
-            p += 2;
-
-            uint8_t r5 = (hi >> 3) & 0x1F;
-            uint8_t g6 = ((hi & 0x07) << 3) | ((lo & 0xE0) >> 5);
-            uint8_t b5 = lo & 0x1F;
-
-            d[0] = expand_5_to_8(r5);
-            d[1] = expand_6_to_8(g6);
-            d[2] = expand_5_to_8(b5);
-            d += 3;
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+            memcpy(dst, src + first, pixels);
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            memcpy(dst, src + first * 2, pixels * 2);
+            break;
+        case V4L2_PIX_FMT_UYVY:
+            // Cb Y0 Cr Y1 -> Y0 Cb Y1 Cr，即交换每个 16 位的高低字节
+            pixel_convert_swap16(src + first * 2, dst, pixels);
+            break;
+        case V4L2_PIX_FMT_YUV422P: {
+            const uint8_t* y_plane = src;
+            const uint8_t* u_plane = y_plane + (size_t)width * height;
+            const uint8_t* v_plane = u_plane + (size_t)(width / 2) * height;
+            pixel_convert_yuv422p_to_yuyv(y_plane + first, u_plane + first / 2, v_plane + first / 2, dst, pixels);
+            break;
         }
-    } else {
-        // 其他未覆盖格式，清零
-        memset(rgb, 0, rgb_size);
+        case V4L2_PIX_FMT_RGB24:
+            memcpy(dst, src + first * 3, pixels * 3);
+            break;
+        case V4L2_PIX_FMT_RGB565:
+            // RGB565 小端
+            pixel_convert_rgb565_to_rgb888(src + first * 2, dst, pixels);
+            break;
+        default:
+            // 其他未覆盖格式，清零
+            memset(dst, 0, pixels * 3);
+            break;
     }
-
-    if (out_fmt)
-        *out_fmt = JPEG_PIXEL_FORMAT_RGB888;
-    if (out_size)
-        *out_size = rgb_size;
-    return rgb;
+    return dst;
 }
 
 #if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
@@ -183,7 +191,7 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
                                                 jpeg_enc_input_format_t* out_fmt, int* out_size) {
     if (format == V4L2_PIX_FMT_GREY) {
         int sz = (int)width * (int)height;
-        uint8_t* buf = (uint8_t*)malloc_psram(sz);
+        uint8_t* buf = (uint8_t*)frame_buf_alloc(sz);
         if (!buf)
             return NULL;
         memcpy(buf, src, sz);
@@ -196,9 +204,9 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
 
     if (format == V4L2_PIX_FMT_RGB24) {
         int sz = (int)width * (int)height * 3;
-        uint8_t* buf = (uint8_t*)malloc_psram(sz);
+        uint8_t* buf = (uint8_t*)frame_buf_alloc(sz);
         if (!buf) {
-            ESP_LOGE(TAG, "malloc_psram failed");
+            ESP_LOGE(TAG, "frame_buf_alloc failed");
             return NULL;
         }
         memcpy(buf, src, sz);
@@ -211,7 +219,7 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
 
     if (format == V4L2_PIX_FMT_RGB565) {
         int sz = (int)width * (int)height * 2;
-        uint8_t* buf = (uint8_t*)malloc_psram(sz);
+        uint8_t* buf = (uint8_t*)frame_buf_alloc(sz);
         if (!buf)
             return NULL;
         memcpy(buf, src, sz);
@@ -225,18 +233,15 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
     if (format == V4L2_PIX_FMT_YUYV) {
         // 硬件需要 | Y1 V Y0 U | 的“大端”格式，因此需要 bswap16
         int sz = (int)width * (int)height * 2;
-        uint16_t* buf = (uint16_t*)malloc_psram(sz);
+        uint8_t* buf = (uint8_t*)frame_buf_alloc(sz);
         if (!buf)
             return NULL;
-        const uint16_t* bsrc = (const uint16_t*)src;
-        for (int i = 0; i < sz / 2; i++) {
-            buf[i] = __builtin_bswap16(bsrc[i]);
-        }
+        pixel_convert_swap16(src, buf, (size_t)width * height);
         if (out_fmt)
             *out_fmt = JPEG_ENCODE_IN_FORMAT_YUV422;
         if (out_size)
             *out_size = sz;
-        return (uint8_t*)buf;
+        return buf;
     }
 
     return NULL;
@@ -250,6 +255,10 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
     if (quality > 100)
         quality = 100;
 
+    if (!check_source_len(src_len, width, height, format)) {
+        return false;
+    }
+
     jpeg_enc_input_format_t enc_src_type = JPEG_ENCODE_IN_FORMAT_RGB888;
     int enc_in_size = 0;
     uint8_t* enc_in = convert_input_to_hw_encoder_buf(src, width, height, format, &enc_src_type, &enc_in_size);
@@ -259,7 +268,7 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
     }
 
     if (!hw_jpeg_ensure_inited()) {
-        free(enc_in);
+        frame_buf_free(enc_in);
         return false;
     }
 
@@ -277,14 +286,14 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
     size_t out_cap_aligned = 0;
     uint8_t* outbuf = (uint8_t*)jpeg_alloc_encoder_mem(out_cap, &jpeg_enc_output_mem_cfg, &out_cap_aligned);
     if (!outbuf) {
-        free(enc_in);
+        frame_buf_free(enc_in);
         ESP_LOGE(TAG, "alloc out buffer failed");
         return false;
     }
 
     uint32_t out_len = 0;
     esp_err_t er = jpeg_encoder_process(s_hw_jpeg_handle, &enc_cfg, enc_in, (uint32_t)enc_in_size, outbuf, (uint32_t)out_cap_aligned, &out_len);
-    free(enc_in);
+    frame_buf_free(enc_in);
 
     if (er != ESP_OK) {
         free(outbuf);
@@ -314,27 +323,25 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
 }
 #endif // CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
 
+// scaler 不为空时输入行由它从源图像裁剪缩小得到，width、height、format 为它的输出，
+// src_len 已由调用者按源图像检查
 static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_t width, uint16_t height,
                                      v4l2_pix_fmt_t format, uint8_t quality, uint8_t** jpg_out, size_t* jpg_out_len,
-                                     jpg_out_cb cb, void* cb_arg) {
+                                     jpg_out_cb cb, void* cb_arg, image_scaler_t* scaler = NULL) {
+    if (!scaler && !check_source_len(src_len, width, height, format)) {
+        return false;
+    }
     if (quality < 1)
         quality = 1;
     if (quality > 100)
         quality = 100;
 
-    jpeg_pixel_format_t enc_src_type = JPEG_PIXEL_FORMAT_RGB888;
-    int enc_in_size = 0;
-    uint8_t* enc_in = convert_input_to_encoder_buf(src, width, height, format, &enc_src_type, &enc_in_size);
-    if (!enc_in) {
-        ESP_LOGE(TAG, "alloc/convert input failed");
-        return false;
-    }
-
+    int bytes_per_pixel = 3;
     jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
     cfg.width = width;
     cfg.height = height;
-    cfg.src_type = enc_src_type;
-    cfg.subsampling = (enc_src_type == JPEG_PIXEL_FORMAT_GRAY) ? JPEG_SUBSAMPLE_GRAY : JPEG_SUBSAMPLE_420;
+    cfg.src_type = encoder_input_format(format, &bytes_per_pixel);
+    cfg.subsampling = (cfg.src_type == JPEG_PIXEL_FORMAT_GRAY) ? JPEG_SUBSAMPLE_GRAY : JPEG_SUBSAMPLE_420;
     cfg.quality = quality;
     cfg.rotate = JPEG_ROTATE_0D;
     cfg.task_enable = false;
@@ -342,38 +349,106 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     jpeg_enc_handle_t h = NULL;
     jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
     if (ret != JPEG_ERR_OK) {
-        jpeg_free_align(enc_in);
         ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
         return false;
     }
 
-    // 估算输出缓冲区：宽高的 1.5 倍 + 64KB
-    size_t out_cap = (size_t)width * (size_t)height * 3 / 2 + 64 * 1024;
-    if (out_cap < 128 * 1024)
-        out_cap = 128 * 1024;
-    uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
-    if (!outbuf) {
+    // 高度是 MCU 行的整数倍时按 MCU 行转换并编码，转换缓冲区只需一行 MCU；
+    // 否则整帧转换后一次编码
+    size_t row_size = (size_t)width * bytes_per_pixel;
+    int block_size = jpeg_enc_get_block_size(h);
+    int block_lines = block_size > 0 ? (int)(block_size / row_size) : 0;
+    bool by_block = block_lines > 0 && height % block_lines == 0;
+    int lines = by_block ? block_lines : height;
+    size_t in_size = row_size * lines;
+
+    // 估算整帧输出缓冲区：宽高的 1.5 倍 + 64KB
+    size_t frame_out_cap = (size_t)width * (size_t)height * 3 / 2 + 64 * 1024;
+    if (frame_out_cap < 128 * 1024)
+        frame_out_cap = 128 * 1024;
+    // 回调模式下按 MCU 行输出，一行 MCU 的压缩数据不会超过原始数据的两倍，另加文件头
+    bool block_out = cb && by_block;
+    size_t out_cap = block_out ? in_size * 2 + 1024 : frame_out_cap;
+
+    // 一行 MCU 大小的缓冲区来自共享的临时区，整帧大小的缓冲区来自 jpeg_frame 区域，用完即释放
+    JpegScratch scratch;
+    bool in_place = !scaler && can_encode_in_place(src, format);
+    size_t acc_size = scaler ? image_scale_acc_size(width) : 0;
+    size_t pooled = (by_block && !in_place ? align16(in_size) : 0) + (block_out ? align16(out_cap) : 0) + align16(acc_size);
+    if (pooled > 0 && !scratch.arena().Reserve(pooled)) {
         jpeg_enc_close(h);
-        jpeg_free_align(enc_in);
-        ESP_LOGE(TAG, "alloc out buffer failed");
+        ESP_LOGE(TAG, "alloc scratch buffers failed");
+        return false;
+    }
+    if (scaler) {
+        scaler->acc = (uint32_t*)scratch.arena().Allocate(acc_size);
+    }
+    uint8_t* in_buf = NULL;
+    if (!in_place) {
+        in_buf = by_block ? (uint8_t*)scratch.arena().Allocate(in_size) : (uint8_t*)frame_buf_alloc(in_size);
+    }
+    uint8_t* outbuf = block_out ? (uint8_t*)scratch.arena().Allocate(out_cap) : (uint8_t*)frame_buf_alloc(out_cap);
+    if ((!in_place && !in_buf) || !outbuf) {
+        jpeg_enc_close(h);
+        if (!by_block)
+            frame_buf_free(in_buf);
+        if (!block_out)
+            frame_buf_free(outbuf);
+        ESP_LOGE(TAG, "alloc/convert input failed");
         return false;
     }
 
-    int out_len = 0;
-    ret = jpeg_enc_process(h, enc_in, enc_in_size, outbuf, (int)out_cap, &out_len);
+    size_t out_len = 0;
+    size_t index = 0;
+    bool aborted = false;
+    for (int y = 0; y < height; y += lines) {
+        const uint8_t* in = in_buf;
+        if (scaler) {
+            image_scale_rows(scaler, y, lines, in_buf);
+        } else {
+            in = fetch_rows(src, width, height, format, y, lines, in_buf);
+        }
+        uint8_t* out = block_out ? outbuf : outbuf + out_len;
+        int len = 0;
+        if (by_block) {
+            ret = jpeg_enc_process_with_block(h, in, (int)in_size, out, (int)(out_cap - (out - outbuf)), &len);
+        } else {
+            ret = jpeg_enc_process(h, in, (int)in_size, out, (int)(out_cap - out_len), &len);
+        }
+        if (ret < JPEG_ERR_OK) {
+            break;
+        }
+        if (block_out) {
+            // 回调处理的字节数不足时中止编码，例如上传已经失败
+            if (len > 0 && cb(cb_arg, index++, outbuf, (size_t)len) != (size_t)len) {
+                aborted = true;
+                break;
+            }
+        } else {
+            out_len += len;
+        }
+    }
     jpeg_enc_close(h);
-    jpeg_free_align(enc_in);
+    if (!by_block)
+        frame_buf_free(in_buf);
 
-    if (ret != JPEG_ERR_OK) {
-        free(outbuf);
+    if (ret < JPEG_ERR_OK) {
+        if (!block_out)
+            frame_buf_free(outbuf);
         ESP_LOGE(TAG, "jpeg_enc_process failed: %d", (int)ret);
         return false;
     }
+    if (aborted) {
+        ESP_LOGW(TAG, "jpeg output callback aborted at chunk %u", (unsigned)index);
+        return false;
+    }
 
     if (cb) {
-        cb(cb_arg, 0, outbuf, (size_t)out_len);
-        cb(cb_arg, 1, NULL, 0);  // 结束信号
-        free(outbuf);
+        if (!block_out) {
+            cb(cb_arg, index++, outbuf, out_len);
+            frame_buf_free(outbuf);
+        }
+        cb(cb_arg, index, NULL, 0);  // 结束信号
         if (jpg_out)
             *jpg_out = NULL;
         if (jpg_out_len)
@@ -382,12 +457,14 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     }
 
     if (jpg_out && jpg_out_len) {
+        // 所有权转交给调用者
+        frame_region().Detach(outbuf);
         *jpg_out = outbuf;
-        *jpg_out_len = (size_t)out_len;
+        *jpg_out_len = out_len;
         return true;
     }
 
-    free(outbuf);
+    frame_buf_free(outbuf);
     return true;
 }
 
@@ -412,3 +489,168 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #endif
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
+
+bool image_to_jpeg_crop_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
+                           const jpeg_crop_t* crop, uint16_t out_width, uint16_t out_height, uint8_t quality,
+                           jpg_out_cb cb, void* arg) {
+    jpeg_crop_t full = {0, 0, width, height};
+    if (crop == NULL || crop->width == 0 || crop->height == 0) {
+        crop = &full;
+    }
+    bool whole = crop->x == 0 && crop->y == 0 && crop->width == width && crop->height == height;
+    if (whole && out_width == width && out_height == height) {
+        return image_to_jpeg_cb(src, src_len, width, height, format, quality, cb, arg);
+    }
+
+    if (!check_source_len(src_len, width, height, format)) {
+        return false;
+    }
+    image_scaler_t scaler;
+    if (!image_scale_init(&scaler, src, width, height, format, crop->x, crop->y, crop->width, crop->height,
+                          out_width, out_height, NULL)) {
+        ESP_LOGE(TAG, "unsupported crop %ux%u+%u+%u to %ux%u of %ux%u format 0x%08x", crop->width, crop->height,
+                 crop->x, crop->y, out_width, out_height, width, height, (unsigned)format);
+        return false;
+    }
+    v4l2_pix_fmt_t out_format = image_scale_output_format(format);
+
+#if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+    {
+        // 硬件编码器只接受整帧，先缩小到一帧，缩小后的帧只有原来的一小部分
+        size_t bpp = out_format == V4L2_PIX_FMT_GREY ? 1 : 3;
+        size_t scaled_len = (size_t)out_width * out_height * bpp;
+        uint8_t* scaled = (uint8_t*)frame_buf_alloc(scaled_len);
+        scaler.acc = (uint32_t*)jpeg_region().Allocate(image_scale_acc_size(out_width), 16);
+        bool ok = false;
+        if (scaled && scaler.acc) {
+            image_scale_rows(&scaler, 0, out_height, scaled);
+            ok = encode_with_hw_jpeg(scaled, scaled_len, out_width, out_height, out_format, quality, NULL, NULL, cb, arg);
+        }
+        jpeg_region().Free(scaler.acc);
+        frame_buf_free(scaled);
+        if (ok) {
+            return true;
+        }
+        // Fallback to esp_new_jpeg
+    }
+#endif
+    // 每行 MCU 直接从源图像裁剪缩小并转换格式，不需要中间帧
+    return encode_with_esp_new_jpeg(src, src_len, out_width, out_height, out_format, quality, NULL, NULL, cb, arg,
+                                    &scaler);
+}
+
+bool image_to_jpeg_rows_cb(uint16_t width, uint16_t height, v4l2_pix_fmt_t format, uint8_t quality,
+                           jpg_rows_cb rows_cb, void* rows_arg, jpg_out_cb cb, void* arg) {
+    if (format != V4L2_PIX_FMT_RGB565) {
+        ESP_LOGE(TAG, "strip encoding only supports RGB565, got 0x%08x", (unsigned)format);
+        return false;
+    }
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = JPEG_PIXEL_FORMAT_RGB888;
+    cfg.subsampling = JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_enc_handle_t h = NULL;
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        return false;
+    }
+
+    // 编码器每次处理一行 MCU（4:2:0 为 16 行），只需要一行 MCU 大小的缓冲区
+    int block_size = jpeg_enc_get_block_size(h);
+    int block_lines = block_size / ((int)width * 3);
+    if (block_size <= 0 || block_lines <= 0) {
+        jpeg_enc_close(h);
+        ESP_LOGE(TAG, "jpeg_enc_get_block_size failed: %d", block_size);
+        return false;
+    }
+    // 与 encode_with_esp_new_jpeg 相同，只有高度是 MCU 行的整数倍时才按 MCU 行编码；
+    // 否则（例如 280、135 行高的屏幕）条带拼成整帧后一次编码，不补齐最后一行 MCU
+    bool by_block = height % block_lines == 0;
+    size_t strip_size = (size_t)width * block_lines * 2;
+    size_t frame_size = (size_t)width * height * 3;
+    // 一行 MCU 的压缩输出不会超过原始数据的两倍，另加文件头；整帧输出与 encode_with_esp_new_jpeg 的估算相同
+    size_t out_cap = (size_t)block_size * 2 + 1024;
+    if (!by_block) {
+        out_cap = (size_t)width * height * 3 / 2 + 64 * 1024;
+        if (out_cap < 128 * 1024)
+            out_cap = 128 * 1024;
+    }
+    JpegScratch scratch;
+    MemoryArena& arena = scratch.arena();
+    bool ok = arena.Reserve(align16(strip_size) + (by_block ? align16(block_size) + align16(out_cap) : 0));
+    uint8_t* strip = ok ? (uint8_t*)arena.Allocate(strip_size) : NULL;
+    uint8_t* block = NULL;
+    uint8_t* outbuf = NULL;
+    if (ok && by_block) {
+        block = (uint8_t*)arena.Allocate(block_size);
+        outbuf = (uint8_t*)arena.Allocate(out_cap);
+    } else if (ok) {
+        // 整帧大小的缓冲区用完即释放
+        block = (uint8_t*)frame_buf_alloc(frame_size);
+        outbuf = (uint8_t*)frame_buf_alloc(out_cap);
+        ok = block != NULL && outbuf != NULL;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "alloc strip buffers failed");
+    }
+
+    size_t index = 0;
+    for (int y = 0; ok && y < height; y += block_lines) {
+        int lines = height - y < block_lines ? height - y : block_lines;
+        if (!rows_cb(rows_arg, (uint16_t)y, (uint16_t)lines, strip)) {
+            ESP_LOGE(TAG, "rows callback failed at line %d", y);
+            ok = false;
+            break;
+        }
+        if (!by_block) {
+            pixel_convert_rgb565_to_rgb888(strip, block + (size_t)y * width * 3, (size_t)width * lines);
+            continue;
+        }
+        pixel_convert_rgb565_to_rgb888(strip, block, (size_t)width * block_lines);
+
+        int out_len = 0;
+        ret = jpeg_enc_process_with_block(h, block, block_size, outbuf, (int)out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+            break;
+        }
+        if (out_len > 0 && cb(arg, index++, outbuf, (size_t)out_len) != (size_t)out_len) {
+            ESP_LOGW(TAG, "jpeg output callback aborted at chunk %u", (unsigned)index);
+            ok = false;
+            break;
+        }
+    }
+    if (ok && !by_block) {
+        int out_len = 0;
+        ret = jpeg_enc_process(h, block, (int)frame_size, outbuf, (int)out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process failed: %d", (int)ret);
+            ok = false;
+        } else if (cb(arg, index++, outbuf, (size_t)out_len) != (size_t)out_len) {
+            ESP_LOGW(TAG, "jpeg output callback aborted");
+            ok = false;
+        }
+    }
+    if (!by_block) {
+        frame_buf_free(block);
+        frame_buf_free(outbuf);
+    }
+    if (ok) {
+        cb(arg, index, NULL, 0);  // 结束信号
+    }
+
+    jpeg_enc_close(h);
+    return ok;
+}
@@ -16,7 +16,7 @@ extern "C" {
 
 // JPEG输出回调函数类型
 // arg: 用户自定义参数, index: 当前数据索引, data: JPEG数据块, len: 数据块长度
-// 返回: 实际处理的字节数
+// 返回: 实际处理的字节数，少于 len 时编码器中止编码并返回失败（硬件编码器一次输出整帧，不受影响）
 typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t len);
 
 /**
@@ -28,7 +28,7 @@ typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t l
  * - 高质量JPEG输出
  * 
  * @param src       源图像数据
- * @param src_len   源图像数据长度
+ * @param src_len   源图像数据长度，不足一帧时返回失败
  * @param width     图像宽度
  * @param height    图像高度  
  * @param format    图像格式 (PIXFORMAT_RGB565, PIXFORMAT_RGB888, 等)
@@ -50,7 +50,7 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
  * - 通过回调函数逐块处理JPEG数据
  * 
  * @param src       源图像数据
- * @param src_len   源图像数据长度
+ * @param src_len   源图像数据长度，不足一帧时返回失败
  * @param width     图像宽度
  * @param height    图像高度
  * @param format    图像格式
@@ -63,6 +63,67 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
 bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, 
                       v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+// 源图像中的裁剪区域，像素坐标
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} jpeg_crop_t;
+
+/**
+ * @brief 裁剪并缩小后编码为JPEG（回调版本）
+ *
+ * 裁剪区域按区域平均缩小到 out_width x out_height，缩小和格式转换在编码每一行 MCU 时
+ * 一起完成，不生成中间帧（硬件编码器先缩小成一帧再编码）。输出尺寸必须不大于裁剪区域。
+ * 裁剪区域为空且输出为原尺寸时与 image_to_jpeg_cb 相同。
+ * 缩小支持 RGB565、RGB24、YUYV、GREY 输入。
+ *
+ * @param crop       裁剪区域，NULL 或宽高为 0 表示整幅图像
+ * @param out_width  输出宽度
+ * @param out_height 输出高度
+ *
+ * @return true 成功, false 失败
+ */
+bool image_to_jpeg_crop_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
+                           const jpeg_crop_t *crop, uint16_t out_width, uint16_t out_height, uint8_t quality,
+                           jpg_out_cb cb, void *arg);
+
+// 按条带提供图像数据的回调函数类型
+// arg: 用户自定义参数, y: 起始行, lines: 行数, dst: 目标缓冲区（行间距为 width * 每像素字节数）
+// 返回: false 表示中止编码
+typedef bool (*jpg_rows_cb)(void *arg, uint16_t y, uint16_t lines, uint8_t *dst);
+
+/**
+ * @brief 按条带将图像编码为JPEG（回调版本）
+ *
+ * 源图像不需要整帧存在于内存中：编码器每次通过 rows_cb 取一行 MCU 高度（4:2:0 为 16 行）
+ * 的像素，转换后立即编码，并把这一段 JPEG 数据交给 cb。峰值内存只有一个条带，与图像高度无关。
+ * 高度不是 MCU 行的整数倍时，条带转换到一个整帧缓冲区后一次编码，峰值内存与整帧编码相同。
+ * 仅使用软件编码器，目前只支持 RGB565 小端输入。
+ *
+ * @param width     图像宽度
+ * @param height    图像高度
+ * @param format    图像格式 (V4L2_PIX_FMT_RGB565)
+ * @param quality   JPEG质量 (1-100)
+ * @param rows_cb   提供像素行的回调函数
+ * @param rows_arg  传递给 rows_cb 的用户参数
+ * @param cb        输出回调函数
+ * @param arg       传递给输出回调函数的用户参数
+ *
+ * @return true 成功, false 失败
+ */
+bool image_to_jpeg_rows_cb(uint16_t width, uint16_t height, v4l2_pix_fmt_t format, uint8_t quality,
+                           jpg_rows_cb rows_cb, void *rows_arg, jpg_out_cb cb, void *arg);
+
+/**
+ * @brief 释放编码之间保留的转换/输出缓冲区
+ *
+ * 按 MCU 行编码用到的缓冲区在编码结束后保留给下一次使用，内存紧张时可以调用本函数归还。
+ * 正在进行的编码不受影响。
+ */
+void image_to_jpeg_release_buffers(void);
+
 #ifdef __cplusplus
 }
 #endif
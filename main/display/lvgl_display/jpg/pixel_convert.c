@@ -0,0 +1,125 @@
+#include "pixel_convert.h"
+
+// 快速实现按 32 位字读写（一次 2 个 16 位像素，ESP32 系列均为小端），要求源和目标 4 字节对齐；
+// 不对齐的缓冲区和末尾不足一个字的像素交给参考实现处理
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+static inline int is_word_aligned(const void *p) {
+    return ((uintptr_t)p & 3) == 0;
+}
+
+static inline uint8_t expand_5_to_8(uint8_t v) {
+    return (uint8_t)((v << 3) | (v >> 2));
+}
+
+static inline uint8_t expand_6_to_8(uint8_t v) {
+    return (uint8_t)((v << 2) | (v >> 4));
+}
+
+void pixel_convert_swap16_ref(const uint8_t *src, uint8_t *dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t lo = src[0];
+        uint8_t hi = src[1];
+        dst[0] = hi;
+        dst[1] = lo;
+        src += 2;
+        dst += 2;
+    }
+}
+
+void pixel_convert_swap16(const uint8_t *src, uint8_t *dst, size_t pixels) {
+    if (!is_word_aligned(src) || !is_word_aligned(dst)) {
+        pixel_convert_swap16_ref(src, dst, pixels);
+        return;
+    }
+    const word_t *s = (const word_t *)src;
+    word_t *d = (word_t *)dst;
+    size_t words = pixels / 2;
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2) {
+        uint32_t w0 = s[i];
+        uint32_t w1 = s[i + 1];
+        d[i] = ((w0 & 0x00FF00FF) << 8) | ((w0 >> 8) & 0x00FF00FF);
+        d[i + 1] = ((w1 & 0x00FF00FF) << 8) | ((w1 >> 8) & 0x00FF00FF);
+    }
+    for (; i < words; i++) {
+        uint32_t w = s[i];
+        d[i] = ((w & 0x00FF00FF) << 8) | ((w >> 8) & 0x00FF00FF);
+    }
+    pixel_convert_swap16_ref(src + words * 4, dst + words * 4, pixels & 1);
+}
+
+void pixel_convert_rgb565_to_rgb888_ref(const uint8_t *src, uint8_t *dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t lo = src[0];  // 低字节（LSB）
+        uint8_t hi = src[1];  // 高字节（MSB）
+        src += 2;
+
+        uint8_t r5 = (hi >> 3) & 0x1F;
+        uint8_t g6 = ((hi & 0x07) << 3) | ((lo & 0xE0) >> 5);
+        uint8_t b5 = lo & 0x1F;
+
+        dst[0] = expand_5_to_8(r5);
+        dst[1] = expand_6_to_8(g6);
+        dst[2] = expand_5_to_8(b5);
+        dst += 3;
+    }
+}
+
+void pixel_convert_rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels) {
+    if (!is_word_aligned(src) || !is_word_aligned(dst)) {
+        pixel_convert_rgb565_to_rgb888_ref(src, dst, pixels);
+        return;
+    }
+    const word_t *s = (const word_t *)src;
+    word_t *d = (word_t *)dst;
+    size_t groups = pixels / 4;
+    for (size_t i = 0; i < groups; i++) {
+        // 每个字里的两个像素并行展开，每个通道在各自的 16 位通道里不会溢出 8 位
+        uint32_t a = s[0];
+        uint32_t b = s[1];
+        uint32_t ra = (a >> 11) & 0x001F001F, ga = (a >> 5) & 0x003F003F, ba = a & 0x001F001F;
+        uint32_t rb = (b >> 11) & 0x001F001F, gb = (b >> 5) & 0x003F003F, bb = b & 0x001F001F;
+        ra = (ra << 3) | (ra >> 2);
+        ga = (ga << 2) | (ga >> 4);
+        ba = (ba << 3) | (ba >> 2);
+        rb = (rb << 3) | (rb >> 2);
+        gb = (gb << 2) | (gb >> 4);
+        bb = (bb << 3) | (bb >> 2);
+        // 4 个像素 R0 G0 B0 R1 | G1 B1 R2 G2 | B2 R3 G3 B3
+        d[0] = (ra & 0xFF) | (ga & 0xFF) << 8 | (ba & 0xFF) << 16 | (ra >> 16) << 24;
+        d[1] = (ga >> 16) | (ba >> 16) << 8 | (rb & 0xFF) << 16 | (gb & 0xFF) << 24;
+        d[2] = (bb & 0xFF) | (rb >> 16) << 8 | (gb >> 16) << 16 | (bb >> 16) << 24;
+        s += 2;
+        d += 3;
+    }
+    pixel_convert_rgb565_to_rgb888_ref(src + groups * 8, dst + groups * 12, pixels & 3);
+}
+
+void pixel_convert_yuv422p_to_yuyv_ref(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                                       size_t pixels) {
+    for (size_t x = 0; x < pixels; x += 2) {
+        dst[0] = y[x + 0];
+        dst[1] = u[x / 2];
+        dst[2] = y[x + 1];
+        dst[3] = v[x / 2];
+        dst += 4;
+    }
+}
+
+void pixel_convert_yuv422p_to_yuyv(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                                   size_t pixels) {
+    if (!is_word_aligned(dst)) {
+        pixel_convert_yuv422p_to_yuyv_ref(y, u, v, dst, pixels);
+        return;
+    }
+    // 平面的对齐取决于宽度，读取仍按字节，写入合并为整字
+    word_t *d = (word_t *)dst;
+    size_t x = 0;
+    for (; x + 4 <= pixels; x += 4) {
+        d[0] = y[x] | u[x / 2] << 8 | (uint32_t)y[x + 1] << 16 | (uint32_t)v[x / 2] << 24;
+        d[1] = y[x + 2] | u[x / 2 + 1] << 8 | (uint32_t)y[x + 3] << 16 | (uint32_t)v[x / 2 + 1] << 24;
+        d += 2;
+    }
+    pixel_convert_yuv422p_to_yuyv_ref(y + x, u + x / 2, v + x / 2, (uint8_t *)d, pixels - x);
+}
@@ -0,0 +1,27 @@
+// pixel_convert.h - JPEG 编码前的像素格式转换
+// 每种转换都有逐字节的参考实现（_ref）和按 32 位字处理的快速实现，两者输出必须逐字节一致
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 交换每个 16 位像素的高低字节：RGB565 大小端互转、UYVY <-> YUYV
+void pixel_convert_swap16(const uint8_t *src, uint8_t *dst, size_t pixels);
+void pixel_convert_swap16_ref(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+// RGB565 小端 -> RGB888
+void pixel_convert_rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels);
+void pixel_convert_rgb565_to_rgb888_ref(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+// YUV422 平面 -> YUYV (Y Cb Y Cr)，pixels 必须为偶数，u/v 各 pixels / 2 字节
+void pixel_convert_yuv422p_to_yuyv(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, size_t pixels);
+void pixel_convert_yuv422p_to_yuyv_ref(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                                       size_t pixels);
+
+#ifdef __cplusplus
+}
+#endif
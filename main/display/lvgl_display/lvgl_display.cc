@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <font_awesome.h>
 
 #include "lvgl_display.h"
@@ -12,9 +13,20 @@
 #include "settings.h"
 #include "assets/lang_config.h"
 #include "jpg/image_to_jpeg.h"
+#include "jpg/pixel_convert.h"
+#include "task_stack.h"
+
+#if CONFIG_LV_USE_SNAPSHOT && !CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+// Layer and display internals for rendering the screen in strips
+#include <lvgl_private.h>
+#endif
 
 #define TAG "Display"
 
+// Cadence of the status probe task, the network state is also read on UpdateStatusBar(true)
+#define BATTERY_PROBE_INTERVAL_MS   5000
+#define NETWORK_PROBE_INTERVAL_MS   10000
+
 LvglDisplay::LvglDisplay() {
     // Notification timer
     esp_timer_create_args_t notification_timer_args = {
@@ -41,6 +53,13 @@ LvglDisplay::LvglDisplay() {
 }
 
 LvglDisplay::~LvglDisplay() {
+    if (status_probe_task_ != nullptr) {
+        status_probe_stop_ = true;
+        xTaskNotifyGive(status_probe_task_);
+        xSemaphoreTake(status_probe_done_, portMAX_DELAY);
+        vTaskDelete(status_probe_task_);
+        vSemaphoreDelete(status_probe_done_);
+    }
     if (notification_timer_ != nullptr) {
         esp_timer_stop(notification_timer_);
         esp_timer_delete(notification_timer_);
@@ -74,9 +93,13 @@ void LvglDisplay::SetStatus(const char* status) {
     if (status_label_ == nullptr) {
         return;
     }
-    lv_label_set_text(status_label_, status);
+    if (strcmp(lv_label_get_text(status_label_), status) != 0) {
+        lv_label_set_text(status_label_, status);
+    }
     lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    // The clock has to be drawn again when it takes the label back
+    status_bar_.Reset(StatusBarModel::kClock);
 
     last_status_update_time_ = std::chrono::system_clock::now();
 }
@@ -103,48 +126,33 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
 
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
-        }
-
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
+    // Format the clock outside the lock, it is only shown while idle
+    char time_str[16] = {};
+    bool show_clock = false;
+    if (app.GetDeviceState() == kDeviceStateIdle &&
+        last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
+        // Set status to clock "HH:MM"
+        time_t now = time(NULL);
+        struct tm* tm = localtime(&now);
+        // Check if the we have already set the time
+        if (tm->tm_year >= 2025 - 1900) {
+            strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
+            show_clock = true;
+        } else {
+            ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
         }
     }
 
-    // Update time
-    if (app.GetDeviceState() == kDeviceStateIdle) {
-        if (last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
-            // Set status to clock "HH:MM"
-            time_t now = time(NULL);
-            struct tm* tm = localtime(&now);
-            // Check if the we have already set the time
-            if (tm->tm_year >= 2025 - 1900) {
-                char time_str[16];
-                strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
-                SetStatus(time_str);
-            } else {
-                ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
-            }
-        }
+    StatusProbe probe;
+    {
+        std::lock_guard<std::mutex> lock(probe_mutex_);
+        probe = probe_;
     }
-
-    esp_pm_lock_acquire(pm_lock_);
-    // 更新电池图标
-    int battery_level;
-    bool charging, discharging;
-    const char* icon = nullptr;
-    if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        if (charging) {
-            icon = FONT_AWESOME_BATTERY_BOLT;
+    const char* battery_icon = nullptr;
+    bool battery_empty = false;
+    if (probe.has_battery) {
+        if (probe.charging) {
+            battery_icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
                 FONT_AWESOME_BATTERY_EMPTY, // 0-19%
@@ -154,52 +162,112 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
+            battery_icon = levels[std::clamp(probe.battery_level, 0, 100) / 20];
+            battery_empty = probe.battery_level < 20;
         }
+    }
+
+    bool play_low_battery_sound = false;
+    {
         DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
+        if (mute_label_ == nullptr) {
+            return;
+        }
+
+        // Started on the first update, displays without a status bar never need it
+        if (status_probe_task_ == nullptr) {
+            status_probe_done_ = xSemaphoreCreateBinary();
+            xTaskCreate([](void* arg) {
+                static_cast<LvglDisplay*>(arg)->StatusProbeTask();
+            }, "status_probe", TASK_STACK_STATUS_PROBE, this, 1, &status_probe_task_);
+        } else if (update_all) {
+            xTaskNotifyGive(status_probe_task_);
         }
 
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
+        if (status_bar_.Set(StatusBarModel::kMute, codec->output_volume() == 0 ? FONT_AWESOME_VOLUME_XMARK : "")) {
+            lv_label_set_text(mute_label_, status_bar_.value(StatusBarModel::kMute).c_str());
+        }
+
+        if (!show_clock) {
+            status_bar_.Reset(StatusBarModel::kClock);
+        } else if (status_bar_.Set(StatusBarModel::kClock, time_str) && status_label_ != nullptr) {
+            // Not through SetStatus(), the clock does not hold the label for 10 seconds
+            lv_label_set_text(status_label_, time_str);
+            lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+        }
+
+        if (battery_icon != nullptr) {
+            if (battery_label_ != nullptr && status_bar_.Set(StatusBarModel::kBattery, battery_icon)) {
+                lv_label_set_text(battery_label_, battery_icon);
+            }
+            if (low_battery_popup_ != nullptr &&
+                status_bar_.SetVisible(StatusBarModel::kLowBattery, battery_empty && probe.discharging)) {
+                if (battery_empty && probe.discharging) {
                     lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
+                    play_low_battery_sound = true;
+                } else {
                     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
                 }
             }
         }
+
+        if (network_label_ != nullptr && probe.network_icon != nullptr &&
+            status_bar_.Set(StatusBarModel::kNetwork, probe.network_icon)) {
+            lv_label_set_text(network_label_, probe.network_icon);
+        }
     }
 
-    // 每 10 秒更新一次网络图标
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
-        // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
-        auto device_state = Application::GetInstance().GetDeviceState();
-        static const std::vector<DeviceState> allowed_states = {
-            kDeviceStateIdle,
-            kDeviceStateStarting,
-            kDeviceStateWifiConfiguring,
-            kDeviceStateListening,
-            kDeviceStateActivating,
-        };
-        if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
+    if (play_low_battery_sound) {
+        app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+    }
+}
+
+void LvglDisplay::StatusProbeTask() {
+    auto& board = Board::GetInstance();
+    int64_t next_battery = 0;
+    int64_t next_network = 0;
+    bool force_network = false;
+    while (!status_probe_stop_) {
+        int64_t now = esp_timer_get_time();
+        if (now >= next_battery) {
+            StatusProbe battery;
+            esp_pm_lock_acquire(pm_lock_);
+            battery.has_battery = board.GetBatteryLevel(battery.battery_level, battery.charging, battery.discharging);
+            esp_pm_lock_release(pm_lock_);
+            std::lock_guard<std::mutex> lock(probe_mutex_);
+            probe_.has_battery = battery.has_battery;
+            probe_.battery_level = battery.battery_level;
+            probe_.charging = battery.charging;
+            probe_.discharging = battery.discharging;
+            next_battery = now + BATTERY_PROBE_INTERVAL_MS * 1000;
+        }
+
+        if (force_network || now >= next_network) {
+            // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
+            auto device_state = Application::GetInstance().GetDeviceState();
+            static const std::vector<DeviceState> allowed_states = {
+                kDeviceStateIdle,
+                kDeviceStateStarting,
+                kDeviceStateWifiConfiguring,
+                kDeviceStateListening,
+                kDeviceStateActivating,
+            };
+            if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
+                esp_pm_lock_acquire(pm_lock_);
+                const char* icon = board.GetNetworkStateIcon();
+                esp_pm_lock_release(pm_lock_);
+                std::lock_guard<std::mutex> lock(probe_mutex_);
+                probe_.network_icon = icon;
             }
+            next_network = now + NETWORK_PROBE_INTERVAL_MS * 1000;
         }
-    }
 
-    esp_pm_lock_release(pm_lock_);
+        int64_t wait_us = std::min(next_battery, next_network) - esp_timer_get_time();
+        force_network = ulTaskNotifyTake(pdTRUE, wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) : 0) > 0;
+    }
+    xSemaphoreGive(status_probe_done_);
+    vTaskSuspend(NULL);
 }
 
 void LvglDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -216,10 +284,58 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
 }
 
 bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
+    // 清空输出字符串，JPEG 数据按段追加，避免预分配大内存块
+    jpeg_data.clear();
+    return SnapshotToJpeg([&jpeg_data](const void* data, size_t len) {
+        jpeg_data.append(static_cast<const char*>(data), len);
+    }, quality);
+}
+
+#if CONFIG_LV_USE_SNAPSHOT && !CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+// Render one horizontal strip of an object, the same way lv_snapshot_take_to_draw_buf() renders all of it
+static void RenderStrip(lv_obj_t* obj, lv_draw_buf_t* draw_buf, const lv_area_t& area) {
+    lv_draw_buf_clear(draw_buf, nullptr);
+
+    lv_layer_t layer;
+    lv_memzero(&layer, sizeof(layer));
+    layer.draw_buf = draw_buf;
+    layer.buf_area = area;
+    layer.color_format = LV_COLOR_FORMAT_RGB565;
+    layer._clip_area = area;
+    layer.phy_clip_area = area;
+
+    lv_display_t* disp_old = lv_refr_get_disp_refreshing();
+    lv_display_t* disp_new = lv_obj_get_display(obj);
+    lv_layer_t* layer_old = disp_new->layer_head;
+    disp_new->layer_head = &layer;
+
+    lv_refr_set_disp_refreshing(disp_new);
+    lv_obj_redraw(&layer, obj);
+    while (layer.draw_task_head) {
+        lv_draw_dispatch_wait_for_request();
+        lv_draw_dispatch();
+    }
+
+    disp_new->layer_head = layer_old;
+    lv_refr_set_disp_refreshing(disp_old);
+}
+#endif
+
+bool LvglDisplay::SnapshotToJpeg(std::function<void(const void* data, size_t len)> on_data, int quality) {
 #if CONFIG_LV_USE_SNAPSHOT
     DisplayLockGuard lock(this);
 
+    auto output = [](void *arg, size_t index, const void *data, size_t len) -> size_t {
+        auto on_data = static_cast<std::function<void(const void*, size_t)>*>(arg);
+        if (data && len > 0) {
+            (*on_data)(data, len);
+        }
+        return len;
+    };
+
     lv_obj_t* screen = lv_screen_active();
+#if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+    // The hardware encoder only takes whole frames
     lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
     if (draw_buffer == nullptr) {
         ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
@@ -227,32 +343,131 @@ bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
     }
 
     // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
-    }
-
-    // 清空输出字符串并使用回调版本，避免预分配大内存块
-    jpeg_data.clear();
+    pixel_convert_swap16(draw_buffer->data, draw_buffer->data, draw_buffer->data_size / 2);
 
-    // 🚀 使用回调版本的JPEG编码器，进一步节省内存
     bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
-        [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
-        if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
+        output, &on_data);
+    lv_draw_buf_destroy(draw_buffer);
+#else
+    // Render the screen strip by strip straight into the encoder's input buffer, so only
+    // one MCU row of pixels is in memory at a time instead of the whole frame
+    bool ret = image_to_jpeg_rows_cb(lv_obj_get_width(screen), lv_obj_get_height(screen), V4L2_PIX_FMT_RGB565, quality,
+        [](void *arg, uint16_t y, uint16_t lines, uint8_t *dst) -> bool {
+        auto screen = static_cast<lv_obj_t*>(arg);
+        int32_t width = lv_obj_get_width(screen);
+        uint32_t stride = width * 2;
+        lv_draw_buf_t draw_buf;
+        if (lv_draw_buf_init(&draw_buf, width, lines, LV_COLOR_FORMAT_RGB565, stride, dst, stride * lines) != LV_RESULT_OK) {
+            return false;
         }
-        return len;
-    }, &jpeg_data);
+        lv_area_t area;
+        lv_obj_get_coords(screen, &area);
+        area.y1 += y;
+        area.y2 = area.y1 + lines - 1;
+        RenderStrip(screen, &draw_buf, area);
+
+        // swap bytes, as the whole frame snapshot did
+        pixel_convert_swap16(dst, dst, (size_t)width * lines);
+        return true;
+    }, screen, output, &on_data);
+#endif
     if (!ret) {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
     }
-
-    lv_draw_buf_destroy(draw_buffer);
     return ret;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
     return false;
 #endif
 }
+
+void LvglDisplay::EnableFlushStats() {
+    if (display_ == nullptr) {
+        return;
+    }
+    flush_stats_.start_time = esp_timer_get_time();
+    // Events are sent from the LVGL task with the port lock held, so no extra locking is needed
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LvglDisplay*>(lv_event_get_user_data(e));
+        auto& stats = self->flush_stats_;
+        int64_t now = esp_timer_get_time();
+        switch (lv_event_get_code(e)) {
+        case LV_EVENT_REFR_START:
+            self->refresh_start_time_ = now;
+            self->render_start_time_ = 0;
+            break;
+        case LV_EVENT_RENDER_START:
+            self->render_start_time_ = now;
+            break;
+        case LV_EVENT_RENDER_READY:
+            if (self->render_start_time_ != 0) {
+                stats.render_time += now - self->render_start_time_;
+                stats.frames++;
+            }
+            break;
+        case LV_EVENT_REFR_READY:
+            // Idle refresh cycles without anything to render are not counted
+            if (self->render_start_time_ != 0 && self->refresh_start_time_ != 0) {
+                uint32_t elapsed = now - self->refresh_start_time_;
+                stats.refresh_time += elapsed;
+                stats.max_refresh_time = std::max(stats.max_refresh_time, elapsed);
+            }
+            break;
+        case LV_EVENT_FLUSH_START: {
+            stats.flushes++;
+            auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+            if (area != nullptr) {
+                stats.flushed_pixels += lv_area_get_size(area);
+            }
+            break;
+        }
+        case LV_EVENT_FLUSH_WAIT_START:
+            self->flush_wait_start_time_ = now;
+            break;
+        case LV_EVENT_FLUSH_WAIT_FINISH:
+            if (self->flush_wait_start_time_ != 0) {
+                stats.flush_wait_time += now - self->flush_wait_start_time_;
+                self->flush_wait_start_time_ = 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }, LV_EVENT_ALL, this);
+}
+
+cJSON* LvglDisplay::GetFlushStatsJson() {
+    DisplayFlushStats stats;
+    {
+        DisplayLockGuard lock(this);
+        stats = flush_stats_;
+    }
+
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "frames", stats.frames);
+    cJSON_AddNumberToObject(json, "flushes", stats.flushes);
+    if (stats.frames > 0) {
+        cJSON_AddNumberToObject(json, "avg_refresh_us", (double)(stats.refresh_time / stats.frames));
+        cJSON_AddNumberToObject(json, "avg_render_us", (double)(stats.render_time / stats.frames));
+        cJSON_AddNumberToObject(json, "avg_flush_wait_us", (double)(stats.flush_wait_time / stats.frames));
+    }
+    cJSON_AddNumberToObject(json, "max_refresh_us", stats.max_refresh_time);
+    // Share of the refresh time spent waiting for transfers, lower means more render / flush overlap
+    int wait_percent = stats.refresh_time > 0 ? (int)(stats.flush_wait_time * 100 / stats.refresh_time) : 0;
+    cJSON_AddNumberToObject(json, "flush_wait_percent", wait_percent);
+    cJSON_AddNumberToObject(json, "flushed_pixels", (double)stats.flushed_pixels);
+    int64_t elapsed = esp_timer_get_time() - stats.start_time;
+    if (stats.start_time != 0 && elapsed > 0) {
+        cJSON_AddNumberToObject(json, "pixels_per_second", (double)(stats.flushed_pixels * 1000000 / elapsed));
+    }
+
+    // Status bar widget updates made, and skipped because the value was already shown
+    auto status_bar = cJSON_CreateObject();
+    {
+        DisplayLockGuard lock(this);
+        cJSON_AddNumberToObject(status_bar, "setter_calls", status_bar_.setter_calls());
+        cJSON_AddNumberToObject(status_bar, "setters_avoided", status_bar_.setters_avoided());
+    }
+    cJSON_AddItemToObject(json, "status_bar", status_bar);
+    return json;
+}
@@ -3,14 +3,35 @@
 
 #include "display.h"
 #include "lvgl_image.h"
+#include "status_bar_model.h"
 
 #include <lvgl.h>
 #include <esp_timer.h>
 #include <esp_log.h>
 #include <esp_pm.h>
+#include <cJSON.h>
 
+#include <atomic>
 #include <string>
 #include <chrono>
+#include <functional>
+#include <mutex>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+// Refresh timing collected from the LVGL display events, times in microseconds
+struct DisplayFlushStats {
+    uint32_t frames = 0;
+    uint32_t flushes = 0;
+    uint64_t refresh_time = 0;      // Whole refresh cycle, render plus flush
+    uint64_t render_time = 0;       // Drawing into the draw buffers, including waits
+    uint64_t flush_wait_time = 0;   // Renderer blocked because the target buffer was still being transferred
+    uint32_t max_refresh_time = 0;
+    uint64_t flushed_pixels = 0;    // Pixels handed to the panel, shrinks with smaller invalidated areas
+    int64_t start_time = 0;         // When counting started
+};
 
 class LvglDisplay : public Display {
 public:
@@ -24,6 +45,10 @@ public:
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Streams the JPEG to on_data piece by piece while the screen is encoded
+    virtual bool SnapshotToJpeg(std::function<void(const void* data, size_t len)> on_data, int quality = 80);
+    // The caller owns the returned object, includes the status bar setter counters
+    cJSON* GetFlushStatsJson();
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
@@ -36,17 +61,45 @@ protected:
     lv_obj_t *battery_label_ = nullptr;
     lv_obj_t* low_battery_popup_ = nullptr;
     lv_obj_t* low_battery_label_ = nullptr;
-    
-    const char* battery_icon_ = nullptr;
-    const char* network_icon_ = nullptr;
-    bool muted_ = false;
+
+    // What the status bar shows, only touched with the display locked
+    StatusBarModel status_bar_;
 
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    DisplayFlushStats flush_stats_;
+    int64_t refresh_start_time_ = 0;
+    int64_t render_start_time_ = 0;
+    int64_t flush_wait_start_time_ = 0;
+
+    // Call after display_ has been created
+    void EnableFlushStats();
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
+
+private:
+    // Battery and network state read by the status probe task, slow on some boards
+    // (ADC sampling, AT commands to a cellular modem), so never read with the display locked
+    struct StatusProbe {
+        bool has_battery = false;
+        int battery_level = 0;
+        bool charging = false;
+        bool discharging = false;
+        const char* network_icon = nullptr;
+    };
+
+    std::mutex probe_mutex_;
+    StatusProbe probe_;
+    TaskHandle_t status_probe_task_ = nullptr;
+    // Set by the destructor, the task finishes its probe, gives status_probe_done_ and
+    // waits to be deleted, so it is never deleted holding probe_mutex_ or mid AT command
+    std::atomic<bool> status_probe_stop_{false};
+    SemaphoreHandle_t status_probe_done_ = nullptr;
+
+    void StatusProbeTask();
 };
 
 
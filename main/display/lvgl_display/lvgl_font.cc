@@ -1,4 +1,6 @@
 #include "lvgl_font.h"
+#include "glyph_cache.h"
+#include "assets/hot_glyphs.h"
 #include <cbin_font.h>
 
 
@@ -7,7 +9,19 @@ LvglCBinFont::LvglCBinFont(void* data) {
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    GlyphCache::GetInstance().DetachFont(cached_font_);
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+void LvglCBinFont::EnableGlyphCache() {
+    if (font_ == nullptr || cached_font_ != nullptr) {
+        return;
+    }
+    auto& cache = GlyphCache::GetInstance();
+    cached_font_ = cache.AttachFont(font_);
+    if (cached_font_ != nullptr) {
+        cache.Prefill(cached_font_, HotGlyphs::kCodepoints, HotGlyphs::kCount);
+    }
+}
@@ -24,8 +24,13 @@ class LvglCBinFont : public LvglFont {
 public:
     LvglCBinFont(void* data);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override { return cached_font_ != nullptr ? cached_font_ : font_; }
+
+    // Draw through the shared GlyphCache and decode the most frequent characters now.
+    // Only for fonts rendered by LVGL, call before font() is handed to any object.
+    void EnableGlyphCache();
 
 private:
     lv_font_t* font_;
+    lv_font_t* cached_font_ = nullptr;
 };
@@ -0,0 +1,22 @@
+#include "status_bar_model.h"
+
+bool StatusBarModel::Set(Field field, const char* value) {
+    if (value == nullptr) {
+        value = "";
+    }
+    auto& field_value = fields_[field];
+    if (field_value.known && field_value.value == value) {
+        setters_avoided_++;
+        return false;
+    }
+    field_value.value = value;
+    field_value.known = true;
+    setter_calls_++;
+    return true;
+}
+
+void StatusBarModel::ResetAll() {
+    for (auto& field_value : fields_) {
+        field_value.known = false;
+    }
+}
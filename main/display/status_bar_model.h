@@ -0,0 +1,48 @@
+#ifndef STATUS_BAR_MODEL_H
+#define STATUS_BAR_MODEL_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * What the status bar widgets show. Every update goes through Set(), which tells
+ * whether the widget has to be touched, so the LVGL setters (and the relayout and
+ * redraw that follow them) only run when a value actually changes. Values are
+ * compared by content, icons of different boards come from different translation
+ * units. The model has no LVGL dependency and is tested on the host in
+ * scripts/status_bar_test.
+ */
+class StatusBarModel {
+public:
+    enum Field : uint8_t {
+        kClock,         // "HH:MM" shown in the status label while idle
+        kMute,
+        kBattery,
+        kNetwork,
+        kLowBattery,    // Low battery popup, "1" while shown
+        kFieldCount
+    };
+
+    // Returns true if the widget has to be updated to value, nullptr counts as ""
+    bool Set(Field field, const char* value);
+    bool SetVisible(Field field, bool visible) { return Set(field, visible ? "1" : ""); }
+    // Something else drew over the widget, the next Set() applies its value again
+    void Reset(Field field) { fields_[field].known = false; }
+    void ResetAll();
+
+    const std::string& value(Field field) const { return fields_[field].value; }
+    uint32_t setter_calls() const { return setter_calls_; }
+    uint32_t setters_avoided() const { return setters_avoided_; }
+
+private:
+    struct Value {
+        std::string value;
+        bool known = false;     // False until the widget was set through the model
+    };
+
+    Value fields_[kFieldCount];
+    uint32_t setter_calls_ = 0;
+    uint32_t setters_avoided_ = 0;
+};
+
+#endif // STATUS_BAR_MODEL_H
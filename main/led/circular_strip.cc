@@ -1,16 +1,17 @@
 #include "circular_strip.h"
 #include "application.h"
 #include <esp_log.h>
+#include <soc/soc_caps.h>
+#include <algorithm>
 
 #define TAG "CircularStrip"
 
-#define BLINK_INFINITE -1
-
 CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
     assert(gpio != GPIO_NUM_NC);
 
-    colors_.resize(max_leds_);
+    front_.resize(max_leds_);
+    back_.resize(max_leds_);
 
     led_strip_config_t strip_config = {};
     strip_config.strip_gpio_num = gpio;
@@ -20,16 +21,33 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
 
     led_strip_rmt_config_t rmt_config = {};
     rmt_config.resolution_hz = 10 * 1000 * 1000; // 10MHz
-
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
+#if SOC_RMT_SUPPORT_DMA
+    // A whole frame goes out by DMA, instead of an interrupt refilling the RMT memory every two LEDs
+    if (max_leds_ >= CIRCULAR_STRIP_DMA_MIN_LEDS) {
+        rmt_config.flags.with_dma = true;
+        rmt_config.mem_block_symbols = 1024;
+    }
+#endif
+
+    auto ret = led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_);
+#if SOC_RMT_SUPPORT_DMA
+    if (ret != ESP_OK && rmt_config.flags.with_dma) {
+        ESP_LOGW(TAG, "No DMA channel for the LED strip, using RMT memory");
+        rmt_config.flags.with_dma = false;
+        rmt_config.mem_block_symbols = 0;
+        ret = led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_);
+    }
+#endif
+    ESP_ERROR_CHECK(ret);
     led_strip_clear(led_strip_);
 
     esp_timer_create_args_t strip_timer_args = {
         .callback = [](void *arg) {
             auto strip = static_cast<CircularStrip*>(arg);
             std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
+            // Stale if a new effect started and armed the timer while this waited for the lock
+            if (!esp_timer_is_active(strip->strip_timer_)) {
+                strip->ShowFrame();
             }
         },
         .arg = this,
@@ -42,138 +60,99 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
 
 CircularStrip::~CircularStrip() {
     esp_timer_stop(strip_timer_);
+    esp_timer_delete(strip_timer_);
     if (led_strip_ != nullptr) {
+        if (transmitting_) {
+            led_strip_refresh_wait(led_strip_);
+        }
         led_strip_del(led_strip_);
     }
 }
 
 
 void CircularStrip::SetAllColor(StripColor color) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-    }
-    led_strip_refresh(led_strip_);
+    StartEffect(StripEffect::Frame(std::vector<StripColor>(max_leds_, color)));
 }
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    colors_[index] = color;
-    led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
-    led_strip_refresh(led_strip_);
+    std::vector<StripColor> colors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        colors = front_;
+    }
+    if (index < colors.size()) {
+        colors[index] = color;
+    }
+    StartEffect(StripEffect::Frame(colors));
 }
 
 void CircularStrip::Blink(StripColor color, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-    }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
-        } else {
-            led_strip_clear(led_strip_);
-        }
-        on = !on;
-    });
+    StartEffect(StripEffect::Blink(color, interval_ms));
 }
 
 void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
-        }
-    });
+    std::vector<StripColor> colors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        colors = front_;
+    }
+    StartEffect(StripEffect::FadeOut(colors, interval_ms));
 }
 
 void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
-            }
-            if (color.green > low.green) {
-                color.green--;
-            }
-            if (color.blue > low.blue) {
-                color.blue--;
-            }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
-            }
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-        }
-        led_strip_refresh(led_strip_);
-    });
+    StartEffect(StripEffect::Breathe(low, high, interval_ms));
 }
 
 void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = low;
-    }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
-        }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
+    StartEffect(StripEffect::Scroll(low, high, length, interval_ms, max_leds_));
 }
 
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
+void CircularStrip::StartEffect(StripEffect&& effect) {
     if (led_strip_ == nullptr) {
         return;
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    effect_ = std::move(effect);
+    effect_start_us_ = esp_timer_get_time();
+    next_frame_ms_ = 0;
+    effect_.Render(0, back_);
+    ShowFrame();
+}
+
+// Sends the frame rendered ahead in back_, then renders the one after it while the
+// RMT sends this one, and sleeps until it is due. Called with mutex_ held
+void CircularStrip::ShowFrame() {
+    if (next_frame_ms_ < 0) {
+        return;
+    }
+    // Sent one frame interval ago, the wait returns at once
+    if (transmitting_) {
+        led_strip_refresh_wait(led_strip_);
+        transmitting_ = false;
+    }
+    bool changed = false;
+    for (int i = 0; i < max_leds_; i++) {
+        if (back_[i] != front_[i]) {
+            led_strip_set_pixel(led_strip_, i, back_[i].red, back_[i].green, back_[i].blue);
+            changed = true;
+        }
+    }
+    if (changed) {
+        transmitting_ = led_strip_refresh_async(led_strip_) == ESP_OK;
+    }
+    std::swap(front_, back_);
+
+    // Frames missed while the timer task was busy are skipped
+    int64_t now_ms = (esp_timer_get_time() - effect_start_us_) / 1000;
+    next_frame_ms_ = effect_.GetNextFrameTime(std::max(next_frame_ms_, now_ms));
+    if (next_frame_ms_ < 0) {
+        return;
+    }
+    effect_.Render(next_frame_ms_, back_);
+    int64_t delay_us = effect_start_us_ + next_frame_ms_ * 1000 - esp_timer_get_time();
+    esp_timer_start_once(strip_timer_, std::max<int64_t>(delay_us, 1000));
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -2,6 +2,7 @@
 #define _CIRCULAR_STRIP_H_
 
 #include "led.h"
+#include "strip_effect.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
@@ -11,10 +12,8 @@
 
 #define DEFAULT_BRIGHTNESS 32
 #define LOW_BRIGHTNESS 4
-
-struct StripColor {
-    uint8_t red = 0, green = 0, blue = 0;
-};
+// Strips from this length on are sent by DMA where the RMT supports it
+#define CIRCULAR_STRIP_DMA_MIN_LEDS 8
 
 class CircularStrip : public Led {
 public:
@@ -31,20 +30,23 @@ public:
 
 private:
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     int max_leds_ = 0;
-    std::vector<StripColor> colors_;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
     esp_timer_handle_t strip_timer_ = nullptr;
-    std::function<void()> strip_callback_ = nullptr;
+    StripEffect effect_;
+    int64_t effect_start_us_ = 0;
+    // Effect time of the frame in back_, -1 once the effect stops changing
+    int64_t next_frame_ms_ = -1;
+    // front_ is on the strip, back_ is rendered ahead while front_ is being sent
+    std::vector<StripColor> front_;
+    std::vector<StripColor> back_;
+    bool transmitting_ = false;
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
     uint8_t low_brightness_ = LOW_BRIGHTNESS;
 
-    void StartStripTask(int interval_ms, std::function<void()> cb);
-    void Rainbow(StripColor low, StripColor high, int interval_ms);
+    void StartEffect(StripEffect&& effect);
+    void ShowFrame();
     void FadeOut(int interval_ms);
 };
 
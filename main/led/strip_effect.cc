@@ -0,0 +1,220 @@
+#include "strip_effect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#define PERCEPTUAL_MAX 1023
+
+namespace {
+
+struct GammaTables {
+    uint8_t encode[PERCEPTUAL_MAX + 1];
+    uint16_t decode[256];
+
+    GammaTables() {
+        for (int p = 0; p <= PERCEPTUAL_MAX; p++) {
+            encode[p] = (uint8_t)lround(255.0 * pow((double)p / PERCEPTUAL_MAX, 2.2));
+        }
+        // The encode table never steps by more than 1, so every value has a first
+        // perceptual value that encodes back to it exactly
+        int p = 0;
+        for (int v = 0; v < 256; v++) {
+            while (encode[p] < v) {
+                p++;
+            }
+            decode[v] = p;
+        }
+    }
+};
+
+const GammaTables& Gamma() {
+    static GammaTables tables;
+    return tables;
+}
+
+const StripColor kWhite = {255, 255, 255};
+const StripColor kBlack = {0, 0, 0};
+
+} // namespace
+
+uint16_t StripEffect::Decode(uint8_t value) {
+    return Gamma().decode[value];
+}
+
+uint8_t StripEffect::Encode(uint16_t perceptual) {
+    return Gamma().encode[std::min<uint16_t>(perceptual, PERCEPTUAL_MAX)];
+}
+
+StripEffect StripEffect::Frame(const std::vector<StripColor>& colors) {
+    StripEffect effect;
+    effect.keyframes_ = {{0, kWhite, true}};
+    effect.base_ = colors;
+    return effect;
+}
+
+StripEffect StripEffect::Blink(StripColor color, int interval_ms) {
+    interval_ms = std::max(interval_ms, STRIP_EFFECT_FRAME_MS);
+    StripEffect effect;
+    effect.keyframes_ = {{0, color, true}, {interval_ms, kBlack, true}};
+    effect.period_ms_ = 2 * interval_ms;
+    return effect;
+}
+
+StripEffect StripEffect::Breathe(StripColor low, StripColor high, int interval_ms) {
+    interval_ms = std::max(interval_ms, STRIP_EFFECT_FRAME_MS);
+    int steps = std::max({abs(high.red - low.red), abs(high.green - low.green), abs(high.blue - low.blue)});
+    StripEffect effect;
+    if (steps == 0) {
+        effect.keyframes_ = {{0, low, true}};
+        return effect;
+    }
+    effect.keyframes_ = {{0, low, false}, {steps * interval_ms, high, false}};
+    effect.period_ms_ = 2 * steps * interval_ms;
+    return effect;
+}
+
+StripEffect StripEffect::Scroll(StripColor low, StripColor high, int length, int interval_ms, int leds) {
+    interval_ms = std::max(interval_ms, STRIP_EFFECT_FRAME_MS);
+    leds = std::max(leds, 1);
+    StripEffect effect;
+    if (length <= 0 || length >= leds) {
+        effect.keyframes_ = {{0, length <= 0 ? low : high, true}};
+        return effect;
+    }
+    // Seen from one LED, the lit run arrives, passes in length intervals, and comes back
+    // after going once around the strip
+    effect.keyframes_ = {{0, high, true}, {interval_ms, low, true}};
+    if (length > 1) {
+        effect.keyframes_.push_back({(leds - length + 1) * interval_ms, high, true});
+    }
+    effect.period_ms_ = leds * interval_ms;
+    effect.led_delay_ms_ = interval_ms;
+    effect.leds_ = leds;
+    return effect;
+}
+
+StripEffect StripEffect::FadeOut(const std::vector<StripColor>& from, int interval_ms) {
+    interval_ms = std::max(interval_ms, STRIP_EFFECT_FRAME_MS);
+    int brightest = 0;
+    for (auto& color : from) {
+        brightest = std::max({brightest, (int)color.red, (int)color.green, (int)color.blue});
+    }
+    int steps = 0;
+    for (; brightest > 0; brightest /= 2) {
+        steps++;
+    }
+    StripEffect effect = Frame(from);
+    if (steps > 0) {
+        effect.keyframes_ = {{0, kWhite, false}, {steps * interval_ms, kBlack, true}};
+    }
+    return effect;
+}
+
+int64_t StripEffect::GetLocalTime(int64_t t_ms, int led) const {
+    int64_t local = t_ms - (int64_t)led * led_delay_ms_;
+    if (period_ms_ > 0) {
+        local %= period_ms_;
+        if (local < 0) {
+            local += period_ms_;
+        }
+    }
+    return std::max<int64_t>(local, 0);
+}
+
+int StripEffect::FindKeyframe(int64_t local_ms) const {
+    int index = -1;
+    for (size_t i = 0; i < keyframes_.size() && keyframes_[i].time_ms <= local_ms; i++) {
+        index = i;
+    }
+    return index;
+}
+
+const StripKeyframe* StripEffect::GetNextKeyframe(int index, int64_t& end_ms) const {
+    if (index + 1 < (int)keyframes_.size()) {
+        end_ms = keyframes_[index + 1].time_ms;
+        return &keyframes_[index + 1];
+    }
+    if (period_ms_ > 0) {
+        end_ms = period_ms_;
+        return &keyframes_[0];
+    }
+    return nullptr;
+}
+
+StripColor StripEffect::ColorAt(int64_t local_ms, const StripColor* base) const {
+    int index = std::max(FindKeyframe(local_ms), 0);
+    auto& from = keyframes_[index];
+    int64_t end_ms = 0;
+    auto to = GetNextKeyframe(index, end_ms);
+    bool fading = !from.hold && to != nullptr && local_ms > from.time_ms;
+    if (!fading && base == nullptr) {
+        return from.color;
+    }
+
+    // Integer interpolation in perceptual space with an 8 bit fraction. Over a base frame
+    // the result is a gain, so that the base colors keep their hue while fading
+    const StripColor& target = fading ? to->color : from.color;
+    const StripColor& under = base ? *base : kBlack;
+    const uint8_t a[3] = {from.color.red, from.color.green, from.color.blue};
+    const uint8_t b[3] = {target.red, target.green, target.blue};
+    const uint8_t c[3] = {under.red, under.green, under.blue};
+    int fraction = fading ? (int)((local_ms - from.time_ms) * 256 / (end_ms - from.time_ms)) : 0;
+    uint8_t out[3];
+    for (int i = 0; i < 3; i++) {
+        int pa = Decode(a[i]);
+        int p = pa + (Decode(b[i]) - pa) * fraction / 256;
+        out[i] = base ? Encode(Decode(c[i]) * p / PERCEPTUAL_MAX) : Encode(p);
+    }
+    return {out[0], out[1], out[2]};
+}
+
+void StripEffect::Render(int64_t t_ms, std::vector<StripColor>& frame) const {
+    if (keyframes_.empty()) {
+        std::fill(frame.begin(), frame.end(), kBlack);
+        return;
+    }
+    if (led_delay_ms_ == 0 && base_.empty()) {
+        std::fill(frame.begin(), frame.end(), ColorAt(GetLocalTime(t_ms, 0), nullptr));
+        return;
+    }
+    for (size_t i = 0; i < frame.size(); i++) {
+        if (base_.empty()) {
+            frame[i] = ColorAt(GetLocalTime(t_ms, i), nullptr);
+        } else {
+            const StripColor& base = i < base_.size() ? base_[i] : kBlack;
+            frame[i] = ColorAt(GetLocalTime(t_ms, i), &base);
+        }
+    }
+}
+
+int64_t StripEffect::GetNextLocalChange(int64_t local_ms) const {
+    int index = std::max(FindKeyframe(local_ms), 0);
+    auto& from = keyframes_[index];
+    int64_t end_ms = 0;
+    auto to = GetNextKeyframe(index, end_ms);
+    if (to == nullptr) {
+        return -1;
+    }
+    if (from.hold || from.color == to->color) {
+        return end_ms - local_ms;
+    }
+    // Fading frames stay on the grid of the keyframe they started from
+    int64_t frame = STRIP_EFFECT_FRAME_MS - (local_ms - from.time_ms) % STRIP_EFFECT_FRAME_MS;
+    return std::min(frame, end_ms - local_ms);
+}
+
+int64_t StripEffect::GetNextFrameTime(int64_t t_ms) const {
+    if (keyframes_.empty()) {
+        return -1;
+    }
+    int64_t next = -1;
+    int leds = led_delay_ms_ > 0 ? leds_ : 1;
+    for (int i = 0; i < leds; i++) {
+        int64_t delta = GetNextLocalChange(GetLocalTime(t_ms, i));
+        if (delta > 0 && (next < 0 || delta < next)) {
+            next = delta;
+        }
+    }
+    return next < 0 ? -1 : t_ms + next;
+}
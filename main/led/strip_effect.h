@@ -0,0 +1,86 @@
+#ifndef _STRIP_EFFECT_H_
+#define _STRIP_EFFECT_H_
+
+#include <cstdint>
+#include <vector>
+
+// Frame interval while an effect fades, and the shortest effect interval
+#define STRIP_EFFECT_FRAME_MS 20
+
+struct StripColor {
+    uint8_t red = 0, green = 0, blue = 0;
+
+    bool operator==(const StripColor& other) const {
+        return red == other.red && green == other.green && blue == other.blue;
+    }
+    bool operator!=(const StripColor& other) const { return !(*this == other); }
+};
+
+// The color at time_ms. It fades to the next keyframe, unless hold is set, then it
+// stays until the next keyframe
+struct StripKeyframe {
+    int32_t time_ms;
+    StripColor color;
+    bool hold;
+};
+
+/*
+ * An LED strip effect compiled into a keyframe table, so that a frame costs a table
+ * lookup per LED instead of stepping colors in a timer callback:
+ *
+ *   Blink      two held keyframes
+ *   Breathe    two fading keyframes
+ *   Scroll     three held keyframes, every LED one interval behind the previous one
+ *   FadeOut    a fading gain from 1 to 0 over the frame that was shown
+ *
+ * Colors fade in perceptual space, through gamma tables, with integer arithmetic. The
+ * keyframe colors themselves are output exactly. Effects are plain C++, so they render on
+ * the host (scripts/strip_effect_test).
+ */
+class StripEffect {
+public:
+    StripEffect() = default;
+
+    // A frame that does not change
+    static StripEffect Frame(const std::vector<StripColor>& colors);
+    // On for interval_ms, off for interval_ms
+    static StripEffect Blink(StripColor color, int interval_ms);
+    // From low to high and back, every channel takes up to interval_ms per step as before
+    static StripEffect Breathe(StripColor low, StripColor high, int interval_ms);
+    // length LEDs in high move one LED further every interval_ms, the others are low
+    static StripEffect Scroll(StripColor low, StripColor high, int length, int interval_ms, int leds);
+    // Fades the frame out in as many intervals as halving its brightest channel down to 0 takes
+    static StripEffect FadeOut(const std::vector<StripColor>& from, int interval_ms);
+
+    // Renders the frame at t_ms since the effect started into frame, which sets the number of LEDs
+    void Render(int64_t t_ms, std::vector<StripColor>& frame) const;
+    // The next time after t_ms at which the frame can change, -1 if it never does
+    int64_t GetNextFrameTime(int64_t t_ms) const;
+
+    const std::vector<StripKeyframe>& keyframes() const { return keyframes_; }
+    // Looping effects start over after period_ms, 0 for effects that stop at the last keyframe
+    int32_t period_ms() const { return period_ms_; }
+
+    // 8 bit LED values to 10 bit perceptual values and back, gamma 2.2
+    static uint16_t Decode(uint8_t value);
+    static uint8_t Encode(uint16_t perceptual);
+
+private:
+    std::vector<StripKeyframe> keyframes_;
+    int32_t period_ms_ = 0;
+    // LED i runs i * led_delay_ms_ behind LED 0, for leds_ LEDs
+    int32_t led_delay_ms_ = 0;
+    int leds_ = 1;
+    // If not empty, keyframe colors are gains applied to this frame
+    std::vector<StripColor> base_;
+
+    int64_t GetLocalTime(int64_t t_ms, int led) const;
+    // Index of the keyframe the local time is in, -1 before the first one
+    int FindKeyframe(int64_t local_ms) const;
+    // The keyframe after index, wrapping around in looping effects, null after the last one
+    const StripKeyframe* GetNextKeyframe(int index, int64_t& end_ms) const;
+    StripColor ColorAt(int64_t local_ms, const StripColor* base) const;
+    int64_t GetNextLocalChange(int64_t local_ms) const;
+};
+
+#endif // _STRIP_EFFECT_H_
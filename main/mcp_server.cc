@@ -7,6 +7,7 @@
 #include <esp_log.h>
 #include <esp_app_desc.h>
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <esp_pthread.h>
 
@@ -15,11 +16,46 @@
 #include "oled_display.h"
 #include "board.h"
 #include "settings.h"
+#include "system_profiler.h"
+#include "task_stack_recorder.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
 
 #define TAG "MCP"
 
+// The photo options are in the camera menu, which targets without a camera do not have
+#ifndef CONFIG_XIAOZHI_CAMERA_PHOTO_MAX_SIZE
+#define CONFIG_XIAOZHI_CAMERA_PHOTO_MAX_SIZE 0
+#endif
+#ifndef CONFIG_XIAOZHI_CAMERA_PHOTO_QUALITY
+#define CONFIG_XIAOZHI_CAMERA_PHOTO_QUALITY 80
+#endif
+
+// "" or "full" for the whole frame, "center" for its middle half, or "x,y,w,h" in percent
+static bool ParsePhotoCrop(const std::string& crop, PhotoOptions& options) {
+    if (crop.empty() || crop == "full") {
+        options.crop_x = options.crop_y = options.crop_width = options.crop_height = 0;
+        return true;
+    }
+    if (crop == "center" || crop == "centre") {
+        options.crop_x = options.crop_y = 25;
+        options.crop_width = options.crop_height = 50;
+        return true;
+    }
+    int x, y, w, h;
+    if (sscanf(crop.c_str(), "%d,%d,%d,%d", &x, &y, &w, &h) != 4) {
+        return false;
+    }
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > 100 || y + h > 100) {
+        return false;
+    }
+    options.crop_x = x;
+    options.crop_y = y;
+    options.crop_width = w;
+    options.crop_height = h;
+    return true;
+}
+
 McpServer::McpServer() {
 }
 
@@ -103,12 +139,25 @@ void McpServer::AddCommonTools() {
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
+            "  `max_size`: Longest side of the uploaded photo in pixels, 0 for full resolution. Raise it for small details.\n"
+            "  `quality`: JPEG quality, 1 to 100.\n"
+            "  `crop`: `center` to look closer at the middle of the view, or `x,y,w,h` in percent of the view.\n"
             "Return:\n"
             "  A JSON object that provides the photo information.",
             PropertyList({
-                Property("question", kPropertyTypeString)
+                Property("question", kPropertyTypeString),
+                Property("max_size", kPropertyTypeInteger, CONFIG_XIAOZHI_CAMERA_PHOTO_MAX_SIZE, 0, 4096),
+                Property("quality", kPropertyTypeInteger, CONFIG_XIAOZHI_CAMERA_PHOTO_QUALITY, 1, 100),
+                Property("crop", kPropertyTypeString, std::string())
             }),
             [camera](const PropertyList& properties) -> ReturnValue {
+                PhotoOptions options;
+                options.max_size = properties["max_size"].value<int>();
+                options.quality = properties["quality"].value<int>();
+                if (!ParsePhotoCrop(properties["crop"].value<std::string>(), options)) {
+                    throw std::runtime_error("Invalid crop, use center or x,y,w,h in percent");
+                }
+
                 // Lower the priority to do the camera capture
                 TaskPriorityReset priority_reset(1);
 
@@ -116,7 +165,7 @@ void McpServer::AddCommonTools() {
                     throw std::runtime_error("Failed to capture photo");
                 }
                 auto question = properties["question"].value<std::string>();
-                return camera->Explain(question);
+                return camera->Explain(question, options);
             });
     }
 #endif
@@ -135,6 +184,35 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+#if CONFIG_USE_SYSTEM_PROFILER
+    AddUserOnlyTool("self.system.get_profile",
+        "Get the recent CPU usage per task, stack high water marks and heap statistics",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return SystemProfiler::GetInstance().GetProfileJson();
+        });
+#endif
+
+#if CONFIG_USE_TASK_STACK_RECORDER
+    AddUserOnlyTool("self.system.get_stack_report",
+        "Get the configured stack size and the deepest recorded stack usage (bytes) of each application task, "
+        "`max_used` covers all sessions since the last reset.\n"
+        "Args:\n"
+        "  `reset`: Clear the recorded values after returning them",
+        PropertyList({
+            Property("reset", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& recorder = TaskStackRecorder::GetInstance();
+            recorder.Sample();
+            auto json = recorder.GetReportJson();
+            if (properties["reset"].value<bool>()) {
+                recorder.Reset();
+            }
+            return json;
+        });
+#endif
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
@@ -188,6 +266,12 @@ void McpServer::AddUserOnlyTools() {
                 return json;
             });
 
+        AddUserOnlyTool("self.screen.get_flush_stats", "Render and flush timing, pixels flushed per second, and status bar updates made and skipped, of the screen since boot",
+            PropertyList(),
+            [display](const PropertyList& properties) -> ReturnValue {
+                return display->GetFlushStatsJson();
+            });
+
 #if CONFIG_LV_USE_SNAPSHOT
         AddUserOnlyTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
             PropertyList({
@@ -198,13 +282,6 @@ void McpServer::AddUserOnlyTools() {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
-                }
-
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
                 // 构造multipart/form-data请求体
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
                 
@@ -223,8 +300,17 @@ void McpServer::AddUserOnlyTools() {
                     http->Write(file_header.c_str(), file_header.size());
                 }
 
-                // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                // JPEG数据，编码器每输出一段就直接写入请求体，不在内存中拼接整张图片
+                size_t jpeg_size = 0;
+                bool encoded = display->SnapshotToJpeg([&http, &jpeg_size](const void* data, size_t len) {
+                    http->Write(static_cast<const char*>(data), len);
+                    jpeg_size += len;
+                }, quality);
+                if (!encoded) {
+                    http->Close();
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ESP_LOGI(TAG, "Uploaded snapshot %u bytes to %s", jpeg_size, url.c_str());
 
                 {
                     // multipart尾部
@@ -523,29 +609,21 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
     }
 
     PropertyList arguments = (*tool_iter)->properties();
-    try {
+    ToolArguments values;
+    if (cJSON_IsObject(tool_arguments)) {
         for (auto& argument : arguments) {
-            bool found = false;
-            if (cJSON_IsObject(tool_arguments)) {
-                auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                    argument.set_value<bool>(value->valueint == 1);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                    argument.set_value<int>(value->valueint);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                    argument.set_value<std::string>(value->valuestring);
-                    found = true;
-                }
-            }
-
-            if (!argument.has_default_value() && !found) {
-                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
-                return;
+            auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
+            if (cJSON_IsBool(value)) {
+                values[argument.name()] = value->valueint == 1;
+            } else if (cJSON_IsNumber(value)) {
+                values[argument.name()] = value->valueint;
+            } else if (cJSON_IsString(value)) {
+                values[argument.name()] = std::string(value->valuestring);
             }
         }
+    }
+    try {
+        BindArguments(arguments, values);
     } catch (const std::exception& e) {
         ESP_LOGE(TAG, "tools/call: %s", e.what());
         ReplyError(id, e.what());
@@ -563,3 +641,56 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
         }
     });
 }
+
+void McpServer::BindArguments(PropertyList& properties, const ToolArguments& arguments) {
+    for (auto& property : properties) {
+        bool found = false;
+        auto value = arguments.find(property.name());
+        if (value != arguments.end()) {
+            if (property.type() == kPropertyTypeBoolean && std::holds_alternative<bool>(value->second)) {
+                property.set_value<bool>(std::get<bool>(value->second));
+                found = true;
+            } else if (property.type() == kPropertyTypeInteger && std::holds_alternative<int>(value->second)) {
+                property.set_value<int>(std::get<int>(value->second));
+                found = true;
+            } else if (property.type() == kPropertyTypeString && std::holds_alternative<std::string>(value->second)) {
+                property.set_value<std::string>(std::get<std::string>(value->second));
+                found = true;
+            }
+        }
+
+        if (!property.has_default_value() && !found) {
+            throw std::invalid_argument("Missing valid argument: " + property.name());
+        }
+    }
+}
+
+bool McpServer::CallTool(const std::string& tool_name, const ToolArguments& arguments) {
+    auto tool_iter = std::find_if(tools_.begin(), tools_.end(),
+                                 [&tool_name](const McpTool* tool) {
+                                     return tool->name() == tool_name;
+                                 });
+    if (tool_iter == tools_.end()) {
+        ESP_LOGW(TAG, "Local call: Unknown tool: %s", tool_name.c_str());
+        return false;
+    }
+
+    PropertyList properties = (*tool_iter)->properties();
+    try {
+        BindArguments(properties, arguments);
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "Local call %s: %s", tool_name.c_str(), e.what());
+        return false;
+    }
+
+    auto& app = Application::GetInstance();
+    app.Schedule([tool = *tool_iter, properties = std::move(properties)]() {
+        try {
+            tool->Call(properties);
+            ESP_LOGI(TAG, "Local call %s done", tool->name().c_str());
+        } catch (const std::exception& e) {
+            ESP_LOGE(TAG, "Local call %s: %s", tool->name().c_str(), e.what());
+        }
+    });
+    return true;
+}
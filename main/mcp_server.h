@@ -48,6 +48,8 @@ public:
 
 // 添加类型别名
 using ReturnValue = std::variant<bool, int, std::string, cJSON*, ImageContent*>;
+// Tool call arguments by property name
+using ToolArguments = std::map<std::string, std::variant<bool, int, std::string>>;
 
 enum PropertyType {
     kPropertyTypeBoolean,
@@ -325,6 +327,9 @@ public:
     void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    // Calls a tool from the device itself on the main thread, without a reply. False if the
+    // tool does not exist or an argument is missing or invalid
+    bool CallTool(const std::string& tool_name, const ToolArguments& arguments);
 
 private:
     McpServer();
@@ -337,6 +342,9 @@ private:
 
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
+    // Sets the properties from the arguments. Arguments of the wrong type count as missing,
+    // throws if a property without a default value is missing
+    static void BindArguments(PropertyList& properties, const ToolArguments& arguments);
 
     std::vector<McpTool*> tools_;
 };
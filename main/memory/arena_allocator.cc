@@ -0,0 +1,268 @@
+#include "arena_allocator.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "Memory"
+
+static uint32_t PlacementCaps(MemoryPlacement placement) {
+    switch (placement) {
+        case kPlacementDmaInternal:
+            return MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        case kPlacementInternal:
+            return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        case kPlacementPsram:
+        case kPlacementPsramPreferred:
+        default:
+            return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    }
+}
+
+static const char* PlacementName(MemoryPlacement placement) {
+    switch (placement) {
+        case kPlacementDmaInternal:
+            return "dma";
+        case kPlacementInternal:
+            return "internal";
+        case kPlacementPsram:
+            return "psram";
+        case kPlacementPsramPreferred:
+        default:
+            return "psram_preferred";
+    }
+}
+
+static void* CapsAlloc(size_t size, uint32_t caps, size_t alignment) {
+    if (alignment > 0) {
+        return heap_caps_aligned_alloc(alignment, size, caps);
+    }
+    return heap_caps_malloc(size, caps);
+}
+
+void* MemoryPlacementAlloc(size_t size, MemoryPlacement placement, size_t alignment) {
+    void* ptr = CapsAlloc(size, PlacementCaps(placement), alignment);
+    if (ptr == nullptr && placement == kPlacementPsramPreferred) {
+        ptr = CapsAlloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, alignment);
+    }
+    return ptr;
+}
+
+// MemoryRegion
+
+MemoryRegion::MemoryRegion(const char* name, MemoryPlacement placement, size_t budget)
+    : name_(name), placement_(placement), budget_(budget) {
+}
+
+void* MemoryRegion::Allocate(size_t size, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (budget_ > 0 && used_ + size > budget_) {
+        failures_++;
+        ESP_LOGW(TAG, "Region %s over budget: used %u + %u > %u", name_.c_str(), used_, size, budget_);
+        return nullptr;
+    }
+
+    void* ptr = MemoryPlacementAlloc(size, placement_, alignment);
+    if (ptr == nullptr) {
+        failures_++;
+        ESP_LOGE(TAG, "Region %s failed to allocate %u bytes (%s)", name_.c_str(), size, PlacementName(placement_));
+        return nullptr;
+    }
+
+    // The heap rounds blocks up. The budget holds the real block size, the same value
+    // that is accounted here and that Free() subtracts
+    size_t allocated = heap_caps_get_allocated_size(ptr);
+    if (budget_ > 0 && used_ + allocated > budget_) {
+        heap_caps_free(ptr);
+        failures_++;
+        ESP_LOGW(TAG, "Region %s over budget: used %u + %u > %u", name_.c_str(), used_, allocated, budget_);
+        return nullptr;
+    }
+    used_ += allocated;
+    peak_ = std::max(peak_, used_);
+    allocations_++;
+    return ptr;
+}
+
+void MemoryRegion::Free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t size = heap_caps_get_allocated_size(ptr);
+    used_ = used_ > size ? used_ - size : 0;
+    heap_caps_free(ptr);
+}
+
+void MemoryRegion::Detach(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t size = heap_caps_get_allocated_size(ptr);
+    used_ = used_ > size ? used_ - size : 0;
+}
+
+void MemoryRegion::SetBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+}
+
+cJSON* MemoryRegion::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "placement", PlacementName(placement_));
+    cJSON_AddNumberToObject(json, "budget", budget_);
+    cJSON_AddNumberToObject(json, "used", used_);
+    cJSON_AddNumberToObject(json, "peak", peak_);
+    cJSON_AddNumberToObject(json, "allocations", allocations_);
+    cJSON_AddNumberToObject(json, "failures", failures_);
+    return json;
+}
+
+// MemoryArena
+
+MemoryArena::MemoryArena(MemoryRegion& region, size_t capacity) : region_(region) {
+    if (capacity > 0) {
+        Reserve(capacity);
+    }
+}
+
+MemoryArena::~MemoryArena() {
+    Release();
+}
+
+bool MemoryArena::Reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return true;
+    }
+    if (offset_ != 0) {
+        ESP_LOGE(TAG, "Arena in region %s cannot grow while in use", region_.name().c_str());
+        return false;
+    }
+
+    // Free the old block first so that the new one can reuse its space
+    Release();
+    block_ = (uint8_t*)region_.Allocate(capacity, 16);
+    if (block_ == nullptr) {
+        return false;
+    }
+    capacity_ = capacity;
+    return true;
+}
+
+void* MemoryArena::Allocate(size_t size, size_t alignment) {
+    if (alignment == 0) {
+        alignment = 1;
+    }
+    // Align the address, the block itself is only 16 byte aligned
+    uintptr_t base = (uintptr_t)block_;
+    size_t start = ((base + offset_ + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    if (block_ == nullptr || start + size > capacity_) {
+        return nullptr;
+    }
+    offset_ = start + size;
+    return block_ + start;
+}
+
+void MemoryArena::Release() {
+    if (block_ != nullptr) {
+        region_.Free(block_);
+        block_ = nullptr;
+    }
+    capacity_ = 0;
+    offset_ = 0;
+}
+
+// MemoryRegistry
+
+MemoryRegistry::MemoryRegistry() {
+    // Budgets are upper bounds for each subsystem, not reservations. Esp32Camera sizes the
+    // camera region from the sensor resolution once it is known
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_CAMERA, kPlacementPsram, 4 * 1024 * 1024));
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_JPEG, kPlacementPsramPreferred, 2 * 1024 * 1024));
+    // Whole frame buffers of one JPEG encode, freed when it is done. Their size follows the image,
+    // so they are accounted without a budget
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_JPEG_FRAME, kPlacementPsramPreferred, 0));
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_GIF, kPlacementPsramPreferred, 1024 * 1024));
+#if CONFIG_GIF_FRAME_CACHE_SIZE > 0
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_GIF_CACHE, kPlacementPsram, CONFIG_GIF_FRAME_CACHE_SIZE * 1024));
+#endif
+#if CONFIG_GLYPH_CACHE_SIZE > 0
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_GLYPH_CACHE, kPlacementPsram, CONFIG_GLYPH_CACHE_SIZE * 1024));
+#endif
+}
+
+MemoryRegistry::~MemoryRegistry() {
+    for (auto region : regions_) {
+        delete region;
+    }
+}
+
+MemoryRegion* MemoryRegistry::GetRegion(const char* name) {
+    for (auto region : regions_) {
+        if (region->name() == name) {
+            return region;
+        }
+    }
+    return nullptr;
+}
+
+static cJSON* HeapStatsJson(uint32_t caps) {
+    size_t free_size = heap_caps_get_free_size(caps);
+    size_t largest_block = heap_caps_get_largest_free_block(caps);
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "free", free_size);
+    cJSON_AddNumberToObject(json, "min_free", heap_caps_get_minimum_free_size(caps));
+    cJSON_AddNumberToObject(json, "largest_block", largest_block);
+    // 0% means all free memory is one block, close to 100% means it is scattered in small pieces
+    int fragmentation = free_size > 0 ? 100 - (int)(largest_block * 100 / free_size) : 0;
+    cJSON_AddNumberToObject(json, "fragmentation", fragmentation);
+    return json;
+}
+
+cJSON* MemoryRegistry::GetStatsJson() {
+    auto json = cJSON_CreateObject();
+    auto heaps = cJSON_CreateObject();
+    cJSON_AddItemToObject(heaps, "internal", HeapStatsJson(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    cJSON_AddItemToObject(heaps, "dma", HeapStatsJson(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+        cJSON_AddItemToObject(heaps, "psram", HeapStatsJson(MALLOC_CAP_SPIRAM));
+    }
+    cJSON_AddItemToObject(json, "heaps", heaps);
+
+    auto regions = cJSON_CreateObject();
+    for (auto region : regions_) {
+        cJSON_AddItemToObject(regions, region->name().c_str(), region->GetStatsJson());
+    }
+    cJSON_AddItemToObject(json, "regions", regions);
+    return json;
+}
+
+void MemoryRegistry::PrintStats() {
+    for (auto region : regions_) {
+        ESP_LOGI(TAG, "%-8s used %7u peak %7u budget %7u", region->name().c_str(), region->used(), region->peak(),
+            region->budget());
+    }
+}
+
+// C interface
+
+void* memory_region_malloc(const char* region, size_t size) {
+    auto r = MemoryRegistry::GetInstance().GetRegion(region);
+    if (r == nullptr) {
+        ESP_LOGE(TAG, "Unknown memory region: %s", region);
+        return nullptr;
+    }
+    return r->Allocate(size);
+}
+
+void memory_region_free(const char* region, void* ptr) {
+    auto r = MemoryRegistry::GetInstance().GetRegion(region);
+    if (r == nullptr) {
+        heap_caps_free(ptr);
+        return;
+    }
+    r->Free(ptr);
+}
@@ -0,0 +1,137 @@
+#ifndef _ARENA_ALLOCATOR_H_
+#define _ARENA_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Subsystem names shared with C code (gifdec)
+#define MEMORY_REGION_CAMERA "camera"
+#define MEMORY_REGION_JPEG   "jpeg"
+#define MEMORY_REGION_JPEG_FRAME "jpeg_frame"
+#define MEMORY_REGION_GIF    "gif"
+#define MEMORY_REGION_GIF_CACHE "gif_cache"
+#define MEMORY_REGION_GLYPH_CACHE "glyph_cache"
+
+// C entry points for code that cannot use the classes below
+void* memory_region_malloc(const char* region, size_t size);
+void memory_region_free(const char* region, void* ptr);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cJSON.h>
+
+enum MemoryPlacement {
+    kPlacementDmaInternal,      // DMA capable internal RAM (SPI / I2S / LCD transfers)
+    kPlacementInternal,         // Internal RAM only, for latency sensitive data
+    kPlacementPsram,            // PSRAM only, fail if there is none
+    kPlacementPsramPreferred,   // PSRAM, falling back to internal RAM on chips without it
+};
+
+// Allocate memory according to the placement policy, free with heap_caps_free()
+void* MemoryPlacementAlloc(size_t size, MemoryPlacement placement, size_t alignment = 0);
+
+/**
+ * A named allocation budget for one subsystem. All allocations are made with
+ * the subsystem's placement policy and are accounted against its budget, so
+ * one feature cannot silently eat the internal RAM that Wi-Fi and DMA need.
+ */
+class MemoryRegion {
+public:
+    MemoryRegion(const char* name, MemoryPlacement placement, size_t budget);
+
+    void* Allocate(size_t size, size_t alignment = 0);
+    void Free(void* ptr);
+    // Stop accounting a block whose ownership leaves the subsystem (freed later with heap_caps_free)
+    void Detach(void* ptr);
+    // For subsystems whose needs are only known at run time, blocks already allocated are kept
+    void SetBudget(size_t budget);
+
+    const std::string& name() const { return name_; }
+    MemoryPlacement placement() const { return placement_; }
+    size_t budget() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return budget_;
+    }
+    size_t used() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return used_;
+    }
+    size_t peak() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return peak_;
+    }
+    cJSON* GetStatsJson();
+
+private:
+    std::string name_;
+    MemoryPlacement placement_;
+    size_t budget_;     // 0 means unlimited
+    mutable std::mutex mutex_;
+    size_t used_ = 0;
+    size_t peak_ = 0;
+    uint32_t allocations_ = 0;
+    uint32_t failures_ = 0;
+};
+
+/**
+ * Bump allocator over a single block owned by a region. The block is kept
+ * between uses and only grows, so per-call scratch buffers stop churning
+ * the heap. Reset() releases all allocations at once.
+ */
+class MemoryArena {
+public:
+    MemoryArena(MemoryRegion& region, size_t capacity = 0);
+    ~MemoryArena();
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    // Make sure at least capacity bytes are available after Reset()
+    bool Reserve(size_t capacity);
+    void* Allocate(size_t size, size_t alignment = 16);
+    void Reset() { offset_ = 0; }
+    // Return the block to the region
+    void Release();
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return offset_; }
+
+private:
+    MemoryRegion& region_;
+    uint8_t* block_ = nullptr;
+    size_t capacity_ = 0;
+    size_t offset_ = 0;
+};
+
+class MemoryRegistry {
+public:
+    static MemoryRegistry& GetInstance() {
+        static MemoryRegistry instance;
+        return instance;
+    }
+    MemoryRegistry(const MemoryRegistry&) = delete;
+    MemoryRegistry& operator=(const MemoryRegistry&) = delete;
+
+    // Returns nullptr for unknown names
+    MemoryRegion* GetRegion(const char* name);
+    // Region budgets plus per-heap fragmentation figures
+    cJSON* GetStatsJson();
+    void PrintStats();
+
+private:
+    MemoryRegistry();
+    ~MemoryRegistry();
+
+    std::vector<MemoryRegion*> regions_;
+};
+
+#endif // __cplusplus
+
+#endif // _ARENA_ALLOCATOR_H_
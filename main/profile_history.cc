@@ -0,0 +1,60 @@
+#include "profile_history.h"
+
+#include <algorithm>
+
+std::vector<TaskUsage> ProfileHistory::ComputeTaskUsage(const std::vector<TaskSnapshot>& prev,
+    const std::vector<TaskSnapshot>& curr, uint32_t elapsed_run_time, int cores) {
+    std::vector<TaskUsage> usage;
+    usage.reserve(curr.size());
+    uint64_t capacity = (uint64_t)elapsed_run_time * cores;
+
+    for (auto& task : curr) {
+        uint32_t task_elapsed = 0;
+        auto it = std::find_if(prev.begin(), prev.end(), [&task](const TaskSnapshot& t) {
+            return t.handle == task.handle;
+        });
+        // A deleted task's handle can be reused by a new task, whose counter starts over
+        if (it != prev.end() && it->name == task.name) {
+            // Unsigned subtraction keeps the delta correct across counter wrap-around
+            task_elapsed = task.run_time - it->run_time;
+        }
+
+        uint8_t percent = 0;
+        if (capacity > 0) {
+            percent = (uint8_t)std::min<uint64_t>(100, (uint64_t)task_elapsed * 100 / capacity);
+        }
+        usage.push_back({task.name, percent, task.stack_high_water_mark});
+    }
+
+    std::stable_sort(usage.begin(), usage.end(), [](const TaskUsage& a, const TaskUsage& b) {
+        return a.cpu_percent > b.cpu_percent;
+    });
+    return usage;
+}
+
+uint8_t ProfileHistory::ComputeCpuLoad(const std::vector<TaskUsage>& usage) {
+    int idle_percent = 0;
+    for (auto& task : usage) {
+        if (task.name.compare(0, 4, "IDLE") == 0) {
+            idle_percent += task.cpu_percent;
+        }
+    }
+    return (uint8_t)std::max(0, 100 - std::min(100, idle_percent));
+}
+
+void ProfileHistory::Add(ProfileSample&& sample) {
+    for (auto& task : sample.tasks) {
+        auto it = min_stack_high_water_mark_.find(task.name);
+        if (it == min_stack_high_water_mark_.end() || task.stack_high_water_mark < it->second) {
+            min_stack_high_water_mark_[task.name] = task.stack_high_water_mark;
+        }
+    }
+
+    if (sample.tasks.size() > SYSTEM_PROFILER_TOP_TASKS) {
+        sample.tasks.resize(SYSTEM_PROFILER_TOP_TASKS);
+    }
+    samples_.push_back(std::move(sample));
+    while (samples_.size() > SYSTEM_PROFILER_MAX_SAMPLES) {
+        samples_.pop_front();
+    }
+}
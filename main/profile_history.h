@@ -0,0 +1,67 @@
+#ifndef _PROFILE_HISTORY_H_
+#define _PROFILE_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#define SYSTEM_PROFILER_MAX_SAMPLES 12
+#define SYSTEM_PROFILER_TOP_TASKS 8
+
+// Raw per-task counters captured by uxTaskGetSystemState
+struct TaskSnapshot {
+    const void* handle;
+    std::string name;
+    uint32_t run_time;
+    uint32_t stack_high_water_mark;
+};
+
+struct TaskUsage {
+    std::string name;
+    uint8_t cpu_percent;
+    uint32_t stack_high_water_mark;
+};
+
+struct ProfileSample {
+    int64_t timestamp_ms;
+    uint8_t cpu_load;
+    size_t internal_free;
+    size_t internal_min_free;
+    size_t internal_largest_block;
+    size_t psram_free;
+    size_t psram_largest_block;
+    std::vector<TaskUsage> tasks;   // Busiest tasks first, at most SYSTEM_PROFILER_TOP_TASKS
+};
+
+/*
+ * The aggregation behind SystemProfiler: per-task CPU shares from two task snapshots,
+ * and the ring of samples with the lowest stack high water mark of every task. It is
+ * plain C++, so it runs on the host (scripts/system_profiler_test). Not thread safe,
+ * SystemProfiler locks around it.
+ */
+class ProfileHistory {
+public:
+    // Tasks missing from prev, or whose handle now belongs to a task with another name,
+    // are new and reported with 0% CPU. Busiest tasks first
+    static std::vector<TaskUsage> ComputeTaskUsage(const std::vector<TaskSnapshot>& prev,
+        const std::vector<TaskSnapshot>& curr, uint32_t elapsed_run_time, int cores);
+    // CPU load in percent derived from the IDLE tasks' share
+    static uint8_t ComputeCpuLoad(const std::vector<TaskUsage>& usage);
+
+    // Keeps the last SYSTEM_PROFILER_MAX_SAMPLES samples with their busiest tasks. The
+    // stack high water marks of all tasks count, not just the busiest
+    void Add(ProfileSample&& sample);
+
+    const std::deque<ProfileSample>& samples() const { return samples_; }
+    const std::map<std::string, uint32_t>& min_stack_high_water_mark() const { return min_stack_high_water_mark_; }
+
+private:
+    std::deque<ProfileSample> samples_;
+    // Lowest stack high water mark seen for each task since boot
+    std::map<std::string, uint32_t> min_stack_high_water_mark_;
+};
+
+#endif // _PROFILE_HISTORY_H_
@@ -54,7 +54,7 @@ void Protocol::SendWakeWordDetected(const std::string& wake_word) {
     SendText(json);
 }
 
-void Protocol::SendStartListening(ListeningMode mode) {
+void Protocol::SendStartListening(ListeningMode mode, bool dtx) {
     std::string message = "{\"session_id\":\"" + session_id_ + "\"";
     message += ",\"type\":\"listen\",\"state\":\"start\"";
     if (mode == kListeningModeRealtime) {
@@ -64,6 +64,9 @@ void Protocol::SendStartListening(ListeningMode mode) {
     } else {
         message += ",\"mode\":\"manual\"";
     }
+    if (dtx) {
+        message += ",\"dtx\":true";
+    }
     message += "}";
     SendText(message);
 }
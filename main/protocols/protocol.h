@@ -11,13 +11,14 @@ struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // Uplink frame index since listening started, DTX leaves gaps
     std::vector<uint8_t> payload;
 };
 
 struct BinaryProtocol2 {
     uint16_t version;
     uint16_t type;          // Message type (0: OPUS, 1: JSON)
-    uint32_t reserved;      // Reserved for future use
+    uint32_t reserved;      // Uplink: frame sequence number
     uint32_t timestamp;     // Timestamp in milliseconds (used for server-side AEC)
     uint32_t payload_size;  // Payload size in bytes
     uint8_t payload[];      // Payload data
@@ -25,7 +26,7 @@ struct BinaryProtocol2 {
 
 struct BinaryProtocol3 {
     uint8_t type;
-    uint8_t reserved;
+    uint8_t reserved;       // Uplink: low byte of the frame sequence number
     uint16_t payload_size;
     uint8_t payload[];
 } __attribute__((packed));
@@ -69,7 +70,7 @@ public:
     virtual bool IsAudioChannelOpened() const = 0;
     virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
-    virtual void SendStartListening(ListeningMode mode);
+    virtual void SendStartListening(ListeningMode mode, bool dtx = false);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
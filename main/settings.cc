@@ -1,58 +1,330 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
-}
+// Delay between the first unsaved change and the NVS commit. Changes made
+// within this window (e.g. dragging a volume slider) end up in one commit.
+#define SETTINGS_COMMIT_DELAY_MS 3000
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+namespace {
+
+enum class ValueType : uint8_t {
+    kNone,      // Known to be absent in NVS (or pending erase)
+    kString,
+    kInt,
+    kBool,
+};
+
+struct Entry {
+    ValueType type = ValueType::kNone;
+    ValueType missing_type = ValueType::kNone;  // Type that was looked up when the key was not found
+    std::string str_value;
+    int32_t int_value = 0;
+    bool dirty = false;
+};
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
+
+    SettingsCache(const SettingsCache&) = delete;
+    SettingsCache& operator=(const SettingsCache&) = delete;
+
+    bool GetString(const std::string& ns, const std::string& key, std::string& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = Lookup(ns, key, ValueType::kString);
+        if (entry.type != ValueType::kString) {
+            return false;
         }
-        nvs_close(nvs_handle_);
+        value = entry.str_value;
+        return true;
     }
-}
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    bool GetInt(const std::string& ns, const std::string& key, ValueType type, int32_t& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = Lookup(ns, key, type);
+        if (entry.type != type) {
+            return false;
+        }
+        value = entry.int_value;
+        return true;
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    void SetString(const std::string& ns, const std::string& key, const std::string& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = entries_[ns][key];
+        if (entry.type == ValueType::kString && entry.str_value == value) {
+            return;
+        }
+        entry.type = ValueType::kString;
+        entry.str_value = value;
+        MarkDirty(entry);
     }
 
+    void SetInt(const std::string& ns, const std::string& key, ValueType type, int32_t value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = entries_[ns][key];
+        if (entry.type == type && entry.int_value == value) {
+            return;
+        }
+        entry.type = type;
+        entry.str_value.clear();
+        entry.int_value = value;
+        MarkDirty(entry);
+    }
+
+    void EraseKey(const std::string& ns, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = entries_[ns][key];
+        entry.type = ValueType::kNone;
+        entry.missing_type = ValueType::kNone;
+        entry.str_value.clear();
+        MarkDirty(entry);
+    }
+
+    void EraseAll(const std::string& ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [key, entry] : entries_[ns]) {
+            if (entry.dirty) {
+                dirty_count_--;
+            }
+        }
+        entries_.erase(ns);
+
+        nvs_handle_t handle;
+        auto ret = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+            return;
+        }
+        ESP_ERROR_CHECK(nvs_erase_all(handle));
+        ESP_ERROR_CHECK(nvs_commit(handle));
+        nvs_close(handle);
+        commit_count_++;
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (commit_timer_ != nullptr) {
+            esp_timer_stop(commit_timer_);
+        }
+        if (dirty_count_ == 0) {
+            return;
+        }
+
+        for (auto& [ns, keys] : entries_) {
+            FlushNamespace(ns, keys);
+        }
+        // Entries that failed to commit stay dirty and are retried later
+        if (dirty_count_ > 0 && commit_timer_ != nullptr) {
+            esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
+        }
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (commit_timer_ != nullptr) {
+            esp_timer_stop(commit_timer_);
+        }
+        entries_.clear();
+        dirty_count_ = 0;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::map<std::string, Entry>> entries_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    int dirty_count_ = 0;
+    int commit_count_ = 0;
+
+    SettingsCache() {
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                auto self = static_cast<SettingsCache*>(arg);
+                self->Flush();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+
+        // esp_restart() runs shutdown handlers first, so pending changes survive any reboot path
+        esp_register_shutdown_handler([]() {
+            SettingsCache::GetInstance().Flush();
+        });
+    }
+
+    // Must be called with mutex_ held
+    Entry& Lookup(const std::string& ns, const std::string& key, ValueType type) {
+        auto& entry = entries_[ns][key];
+        if (entry.type != ValueType::kNone || entry.dirty || entry.missing_type == type) {
+            return entry;
+        }
+
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            entry.missing_type = type;
+            return entry;
+        }
+
+        esp_err_t ret = ESP_FAIL;
+        switch (type) {
+        case ValueType::kString: {
+            size_t length = 0;
+            ret = nvs_get_str(handle, key.c_str(), nullptr, &length);
+            if (ret == ESP_OK) {
+                entry.str_value.resize(length);
+                ret = nvs_get_str(handle, key.c_str(), entry.str_value.data(), &length);
+                while (!entry.str_value.empty() && entry.str_value.back() == '\0') {
+                    entry.str_value.pop_back();
+                }
+            }
+            break;
+        }
+        case ValueType::kInt:
+            ret = nvs_get_i32(handle, key.c_str(), &entry.int_value);
+            break;
+        case ValueType::kBool: {
+            uint8_t value;
+            ret = nvs_get_u8(handle, key.c_str(), &value);
+            entry.int_value = value != 0;
+            break;
+        }
+        default:
+            break;
+        }
+        nvs_close(handle);
+
+        if (ret == ESP_OK) {
+            entry.type = type;
+        } else {
+            entry.str_value.clear();
+            entry.missing_type = type;
+        }
+        return entry;
+    }
+
+    // Must be called with mutex_ held
+    void MarkDirty(Entry& entry) {
+        if (!entry.dirty) {
+            entry.dirty = true;
+            dirty_count_++;
+        }
+        // Start the timer only on the first change so that a stream of updates cannot postpone the commit forever
+        if (commit_timer_ != nullptr && !esp_timer_is_active(commit_timer_)) {
+            esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
+        }
+    }
+
+    // Must be called with mutex_ held. Entries are only marked clean once their namespace is committed
+    void FlushNamespace(const std::string& ns, std::map<std::string, Entry>& keys) {
+        nvs_handle_t handle = 0;
+        std::vector<Entry*> written;
+        for (auto& [key, entry] : keys) {
+            if (!entry.dirty) {
+                continue;
+            }
+
+            if (handle == 0) {
+                auto ret = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+                if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+                    return;
+                }
+            }
+
+            esp_err_t ret = ESP_OK;
+            switch (entry.type) {
+            case ValueType::kString:
+                ret = nvs_set_str(handle, key.c_str(), entry.str_value.c_str());
+                break;
+            case ValueType::kInt:
+                ret = nvs_set_i32(handle, key.c_str(), entry.int_value);
+                break;
+            case ValueType::kBool:
+                ret = nvs_set_u8(handle, key.c_str(), entry.int_value ? 1 : 0);
+                break;
+            case ValueType::kNone:
+                ret = nvs_erase_key(handle, key.c_str());
+                if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                    ret = ESP_OK;
+                }
+                break;
+            }
+            if (ret == ESP_ERR_NVS_INVALID_NAME || ret == ESP_ERR_NVS_VALUE_TOO_LONG) {
+                // Retrying cannot fix the key or the value, drop the change
+                ESP_LOGE(TAG, "Dropped %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(ret));
+                entry.dirty = false;
+                dirty_count_--;
+                continue;
+            }
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(ret));
+                continue;
+            }
+            written.push_back(&entry);
+        }
+
+        if (handle == 0) {
+            return;
+        }
+        auto ret = nvs_commit(handle);
+        nvs_close(handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+            return;
+        }
+        for (auto entry : written) {
+            entry->dirty = false;
+            dirty_count_--;
+        }
+        commit_count_++;
+        ESP_LOGI(TAG, "Committed namespace %s (total commits: %d)", ns.c_str(), commit_count_);
+    }
+};
+
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
     std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    if (!SettingsCache::GetInstance().GetString(ns_, key, value)) {
+        return default_value;
     }
     return value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetString(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
     int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    if (!SettingsCache::GetInstance().GetInt(ns_, key, ValueType::kInt, value)) {
         return default_value;
     }
     return value;
@@ -60,20 +332,15 @@ int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetInt(ns_, key, ValueType::kInt, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    int32_t value;
+    if (!SettingsCache::GetInstance().GetInt(ns_, key, ValueType::kBool, value)) {
         return default_value;
     }
     return value != 0;
@@ -81,8 +348,7 @@ bool Settings::GetBool(const std::string& key, bool default_value) {
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetInt(ns_, key, ValueType::kBool, value ? 1 : 0);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +356,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().EraseKey(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,8 +364,16 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
+
+void Settings::ClearCache() {
+    SettingsCache::GetInstance().Clear();
+}
@@ -4,6 +4,9 @@
 #include <string>
 #include <nvs_flash.h>
 
+// Settings is a lightweight view over a process-wide cache. Reads are served
+// from RAM after the first lookup, writes are coalesced and committed to NVS
+// by a debounced timer, so constructing a Settings object is cheap.
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
@@ -18,11 +21,14 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Write all pending changes to NVS immediately (before reboot / OTA)
+    static void Flush();
+    // Drop cached values and pending changes (after the NVS partition is erased)
+    static void ClearCache();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
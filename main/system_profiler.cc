@@ -0,0 +1,141 @@
+#include "system_profiler.h"
+#include "arena_allocator.h"
+#include "task_stack.h"
+#include "gif/gif_frame_cache.h"
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#define TAG "SystemProfiler"
+
+void SystemProfiler::Start(int interval_seconds) {
+    if (task_handle_ != nullptr) {
+        return;
+    }
+    interval_seconds_ = interval_seconds;
+    xTaskCreate([](void* arg) {
+        auto self = static_cast<SystemProfiler*>(arg);
+        self->ProfilerTask();
+        vTaskDelete(NULL);
+    }, "profiler", TASK_STACK_PROFILER, this, 1, &task_handle_);
+    ESP_LOGI(TAG, "Profiler started, interval %d s", interval_seconds_);
+}
+
+bool SystemProfiler::TakeSnapshot(std::vector<TaskSnapshot>& snapshot, uint32_t& total_run_time) {
+    UBaseType_t array_size = uxTaskGetNumberOfTasks() + 5;
+    auto status_array = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * array_size);
+    if (status_array == nullptr) {
+        return false;
+    }
+
+    configRUN_TIME_COUNTER_TYPE run_time = 0;
+    array_size = uxTaskGetSystemState(status_array, array_size, &run_time);
+    snapshot.clear();
+    snapshot.reserve(array_size);
+    for (UBaseType_t i = 0; i < array_size; i++) {
+        snapshot.push_back({
+            .handle = status_array[i].xHandle,
+            .name = status_array[i].pcTaskName,
+            .run_time = (uint32_t)status_array[i].ulRunTimeCounter,
+            .stack_high_water_mark = (uint32_t)status_array[i].usStackHighWaterMark,
+        });
+    }
+    free(status_array);
+    total_run_time = (uint32_t)run_time;
+    return array_size > 0;
+}
+
+void SystemProfiler::ProfilerTask() {
+    std::vector<TaskSnapshot> prev, curr;
+    uint32_t prev_run_time = 0, curr_run_time = 0;
+    TakeSnapshot(prev, prev_run_time);
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(interval_seconds_ * 1000));
+        if (!TakeSnapshot(curr, curr_run_time)) {
+            ESP_LOGW(TAG, "Failed to take task snapshot");
+            continue;
+        }
+
+        auto usage = ProfileHistory::ComputeTaskUsage(prev, curr, curr_run_time - prev_run_time, CONFIG_FREERTOS_NUMBER_OF_CORES);
+        ProfileSample sample = {
+            .timestamp_ms = esp_timer_get_time() / 1000,
+            .cpu_load = ProfileHistory::ComputeCpuLoad(usage),
+            .internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+            .internal_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+            .internal_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+            .psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+            .psram_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+            .tasks = std::move(usage),
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            history_.Add(std::move(sample));
+        }
+
+        std::swap(prev, curr);
+        prev_run_time = curr_run_time;
+    }
+}
+
+cJSON* SystemProfiler::SampleToJson(const ProfileSample& sample) {
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "uptime_ms", sample.timestamp_ms);
+    cJSON_AddNumberToObject(json, "cpu_load", sample.cpu_load);
+
+    auto internal = cJSON_CreateObject();
+    cJSON_AddNumberToObject(internal, "free", sample.internal_free);
+    cJSON_AddNumberToObject(internal, "min_free", sample.internal_min_free);
+    cJSON_AddNumberToObject(internal, "largest_block", sample.internal_largest_block);
+    cJSON_AddItemToObject(json, "internal", internal);
+
+    if (sample.psram_free > 0) {
+        auto psram = cJSON_CreateObject();
+        cJSON_AddNumberToObject(psram, "free", sample.psram_free);
+        cJSON_AddNumberToObject(psram, "largest_block", sample.psram_largest_block);
+        cJSON_AddItemToObject(json, "psram", psram);
+    }
+
+    auto tasks = cJSON_CreateArray();
+    for (auto& task : sample.tasks) {
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", task.name.c_str());
+        cJSON_AddNumberToObject(item, "cpu", task.cpu_percent);
+        cJSON_AddNumberToObject(item, "stack_free", task.stack_high_water_mark);
+        cJSON_AddItemToArray(tasks, item);
+    }
+    cJSON_AddItemToObject(json, "tasks", tasks);
+    return json;
+}
+
+cJSON* SystemProfiler::GetProfileJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "interval", interval_seconds_);
+
+    auto samples = cJSON_CreateArray();
+    for (auto& sample : history_.samples()) {
+        cJSON_AddItemToArray(samples, SampleToJson(sample));
+    }
+    cJSON_AddItemToObject(json, "samples", samples);
+
+    auto stacks = cJSON_CreateObject();
+    for (auto& [name, high_water_mark] : history_.min_stack_high_water_mark()) {
+        cJSON_AddNumberToObject(stacks, name.c_str(), high_water_mark);
+    }
+    cJSON_AddItemToObject(json, "min_stack_free", stacks);
+    cJSON_AddItemToObject(json, "memory", MemoryRegistry::GetInstance().GetStatsJson());
+    cJSON_AddItemToObject(json, "gif_cache", GifFrameCache::GetInstance().GetStatsJson());
+    cJSON_AddItemToObject(json, "glyph_cache", GlyphCache::GetInstance().GetStatsJson());
+    return json;
+}
+
+cJSON* SystemProfiler::GetSummaryJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (history_.samples().empty()) {
+        return nullptr;
+    }
+    return SampleToJson(history_.samples().back());
+}
@@ -0,0 +1,45 @@
+#ifndef _SYSTEM_PROFILER_H_
+#define _SYSTEM_PROFILER_H_
+
+#include <vector>
+#include <mutex>
+
+#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "profile_history.h"
+
+// Keeps a ring of periodic CPU / stack / heap samples so that the data can be
+// queried remotely (MCP) instead of reading one-shot logs over serial.
+class SystemProfiler {
+public:
+    static SystemProfiler& GetInstance() {
+        static SystemProfiler instance;
+        return instance;
+    }
+    SystemProfiler(const SystemProfiler&) = delete;
+    SystemProfiler& operator=(const SystemProfiler&) = delete;
+
+    void Start(int interval_seconds = 5);
+
+    // Full ring, the caller owns the returned object
+    cJSON* GetProfileJson();
+    // Latest sample only, small enough to attach to the device status
+    cJSON* GetSummaryJson();
+
+private:
+    SystemProfiler() = default;
+    ~SystemProfiler() = default;
+
+    void ProfilerTask();
+    bool TakeSnapshot(std::vector<TaskSnapshot>& snapshot, uint32_t& total_run_time);
+    static cJSON* SampleToJson(const ProfileSample& sample);
+
+    std::mutex mutex_;
+    TaskHandle_t task_handle_ = nullptr;
+    int interval_seconds_ = 5;
+    ProfileHistory history_;
+};
+
+#endif // _SYSTEM_PROFILER_H_
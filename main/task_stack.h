@@ -0,0 +1,75 @@
+#ifndef _TASK_STACK_H_
+#define _TASK_STACK_H_
+
+#include <sdkconfig.h>
+
+/*
+ * Stack sizes (in bytes) of the long lived tasks created by the application.
+ *
+ * Every value can be overridden with a compile definition. Run
+ * scripts/stack_report.py on the `self.system.get_stack_report` output of
+ * real devices to get recommended values before changing them.
+ */
+
+#ifndef TASK_STACK_MAIN_EVENT_LOOP
+#define TASK_STACK_MAIN_EVENT_LOOP      (2048 * 4)
+#endif
+
+#if CONFIG_USE_AUDIO_PROCESSOR
+#ifndef TASK_STACK_AUDIO_INPUT
+#define TASK_STACK_AUDIO_INPUT          (2048 * 3)
+#endif
+#ifndef TASK_STACK_AUDIO_OUTPUT
+#define TASK_STACK_AUDIO_OUTPUT         (2048 * 2)
+#endif
+#else
+#ifndef TASK_STACK_AUDIO_INPUT
+#define TASK_STACK_AUDIO_INPUT          (2048 * 2)
+#endif
+#ifndef TASK_STACK_AUDIO_OUTPUT
+#define TASK_STACK_AUDIO_OUTPUT         2048
+#endif
+#endif
+
+#ifndef TASK_STACK_OPUS_CODEC
+#define TASK_STACK_OPUS_CODEC           (2048 * 13)
+#endif
+
+#ifndef TASK_STACK_AUDIO_COMMUNICATION
+#define TASK_STACK_AUDIO_COMMUNICATION  4096
+#endif
+
+#ifndef TASK_STACK_AUDIO_DETECTION
+#define TASK_STACK_AUDIO_DETECTION      4096
+#endif
+
+// Allocated from PSRAM, only created while uploading the wake word audio
+#ifndef TASK_STACK_ENCODE_WAKE_WORD
+#define TASK_STACK_ENCODE_WAKE_WORD     (4096 * 7)
+#endif
+
+// std::thread started by Esp32Camera::Explain
+#ifndef TASK_STACK_JPEG_ENCODER
+#define TASK_STACK_JPEG_ENCODER         CONFIG_PTHREAD_TASK_STACK_SIZE_DEFAULT
+#endif
+
+#ifndef TASK_STACK_PROFILER
+#define TASK_STACK_PROFILER             4096
+#endif
+
+// Steps the emote animations, USE_EMOTE_MESSAGE_STYLE only
+#ifndef TASK_STACK_EMOTE_PACER
+#define TASK_STACK_EMOTE_PACER          3072
+#endif
+
+// Reads battery and network state for the LVGL status bar, the 4G boards query the modem over AT
+#ifndef TASK_STACK_STATUS_PROBE
+#define TASK_STACK_STATUS_PROBE         4096
+#endif
+
+// Background capture of Esp32Camera, CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING only
+#ifndef TASK_STACK_CAMERA_RING
+#define TASK_STACK_CAMERA_RING          3072
+#endif
+
+#endif // _TASK_STACK_H_
@@ -0,0 +1,110 @@
+#include "task_stack_recorder.h"
+#include "task_stack.h"
+#include "settings.h"
+
+#include <cstring>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TAG "TaskStack"
+#define TASK_STACK_NAMESPACE "stack_hwm"
+
+TaskStackRecorder::TaskStackRecorder() {
+    tasks_ = {
+        {"main_event_loop", "main_loop", TASK_STACK_MAIN_EVENT_LOOP},
+        {"audio_input", "audio_in", TASK_STACK_AUDIO_INPUT},
+        {"audio_output", "audio_out", TASK_STACK_AUDIO_OUTPUT},
+        {"opus_codec", "opus_codec", TASK_STACK_OPUS_CODEC},
+        {"audio_communication", "afe_comm", TASK_STACK_AUDIO_COMMUNICATION},
+        {"audio_detection", "afe_detect", TASK_STACK_AUDIO_DETECTION},
+        {"encode_wake_word", "ww_encode", TASK_STACK_ENCODE_WAKE_WORD},
+        {"jpeg_encoder", "jpeg_enc", TASK_STACK_JPEG_ENCODER},
+        {"profiler", "profiler", TASK_STACK_PROFILER},
+        {"emote_pacer", "emote_pacer", TASK_STACK_EMOTE_PACER},
+        {"status_probe", "status_probe", TASK_STACK_STATUS_PROBE},
+        {"camera_ring", "camera_ring", TASK_STACK_CAMERA_RING},
+    };
+
+    Settings settings(TASK_STACK_NAMESPACE, false);
+    for (auto& task : tasks_) {
+        task.max_used = settings.GetInt(task.key, 0);
+    }
+}
+
+TrackedTaskStack* TaskStackRecorder::Find(const char* task_name) {
+    // FreeRTOS truncates task names to configMAX_TASK_NAME_LEN - 1 characters
+    for (auto& task : tasks_) {
+        if (strncmp(task.name, task_name, configMAX_TASK_NAME_LEN - 1) == 0) {
+            return &task;
+        }
+    }
+    return nullptr;
+}
+
+void TaskStackRecorder::Record(TrackedTaskStack& task, uint32_t high_water_mark) {
+    uint32_t used = high_water_mark < task.stack_size ? task.stack_size - high_water_mark : 0;
+    if (used > task.session_max_used) {
+        task.session_max_used = used;
+    }
+    if (used > task.max_used) {
+        task.max_used = used;
+        // Settings batches the commit, and the value only ever grows, so flash writes stay rare
+        Settings settings(TASK_STACK_NAMESPACE, true);
+        settings.SetInt(task.key, used);
+        ESP_LOGI(TAG, "New stack usage record for %s: %lu / %lu bytes", task.name, used, task.stack_size);
+    }
+}
+
+void TaskStackRecorder::Sample() {
+    UBaseType_t array_size = uxTaskGetNumberOfTasks() + 5;
+    auto status_array = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * array_size);
+    if (status_array == nullptr) {
+        return;
+    }
+    array_size = uxTaskGetSystemState(status_array, array_size, nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (UBaseType_t i = 0; i < array_size; i++) {
+        auto task = Find(status_array[i].pcTaskName);
+        if (task != nullptr) {
+            Record(*task, status_array[i].usStackHighWaterMark);
+        }
+    }
+    free(status_array);
+}
+
+void TaskStackRecorder::RecordCurrentTask() {
+    auto high_water_mark = uxTaskGetStackHighWaterMark(nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto task = Find(pcTaskGetName(nullptr));
+    if (task != nullptr) {
+        Record(*task, high_water_mark);
+    }
+}
+
+void TaskStackRecorder::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& task : tasks_) {
+        task.max_used = 0;
+        task.session_max_used = 0;
+    }
+    Settings settings(TASK_STACK_NAMESPACE, true);
+    settings.EraseAll();
+}
+
+cJSON* TaskStackRecorder::GetReportJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto json = cJSON_CreateObject();
+    auto tasks = cJSON_CreateArray();
+    for (auto& task : tasks_) {
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", task.name);
+        cJSON_AddNumberToObject(item, "stack_size", task.stack_size);
+        cJSON_AddNumberToObject(item, "max_used", task.max_used);
+        cJSON_AddNumberToObject(item, "session_max_used", task.session_max_used);
+        cJSON_AddItemToArray(tasks, item);
+    }
+    cJSON_AddItemToObject(json, "tasks", tasks);
+    return json;
+}
@@ -0,0 +1,55 @@
+#ifndef _TASK_STACK_RECORDER_H_
+#define _TASK_STACK_RECORDER_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <cJSON.h>
+
+struct TrackedTaskStack {
+    const char* name;           // FreeRTOS task name
+    const char* key;            // NVS key, at most 15 characters
+    uint32_t stack_size;        // Configured size from task_stack.h
+    uint32_t session_max_used = 0;
+    uint32_t max_used = 0;      // Worst case over all sessions, persisted in NVS
+};
+
+/**
+ * Records the deepest stack usage of the tasks listed in task_stack.h and keeps
+ * the worst case in NVS, so the numbers survive reboots and firmware updates.
+ * Usage is stored in bytes used rather than bytes free, which stays valid
+ * after a stack size has been changed.
+ */
+class TaskStackRecorder {
+public:
+    static TaskStackRecorder& GetInstance() {
+        static TaskStackRecorder instance;
+        return instance;
+    }
+    TaskStackRecorder(const TaskStackRecorder&) = delete;
+    TaskStackRecorder& operator=(const TaskStackRecorder&) = delete;
+
+    // Check all running tracked tasks, cheap enough to call from the clock tick
+    void Sample();
+    // For short lived tasks, call right before the task exits
+    void RecordCurrentTask();
+    // Forget the persisted values, e.g. after the stack sizes were retuned
+    void Reset();
+
+    // Export for scripts/stack_report.py, the caller owns the returned object
+    cJSON* GetReportJson();
+
+private:
+    TaskStackRecorder();
+    ~TaskStackRecorder() = default;
+
+    // Must be called with mutex_ held
+    void Record(TrackedTaskStack& task, uint32_t high_water_mark);
+    TrackedTaskStack* Find(const char* task_name);
+
+    std::mutex mutex_;
+    std::vector<TrackedTaskStack> tasks_;
+};
+
+#endif // _TASK_STACK_RECORDER_H_
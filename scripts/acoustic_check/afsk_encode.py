@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+声波配网编码器 - 生成小智声波配网的 AFSK 音频
+
+默认生成带前向纠错的帧 (版本 1), 与固件 main/boards/common/afsk_frame.cc 一致:
+
+    前导码  0x01 0x21          0x01 0x02 为旧格式, 0x20 | 版本号为纠错帧
+    帧头    长度, 标志          后接 6 字节 Reed-Solomon 校验, 可纠正 3 个字节错误
+    数据    内容 + CRC-16, 按字节轮流分成最多 16 字节的块, 每块后接 8 字节
+            Reed-Solomon 校验 (每块可纠正 4 个字节错误), 各块按字节交织发送
+
+--legacy 生成旧格式 (起始标识, 文本, 校验和, 结束标识), 用于旧固件。
+
+用法:
+    python afsk_encode.py --ssid MyWiFi --password secret -o wifi.wav
+    python afsk_encode.py --ssid MyWiFi --password secret --hex
+    python afsk_encode.py --self-test
+"""
+
+import argparse
+import math
+import struct
+import sys
+import wave
+
+MARK = 1800
+SPACE = 1500
+BIT_RATE = 100
+
+FRAME_VERSION = 1
+FRAME_HEADER_PARITY = 6
+FRAME_BLOCK_DATA = 16
+FRAME_BLOCK_PARITY = 8
+FRAME_MAX_PAYLOAD = 96
+
+# 与 scripts/afsk_demod_test/afsk_frame_test.cc 中的测试向量相同
+GOLDEN_TEXT = "XiaoZhi\n12345678"
+GOLDEN_FRAME = "01211000f7f6b669f9375869616f5a68690a31323334353637383b153dd656e8a2da1225422ae4c045e109b3"
+
+# GF(256), 本原多项式 0x11d
+GF_EXP = [0] * 512
+GF_LOG = [0] * 256
+_x = 1
+for _i in range(255):
+    GF_EXP[_i] = _x
+    GF_LOG[_x] = _i
+    _x <<= 1
+    if _x & 0x100:
+        _x ^= 0x11D
+for _i in range(255, 512):
+    GF_EXP[_i] = GF_EXP[_i - 255]
+
+
+def gf_mul(a: int, b: int) -> int:
+    if a == 0 or b == 0:
+        return 0
+    return GF_EXP[GF_LOG[a] + GF_LOG[b]]
+
+
+def rs_generator(nsym: int) -> list:
+    """生成多项式 (x - a^0)(x - a^1)...(x - a^(nsym-1)), 高次在前"""
+    g = [1]
+    for i in range(nsym):
+        root = GF_EXP[i]
+        g = g + [0]
+        for j in range(len(g) - 1, 0, -1):
+            g[j] ^= gf_mul(g[j - 1], root)
+    return g
+
+
+def rs_encode(data: bytes, nsym: int) -> bytes:
+    """返回 nsym 个校验字节"""
+    g = rs_generator(nsym)
+    parity = [0] * nsym
+    for d in data:
+        feedback = d ^ parity[0]
+        parity = parity[1:] + [0]
+        if feedback:
+            for j in range(nsym):
+                parity[j] ^= gf_mul(feedback, g[j + 1])
+    return bytes(parity)
+
+
+def crc16(data: bytes) -> int:
+    """CRC-16/CCITT-FALSE"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def encode_frame(text: bytes) -> bytes:
+    """生成纠错帧, 包括前导码"""
+    if len(text) > FRAME_MAX_PAYLOAD:
+        raise ValueError(f"内容最长 {FRAME_MAX_PAYLOAD} 字节")
+    header = bytes([len(text), 0])
+    frame = bytes([0x01, 0x20 | FRAME_VERSION]) + header + rs_encode(header, FRAME_HEADER_PARITY)
+
+    crc = crc16(text)
+    data = text + bytes([crc >> 8, crc & 0xFF])
+    blocks = (len(data) + FRAME_BLOCK_DATA - 1) // FRAME_BLOCK_DATA
+    codewords = []
+    for b in range(blocks):
+        block = data[b::blocks]
+        codewords.append(block + rs_encode(block, FRAME_BLOCK_PARITY))
+
+    # 交织: 先发每块的第 r 个字节, 再发第 r + 1 个
+    body = bytearray()
+    for r in range(max(len(c) for c in codewords)):
+        for c in codewords:
+            if r < len(c):
+                body.append(c[r])
+    return frame + bytes(body)
+
+
+def encode_legacy(text: bytes) -> bytes:
+    """旧格式: 起始标识, 文本, 校验和, 结束标识"""
+    return bytes([0x01, 0x02]) + text + bytes([sum(text) & 0xFF, 0x03, 0x04])
+
+
+def to_bits(data: bytes) -> list:
+    return [(b >> i) & 1 for b in data for i in range(7, -1, -1)]
+
+
+def afsk_modulate(bits: list, sample_rate: int) -> list:
+    """与 sonic_wifi_config.html 相同的调制"""
+    samples_per_bit = sample_rate // BIT_RATE
+    samples = []
+    for i, bit in enumerate(bits):
+        freq = MARK if bit else SPACE
+        for j in range(samples_per_bit):
+            t = (i * samples_per_bit + j) / sample_rate
+            samples.append(math.sin(2 * math.pi * freq * t))
+    return samples
+
+
+def write_wav(path: str, samples: list, sample_rate: int):
+    with wave.open(path, "wb") as wav:
+        wav.setnchannels(1)
+        wav.setsampwidth(2)
+        wav.setframerate(sample_rate)
+        wav.writeframes(b"".join(struct.pack("<h", int(max(-1.0, min(1.0, s)) * 32767)) for s in samples))
+
+
+def self_test() -> bool:
+    ok = encode_frame(GOLDEN_TEXT.encode()).hex() == GOLDEN_FRAME
+    ok &= crc16(b"123456789") == 0x29B1
+    print("All checks passed" if ok else "FAIL 编码结果与固件测试向量不一致")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="生成小智声波配网音频")
+    parser.add_argument("--ssid", help="WiFi 名称")
+    parser.add_argument("--password", default="", help="WiFi 密码")
+    parser.add_argument("-o", "--output", default="wifi_config.wav", help="输出 WAV 文件")
+    parser.add_argument("--sample-rate", type=int, default=44100, help="采样率")
+    parser.add_argument("--legacy", action="store_true", help="旧格式, 不带纠错")
+    parser.add_argument("--hex", action="store_true", help="只输出帧的十六进制字节")
+    parser.add_argument("--self-test", action="store_true", help="检查编码与固件一致")
+    args = parser.parse_args()
+
+    if args.self_test:
+        sys.exit(0 if self_test() else 1)
+    if args.ssid is None:
+        parser.error("需要 --ssid")
+
+    text = (args.ssid + "\n" + args.password).encode()
+    frame = encode_legacy(text) if args.legacy else encode_frame(text)
+    if args.hex:
+        print(frame.hex())
+        return
+    samples = afsk_modulate(to_bits(frame), args.sample_rate)
+    write_wav(args.output, samples, args.sample_rate)
+    print(f"{len(frame)} 字节, {len(frame) * 8 / BIT_RATE:.2f} 秒, 已写入 {args.output}")
+
+
+if __name__ == "__main__":
+    main()
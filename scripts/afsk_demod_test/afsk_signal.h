@@ -0,0 +1,86 @@
+// AFSK synthesis and the device receive pipeline, shared by the host tests
+#pragma once
+
+#include "afsk_dsp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static const int kInputRate = 16000;
+static const size_t kReadSamples = 480;
+static const double kToneAmplitude = 8000.0;
+
+inline int16_t ToSample(double v) {
+    v = std::round(v);
+    return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+// Bytes to bits, most significant bit first, as the web page sends them
+inline std::vector<uint8_t> ToBits(const std::vector<uint8_t>& bytes) {
+    std::vector<uint8_t> bits;
+    for (uint8_t b : bytes) {
+        for (int i = 7; i >= 0; i--) {
+            bits.push_back((b >> i) & 1);
+        }
+    }
+    return bits;
+}
+
+// Bits played like the web page, starting offset seconds into the audio, with white noise
+// at snr_db over the 0-8kHz band
+inline std::vector<int16_t> Modulate(const std::vector<uint8_t>& bits, double offset, double snr_db, uint32_t seed) {
+    const double samples_per_bit = (double)kInputRate / kBitRate;
+    size_t lead = (size_t)std::round(offset * kInputRate);
+    size_t total = lead + (size_t)(bits.size() * samples_per_bit) + kInputRate / 10;
+    double noise_sigma = kToneAmplitude / std::sqrt(2.0) / std::pow(10.0, snr_db / 20.0);
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, noise_sigma);
+    std::vector<int16_t> audio(total);
+    for (size_t i = 0; i < total; i++) {
+        double v = 0.0;
+        if (i >= lead && (size_t)((i - lead) / samples_per_bit) < bits.size()) {
+            double t = (double)(i - lead) / kInputRate;
+            double f = bits[(size_t)((i - lead) / samples_per_bit)] ? kMarkFrequency : kSpaceFrequency;
+            v = kToneAmplitude * std::sin(2.0 * M_PI * f * t);
+        }
+        audio[i] = ToSample(v + noise(rng));
+    }
+    return audio;
+}
+
+// The device pipeline: decimator and signal processor, fed in 30ms reads
+class Pipeline {
+public:
+    explicit Pipeline(bool fixed_point)
+        : decimator_(kInputRate, kAudioSampleRate, fixed_point),
+          processor_(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize, fixed_point),
+          downsampled_(decimator_.MaxOutputSize(kReadSamples)) {}
+
+    void Process(const int16_t* samples, size_t count, std::vector<float>& probabilities) {
+        size_t n = decimator_.Process(samples, count, downsampled_.data());
+        processor_.ProcessAudioSamples(downsampled_.data(), n, probabilities);
+    }
+
+private:
+    audio_wifi_config::PolyphaseDecimator decimator_;
+    audio_wifi_config::AudioSignalProcessor processor_;
+    std::vector<int16_t> downsampled_;
+};
+
+template <typename P>
+std::vector<float> Run(P& pipeline, const std::vector<int16_t>& audio, double* seconds) {
+    std::vector<float> probabilities;
+    probabilities.reserve(audio.size() / (kInputRate / kBitRate) + 1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < audio.size(); i += kReadSamples) {
+        size_t n = std::min(kReadSamples, audio.size() - i);
+        pipeline.Process(&audio[i], n, probabilities);
+    }
+    if (seconds != nullptr) {
+        *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return probabilities;
+}
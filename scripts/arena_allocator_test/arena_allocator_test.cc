@@ -0,0 +1,209 @@
+/*
+ * Host test of main/memory/arena_allocator.cc on the heap shim of scripts/host_test, with
+ * internal and PSRAM heaps of a fixed size. It checks that:
+ *
+ * 1. Placements allocate from their heap. PSRAM preferred falls back to internal RAM when
+ *    PSRAM is full, PSRAM only fails.
+ * 2. A region accounts the allocated block size, checks its budget against that same size,
+ *    and its used bytes go back to 0 when every block is freed or detached. A budget set
+ *    later applies to the next allocations.
+ * 3. An arena hands out aligned pieces of one block, reuses the block after Reset(), only
+ *    grows while empty and gives the block back on Release().
+ * 4. The registry and the C entry points find the regions by name, and blocks of unknown
+ *    regions are freed with heap_caps_free.
+ * 5. Threads allocating and freeing in one region never push it over its budget and leave
+ *    nothing accounted.
+ *
+ * Usage: arena_allocator_test [-v]
+ */
+#include "arena_allocator.h"
+#include "esp_heap_caps.h"
+#include "host_test.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define INTERNAL_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define PSRAM_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+static void TestPlacement() {
+    const char* test = "placement";
+    heap_caps_test_set_capacity(MALLOC_CAP_INTERNAL, 64 * 1024);
+    heap_caps_test_set_capacity(MALLOC_CAP_SPIRAM, 16 * 1024);
+
+    size_t internal = heap_caps_get_free_size(INTERNAL_CAPS);
+    size_t psram = heap_caps_get_free_size(PSRAM_CAPS);
+    void* a = MemoryPlacementAlloc(1000, kPlacementInternal);
+    Check(a != nullptr && heap_caps_get_free_size(INTERNAL_CAPS) < internal &&
+        heap_caps_get_free_size(PSRAM_CAPS) == psram, test, "internal from the internal heap");
+    void* b = MemoryPlacementAlloc(1000, kPlacementPsramPreferred);
+    Check(b != nullptr && heap_caps_get_free_size(PSRAM_CAPS) < psram, test, "PSRAM preferred from PSRAM");
+
+    internal = heap_caps_get_free_size(INTERNAL_CAPS);
+    void* c = MemoryPlacementAlloc(20 * 1024, kPlacementPsram);
+    Check(c == nullptr, test, "PSRAM only fails when PSRAM is full");
+    void* d = MemoryPlacementAlloc(20 * 1024, kPlacementPsramPreferred, 64);
+    Check(d != nullptr && heap_caps_get_free_size(INTERNAL_CAPS) < internal, test,
+        "PSRAM preferred falls back to internal RAM");
+    Check(((uintptr_t)d & 63) == 0, test, "aligned allocation");
+
+    heap_caps_free(a);
+    heap_caps_free(b);
+    heap_caps_free(d);
+    Check(heap_caps_get_free_size(INTERNAL_CAPS) == 64 * 1024 && heap_caps_get_free_size(PSRAM_CAPS) == 16 * 1024,
+        test, "heaps empty again");
+    heap_caps_test_set_capacity(MALLOC_CAP_INTERNAL, 0);
+    heap_caps_test_set_capacity(MALLOC_CAP_SPIRAM, 0);
+}
+
+static void TestRegion() {
+    const char* test = "region";
+    MemoryRegion region("test", kPlacementInternal, 252);
+
+    void* a = region.Allocate(13);
+    Check(a != nullptr && region.used() == heap_caps_get_allocated_size(a) && region.used() == 16, test,
+        "allocated size accounted");
+    void* b = region.Allocate(200, 16);
+    Check(b != nullptr && ((uintptr_t)b & 15) == 0 && region.used() == 16 + 200, test, "aligned block accounted");
+
+    // 36 bytes are left. 37 requested bytes are over budget before allocating, 33 are
+    // within it but their block of 40 bytes is not
+    size_t in_use = heap_caps_test_in_use;
+    Check(region.Allocate(37) == nullptr && region.Allocate(33) == nullptr, test, "over budget");
+    Check(region.used() == 216 && heap_caps_test_in_use == in_use, test, "failed allocations leave nothing");
+    void* c = region.Allocate(36);
+    Check(c == nullptr, test, "block rounded over the budget");
+    c = region.Allocate(32);
+    Check(c != nullptr && region.used() == 248, test, "block up to the budget");
+
+    region.Free(a);
+    Check(region.used() == 232, test, "free subtracts the allocated size");
+    region.Detach(b);
+    Check(region.used() == 32, test, "detach subtracts the allocated size");
+    heap_caps_free(b);
+    region.Free(c);
+    region.Free(nullptr);
+    Check(region.used() == 0 && region.peak() == 248, test, "used back to 0, peak kept");
+
+    // A budget set at run time applies to the next allocations, blocks already allocated stay
+    a = region.Allocate(200);
+    region.SetBudget(400);
+    b = region.Allocate(200);
+    Check(b != nullptr && region.budget() == 400 && region.used() == 400, test, "raised budget");
+    region.SetBudget(100);
+    Check(region.Allocate(1) == nullptr && region.used() == 400, test, "lowered budget");
+    region.Free(a);
+    region.Free(b);
+    Check(region.used() == 0, test, "used back to 0 after a new budget");
+
+    MemoryRegion unlimited("unlimited", kPlacementPsramPreferred, 0);
+    void* big = unlimited.Allocate(1 << 20);
+    Check(big != nullptr && unlimited.used() == 1 << 20, test, "budget 0 is unlimited");
+    unlimited.Free(big);
+}
+
+static void TestArena() {
+    const char* test = "arena";
+    MemoryRegion region("arena", kPlacementInternal, 4096);
+    MemoryArena arena(region, 1024);
+    Check(arena.capacity() == 1024 && region.used() == 1024, test, "block reserved from the region");
+
+    auto a = (uint8_t*)arena.Allocate(10);
+    auto b = (uint8_t*)arena.Allocate(100, 64);
+    Check(a != nullptr && b != nullptr && ((uintptr_t)a & 15) == 0 && ((uintptr_t)b & 63) == 0, test, "aligned pieces");
+    Check(b >= a + 10 && arena.used() == (size_t)(b - a) + 100, test, "pieces do not overlap");
+    Check(arena.Allocate(1024) == nullptr, test, "allocation past the capacity fails");
+    Check(!arena.Reserve(2048) && arena.capacity() == 1024, test, "no growth while in use");
+
+    size_t allocations = heap_caps_test_allocations;
+    arena.Reset();
+    auto c = (uint8_t*)arena.Allocate(1000);
+    Check(c == a && heap_caps_test_allocations == allocations, test, "block reused after reset");
+    Check(arena.Reserve(512) && arena.capacity() == 1024, test, "smaller reserve keeps the block");
+
+    arena.Reset();
+    Check(arena.Reserve(3000) && arena.capacity() == 3000 && region.used() == 3000, test,
+        "grows while empty, the old block freed first");
+    Check(!arena.Reserve(5000) && arena.capacity() == 0 && region.used() == 0, test, "over the region budget");
+    Check(arena.Allocate(1) == nullptr, test, "no allocation without a block");
+
+    arena.Reserve(256);
+    arena.Release();
+    Check(arena.capacity() == 0 && region.used() == 0, test, "release gives the block back");
+}
+
+static void TestRegistry() {
+    const char* test = "registry";
+    auto& registry = MemoryRegistry::GetInstance();
+    const char* names[] = {MEMORY_REGION_CAMERA, MEMORY_REGION_JPEG, MEMORY_REGION_GIF, MEMORY_REGION_GIF_CACHE,
+        MEMORY_REGION_GLYPH_CACHE};
+    bool found = true;
+    for (auto name : names) {
+        auto region = registry.GetRegion(name);
+        found &= region != nullptr && region->name() == name;
+    }
+    Check(found, test, "regions found by name");
+    Check(registry.GetRegion("unknown") == nullptr, test, "unknown region");
+    Check(registry.GetRegion(MEMORY_REGION_GIF_CACHE)->budget() == CONFIG_GIF_FRAME_CACHE_SIZE * 1024, test,
+        "cache budget from the configuration");
+
+    auto gif = registry.GetRegion(MEMORY_REGION_GIF);
+    void* ptr = memory_region_malloc(MEMORY_REGION_GIF, 100);
+    Check(ptr != nullptr && gif->used() == heap_caps_get_allocated_size(ptr), test, "C allocation accounted");
+    memory_region_free(MEMORY_REGION_GIF, ptr);
+    Check(gif->used() == 0, test, "C free accounted");
+    Check(memory_region_malloc("unknown", 100) == nullptr, test, "C allocation from an unknown region");
+
+    size_t in_use = heap_caps_test_in_use;
+    memory_region_free("unknown", heap_caps_malloc(100, MALLOC_CAP_8BIT));
+    Check(heap_caps_test_in_use == in_use, test, "unknown region freed with heap_caps_free");
+}
+
+static void TestThreads() {
+    const char* test = "threads";
+    const size_t kBudget = 64 * 1024;
+    MemoryRegion region("threads", kPlacementInternal, kBudget);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&region, t]() {
+            uint32_t seed = 12345 + t;
+            std::vector<void*> blocks;
+            for (int i = 0; i < 20000; i++) {
+                seed = seed * 1103515245 + 12345;
+                if (blocks.size() < 16 && (seed >> 16) % 3 != 0) {
+                    void* ptr = region.Allocate(1 + (seed >> 8) % 4096);
+                    if (ptr != nullptr) {
+                        blocks.push_back(ptr);
+                    }
+                } else if (!blocks.empty()) {
+                    region.Free(blocks.back());
+                    blocks.pop_back();
+                }
+            }
+            for (auto ptr : blocks) {
+                region.Free(ptr);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Check(region.used() == 0, test, "nothing accounted after all threads freed");
+    Check(region.peak() <= kBudget && region.peak() > kBudget / 2, test, "peak within the budget");
+    if (verbose) {
+        printf("threads: peak %zu of %zu bytes\n", region.peak(), kBudget);
+    }
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestPlacement();
+    TestRegion();
+    TestArena();
+    TestRegistry();
+    TestThreads();
+    return ReportChecks();
+}
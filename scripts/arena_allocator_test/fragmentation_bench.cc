@@ -0,0 +1,164 @@
+/*
+ * Fragmentation stress benchmark of the internal heap, on the first fit heap of the
+ * scripts/host_test shim. Every request takes scratch buffers the way the JPEG encoder
+ * does: a converted MCU row strip and an output buffer, of sizes that change with the
+ * screen and the image. While they are held, small long lived blocks (network buffers,
+ * queued packets) come and go around them. Two ways to get the scratch buffers:
+ *
+ *   heap    heap_caps_malloc and heap_caps_free per request, as before the memory regions
+ *   arena   a MemoryArena of the largest request, reserved once and reset per request
+ *
+ * It prints the free internal RAM and the largest free block at the end, the smallest
+ * largest free block and the highest fragmentation figure of the memory statistics
+ * (100 - largest block * 100 / free) while requests hold their buffers, and the allocations
+ * that failed. It checks that the arena never fails an allocation, and that while requests
+ * run it leaves a largest free block at least as large and fragmentation no higher than
+ * per request allocation does. The arena holds its block all the time, so at the end it
+ * leaves less free RAM.
+ *
+ * Usage: fragmentation_bench [requests] [-v]
+ */
+#include "arena_allocator.h"
+#include "esp_heap_caps.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#define HEAP_CAPACITY (200 * 1024)
+#define INTERNAL_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define STRIP_LINES 16
+
+struct Result {
+    size_t final_free = 0;
+    size_t final_largest = 0;
+    size_t min_largest = SIZE_MAX;
+    int max_fragmentation = 0;
+    uint32_t failed_requests = 0;
+    uint32_t failed_blocks = 0;
+};
+
+struct Block {
+    void* ptr;
+    int expires;
+};
+
+class Random {
+public:
+    uint32_t Next() {
+        state_ = state_ * 1103515245 + 12345;
+        return state_ >> 8;
+    }
+    uint32_t Range(uint32_t low, uint32_t high) { return low + Next() % (high - low + 1); }
+
+private:
+    uint32_t state_ = 2024;
+};
+
+static int Fragmentation() {
+    size_t free_size = heap_caps_get_free_size(INTERNAL_CAPS);
+    size_t largest = heap_caps_get_largest_free_block(INTERNAL_CAPS);
+    return free_size > 0 ? 100 - (int)(largest * 100 / free_size) : 0;
+}
+
+static const int kWidths[] = {240, 280, 320, 360, 480};
+
+static Result Run(bool use_arena, int requests) {
+    heap_caps_test_set_capacity(MALLOC_CAP_INTERNAL, HEAP_CAPACITY);
+    Result result;
+    Random random;
+    std::deque<Block> blocks;
+    MemoryRegion region("scratch", kPlacementInternal, 0);
+    MemoryArena arena(region);
+    if (use_arena) {
+        // The largest strip and output buffer
+        arena.Reserve(480 * STRIP_LINES * 3 + 32 * 1024 + 64);
+    }
+
+    for (int request = 0; request < requests; request++) {
+        size_t strip = kWidths[random.Next() % 5] * STRIP_LINES * 3;
+        size_t output = random.Range(8, 32) * 1024;
+        void* strip_buffer;
+        void* output_buffer;
+        if (use_arena) {
+            arena.Reset();
+            strip_buffer = arena.Allocate(strip);
+            output_buffer = arena.Allocate(output);
+        } else {
+            strip_buffer = heap_caps_malloc(strip, INTERNAL_CAPS);
+            output_buffer = heap_caps_malloc(output, INTERNAL_CAPS);
+        }
+        if (strip_buffer == nullptr || output_buffer == nullptr) {
+            result.failed_requests++;
+        }
+
+        // Blocks of the rest of the system, allocated while the request runs and freed
+        // after 1 to 40 requests
+        int count = random.Range(0, 4);
+        for (int i = 0; i < count; i++) {
+            void* ptr = heap_caps_malloc(random.Range(64, 1664), INTERNAL_CAPS);
+            if (ptr == nullptr) {
+                result.failed_blocks++;
+                continue;
+            }
+            blocks.push_back({ptr, request + (int)random.Range(1, 40)});
+        }
+        std::stable_sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+            return a.expires < b.expires;
+        });
+        // What the rest of the system can get while the request holds its buffers
+        result.min_largest = std::min(result.min_largest, heap_caps_get_largest_free_block(INTERNAL_CAPS));
+        result.max_fragmentation = std::max(result.max_fragmentation, Fragmentation());
+
+        if (!use_arena) {
+            heap_caps_free(strip_buffer);
+            heap_caps_free(output_buffer);
+        }
+        while (!blocks.empty() && blocks.front().expires <= request) {
+            heap_caps_free(blocks.front().ptr);
+            blocks.pop_front();
+        }
+    }
+
+    result.final_free = heap_caps_get_free_size(INTERNAL_CAPS);
+    result.final_largest = heap_caps_get_largest_free_block(INTERNAL_CAPS);
+    for (auto& block : blocks) {
+        heap_caps_free(block.ptr);
+    }
+    arena.Release();
+    heap_caps_test_set_capacity(MALLOC_CAP_INTERNAL, 0);
+    return result;
+}
+
+static void Print(const char* name, const Result& result) {
+    printf("%-6s %8zu %10zu %12zu %10d%% %8u %8u\n", name, result.final_free, result.final_largest,
+        result.min_largest, result.max_fragmentation, result.failed_requests, result.failed_blocks);
+}
+
+int main(int argc, char** argv) {
+    int requests = 20000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            requests = atoi(argv[i]);
+        }
+    }
+
+    Result heap = Run(false, requests);
+    Result arena = Run(true, requests);
+    printf("%d requests on a %d KB internal heap\n", requests, HEAP_CAPACITY / 1024);
+    printf("%-6s %8s %10s %12s %11s %8s %8s\n", "", "free", "largest", "min largest", "max frag", "failed", "blocks");
+    Print("heap", heap);
+    Print("arena", arena);
+
+    Check(arena.failed_requests == 0 && arena.failed_blocks == 0, "arena", "no failed allocations");
+    Check(arena.min_largest >= heap.min_largest, "arena", "largest free block at least as large as per request");
+    Check(arena.max_fragmentation <= heap.max_fragmentation, "arena", "fragmentation no higher than per request");
+    return ReportChecks();
+}
@@ -0,0 +1,294 @@
+/*
+ * Host test of CameraBufferPool and CameraFrame against a fake V4L2 capture device.
+ *
+ * The fake device owns a set of "mmap" buffers and a driver queue. It fills a queued
+ * buffer with the next frame sequence number on VIDIOC_DQBUF, and it fails the test if
+ * a buffer is queued twice or if a dequeue would block forever on an empty queue.
+ * Captures are replayed the way Esp32Camera::Capture() runs them, and the test checks:
+ *
+ * 1. Without conversion, the frame is read from the mmap buffer of the newest frame:
+ *    no storage is allocated and nothing is copied. Stale frames go back to the driver
+ *    at once.
+ * 2. The buffer stays out of the driver queue while any lease holds it, for example the
+ *    JPEG encoder of Explain(). It is queued back exactly once, when the last holder
+ *    releases it, from any thread.
+ * 3. A rotation or byte swap frees the sensor buffer once it is done. The converted
+ *    frame goes to storage that is allocated once and reused by later captures, also
+ *    when two conversions are chained. The storage is accounted to the camera memory
+ *    region until the frame is destroyed.
+ * 4. With a single buffer (DVP cameras), capturing while the frame is still leased fails
+ *    instead of blocking.
+ *
+ * Usage: camera_lease_test [-v]
+ */
+#include "camera_buffer_pool.h"
+#include "arena_allocator.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <vector>
+
+// V4L2 mmap capture device, buffers are filled in the order they were queued
+class FakeVideoDevice {
+public:
+    FakeVideoDevice(int buffer_count, size_t frame_size) : frame_size_(frame_size) {
+        buffers_.resize(buffer_count);
+        for (int i = 0; i < buffer_count; i++) {
+            buffers_[i].memory.resize(frame_size);
+            queue_.push_back(i);
+            buffers_[i].queued = true;
+        }
+    }
+
+    bool Dequeue(uint32_t& index, size_t& bytesused, int64_t& timestamp_us) {
+        if (queue_.empty()) {
+            would_block_++;
+            return false;
+        }
+        index = queue_.front();
+        queue_.pop_front();
+        auto& buffer = buffers_[index];
+        buffer.queued = false;
+        // Every frame carries its sequence number
+        sequence_++;
+        memcpy(buffer.memory.data(), &sequence_, sizeof(sequence_));
+        bytesused = frame_size_;
+        timestamp_us = sequence_ * 33333;
+        return true;
+    }
+
+    bool Queue(uint32_t index) {
+        if (index >= buffers_.size() || buffers_[index].queued) {
+            double_queued_++;
+            return false;
+        }
+        buffers_[index].queued = true;
+        queue_.push_back(index);
+        return true;
+    }
+
+    CameraBufferPool CreatePool() {
+        return CameraBufferPool([this](uint32_t& index, size_t& bytesused, int64_t& timestamp_us) {
+                                    return Dequeue(index, bytesused, timestamp_us);
+                                },
+                                [this](uint32_t index) { return Queue(index); });
+    }
+
+    void AddBuffersTo(CameraBufferPool& pool) {
+        for (auto& buffer : buffers_) {
+            pool.AddBuffer(buffer.memory.data(), buffer.memory.size());
+        }
+    }
+
+    const uint8_t* memory(uint32_t index) const { return buffers_[index].memory.data(); }
+    bool queued(uint32_t index) const { return buffers_[index].queued; }
+    size_t queued_count() const { return queue_.size(); }
+    uint32_t sequence() const { return sequence_; }
+    int would_block() const { return would_block_; }
+    int double_queued() const { return double_queued_; }
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> memory;
+        bool queued = false;
+    };
+
+    std::vector<Buffer> buffers_;
+    std::deque<uint32_t> queue_;
+    size_t frame_size_;
+    uint32_t sequence_ = 0;
+    int would_block_ = 0;
+    int double_queued_ = 0;
+};
+
+static uint32_t FrameSequence(const uint8_t* data) {
+    uint32_t sequence;
+    memcpy(&sequence, data, sizeof(sequence));
+    return sequence;
+}
+
+// Esp32Camera::Capture() up to the preview: release the last frame, skip the stale ones
+static bool Capture(CameraBufferPool& pool, CameraFrame& frame, bool rotate, bool swap) {
+    frame.Clear();
+    FrameLease lease = pool.AcquireFresh();
+    if (!lease.valid()) {
+        return false;
+    }
+    if (swap) {
+        auto dst = frame.Reserve(lease.size());
+        if (dst == nullptr) {
+            return false;
+        }
+        memcpy(dst, lease.data(), lease.size());
+        frame.UseReserved(lease.size(), 64, 48, 1);
+        lease.Release();
+    } else {
+        frame.Use(std::move(lease), 64, 48, 1);
+    }
+    if (rotate) {
+        size_t len = frame.len();
+        auto dst = frame.Reserve(len);
+        if (dst == nullptr) {
+            return false;
+        }
+        memcpy(dst, frame.data(), len);
+        frame.UseReserved(len, 48, 64, 1);
+    }
+    return true;
+}
+
+static void TestInPlace(int buffer_count) {
+    char test[32];
+    snprintf(test, sizeof(test), "in place, %d buffers", buffer_count);
+    const size_t frame_size = 64 * 48 * 2;
+    FakeVideoDevice device(buffer_count, frame_size);
+    CameraBufferPool pool = device.CreatePool();
+    device.AddBuffersTo(pool);
+    CameraFrame frame;
+
+    for (int i = 0; i < 20; i++) {
+        Check(Capture(pool, frame, false, false), test, "capture failed");
+        auto& lease = frame.lease();
+        Check(lease.valid(), test, "frame holds no lease");
+        Check(frame.data() == device.memory(lease.index()), test, "frame is not read from the mmap buffer");
+        Check(frame.len() == frame_size, test, "frame length differs from bytesused");
+        Check(FrameSequence(frame.data()) == device.sequence(), test, "frame is not the newest one");
+        Check(lease.timestamp_us() == device.sequence() * 33333, test, "frame timestamp not kept");
+        Check(pool.leased(lease.index()) && !device.queued(lease.index()), test, "leased buffer is queued");
+        Check(device.queued_count() == (size_t)buffer_count - 1, test, "stale buffers were not queued back");
+    }
+    frame.Clear();
+    Check(device.queued_count() == (size_t)buffer_count, test, "buffer not queued back after Clear()");
+
+    auto stats = pool.stats();
+    // One stale frame per queued buffer
+    uint32_t dequeued = 20 * (buffer_count + 1);
+    Check(stats.dequeued == dequeued && stats.leased == 20 && stats.skipped == dequeued - 20, test, "dequeue counts");
+    Check(stats.requeued == dequeued && stats.errors == 0, test, "requeue counts");
+    Check(frame.stats().in_place == 20 && frame.stats().converted == 0, test, "frames were copied");
+    Check(frame.stats().allocations == 0, test, "storage allocated without conversion");
+    Check(device.would_block() == 0 && device.double_queued() == 0, test, "driver misuse");
+    if (verbose) {
+        printf("%s: %u dequeued, %u skipped, %u leased, %u converted, %u allocations\n", test,
+            stats.dequeued, stats.skipped, stats.leased, frame.stats().converted, frame.stats().allocations);
+    }
+}
+
+static void TestSharedLease() {
+    const char* test = "shared lease";
+    FakeVideoDevice device(2, 256);
+    CameraBufferPool pool = device.CreatePool();
+    device.AddBuffersTo(pool);
+    CameraFrame frame;
+
+    Check(Capture(pool, frame, false, false), test, "capture failed");
+    uint32_t index = frame.lease().index();
+
+    // Explain() hands a copy of the lease to the encoder thread
+    FrameLease encoder_lease = frame.lease();
+    frame.Clear();
+    Check(pool.leased(index) && !device.queued(index), test, "buffer queued while the encoder reads it");
+    Check(encoder_lease.data() == device.memory(index), test, "encoder does not read the mmap buffer");
+
+    std::thread encoder([&encoder_lease]() {
+        encoder_lease.Release();
+    });
+    encoder.join();
+    Check(!pool.leased(index) && device.queued(index), test, "buffer not queued back by the last holder");
+
+    // Releasing again or destroying empty leases does not queue the buffer twice
+    encoder_lease.Release();
+    frame.Clear();
+    Check(device.double_queued() == 0, test, "buffer queued twice");
+    Check(pool.stats().requeued == 3, test, "requeue count");
+}
+
+static void TestConversions() {
+    const char* test = "conversions";
+    const size_t frame_size = 64 * 48 * 2;
+    FakeVideoDevice device(2, frame_size);
+    CameraBufferPool pool = device.CreatePool();
+    device.AddBuffersTo(pool);
+
+    // Rotation only: one storage buffer, the sensor buffer is back once rotated
+    CameraFrame rotated;
+    const uint8_t* storage = nullptr;
+    for (int i = 0; i < 20; i++) {
+        Check(Capture(pool, rotated, true, false), test, "rotate capture failed");
+        Check(!rotated.lease().valid(), test, "rotated frame still holds the sensor buffer");
+        Check(device.queued_count() == 2, test, "sensor buffer not queued back after rotation");
+        Check(FrameSequence(rotated.data()) == device.sequence(), test, "rotated frame is not the newest one");
+        Check(rotated.width() == 48 && rotated.height() == 64, test, "rotated size");
+        if (storage == nullptr) {
+            storage = rotated.data();
+        }
+        Check(rotated.data() == storage, test, "rotated frame storage not reused");
+    }
+    Check(rotated.stats().allocations == 1, test, "rotation storage allocated more than once");
+    Check(rotated.stats().converted == 20, test, "rotation count");
+
+    // Byte swap then rotation: the rotation reads the swapped frame from the other storage
+    CameraFrame chained;
+    for (int i = 0; i < 20; i++) {
+        Check(Capture(pool, chained, true, true), test, "chained capture failed");
+        Check(FrameSequence(chained.data()) == device.sequence(), test, "chained frame is not the newest one");
+        Check(device.queued_count() == 2, test, "sensor buffer not queued back after conversion");
+    }
+    Check(chained.stats().allocations == 2, test, "chained conversions allocated more than two buffers");
+    Check(chained.stats().converted == 40 && chained.stats().in_place == 0, test, "chained conversion counts");
+
+    // A larger frame grows the storage once
+    CameraFrame growing;
+    FakeVideoDevice large(1, frame_size * 2);
+    CameraBufferPool large_pool = large.CreatePool();
+    large.AddBuffersTo(large_pool);
+    Check(Capture(pool, growing, true, false), test, "small capture failed");
+    Check(Capture(large_pool, growing, true, false), test, "large capture failed");
+    Check(Capture(pool, growing, true, false), test, "small capture after large failed");
+    Check(growing.stats().allocations == 2, test, "storage not grown once");
+    growing.Clear();
+
+    // One frame for rotated, two for chained, and growing replaced its frame with a double one
+    auto region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_CAMERA);
+    Check(region->used() == 5 * frame_size, test, "storage not accounted to the camera region");
+
+    Check(device.would_block() == 0 && device.double_queued() == 0, test, "driver misuse");
+    if (verbose) {
+        printf("%s: rotate %u allocations for %u frames, swap and rotate %u allocations for %u conversions\n",
+            test, rotated.stats().allocations, rotated.stats().converted,
+            chained.stats().allocations, chained.stats().converted);
+    }
+}
+
+static void TestSingleBuffer() {
+    const char* test = "single buffer";
+    FakeVideoDevice device(1, 256);
+    CameraBufferPool pool = device.CreatePool();
+    device.AddBuffersTo(pool);
+    CameraFrame frame;
+
+    Check(Capture(pool, frame, false, false), test, "capture failed");
+    FrameLease held = frame.lease();
+    // The encoder still holds the only buffer, the next capture must not block
+    Check(!Capture(pool, frame, false, false), test, "capture with every buffer leased succeeded");
+    Check(device.would_block() == 0, test, "dequeue called with an empty queue");
+    Check(pool.stats().errors == 1, test, "error not counted");
+    held.Release();
+    Check(Capture(pool, frame, false, false), test, "capture after release failed");
+    Check(device.double_queued() == 0, test, "buffer queued twice");
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestInPlace(1);
+    TestInPlace(2);
+    TestSharedLease();
+    TestConversions();
+    Check(MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_CAMERA)->used() == 0, "conversions",
+        "storage not freed with the frames");
+    TestSingleBuffer();
+    return ReportChecks();
+}
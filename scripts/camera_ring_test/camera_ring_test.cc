@@ -0,0 +1,363 @@
+/*
+ * Host simulation of the background frame ring of Esp32Camera
+ * (CONFIG_XIAOZHI_ENABLE_CAMERA_FRAME_RING).
+ *
+ * A fake camera streams at 30 fps into V4L2 style buffers. The driver fills its queued
+ * buffers in order, and a dequeue waits for the next sensor frame when no filled buffer
+ * is ready. Its auto exposure converges on the scene brightness with a 150 ms half-life
+ * after every start and scene change. CameraBufferPool and CameraFrameRing are driven
+ * the way the camera_ring task and Capture() drive them on the device, on a simulated
+ * clock. The test checks that:
+ *
+ * 1. Once the exposure settled, every photo is served from the ring at once, without
+ *    waiting for the sensor. The photo is the newest frame and at most one ring period
+ *    plus one sensor frame old.
+ * 2. While the exposure moves after a start, a resume or a scene change, no frame is
+ *    served and photos fall back to fresh frames from the driver.
+ * 3. The ring never holds more than its depth. With depth + 2 buffers, the driver always
+ *    keeps a buffer to fill while the ring and the last photo hold theirs.
+ * 4. Pausing for power save gives every ring buffer back to the driver.
+ * 5. A flickering scene that never settles is served after max_settle_frames frames.
+ *
+ * Usage: camera_ring_test [-v]
+ */
+#include "camera_frame_ring.h"
+#include "host_test.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+static const int64_t kSensorPeriodUs = 33333;   // 30 fps
+// Frame content: brightness, then the capture time
+struct FrameHeader {
+    uint8_t brightness;
+    int64_t captured_us;
+};
+
+class FakeCamera {
+public:
+    FakeCamera(int buffer_count, int64_t& clock) : clock_(clock) {
+        buffers_.resize(buffer_count);
+        for (int i = 0; i < buffer_count; i++) {
+            buffers_[i].memory.resize(640 * 480 * 2);
+            buffers_[i].queued = true;
+            queue_.push_back(i);
+        }
+    }
+
+    void AddBuffersTo(CameraBufferPool& pool) {
+        for (auto& buffer : buffers_) {
+            pool.AddBuffer(buffer.memory.data(), buffer.memory.size());
+        }
+    }
+
+    // The exposure converges from the current brightness to target
+    void SetScene(double target) {
+        start_brightness_ = Brightness(clock_);
+        target_ = target;
+        scene_changed_us_ = clock_;
+    }
+    void SetFlicker(bool flicker) { flicker_ = flicker; }
+    // Stopping and starting the stream makes the exposure start over from dark
+    void Restart() {
+        start_brightness_ = 20;
+        scene_changed_us_ = clock_;
+    }
+    double target() const { return target_; }
+
+    bool Dequeue(uint32_t& index, size_t& bytesused, int64_t& timestamp_us) {
+        if (queue_.empty()) {
+            would_block_++;
+            return false;
+        }
+        index = queue_.front();
+        queue_.pop_front();
+        auto& buffer = buffers_[index];
+        // Filled by the first sensor frame after it was queued and after the previous fill
+        int64_t earliest = std::max(buffer.queued_us, last_fill_us_ + 1);
+        int64_t fill_us = (earliest + kSensorPeriodUs - 1) / kSensorPeriodUs * kSensorPeriodUs;
+        last_fill_us_ = fill_us;
+        if (fill_us > clock_) {
+            waited_us_ += fill_us - clock_;
+            clock_ = fill_us;
+        }
+        FrameHeader header = {(uint8_t)std::lround(Brightness(fill_us)), fill_us};
+        memcpy(buffer.memory.data(), &header, sizeof(header));
+        buffer.queued = false;
+        bytesused = buffer.memory.size();
+        timestamp_us = clock_;
+        dequeued_++;
+        return true;
+    }
+
+    bool Queue(uint32_t index) {
+        if (buffers_[index].queued) {
+            double_queued_++;
+            return false;
+        }
+        buffers_[index].queued = true;
+        buffers_[index].queued_us = clock_;
+        queue_.push_back(index);
+        return true;
+    }
+
+    size_t queued_count() const { return queue_.size(); }
+    int would_block() const { return would_block_; }
+    int double_queued() const { return double_queued_; }
+    int dequeued() const { return dequeued_; }
+    int64_t waited_us() const { return waited_us_; }
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> memory;
+        bool queued = false;
+        int64_t queued_us = 0;
+    };
+
+    double Brightness(int64_t t) const {
+        double elapsed = (t - scene_changed_us_) / 150000.0;
+        double b = target_ + (start_brightness_ - target_) * std::pow(0.5, std::max(elapsed, 0.0));
+        if (flicker_) {
+            b += (t / kSensorPeriodUs) % 2 ? 24 : -24;
+        }
+        return std::min(std::max(b, 0.0), 255.0);
+    }
+
+    int64_t& clock_;
+    std::vector<Buffer> buffers_;
+    std::deque<uint32_t> queue_;
+    int64_t last_fill_us_ = -1;
+    double start_brightness_ = 20;
+    double target_ = 20;
+    int64_t scene_changed_us_ = 0;
+    bool flicker_ = false;
+    int would_block_ = 0;
+    int double_queued_ = 0;
+    int dequeued_ = 0;
+    int64_t waited_us_ = 0;
+};
+
+static FrameHeader Header(const uint8_t* data) {
+    FrameHeader header;
+    memcpy(&header, data, sizeof(header));
+    return header;
+}
+
+struct Photos {
+    int from_ring = 0;
+    int from_driver = 0;
+    int64_t ring_wait_us = 0;
+    int64_t driver_wait_us = 0;
+};
+
+class Simulation {
+public:
+    Simulation(const char* test, int depth, int fps)
+        : test_(test), depth_(depth), period_us_(1000000 / fps),
+          camera_(depth + 2, clock_),
+          pool_([this](uint32_t& index, size_t& bytesused, int64_t& timestamp_us) {
+                    return camera_.Dequeue(index, bytesused, timestamp_us);
+                },
+                [this](uint32_t index) { return camera_.Queue(index); }),
+          ring_(depth) {
+        camera_.AddBuffersTo(pool_);
+        next_tick_us_ = 0;
+    }
+
+    FakeCamera& camera() { return camera_; }
+    CameraFrameRing& ring() { return ring_; }
+    const Photos& photos() const { return photos_; }
+
+    void Pause() {
+        paused_ = true;
+        ring_.Clear();
+        // Only the last photo keeps a buffer
+        size_t held = photo_.lease().valid() ? 1 : 0;
+        Check(camera_.queued_count() == (size_t)depth_ + 2 - held, test_, "pause did not give the ring buffers back");
+    }
+
+    void Resume() {
+        paused_ = false;
+        camera_.Restart();
+        next_tick_us_ = clock_;
+    }
+
+    // Run the ring task until end_us, taking photos at the given times
+    void Run(int64_t end_us, std::vector<int64_t> photo_times, bool expect_settled_photos) {
+        size_t next_photo = 0;
+        while (true) {
+            int64_t next_event = std::min(paused_ ? INT64_MAX : next_tick_us_,
+                next_photo < photo_times.size() ? photo_times[next_photo] : INT64_MAX);
+            if (next_event >= end_us) {
+                clock_ = std::max(clock_, end_us);
+                break;
+            }
+            clock_ = std::max(clock_, next_event);
+            if (next_photo < photo_times.size() && photo_times[next_photo] <= clock_) {
+                TakePhoto(expect_settled_photos);
+                next_photo++;
+                continue;
+            }
+
+            // One tick of the camera_ring task
+            FrameLease lease = pool_.AcquireFresh();
+            Check(lease.valid(), test_, "ring task could not dequeue");
+            if (lease.valid()) {
+                auto header = Header(lease.data());
+                Check(clock_ - header.captured_us <= kSensorPeriodUs, test_, "ring frame is not fresh");
+                ring_.Push(std::move(lease), clock_, header.brightness);
+                pushed_++;
+            }
+            Check(ring_.size() <= (size_t)depth_, test_, "ring holds more than its depth");
+            Check(camera_.queued_count() >= 1, test_, "no buffer left for the driver");
+            next_tick_us_ += period_us_;
+        }
+    }
+
+    void TakePhoto(bool expect_settled) {
+        int64_t start = clock_;
+        photo_.Clear();
+        CameraFrameRing::Frame frame;
+        FrameLease lease;
+        if (!paused_ && ring_.Newest(clock_, 2 * period_us_, frame)) {
+            lease = std::move(frame.lease);
+            auto header = Header(lease.data());
+            Check(clock_ - header.captured_us <= period_us_ + kSensorPeriodUs, test_, "photo from the ring is too old");
+            Check(std::fabs(header.brightness - camera_.target()) <= 8, test_, "photo served before the exposure settled");
+            photos_.from_ring++;
+            photos_.ring_wait_us += clock_ - start;
+        } else {
+            Check(!expect_settled, test_, "settled ring did not serve the photo");
+            lease = pool_.AcquireFresh();
+            Check(lease.valid(), test_, "photo could not dequeue");
+            photos_.from_driver++;
+            photos_.driver_wait_us += clock_ - start;
+        }
+        Check(clock_ - start == 0 || !expect_settled, test_, "photo from the ring waited for the sensor");
+        photo_.Use(std::move(lease), 640, 480, 0);
+    }
+
+    void Finish() {
+        photo_.Clear();
+        ring_.Clear();
+        Check(camera_.queued_count() == (size_t)depth_ + 2, test_, "buffers not back in the driver at the end");
+        Check(camera_.would_block() == 0, test_, "dequeue with an empty queue");
+        Check(camera_.double_queued() == 0, test_, "buffer queued twice");
+        Check(pool_.stats().errors == 0, test_, "pool errors");
+    }
+
+    int64_t clock() const { return clock_; }
+
+private:
+    const char* test_;
+    int depth_;
+    int64_t period_us_;
+    int64_t clock_ = 0;
+    FakeCamera camera_;
+    CameraBufferPool pool_;
+    CameraFrameRing ring_;
+    CameraFrame photo_;
+    bool paused_ = false;
+    int64_t next_tick_us_ = 0;
+    int pushed_ = 0;
+    Photos photos_;
+};
+
+static std::vector<int64_t> PhotoTimes(std::mt19937& rng, int64_t from_us, int64_t to_us) {
+    std::vector<int64_t> times;
+    std::uniform_int_distribution<int64_t> gap(300000, 1500000);
+    for (int64_t t = from_us + gap(rng); t < to_us; t += gap(rng)) {
+        times.push_back(t);
+    }
+    return times;
+}
+
+static void TestConversation(int depth, int fps) {
+    char test[48];
+    snprintf(test, sizeof(test), "conversation, depth %d, %d fps", depth, fps);
+    std::mt19937 rng(depth * 100 + fps);
+    Simulation sim(test, depth, fps);
+    sim.camera().SetScene(128);
+
+    // Warm up: photos right after the start come from the driver
+    sim.Run(150000, {100000}, false);
+    Check(!sim.ring().settled(), test, "settled while the exposure moves");
+    Check(sim.photos().from_driver == 1, test, "photo during warm up not taken from the driver");
+
+    // Settled: every photo comes from the ring without waiting
+    sim.Run(3000000, {}, false);
+    Check(sim.ring().settled(), test, "exposure did not settle");
+    int settle_frames = sim.ring().stats().settle_frames;
+    sim.Run(10000000, PhotoTimes(rng, 3000000, 10000000), true);
+    int ring_photos = sim.photos().from_ring;
+    Check(ring_photos > 0, test, "no photo from the ring");
+
+    // Power save: the ring lets go of its buffers, photos come from the driver
+    sim.Pause();
+    sim.Run(13000000, PhotoTimes(rng, 10000000, 13000000), false);
+    Check(sim.photos().from_ring == ring_photos, test, "photo from the ring while paused");
+
+    // Resume into a brighter scene: nothing is served until it settled again
+    sim.Resume();
+    sim.camera().SetScene(200);
+    sim.Run(13000000 + 400000, {13000000 + 200000}, false);
+    Check(!sim.ring().settled(), test, "settled right after the resume");
+    sim.Run(16000000, {}, false);
+    Check(sim.ring().settled(), test, "exposure did not settle after the resume");
+    sim.Run(24000000, PhotoTimes(rng, 16000000, 24000000), true);
+    sim.Finish();
+
+    auto& photos = sim.photos();
+    if (verbose) {
+        printf("%s: settled after %d frames, %d photos from the ring (%.1f ms wait), "
+            "%d from the driver (%.1f ms average wait)\n", test, settle_frames,
+            photos.from_ring, photos.from_ring ? photos.ring_wait_us / 1000.0 / photos.from_ring : 0.0,
+            photos.from_driver, photos.from_driver ? photos.driver_wait_us / 1000.0 / photos.from_driver : 0.0);
+    }
+}
+
+static void TestFlicker() {
+    const char* test = "flicker";
+    const int depth = 2;
+    Simulation sim(test, depth, 2);
+    sim.camera().SetScene(128);
+    sim.camera().SetFlicker(true);
+    // Brightness keeps jumping by 48, the ring serves after max_settle_frames (8) frames
+    sim.Run(3400000, {}, false);
+    Check(!sim.ring().settled(), test, "flickering scene settled early");
+    sim.Run(3600000, {}, false);
+    Check(sim.ring().settled(), test, "flickering scene never served");
+    Check(sim.ring().stats().settle_frames == 8, test, "settle frames of a flickering scene");
+    sim.Finish();
+}
+
+static void TestRing() {
+    const char* test = "ring";
+    CameraFrameRing ring(2, 4, 2, 8);
+    CameraFrameRing::Frame frame;
+    Check(!ring.Newest(0, 1000, frame), test, "empty ring served a frame");
+    ring.Push(FrameLease(), 0, 100);
+    ring.Push(FrameLease(), 100, 102);
+    Check(!ring.settled(), test, "settled after one stable step");
+    ring.Push(FrameLease(), 200, 101);
+    Check(ring.settled() && ring.size() == 2, test, "settle or depth");
+    Check(ring.Newest(250, 100, frame) && frame.timestamp_us == 200, test, "newest frame not served");
+    Check(!ring.Newest(301, 100, frame), test, "frame older than max age served");
+    Check(ring.stats().unsettled == 0 && ring.stats().served == 1, test, "stats");
+    ring.Clear();
+    Check(ring.size() == 0 && !ring.settled(), test, "clear");
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestRing();
+    TestConversation(1, 2);
+    TestConversation(2, 2);
+    TestConversation(4, 5);
+    TestFlicker();
+    return ReportChecks();
+}
@@ -0,0 +1,17 @@
+/* Minimal LVGL configuration for the headless chat list benchmark, unset options use the LVGL defaults */
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#define LV_COLOR_DEPTH 16
+
+/* lv_malloc_core() and friends are implemented by the benchmark to count heap churn */
+#define LV_USE_STDLIB_MALLOC    LV_STDLIB_CUSTOM
+#define LV_USE_STDLIB_STRING    LV_STDLIB_CLIB
+#define LV_USE_STDLIB_SPRINTF   LV_STDLIB_CLIB
+
+#define LV_USE_OS   LV_OS_NONE
+#define LV_USE_LOG  0
+
+#define LV_FONT_MONTSERRAT_14 1
+
+#endif /* LV_CONF_H */
@@ -0,0 +1,420 @@
+/*
+ * Headless LVGL benchmark for the chat message list.
+ *
+ * The same stream of messages is shown with the old code, which creates a container,
+ * bubble and label for every message and deletes the oldest one at the limit, and with
+ * ChatMessageList, which rebinds a fixed pool of bubbles. After every message the
+ * screen is refreshed as it would be on the device. LVGL uses a counting allocator, so
+ * the benchmark reports the time per message, the heap churn and the peak number of
+ * LVGL objects for both.
+ *
+ * Usage: chat_list_bench [-w width] [-h height] [-n messages] [-c capacity]
+ */
+#include "chat_message_list.h"
+
+#include <lvgl.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/* Counting allocator used by LVGL through LV_STDLIB_CUSTOM */
+
+struct HeapStats {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t allocated_bytes = 0;
+    size_t live_bytes = 0;
+    size_t peak_bytes = 0;
+};
+
+static HeapStats heap;
+
+// Every block starts with its size, 16 bytes keep the payload aligned
+static const size_t kHeaderSize = 16;
+
+void lv_mem_init(void) {}
+
+void lv_mem_deinit(void) {}
+
+lv_mem_pool_t lv_mem_add_pool(void* mem, size_t bytes) {
+    (void)mem;
+    (void)bytes;
+    return nullptr;
+}
+
+void lv_mem_remove_pool(lv_mem_pool_t pool) {
+    (void)pool;
+}
+
+void* lv_malloc_core(size_t size) {
+    auto block = static_cast<uint8_t*>(malloc(size + kHeaderSize));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    heap.allocations++;
+    heap.allocated_bytes += size;
+    heap.live_bytes += size;
+    if (heap.live_bytes > heap.peak_bytes) {
+        heap.peak_bytes = heap.live_bytes;
+    }
+    return block + kHeaderSize;
+}
+
+void lv_free_core(void* p) {
+    if (p == nullptr) {
+        return;
+    }
+    auto block = static_cast<uint8_t*>(p) - kHeaderSize;
+    heap.frees++;
+    heap.live_bytes -= *reinterpret_cast<size_t*>(block);
+    free(block);
+}
+
+void* lv_realloc_core(void* p, size_t new_size) {
+    void* new_p = lv_malloc_core(new_size);
+    if (new_p != nullptr && p != nullptr) {
+        size_t old_size = *reinterpret_cast<size_t*>(static_cast<uint8_t*>(p) - kHeaderSize);
+        memcpy(new_p, p, old_size < new_size ? old_size : new_size);
+        lv_free_core(p);
+    }
+    return new_p;
+}
+
+void lv_mem_monitor_core(lv_mem_monitor_t* mon_p) {
+    memset(mon_p, 0, sizeof(*mon_p));
+    mon_p->total_size = heap.peak_bytes;
+    mon_p->max_used = heap.peak_bytes;
+}
+
+lv_result_t lv_mem_test_core(void) {
+    return LV_RESULT_OK;
+}
+
+/* Display and workload */
+
+static double NowUs() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t TickCb() {
+    return (uint32_t)(NowUs() / 1000);
+}
+
+static void FlushCb(lv_display_t* display, const lv_area_t* area, uint8_t* px_map) {
+    (void)area;
+    (void)px_map;
+    lv_display_flush_ready(display);
+}
+
+static uint32_t CountObjects(lv_obj_t* obj) {
+    uint32_t count = 1;
+    uint32_t child_count = lv_obj_get_child_count(obj);
+    for (uint32_t i = 0; i < child_count; i++) {
+        count += CountObjects(lv_obj_get_child(obj, i));
+    }
+    return count;
+}
+
+struct Message {
+    const char* role;
+    std::string text;
+    bool image;
+};
+
+// A conversation: short user turns, longer assistant answers, status messages and a
+// camera preview now and then
+static std::vector<Message> MakeMessages(int count) {
+    static const char* kWords[] = {"hello", "weather", "today", "is", "sunny", "with", "a", "light", "breeze",
+        "and", "the", "temperature", "will", "reach", "twenty", "degrees", "later"};
+    std::vector<Message> messages;
+    uint32_t seed = 1;
+    for (int i = 0; i < count; i++) {
+        Message message;
+        message.image = false;
+        if (i % 100 == 99) {
+            message.role = "assistant";
+            message.image = true;
+        } else if (i % 10 == 9) {
+            message.role = "system";
+        } else {
+            message.role = i % 2 == 0 ? "user" : "assistant";
+        }
+        int words = message.role[0] == 'a' ? 8 + i % 30 : 2 + i % 6;
+        for (int w = 0; w < words; w++) {
+            seed = seed * 1103515245 + 12345;
+            if (w > 0) {
+                message.text += ' ';
+            }
+            message.text += kWords[(seed >> 16) % (sizeof(kWords) / sizeof(kWords[0]))];
+        }
+        messages.push_back(std::move(message));
+    }
+    return messages;
+}
+
+static ChatBubbleStyle MakeStyle() {
+    ChatBubbleStyle style;
+    style.font = &lv_font_montserrat_14;
+    style.user_bubble_color = lv_color_hex(0x95EC69);
+    style.assistant_bubble_color = lv_color_hex(0xFFFFFF);
+    style.system_bubble_color = lv_color_hex(0xE0E0E0);
+    style.text_color = lv_color_hex(0x000000);
+    style.system_text_color = lv_color_hex(0x666666);
+    style.border_color = lv_color_hex(0x000000);
+    style.padding = 8;
+    style.row_gap = 8;
+    return style;
+}
+
+// The chat area of LcdDisplay::SetupUI with the message style
+static lv_obj_t* CreateContent(const ChatBubbleStyle& style) {
+    lv_obj_t* screen = lv_obj_create(nullptr);
+    lv_screen_load(screen);
+    lv_obj_set_style_text_font(screen, style.font, 0);
+
+    lv_obj_t* content = lv_obj_create(screen);
+    lv_obj_set_size(content, LV_HOR_RES, LV_VER_RES);
+    lv_obj_set_style_radius(content, 0, 0);
+    lv_obj_set_style_pad_all(content, style.padding, 0);
+    lv_obj_set_style_border_width(content, 0, 0);
+    lv_obj_set_scrollbar_mode(content, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_scroll_dir(content, LV_DIR_VER);
+    lv_obj_set_flex_flow(content, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_flex_align(content, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+    lv_obj_set_style_pad_row(content, style.row_gap, 0);
+    return content;
+}
+
+/* The per message object creation that ChatMessageList replaced */
+
+static void LegacySetChatMessage(lv_obj_t* content, const ChatBubbleStyle& style, uint32_t max_messages,
+    const char* role, const char* text) {
+    uint32_t child_count = lv_obj_get_child_count(content);
+    if (child_count >= max_messages) {
+        lv_obj_t* first_child = lv_obj_get_child(content, 0);
+        lv_obj_t* last_child = lv_obj_get_child(content, child_count - 1);
+        lv_obj_delete(first_child);
+        lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+    }
+    if (strcmp(role, "system") == 0 && child_count > 0) {
+        lv_obj_t* last_container = lv_obj_get_child(content, lv_obj_get_child_count(content) - 1);
+        if (lv_obj_get_child_count(last_container) > 0) {
+            auto type = (const char*)lv_obj_get_user_data(lv_obj_get_child(last_container, 0));
+            if (type != nullptr && strcmp(type, "system") == 0) {
+                lv_obj_delete(last_container);
+            }
+        }
+    }
+
+    lv_obj_t* msg_bubble = lv_obj_create(content);
+    lv_obj_set_style_radius(msg_bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(msg_bubble, 0, 0);
+    lv_obj_set_style_pad_all(msg_bubble, style.padding, 0);
+
+    lv_obj_t* msg_text = lv_label_create(msg_bubble);
+    lv_label_set_text(msg_text, text);
+    int32_t text_width = lv_text_get_width(text, strlen(text), style.font, 0);
+    int32_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    int32_t bubble_width = text_width < 20 ? 20 : (text_width < max_width ? text_width : max_width);
+    lv_obj_set_width(msg_text, bubble_width);
+    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
+    lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
+    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
+
+    if (strcmp(role, "user") == 0 || strcmp(role, "system") == 0) {
+        bool user = role[0] == 'u';
+        lv_obj_set_style_bg_color(msg_bubble, user ? style.user_bubble_color : style.system_bubble_color, 0);
+        lv_obj_set_style_text_color(msg_text, user ? style.text_color : style.system_text_color, 0);
+        lv_obj_set_user_data(msg_bubble, (void*)(user ? "user" : "system"));
+
+        lv_obj_t* container = lv_obj_create(content);
+        lv_obj_set_width(container, LV_HOR_RES);
+        lv_obj_set_height(container, LV_SIZE_CONTENT);
+        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
+        lv_obj_set_style_border_width(container, 0, 0);
+        lv_obj_set_style_pad_all(container, 0, 0);
+        lv_obj_set_parent(msg_bubble, container);
+        if (user) {
+            lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+        } else {
+            lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
+        }
+        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+    } else {
+        lv_obj_set_style_bg_color(msg_bubble, style.assistant_bubble_color, 0);
+        lv_obj_set_style_text_color(msg_text, style.text_color, 0);
+        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
+        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+    }
+}
+
+static void LegacySetPreviewImage(lv_obj_t* content, const ChatBubbleStyle& style, std::unique_ptr<LvglImage> image) {
+    lv_obj_t* img_bubble = lv_obj_create(content);
+    lv_obj_set_style_radius(img_bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(img_bubble, 0, 0);
+    lv_obj_set_style_pad_all(img_bubble, style.padding, 0);
+    lv_obj_set_style_bg_color(img_bubble, style.assistant_bubble_color, 0);
+    lv_obj_set_style_bg_opa(img_bubble, LV_OPA_70, 0);
+    lv_obj_set_user_data(img_bubble, (void*)"image");
+
+    lv_obj_t* preview_image = lv_image_create(img_bubble);
+    int32_t max_width = LV_HOR_RES * 70 / 100;
+    int32_t max_height = LV_VER_RES * 50 / 100;
+    auto img_dsc = image->image_dsc();
+    int32_t zoom_w = max_width * 256 / img_dsc->header.w;
+    int32_t zoom_h = max_height * 256 / img_dsc->header.h;
+    int32_t zoom = zoom_w < zoom_h ? zoom_w : zoom_h;
+    if (zoom > 256) zoom = 256;
+    lv_image_set_src(preview_image, img_dsc);
+    lv_image_set_scale(preview_image, zoom);
+    lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
+        delete (LvglImage*)lv_event_get_user_data(e);
+    }, LV_EVENT_DELETE, image.release());
+    lv_obj_set_width(img_bubble, img_dsc->header.w * zoom / 256 + 16);
+    lv_obj_set_height(img_bubble, img_dsc->header.h * zoom / 256 + 16);
+    lv_obj_center(preview_image);
+    lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
+}
+
+/* Benchmark */
+
+static const int kImageWidth = 160;
+static const int kImageHeight = 120;
+
+static std::unique_ptr<LvglImage> MakeImage(std::vector<uint16_t>& pixels, lv_image_dsc_t& dsc) {
+    pixels.assign(kImageWidth * kImageHeight, 0x841F);
+    memset(&dsc, 0, sizeof(dsc));
+    dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    dsc.header.cf = LV_COLOR_FORMAT_RGB565;
+    dsc.header.w = kImageWidth;
+    dsc.header.h = kImageHeight;
+    dsc.header.stride = kImageWidth * 2;
+    dsc.data = (const uint8_t*)pixels.data();
+    dsc.data_size = pixels.size() * 2;
+    return std::make_unique<LvglSourceImage>(&dsc);
+}
+
+static void Run(const char* name, bool pooled, const std::vector<Message>& messages, lv_display_t* display,
+    uint32_t capacity) {
+    auto style = MakeStyle();
+    lv_obj_t* old_screen = lv_screen_active();
+    lv_obj_t* content = CreateContent(style);
+    lv_obj_delete(old_screen);
+    std::unique_ptr<ChatMessageList> list;
+    if (pooled) {
+        list = std::make_unique<ChatMessageList>(content, style, capacity);
+    }
+    std::vector<uint16_t> pixels;
+    lv_image_dsc_t dsc;
+    lv_refr_now(display);
+
+    HeapStats start = heap;
+    heap.peak_bytes = heap.live_bytes;
+    size_t base_bytes = heap.live_bytes;
+    uint32_t peak_objects = 0;
+    double add_us = 0;
+    double refresh_us = 0;
+    for (auto& message : messages) {
+        auto image = message.image ? MakeImage(pixels, dsc) : nullptr;
+        double t0 = NowUs();
+        if (pooled) {
+            if (strcmp(message.role, "system") == 0) {
+                list->RemoveLastSystemMessage();
+            }
+            if (image) {
+                list->AddImage(std::move(image));
+            } else {
+                list->AddMessage(strcmp(message.role, "user") == 0 ? ChatRole::kUser :
+                    strcmp(message.role, "system") == 0 ? ChatRole::kSystem : ChatRole::kAssistant,
+                    message.text.c_str());
+            }
+        } else {
+            if (image) {
+                LegacySetPreviewImage(content, style, std::move(image));
+            } else {
+                LegacySetChatMessage(content, style, capacity, message.role, message.text.c_str());
+            }
+        }
+        double t1 = NowUs();
+        lv_refr_now(display);
+        double t2 = NowUs();
+        add_us += t1 - t0;
+        refresh_us += t2 - t1;
+
+        uint32_t objects = CountObjects(lv_screen_active());
+        if (objects > peak_objects) {
+            peak_objects = objects;
+        }
+    }
+
+    uint64_t allocations = heap.allocations - start.allocations;
+    uint64_t frees = heap.frees - start.frees;
+    uint64_t bytes = heap.allocated_bytes - start.allocated_bytes;
+    size_t n = messages.size();
+    printf("%-8s %8.1f %10.1f %14.1f %10.1f %10zu %8u",
+        name, (add_us + refresh_us) / 1000, add_us / n, refresh_us / n, (double)allocations / n,
+        heap.peak_bytes - base_bytes, peak_objects);
+    if (pooled) {
+        printf("   pool %zu rows, %u binds\n", list->pool_size(), list->stats().binds);
+    } else {
+        printf("\n");
+    }
+    printf("%-8s %8s %10s %14s %10.1f   %llu frees, %llu bytes allocated\n", "", "", "", "",
+        (double)bytes / n, (unsigned long long)frees, (unsigned long long)bytes);
+
+    list.reset();
+}
+
+static void Usage(const char* prog) {
+    printf("Usage: %s [-w width] [-h height] [-n messages] [-c capacity]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int width = 240, height = 320, count = 1000, capacity = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h:n:c:")) != -1) {
+        switch (opt) {
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        case 'n': count = atoi(optarg); break;
+        case 'c': capacity = atoi(optarg); break;
+        default: Usage(argv[0]); return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || count <= 0 || capacity <= 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    lv_init();
+    lv_tick_set_cb(TickCb);
+
+    size_t buffer_size = (size_t)width * 20 * 2;
+    std::vector<uint8_t> buffer(buffer_size);
+    lv_display_t* display = lv_display_create(width, height);
+    lv_display_set_flush_cb(display, FlushCb);
+    lv_display_set_buffers(display, buffer.data(), nullptr, buffer_size, LV_DISPLAY_RENDER_MODE_PARTIAL);
+
+    auto messages = MakeMessages(count);
+    printf("%dx%d, %d messages, %d kept\n", width, height, count, capacity);
+    printf("%-8s %8s %10s %14s %10s %10s %8s\n", "", "total ms", "add us/msg", "refresh us/msg", "allocs/msg",
+        "peak heap", "objects");
+    printf("%-8s %8s %10s %14s %10s\n", "", "", "", "", "bytes/msg");
+    Run("legacy", false, messages, display, capacity);
+    Run("pooled", true, messages, display, capacity);
+
+    lv_display_delete(display);
+    lv_deinit();
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Host test of the local command word intents in main/audio/wake_words/command_intents.cc.
+ *
+ * The test checks that:
+ *
+ * 1. Tool call actions parse: tool names with dots and dashes, integer, boolean and quoted
+ *    string arguments, spaces anywhere between tokens, and calls without arguments.
+ * 2. Malformed actions are rejected: missing parentheses or values, duplicate arguments,
+ *    integers out of range, unterminated strings, trailing text, and "wake" as a tool name.
+ * 3. The dispatch table maps MultiNet ids, which start at 1, to their commands: wake words
+ *    start a conversation, and unknown ids do nothing.
+ * 4. A tool command runs locally only at or above its threshold, below it the command is
+ *    ignored. Actions that do not parse always go to the cloud. Command thresholds below
+ *    the MultiNet detection threshold are raised to it.
+ * 5. Cooldowns are per command: a repeat within the cooldown is ignored, other commands
+ *    still run, and after the cooldown the command runs again. Ignored commands and local
+ *    calls that failed do not start the cooldown.
+ *
+ * Usage: command_intents_test [-v]
+ */
+#include "command_intents.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstring>
+
+static bool Parses(const char* action, std::string& tool, IntentArguments& arguments) {
+    bool ok = ParseIntentAction(action, tool, arguments);
+    if (verbose) {
+        printf("%-60s %s", action, ok ? tool.c_str() : "rejected");
+        if (ok) {
+            for (auto& [name, value] : arguments) {
+                if (std::holds_alternative<bool>(value)) {
+                    printf(" %s=%s", name.c_str(), std::get<bool>(value) ? "true" : "false");
+                } else if (std::holds_alternative<int>(value)) {
+                    printf(" %s=%d", name.c_str(), std::get<int>(value));
+                } else {
+                    printf(" %s='%s'", name.c_str(), std::get<std::string>(value).c_str());
+                }
+            }
+        }
+        printf("\n");
+    }
+    return ok;
+}
+
+static void TestParser() {
+    const char* test = "parser";
+    std::string tool;
+    IntentArguments arguments;
+
+    Check(Parses("self.audio_speaker.set_volume(volume=80)", tool, arguments) &&
+              tool == "self.audio_speaker.set_volume" && arguments.size() == 1 &&
+              std::get<int>(arguments["volume"]) == 80,
+          test, "volume");
+    Check(Parses("  self.screen.set_brightness ( brightness = 30 )  ", tool, arguments) &&
+              tool == "self.screen.set_brightness" && std::get<int>(arguments["brightness"]) == 30,
+          test, "spaces between tokens");
+    Check(Parses("self.lamp.turn_on", tool, arguments) && tool == "self.lamp.turn_on" && arguments.empty(), test,
+          "no arguments");
+    Check(Parses("self.otto.stop()", tool, arguments) && tool == "self.otto.stop" && arguments.empty(), test,
+          "empty argument list");
+    Check(Parses("self.otto.action(action='walk', steps=3, speed=700, direction=-1, arm_swing=+50)", tool,
+                 arguments) &&
+              tool == "self.otto.action" && arguments.size() == 5 &&
+              std::get<std::string>(arguments["action"]) == "walk" && std::get<int>(arguments["steps"]) == 3 &&
+              std::get<int>(arguments["direction"]) == -1 && std::get<int>(arguments["arm_swing"]) == 50,
+          test, "Otto move");
+    Check(Parses("self.light.set_rgb(r=255,g=0,b=64)", tool, arguments) && arguments.size() == 3 &&
+              std::get<int>(arguments["b"]) == 64,
+          test, "lights");
+    Check(Parses("self.set_press_to_talk(mode=\"manual\")", tool, arguments) &&
+              std::get<std::string>(arguments["mode"]) == "manual",
+          test, "double quoted string");
+    Check(Parses("self.display.say(text='it\\'s \"on\", (really)')", tool, arguments) &&
+              std::get<std::string>(arguments["text"]) == "it's \"on\", (really)",
+          test, "escapes and separators inside strings");
+    Check(Parses("self.camera.flip(enable=true, mirror=false)", tool, arguments) &&
+              std::get<bool>(arguments["enable"]) && !std::get<bool>(arguments["mirror"]),
+          test, "booleans");
+    Check(Parses("self.chassis.go-forward(distance=2147483647, back=-2147483648)", tool, arguments) &&
+              tool == "self.chassis.go-forward" && std::get<int>(arguments["distance"]) == 2147483647 &&
+              std::get<int>(arguments["back"]) == -2147483647 - 1,
+          test, "dashes in tool names and integer limits");
+
+    const char* malformed[] = {
+        "",
+        "   ",
+        "wake",
+        "(volume=80)",
+        "self.audio_speaker.set_volume(volume=80",
+        "self.audio_speaker.set_volume volume=80",
+        "self.audio_speaker.set_volume(volume)",
+        "self.audio_speaker.set_volume(volume=)",
+        "self.audio_speaker.set_volume(=80)",
+        "self.audio_speaker.set_volume(volume=80,)",
+        "self.audio_speaker.set_volume(volume=80 brightness=1)",
+        "self.audio_speaker.set_volume(volume=80, volume=90)",
+        "self.audio_speaker.set_volume(volume=2147483648)",
+        "self.audio_speaker.set_volume(volume=-2147483649)",
+        "self.audio_speaker.set_volume(volume=-)",
+        "self.audio_speaker.set_volume(volume=8O)",
+        "self.audio_speaker.set_volume(volume=loud)",
+        "self.otto.action(action='walk)",
+        "self.otto.action(action=\"walk')",
+        "self.otto.action(action.name='walk')",
+        "self.lamp.turn_on() now",
+        "self lamp",
+    };
+    for (const char* action : malformed) {
+        Check(!Parses(action, tool, arguments), test, action);
+    }
+}
+
+// CustomWakeWord: a local decision whose tool call was accepted starts the cooldown
+static IntentDecision Run(CommandIntentTable& table, int command_id, float probability, int64_t now_ms) {
+    auto decision = table.Dispatch(command_id, probability, now_ms);
+    if (decision == kIntentLocal) {
+        table.StartCooldown(command_id, now_ms);
+    }
+    return decision;
+}
+
+static void TestTable() {
+    const char* test = "table";
+    CommandIntentTable table;
+    Check(table.Add("你好小智", "wake", 0.2f, 0), test, "wake word added");
+    Check(table.Add("大声一点", "self.audio_speaker.set_volume(volume=90)", 0.5f, 1000), test, "volume added");
+    Check(table.Add("关灯", "self.lamp.turn_off", 0.3f, 3000), test, "lights added");
+    Check(!table.Add("跳个舞", "dance please", 0.3f, 1000), test, "unknown action reported");
+    Check(table.Add("停下", "self.otto.stop()", 0.0f, 0), test, "stop added");
+    Check(table.size() == 5, test, "ids stay aligned with MultiNet");
+
+    Check(Run(table, 0, 1.0f, 0) == kIntentNone && Run(table, 6, 1.0f, 0) == kIntentNone &&
+              Run(table, -1, 1.0f, 0) == kIntentNone,
+          test, "unknown ids do nothing");
+    Check(table.Get(0) == nullptr && table.Get(6) == nullptr, test, "unknown ids have no command");
+    Check(table.Get(2) != nullptr && table.Get(2)->text == "大声一点" && table.Get(2)->tool ==
+              "self.audio_speaker.set_volume",
+          test, "ids start at 1");
+
+    Check(Run(table, 1, 0.1f, 0) == kIntentWake && Run(table, 1, 0.9f, 10) == kIntentWake, test,
+          "wake words always wake, MultiNet already applied its threshold");
+    Check(Run(table, 4, 1.0f, 0) == kIntentCloud, test, "unparsed actions go to the cloud");
+
+    // Thresholds
+    Check(Run(table, 2, 0.49f, 0) == kIntentNone, test, "below the threshold is ignored");
+    Check(Run(table, 2, 0.49f, 100) == kIntentNone, test, "ignored commands do not start the cooldown");
+    Check(Run(table, 2, 0.5f, 200) == kIntentLocal, test, "at the threshold runs locally");
+
+    // Cooldowns, per command
+    Check(Run(table, 2, 0.9f, 700) == kIntentCooldown, test, "repeat within the cooldown ignored");
+    Check(Run(table, 3, 0.9f, 700) == kIntentLocal, test, "another command runs during a cooldown");
+    Check(Run(table, 2, 0.9f, 1199) == kIntentCooldown, test, "cooldown lasts until its end");
+    Check(Run(table, 2, 0.9f, 1200) == kIntentLocal, test, "runs again after the cooldown");
+    Check(Run(table, 2, 0.9f, 1300) == kIntentCooldown, test, "cooldown restarts with each run");
+    Check(Run(table, 2, 0.1f, 1300) == kIntentNone, test, "low confidence during a cooldown is ignored");
+    Check(Run(table, 3, 0.9f, 3699) == kIntentCooldown && Run(table, 3, 0.9f, 3700) == kIntentLocal, test,
+          "each command has its own cooldown");
+    Check(Run(table, 5, 0.0f, 0) == kIntentLocal && Run(table, 5, 0.0f, 0) == kIntentLocal, test,
+          "no cooldown when it is 0");
+    Check(table.Dispatch(2, 0.9f, 5000) == kIntentLocal && table.Dispatch(2, 0.9f, 5100) == kIntentLocal, test,
+          "a failed local call does not start the cooldown");
+
+    table.Clear();
+    Check(table.size() == 0 && Run(table, 1, 1.0f, 0) == kIntentNone, test, "cleared");
+    Check(table.Add("音量调到最大", "self.audio_speaker.set_volume(volume=100)", 0.3f, 1000) &&
+              Run(table, 1, 0.3f, 5000) == kIntentLocal,
+          test, "ids restart after clearing");
+
+    // Thresholds below the MultiNet one
+    table.Clear();
+    table.SetDetectionThreshold(0.4f);
+    Check(table.Add("开灯", "self.lamp.turn_on", 0.2f, 0) && table.Add("关灯", "self.lamp.turn_off", 0.6f, 0), test,
+          "lights added");
+    Check(table.Get(1)->threshold == 0.4f && table.Get(2)->threshold == 0.6f, test,
+          "thresholds raised to the detection threshold");
+    Check(Run(table, 1, 0.3f, 0) == kIntentNone && Run(table, 1, 0.4f, 0) == kIntentLocal, test,
+          "raised threshold applies");
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestParser();
+    TestTable();
+    return ReportChecks();
+}
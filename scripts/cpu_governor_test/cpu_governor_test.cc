@@ -0,0 +1,342 @@
+/*
+ * Host test of the CPU governor policy in main/cpu_governor_policy.cc.
+ *
+ * Every trace in the traces directory is a list of timed events: device state changes,
+ * audio queue samples, power save sleep mode, and performance locks. The test replays them
+ * through the policy with the maximum frequency of an ESP32-S3 (240MHz) and an ESP32-C3
+ * (160MHz), and checks that:
+ *
+ * 1. Every state gets its floor as soon as it is entered: the maximum while starting,
+ *    connecting, listening or upgrading, 160MHz in idle and speaking, 40MHz on a fatal error.
+ *    Floors never exceed the maximum, and the maximum never changes.
+ * 2. Audio queues backing up raise the floor to the maximum at once and keep it there for
+ *    the whole hold time. It drops back at the first quiet sample after that.
+ * 3. Sleep mode gives 40MHz with light sleep whatever happens in between, and leaving it
+ *    restores the floor of the current state. Light sleep is never on outside sleep mode.
+ * 4. The policy asks for esp_pm_configure exactly when the profile changes.
+ * 5. The residency adds up to the length of the trace, with at least the time under a
+ *    performance lock at the maximum.
+ * 6. The `expect` lines of the traces hold.
+ *
+ * Lines of device logs work as traces too: with debug logging on, CpuGovernor logs its
+ * events as "trace <ms> <event> ...", everything up to "trace " is skipped.
+ *
+ * -v prints the profile changes and the residency per trace.
+ *
+ * Usage: cpu_governor_test [-v] <traces directory>
+ */
+#include "cpu_governor_policy.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// As CpuGovernor samples the queues, and the policy's default hold time
+static const int kSampleInterval = 200;
+static const int kBoostHold = 1000;
+
+struct Event {
+    int64_t ms;
+    std::string kind;
+    std::vector<std::string> args;
+};
+
+struct Trace {
+    std::string name;
+    std::vector<Event> events;
+};
+
+static bool LoadTrace(const std::filesystem::path& path, Trace& trace) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    trace.name = path.stem().string();
+    std::string line;
+    while (std::getline(file, line)) {
+        auto start = line.find("trace ");
+        if (start != std::string::npos) {
+            line = line.substr(start + 6);
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream words(line);
+        Event event;
+        if (!(words >> event.ms >> event.kind)) {
+            continue;
+        }
+        std::string arg;
+        while (words >> arg) {
+            event.args.push_back(arg);
+        }
+        if (!trace.events.empty() && event.ms < trace.events.back().ms) {
+            return false;
+        }
+        trace.events.push_back(std::move(event));
+    }
+    return !trace.events.empty();
+}
+
+static bool ParseState(const std::string& name, DeviceState& state) {
+    for (int i = kDeviceStateUnknown; i <= kDeviceStateFatalError; i++) {
+        if (name == CpuGovernorPolicy::GetStateName((DeviceState)i)) {
+            state = (DeviceState)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The floors the policy documents, kept apart from its own table
+static int ExpectedFloor(DeviceState state, int max_freq) {
+    switch (state) {
+    case kDeviceStateIdle:
+    case kDeviceStateSpeaking:
+        return std::min(160, max_freq);
+    case kDeviceStateFatalError:
+        return 40;
+    default:
+        return max_freq;
+    }
+}
+
+class Replay {
+public:
+    Replay(const Trace& trace, int max_freq) : trace_(trace), max_freq_(max_freq), policy_(max_freq) {
+        snprintf(test_, sizeof(test_), "%s@%dMHz", trace.name.c_str(), max_freq);
+    }
+
+    void Run() {
+        int64_t start = trace_.events.front().ms;
+        int64_t end = trace_.events.back().ms;
+        policy_.ResetResidency(start);
+        now_ = start;
+        next_sample_ = start + kSampleInterval;
+
+        for (auto& event : trace_.events) {
+            if (event.kind != "queue") {
+                SampleUntil(event.ms, false);
+            }
+            now_ = event.ms;
+            Handle(event);
+            CheckInvariants();
+            if (event.kind == "end") {
+                end = event.ms;
+                break;
+            }
+        }
+        AddLockTime(end);
+
+        auto residency = policy_.GetResidency(end);
+        int64_t total = 0;
+        for (auto& [freq, ms] : residency) {
+            total += ms;
+            Check(freq <= max_freq_ && freq >= 40, test_, "residency only at valid frequencies");
+        }
+        Check(total == end - start, test_, "residency adds up to the trace length");
+        Check(residency[max_freq_] >= locked_ms_, test_, "time under a performance lock counts at the maximum");
+
+        if (verbose) {
+            printf("%-26s %3d profile changes, residency:", test_, applies_);
+            for (auto& [freq, ms] : residency) {
+                printf(" %dMHz %5.1f%%", freq, 100.0 * ms / total);
+            }
+            printf(", locked %4.1f%%\n", 100.0 * locked_ms_ / total);
+        }
+    }
+
+private:
+    const Trace& trace_;
+    int max_freq_;
+    CpuGovernorPolicy policy_;
+    char test_[64];
+    int64_t now_ = 0;
+    int64_t next_sample_ = 0;
+    int64_t last_pressure_ = -1;
+    int64_t last_lock_change_ = 0;
+    int64_t locked_ms_ = 0;
+    int lock_depth_ = 0;
+    int applies_ = 0;
+
+    // Samples missing from the trace were empty
+    void SampleUntil(int64_t ms, bool inclusive) {
+        while (next_sample_ < ms || (inclusive && next_sample_ == ms)) {
+            now_ = next_sample_;
+            Sample({0, 0, 0});
+            CheckInvariants();
+        }
+    }
+
+    void Sample(const AudioQueueDepth& depth) {
+        if (CpuGovernorPolicy::IsUnderPressure(depth) && !policy_.sleeping()) {
+            last_pressure_ = now_;
+        }
+        Step(policy_.OnQueueDepth(depth, now_));
+        next_sample_ = now_ + kSampleInterval;
+    }
+
+    void Step(bool changed) {
+        auto& profile = policy_.profile();
+        Check(changed == (profile != last_profile_), test_, "applied exactly when the profile changes");
+        if (changed) {
+            applies_++;
+            if (verbose) {
+                printf("  %-24s %8lld %-14s %3d-%3d MHz%s\n", test_, (long long)now_,
+                    CpuGovernorPolicy::GetStateName(policy_.state()), profile.min_freq_mhz, profile.max_freq_mhz,
+                    profile.light_sleep ? " light sleep" : "");
+            }
+        }
+        last_profile_ = profile;
+    }
+
+    void AddLockTime(int64_t ms) {
+        if (lock_depth_ > 0) {
+            locked_ms_ += ms - last_lock_change_;
+        }
+        last_lock_change_ = ms;
+    }
+
+    void Handle(const Event& event) {
+        auto& args = event.args;
+        if (event.kind == "state") {
+            DeviceState state;
+            bool known = args.size() == 1 && ParseState(args[0], state);
+            Check(known, test_, "known state");
+            if (known) {
+                Step(policy_.OnStateChanged(state, now_));
+            }
+        } else if (event.kind == "queue") {
+            Check(args.size() == 3, test_, "queue sample has three depths");
+            if (args.size() == 3) {
+                SampleUntil(event.ms, false);
+                now_ = event.ms;
+                Sample({std::stoi(args[0]), std::stoi(args[1]), std::stoi(args[2])});
+            }
+        } else if (event.kind == "sleep") {
+            bool sleep = args.size() == 1 && args[0] == "1";
+            Step(policy_.OnSleepMode(sleep, now_));
+            if (sleep) {
+                last_pressure_ = -1;
+            } else {
+                // CpuGovernor restarts its sampling timer on wake up
+                next_sample_ = now_ + kSampleInterval;
+            }
+        } else if (event.kind == "lock") {
+            bool acquired = args.size() == 1 && args[0] == "1";
+            AddLockTime(now_);
+            lock_depth_ += acquired ? 1 : (lock_depth_ > 0 ? -1 : 0);
+            policy_.OnPerformanceLock(acquired, now_);
+        } else if (event.kind == "expect") {
+            bool ok = args.size() == 1 && policy_.profile().min_freq_mhz == std::min(std::stoi(args[0]), max_freq_);
+            if (!ok) {
+                char what[96];
+                snprintf(what, sizeof(what), "expected %s MHz at %lld, got %d MHz", args.empty() ? "?" : args[0].c_str(),
+                    (long long)now_, policy_.profile().min_freq_mhz);
+                Check(false, test_, what);
+            }
+        } else if (event.kind != "end") {
+            Check(false, test_, "known event");
+        }
+    }
+
+    void CheckInvariants() {
+        auto& profile = policy_.profile();
+        Check(profile.max_freq_mhz == max_freq_, test_, "maximum never changes");
+        Check(profile.min_freq_mhz <= max_freq_, test_, "floor at most the maximum");
+        if (policy_.sleeping()) {
+            Check(profile.min_freq_mhz == 40 && profile.light_sleep, test_, "sleep mode is 40MHz with light sleep");
+            return;
+        }
+        Check(!profile.light_sleep, test_, "no light sleep outside sleep mode");
+        bool boost_held = last_pressure_ >= 0 && now_ < last_pressure_ + kBoostHold;
+        bool boost_over = last_pressure_ < 0 || now_ >= last_pressure_ + kBoostHold + kSampleInterval;
+        if (boost_held) {
+            Check(profile.min_freq_mhz == max_freq_, test_, "maximum floor for the hold time after queue pressure");
+        } else if (boost_over) {
+            Check(profile.min_freq_mhz == ExpectedFloor(policy_.state(), max_freq_), test_, "state floor");
+        }
+    }
+
+    CpuProfile last_profile_ = policy_.profile();
+};
+
+static void TestPolicy() {
+    const char* test = "policy";
+    CpuGovernorPolicy policy(240);
+    Check(policy.profile() == CpuProfile{240, 240, false}, test, "starts at the maximum");
+    Check(!policy.OnStateChanged(kDeviceStateStarting, 0), test, "same profile, nothing to apply");
+    Check(policy.OnStateChanged(kDeviceStateIdle, 100), test, "idle lowers the floor");
+    Check(!policy.OnStateChanged(kDeviceStateIdle, 200), test, "repeated state, nothing to apply");
+    Check(!policy.OnStateChanged(kDeviceStateSpeaking, 300), test, "idle and speaking share the floor");
+    Check(!policy.OnQueueDepth({1, 2, 2}, 400), test, "queues in use are not pressure");
+    Check(policy.OnQueueDepth({0, 1, 0}, 600), test, "nothing to play boosts");
+    Check(!policy.OnQueueDepth({0, 3, 0}, 800), test, "pressure while boosted, nothing to apply");
+    Check(!policy.OnQueueDepth({0, 0, 0}, 1799), test, "boost held");
+    Check(policy.OnQueueDepth({0, 0, 0}, 1800), test, "boost over");
+    Check(policy.OnQueueDepth({2, 0, 0}, 2000) && policy.boosted(), test, "encode backlog boosts");
+    Check(policy.OnSleepMode(true, 2100) && !policy.boosted(), test, "sleep ends the boost");
+    Check(!policy.OnQueueDepth({5, 0, 0}, 2200), test, "no boost in sleep mode");
+    Check(!policy.OnStateChanged(kDeviceStateListening, 2300), test, "sleep mode wins over the state");
+    Check(policy.OnSleepMode(false, 2400) && policy.profile() == CpuProfile{240, 240, false}, test,
+        "waking up restores the state floor");
+
+    DeviceState state;
+    bool names = true;
+    for (int i = kDeviceStateUnknown; i <= kDeviceStateFatalError; i++) {
+        names &= ParseState(CpuGovernorPolicy::GetStateName((DeviceState)i), state) && state == i;
+    }
+    Check(names, test, "state names are unique");
+
+    CpuGovernorPolicy c3(160);
+    c3.OnStateChanged(kDeviceStateListening, 0);
+    Check(c3.profile() == CpuProfile{160, 160, false}, test, "floors capped at the maximum");
+    c3.OnSleepMode(true, 0);
+    Check(c3.profile() == CpuProfile{160, 40, true}, test, "sleep mode on a 160MHz target");
+}
+
+int main(int argc, char** argv) {
+    std::string directory;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            directory = argv[i];
+        }
+    }
+    if (directory.empty()) {
+        printf("Usage: %s [-v] <traces directory>\n", argv[0]);
+        return 1;
+    }
+
+    TestPolicy();
+
+    std::vector<std::filesystem::path> paths;
+    for (auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".txt") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    Check(!paths.empty(), "traces", "at least one trace");
+
+    for (auto& path : paths) {
+        Trace trace;
+        bool loaded = LoadTrace(path, trace);
+        Check(loaded, path.filename().c_str(), "trace loads, in time order");
+        if (!loaded) {
+            continue;
+        }
+        for (int max_freq : {240, 160}) {
+            Replay(trace, max_freq).Run();
+        }
+    }
+
+    return ReportChecks();
+}
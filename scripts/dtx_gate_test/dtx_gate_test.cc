@@ -0,0 +1,279 @@
+/*
+ * Host test of the uplink DTX gate in main/audio/dtx_gate.cc.
+ *
+ * Every trace in the traces directory gives, per 60ms frame, whether the talker speaks and
+ * what the VAD reported. Each frame becomes an Opus packet of a typical size and goes
+ * through the gate with the settings of AudioService. The test checks that:
+ *
+ * 1. No speech is clipped: every frame the talker speaks in is sent in full, including the
+ *    frames before the VAD rises.
+ * 2. Sequence numbers are the frame indexes and increase. A gap only follows a SID frame and
+ *    is at most one SID interval long, so a server can tell silence from loss.
+ * 3. The stream is kept alive: while silent, a packet goes out at least once per SID interval.
+ *    SID frames are one TOC byte with the frame count code cleared.
+ * 4. The gate saves bytes on every trace with pauses longer than the hangover and pre-roll,
+ *    never costs bytes, and sends everything when disabled or after Reset().
+ * 5. The test detects clipping: without pre-roll, the late VAD clips speech onsets.
+ *
+ * -v prints the bytes saved per trace, and the clipped onsets and bytes saved per pre-roll length.
+ *
+ * Usage: dtx_gate_test [-v] <traces directory>
+ */
+#include "dtx_gate.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// As AudioService sets up the gate: DTX_HANGOVER_MS, DTX_PRE_ROLL_MS and DTX_SID_INTERVAL_MS
+// in 60ms frames
+static const int kHangover = 600 / 60;
+static const int kPreRoll = 300 / 60;
+static const int kSidInterval = 960 / 60;
+
+// Typical packet sizes of the device encoder, 16kHz mono SILK with noise suppression ahead
+static const size_t kSpeechBytes = 120;
+static const size_t kSilenceBytes = 40;
+// TOC byte of a 60ms SILK wideband frame
+static const uint8_t kToc = 11 << 3;
+// IP, UDP and the MQTT-UDP header per packet
+static const size_t kPacketOverhead = 28 + 16;
+
+struct Trace {
+    std::string name;
+    std::string speech;
+    std::string vad;
+};
+
+struct Sent {
+    size_t frame;  // Frame the packet went out at
+    std::unique_ptr<AudioStreamPacket> packet;
+};
+
+static bool LoadTrace(const std::filesystem::path& path, Trace& trace) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    trace.name = path.stem().string();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string key, frames;
+        words >> key >> frames;
+        if (key == "speech") {
+            trace.speech += frames;
+        } else if (key == "vad") {
+            trace.vad += frames;
+        }
+    }
+    return !trace.speech.empty() && trace.speech.size() == trace.vad.size();
+}
+
+static std::unique_ptr<AudioStreamPacket> MakePacket(bool speech, size_t frame) {
+    auto packet = std::make_unique<AudioStreamPacket>();
+    packet->sample_rate = 16000;
+    packet->frame_duration = 60;
+    packet->payload.assign(speech ? kSpeechBytes : kSilenceBytes, (uint8_t)frame);
+    packet->payload[0] = kToc | (frame & 1);
+    return packet;
+}
+
+static std::vector<Sent> Run(DtxGate& gate, const Trace& trace) {
+    std::vector<Sent> sent;
+    std::vector<std::unique_ptr<AudioStreamPacket>> output;
+    for (size_t i = 0; i < trace.speech.size(); i++) {
+        output.clear();
+        gate.Process(MakePacket(trace.speech[i] == 'S', i), trace.vad[i] == '1', output);
+        for (auto& packet : output) {
+            sent.push_back({i, std::move(packet)});
+        }
+    }
+    return sent;
+}
+
+// Number of speech onsets with at least one frame not sent in full
+static int ClippedOnsets(const Trace& trace, const std::vector<Sent>& sent) {
+    std::vector<bool> full(trace.speech.size(), false);
+    for (auto& s : sent) {
+        if (s.packet->payload.size() > 1) {
+            full[s.packet->sequence] = true;
+        }
+    }
+    int clipped = 0;
+    bool clipped_this = false;
+    for (size_t i = 0; i < trace.speech.size(); i++) {
+        if (trace.speech[i] != 'S') {
+            clipped_this = false;
+            continue;
+        }
+        if (!full[i] && !clipped_this) {
+            clipped++;
+            clipped_this = true;
+        }
+    }
+    return clipped;
+}
+
+static size_t WireBytes(const DtxGate::Statistics& stats, bool dtx) {
+    return dtx ? stats.output_bytes + stats.sent_frames * kPacketOverhead + stats.sid_frames * kPacketOverhead
+               : stats.input_bytes + stats.frames * kPacketOverhead;
+}
+
+static void TestTrace(const Trace& trace) {
+    const char* test = trace.name.c_str();
+    DtxGate gate(kHangover, kPreRoll, kSidInterval);
+    gate.SetEnabled(true);
+    auto sent = Run(gate, trace);
+
+    Check(ClippedOnsets(trace, sent) == 0, test, "no speech onset clipped");
+
+    bool increasing = true, gaps_after_sid = true, gaps_short = true, sid_format = true, alive = true;
+    size_t max_delay = 0;
+    for (size_t i = 0; i < sent.size(); i++) {
+        auto& packet = *sent[i].packet;
+        bool sid = packet.payload.size() == 1;
+        Check(packet.sequence <= sent[i].frame, test, "never sent before captured");
+        max_delay = std::max(max_delay, sent[i].frame - packet.sequence);
+        sid_format &= !sid || packet.payload[0] == kToc;
+        if (i == 0) {
+            alive &= sent[i].frame < (size_t)kSidInterval;
+            continue;
+        }
+        auto& previous = *sent[i - 1].packet;
+        increasing &= packet.sequence > previous.sequence;
+        if (packet.sequence > previous.sequence + 1) {
+            gaps_after_sid &= previous.payload.size() == 1;
+            gaps_short &= packet.sequence - previous.sequence <= (uint32_t)kSidInterval;
+        }
+        alive &= sent[i].frame - sent[i - 1].frame <= (size_t)kSidInterval;
+    }
+    alive &= trace.speech.size() - sent.back().frame <= (size_t)kSidInterval;
+    Check(increasing, test, "sequence numbers increase");
+    Check(gaps_after_sid, test, "gaps only after SID frames");
+    Check(gaps_short, test, "gaps at most one SID interval");
+    Check(alive, test, "a packet at least once per SID interval");
+    Check(sid_format, test, "SID frames are the TOC byte of a zero length frame");
+
+    auto& stats = gate.statistics();
+    Check(stats.frames == trace.speech.size(), test, "every frame counted");
+    // Bytes are saved once the VAD stays off for longer than the hangover and the pre-roll
+    size_t run = 0, longest_pause = 0;
+    for (char v : trace.vad) {
+        run = v == '1' ? 0 : run + 1;
+        longest_pause = std::max(longest_pause, run);
+    }
+    Check(stats.output_bytes <= stats.input_bytes, test, "never more bytes than without DTX");
+    Check(longest_pause <= (size_t)(kHangover + kPreRoll) || stats.output_bytes < stats.input_bytes, test,
+          "bytes saved in pauses");
+    size_t sent_bytes = 0;
+    for (auto& s : sent) {
+        sent_bytes += s.packet->payload.size();
+    }
+    Check(sent_bytes == stats.output_bytes, test, "statistics match the output");
+
+    size_t speech_frames = std::count(trace.speech.begin(), trace.speech.end(), 'S');
+    if (verbose) {
+        printf("%-22s %5.1f%% speech, %4u of %4u frames + %3u SID, payload saved %5.1f%%, on the wire %5.1f%%, "
+               "onset delay up to %zu frames\n",
+               test, 100.0 * speech_frames / trace.speech.size(), stats.sent_frames, stats.frames, stats.sid_frames,
+               100.0 - 100.0 * stats.output_bytes / stats.input_bytes,
+               100.0 - 100.0 * WireBytes(stats, true) / WireBytes(stats, false), max_delay);
+    }
+
+    // Disabled, every frame goes out in full with its index
+    DtxGate off(kHangover, kPreRoll, kSidInterval);
+    auto all = Run(off, trace);
+    bool passthrough = all.size() == trace.speech.size();
+    for (size_t i = 0; passthrough && i < all.size(); i++) {
+        passthrough = all[i].frame == i && all[i].packet->sequence == i && all[i].packet->payload.size() > 1;
+    }
+    Check(passthrough, test, "disabled gate sends every frame");
+
+    // Reset starts a new stream
+    gate.Reset();
+    std::vector<std::unique_ptr<AudioStreamPacket>> output;
+    gate.Process(MakePacket(false, 0), false, output);
+    Check(output.size() == 1 && output[0]->sequence == 0 && gate.statistics().frames == 1, test,
+          "Reset restarts the sequence");
+}
+
+static void TestPreRoll(const std::vector<Trace>& traces) {
+    const char* test = "pre-roll";
+    if (verbose) {
+        printf("\n%-10s", "pre-roll");
+        for (auto& trace : traces) {
+            printf(" %22s", trace.name.c_str());
+        }
+        printf("\n");
+    }
+    int clipped_without = 0;
+    for (int pre_roll = 0; pre_roll <= kPreRoll + 1; pre_roll++) {
+        if (verbose) {
+            printf("%4d ms   ", pre_roll * 60);
+        }
+        for (auto& trace : traces) {
+            DtxGate gate(kHangover, pre_roll, kSidInterval);
+            gate.SetEnabled(true);
+            auto sent = Run(gate, trace);
+            int clipped = ClippedOnsets(trace, sent);
+            if (pre_roll == 0) {
+                clipped_without += clipped;
+            }
+            auto& stats = gate.statistics();
+            if (verbose) {
+                printf(" %3d clipped, %5.1f%% saved", clipped, 100.0 - 100.0 * stats.output_bytes / stats.input_bytes);
+            }
+        }
+        if (verbose) {
+            printf("\n");
+        }
+    }
+    Check(clipped_without > 0, test, "without pre-roll the late VAD clips onsets");
+}
+
+int main(int argc, char** argv) {
+    std::string directory;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            directory = argv[i];
+        }
+    }
+    if (directory.empty()) {
+        printf("Usage: %s [-v] <traces directory>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> paths;
+    for (auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".txt") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<Trace> traces;
+    for (auto& path : paths) {
+        Trace trace;
+        Check(LoadTrace(path, trace), path.filename().c_str(), "trace loads");
+        if (!trace.speech.empty() && trace.speech.size() == trace.vad.size()) {
+            traces.push_back(std::move(trace));
+        }
+    }
+    Check(!traces.empty(), "traces", "at least one trace");
+
+    for (auto& trace : traces) {
+        TestTrace(trace);
+    }
+    TestPreRoll(traces);
+
+    return ReportChecks();
+}
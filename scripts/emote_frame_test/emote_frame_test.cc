@@ -0,0 +1,242 @@
+/*
+ * Host simulation of the emote display pacer task driving FrameScheduler.
+ *
+ * The layer configurations of the emote assets (frame rate, frame count, loop) are
+ * replayed against a simulated clock with the same wake up rules as the pacer task:
+ * sleeps are rounded up to whole FreeRTOS ticks, showing a frame holds the engine for
+ * its render time, and load from the Opus decoder delays the wake ups. For every run
+ * the test checks the achieved frame timing:
+ *
+ * 1. Without load every frame is shown within one tick of its deadline and none is dropped.
+ * 2. Under load, frames are shown late by no more than the stall that delayed them, the
+ *    animation stays in step with the clock (the frame shown is the one due at that time),
+ *    and every skipped deadline is counted as dropped.
+ * 3. Non-looping animations end on their last frame and the scheduler goes idle, with no
+ *    further wake ups. Stopped layers never wake the pacer.
+ * 4. A layer following the audio level shows a frame only when the level moves to another
+ *    frame.
+ *
+ * Usage: emote_frame_test [-v]
+ */
+#include "emote_frame_scheduler.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using emote::FrameScheduler;
+
+static const int64_t kTickUs = 1000;    // CONFIG_FREERTOS_HZ 1000
+// One eaf entry of an emote assets index.json plus its frame count
+struct LayerConfig {
+    const char* name;
+    int fps;
+    uint16_t frames;
+    bool loop;
+};
+
+static const LayerConfig kConfigs[] = {
+    {"happy", 20, 48, true},
+    {"listen", 20, 16, true},
+    {"neutral", 15, 30, false},
+    {"angry", 25, 60, true},
+    {"sleepy", 10, 40, true},
+    {"blink", 30, 12, false},
+};
+
+struct Shown {
+    int layer;
+    uint16_t frame;
+    int64_t time_us;
+};
+
+struct Simulation {
+    int64_t now_us = 0;
+    uint32_t wakeups = 0;
+    std::vector<Shown> shown;
+};
+
+// The pacer task loop. stall() returns how long the pacer is kept from running after
+// a wake up, render_us is how long showing one frame holds the engine.
+static void RunPacer(FrameScheduler& scheduler, Simulation& sim, int64_t until_us,
+                     const std::function<int64_t(int64_t)>& stall, int64_t render_us) {
+    int64_t deadline = scheduler.NextDeadline();
+    while (deadline != FrameScheduler::kIdle) {
+        // ulTaskNotifyTake() with the delay rounded up to whole ticks
+        int64_t wake = sim.now_us;
+        if (deadline > sim.now_us) {
+            wake = sim.now_us + (deadline - sim.now_us + kTickUs - 1) / kTickUs * kTickUs;
+        }
+        if (wake >= until_us) {
+            sim.now_us = until_us;
+            return;
+        }
+        sim.now_us = wake + stall(wake);
+        sim.wakeups++;
+        deadline = scheduler.Run(sim.now_us, [&](int layer, uint16_t frame) {
+            sim.shown.push_back({layer, frame, sim.now_us});
+            sim.now_us += render_us;
+        });
+    }
+}
+
+static int64_t NoStall(int64_t) {
+    return 0;
+}
+
+static void TestSteady() {
+    for (auto& config : kConfigs) {
+        FrameScheduler scheduler(1);
+        Simulation sim;
+        scheduler.Play(0, config.frames, config.fps, config.loop, 0);
+        RunPacer(scheduler, sim, 5000000, NoStall, 2000);
+
+        int64_t period = 1000000 / config.fps;
+        size_t expected = config.loop ? 5000000 / period : config.frames;
+        auto& stats = scheduler.stats(0);
+        Check(stats.dropped == 0, config.name, "frames dropped without load");
+        Check(stats.max_late_us <= kTickUs, config.name, "frame later than one tick");
+        Check(sim.shown.size() == expected, config.name, "wrong number of frames");
+        for (size_t i = 0; i < sim.shown.size(); i++) {
+            if (sim.shown[i].frame != i % config.frames) {
+                Check(false, config.name, "frames out of order");
+                break;
+            }
+        }
+        double fps = sim.shown.size() > 1 ? (sim.shown.size() - 1) * 1e6 /
+            (sim.shown.back().time_us - sim.shown.front().time_us) : 0;
+        if (verbose) {
+            printf("steady  %-8s %2d fps -> %6.2f fps, %zu frames, max late %lld us\n", config.name, config.fps,
+                   fps, sim.shown.size(), (long long)stats.max_late_us);
+        }
+        if (!config.loop) {
+            Check(scheduler.idle(), config.name, "not idle after the last frame");
+            Check(sim.shown.back().frame == config.frames - 1, config.name, "did not end on the last frame");
+        }
+    }
+}
+
+static void TestLoad() {
+    for (auto& config : kConfigs) {
+        if (!config.loop) {
+            continue;
+        }
+        FrameScheduler scheduler(1);
+        Simulation sim;
+        scheduler.Play(0, config.frames, config.fps, true, 0);
+
+        // Opus frames are decoded every 60 ms, some of them keep the pacer waiting for a while
+        std::mt19937 rng(config.fps);
+        int64_t worst_stall = 0;
+        auto stall = [&](int64_t wake) {
+            int64_t in_frame = wake % 60000;
+            int64_t delay = in_frame < 15000 ? 15000 - in_frame : 0;
+            if (rng() % 8 == 0) {
+                delay += 50000 + rng() % 150000;
+            }
+            worst_stall = std::max(worst_stall, delay);
+            return delay;
+        };
+        RunPacer(scheduler, sim, 10000000, stall, 6000);
+
+        int64_t period = 1000000 / config.fps;
+        auto& stats = scheduler.stats(0);
+        bool in_step = true;
+        for (auto& s : sim.shown) {
+            // The frame shown is the one whose deadline passed last
+            if (s.frame != (s.time_us / period) % config.frames) {
+                in_step = false;
+            }
+        }
+        Check(in_step, config.name, "animation fell out of step with the clock under load");
+        Check(stats.dropped > 0, config.name, "no frames dropped under load");
+        Check(stats.max_late_us <= worst_stall + kTickUs + 6000, config.name, "frame later than the stall");
+        // Every deadline up to the end was either shown or dropped
+        uint32_t deadlines = (uint32_t)(sim.shown.back().time_us / period) + 1;
+        Check(stats.frames + stats.dropped == deadlines, config.name, "dropped counter does not add up");
+        if (verbose) {
+            printf("load    %-8s %2d fps -> %6.2f fps, %u shown, %u dropped, max late %lld us, worst stall %lld us\n",
+                   config.name, config.fps, stats.frames / 10.0, stats.frames, stats.dropped,
+                   (long long)stats.max_late_us, (long long)worst_stall);
+        }
+    }
+}
+
+static void TestIdle() {
+    FrameScheduler scheduler(3);
+    Simulation sim;
+    Check(scheduler.idle(), "idle", "new scheduler has a deadline");
+
+    // A looping layer that is stopped and a one-shot that ends
+    scheduler.Play(0, 48, 20, true, 0);
+    scheduler.Play(1, 12, 30, false, 0);
+    scheduler.Stop(0);
+    RunPacer(scheduler, sim, 10000000, NoStall, 1000);
+    Check(scheduler.idle(), "idle", "deadline left after the one-shot ended");
+    Check(sim.wakeups == 12, "idle", "extra wake ups");
+    Check(sim.shown.size() == 12, "idle", "stopped layer was shown");
+    if (verbose) {
+        printf("idle    %u wake ups in 10 s for a 12 frame one-shot\n", sim.wakeups);
+    }
+
+    // Static images are a single frame, shown once even when looping
+    sim = Simulation();
+    scheduler.Play(2, 1, 20, true, 0);
+    RunPacer(scheduler, sim, 10000000, NoStall, 1000);
+    Check(sim.shown.size() == 1 && scheduler.idle(), "idle", "single frame animation kept running");
+
+    scheduler.Play(0, 48, 0, true, 0);
+    Check(scheduler.idle(), "idle", "0 fps layer has a deadline");
+}
+
+static void TestLevel() {
+    FrameScheduler scheduler(1);
+    Simulation sim;
+    scheduler.FollowLevel(0, 8, 20, 0);
+
+    // Silence, then a constant level, then speech that changes every 60 ms Opus frame
+    scheduler.SetLevel(0);
+    RunPacer(scheduler, sim, 1000000, NoStall, 1000);
+    Check(sim.shown.size() == 1 && sim.shown[0].frame == 0, "level", "silence is not a single frame 0");
+
+    scheduler.SetLevel(255);
+    RunPacer(scheduler, sim, 2000000, NoStall, 1000);
+    Check(sim.shown.size() == 2 && sim.shown[1].frame == 7, "level", "constant level is not a single frame");
+
+    std::mt19937 rng(1);
+    size_t before = sim.shown.size();
+    uint32_t changes = 0;
+    int last_frame = 7;
+    for (int i = 0; i < 50; i++) {
+        uint8_t level = (uint8_t)(rng() % 256);
+        scheduler.SetLevel(level);
+        int frame = (level * 7 + 127) / 255;
+        changes += frame != last_frame;
+        last_frame = frame;
+        RunPacer(scheduler, sim, 2000000 + (i + 1) * 60000, NoStall, 1000);
+        if (sim.shown.back().frame != frame) {
+            Check(false, "level", "shown frame does not match the level");
+            break;
+        }
+    }
+    Check(sim.shown.size() - before == changes, "level", "frames shown without a level change");
+    if (verbose) {
+        printf("level   %zu frames for %u level changes\n", sim.shown.size() - before, changes);
+    }
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestSteady();
+    TestLoad();
+    TestIdle();
+    TestLevel();
+    if (failures == 0) {
+        printf("all frame timing checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Generate main/assets/hot_glyphs.h, the characters the glyph cache decodes at boot.
+
+Characters are ranked by how often they appear in the UI strings of the selected
+language plus any corpus files given with --corpus (e.g. chat transcripts in that
+language). ASCII is left out: Latin glyphs are small and cheap to decode, the cache
+pays off for CJK and other large glyphs.
+"""
+import argparse
+import json
+import os
+from collections import Counter
+
+HEADER_TEMPLATE = """// Auto-generated by scripts/gen_hot_glyphs.py
+// Language: {lang_code}, sources: {sources}
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HotGlyphs {{
+    // Most frequent first
+    constexpr uint32_t kCodepoints[] = {{
+{codepoints}
+    }};
+    constexpr size_t kCount = {count};
+}}
+"""
+
+
+def count_text(counter, text):
+    for ch in text:
+        if ord(ch) > 0x7F and not ch.isspace():
+            counter[ch] += 1
+
+
+def count_language(counter, language_json):
+    with open(language_json, 'r', encoding='utf-8') as f:
+        data = json.load(f)
+    for value in data.get('strings', {}).values():
+        if isinstance(value, str):
+            count_text(counter, value)
+
+
+def generate_header(lang_code, output_path, count, corpus_files):
+    main_dir = os.path.dirname(output_path)
+    if os.path.basename(main_dir) == 'assets':
+        main_dir = os.path.dirname(main_dir)
+    language_json = os.path.join(main_dir, 'assets', 'locales', lang_code, 'language.json')
+
+    counter = Counter()
+    sources = []
+    if os.path.exists(language_json):
+        count_language(counter, language_json)
+        sources.append(f'{lang_code}/language.json')
+    for path in corpus_files:
+        with open(path, 'r', encoding='utf-8') as f:
+            count_text(counter, f.read())
+        sources.append(os.path.basename(path))
+
+    # Ties are broken by codepoint so the header only changes when the sources do
+    ranked = sorted(counter.items(), key=lambda item: (-item[1], ord(item[0])))[:count]
+    lines = []
+    for i in range(0, len(ranked), 8):
+        row = ranked[i:i + 8]
+        lines.append('        ' + ' '.join(f'0x{ord(ch):04X},' for ch, _ in row))
+    if not lines:
+        # Zero sized arrays are not allowed, the terminator is never read
+        lines.append('        0,')
+
+    content = HEADER_TEMPLATE.format(
+        lang_code=lang_code,
+        sources=', '.join(sources) if sources else 'none',
+        codepoints='\n'.join(lines),
+        count=len(ranked),
+    )
+    # Keep the timestamp when nothing changed so dependent objects are not rebuilt
+    if os.path.exists(output_path):
+        with open(output_path, 'r', encoding='utf-8') as f:
+            if f.read() == content:
+                return
+    with open(output_path, 'w', encoding='utf-8') as f:
+        f.write(content)
+    print(f"Generated {output_path} with {len(ranked)} glyphs")
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--language', required=True, help='Language code, e.g. zh-CN')
+    parser.add_argument('--output', required=True, help='Output header path')
+    parser.add_argument('--count', type=int, default=500, help='Number of glyphs to keep')
+    parser.add_argument('--corpus', nargs='*', default=[], help='Additional UTF-8 text files to count')
+    args = parser.parse_args()
+    generate_header(args.language, args.output, args.count, args.corpus)
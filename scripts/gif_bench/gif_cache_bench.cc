@@ -0,0 +1,175 @@
+/*
+ * Replays a conversation-like sequence of emotion changes through gifdec, once decoding
+ * every emotion from scratch (the old LvglGif behaviour) and once through GifFrameCache
+ * with the same record-first-loop logic as LvglGif.
+ *
+ * The cache budget is the gif_cache region, CONFIG_GIF_FRAME_CACHE_SIZE in CMakeLists.txt.
+ *
+ * Usage: gif_cache_bench <corpus_dir> [sentences]
+ */
+#include "gifdec.h"
+#include "gif_frame_cache.h"
+#include "arena_allocator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Sentence {
+    std::string emotion;
+    uint32_t duration_ms;
+};
+
+struct RunResult {
+    double decode_ms = 0;
+    uint32_t frames_decoded = 0;
+    uint32_t frames_shown = 0;
+};
+
+static std::map<std::string, std::vector<char>> LoadCorpus(const std::string& dir, const std::vector<std::string>& names) {
+    std::map<std::string, std::vector<char>> files;
+    for (auto& name : names) {
+        std::ifstream f(dir + "/" + name + ".gif", std::ios::binary);
+        if (!f) {
+            fprintf(stderr, "Missing %s/%s.gif, run make_corpus.py first\n", dir.c_str(), name.c_str());
+            exit(1);
+        }
+        files[name] = std::vector<char>(std::istreambuf_iterator<char>(f), {});
+    }
+    return files;
+}
+
+// The mood drifts slowly, and inside a mood the server flips between a few emotions every sentence
+static std::vector<Sentence> MakeConversation(const std::vector<std::string>& emotions, int count) {
+    std::mt19937 rng(42);
+    std::vector<Sentence> sentences;
+    int mood = 1;
+    for (int i = 0; i < count; i++) {
+        if (rng() % 10 == 0) {
+            mood = 1 + rng() % (emotions.size() - 1);
+        }
+        int r = rng() % 10;
+        const std::string& emotion = r < 4 ? emotions[0] : r < 8 ? emotions[mood] : emotions[rng() % emotions.size()];
+        sentences.push_back({emotion, 1500 + (uint32_t)(rng() % 3500)});
+    }
+    return sentences;
+}
+
+static double Now() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Decode frames for the duration of one sentence, as the LVGL timer would
+static RunResult PlayUncached(const std::vector<char>& data, uint32_t duration_ms) {
+    RunResult result;
+    double start = Now();
+    gd_GIF* gif = gd_open_gif_data(data.data());
+    uint32_t elapsed = 0;
+    while (elapsed < duration_ms) {
+        if (gd_get_frame(gif) != 1) {
+            break;
+        }
+        gd_render_frame(gif, gif->canvas);
+        result.frames_decoded++;
+        result.frames_shown++;
+        elapsed += gif->gce.delay * 10 > 0 ? gif->gce.delay * 10 : 10;
+    }
+    gd_close_gif(gif);
+    result.decode_ms = Now() - start;
+    return result;
+}
+
+static RunResult PlayCached(const std::string& name, const std::vector<char>& data, uint32_t duration_ms) {
+    RunResult result;
+    auto& cache = GifFrameCache::GetInstance();
+    double start = Now();
+    auto sequence = cache.Get(name, data.data());
+    uint32_t elapsed = 0;
+
+    if (!sequence) {
+        // Same as LvglGif: decode and record the first loop, then switch to the recording
+        gd_GIF* gif = gd_open_gif_data(data.data());
+        std::shared_ptr<GifFrameSequence> recording;
+        while (elapsed < duration_ms) {
+            if (gd_get_frame(gif) != 1) {
+                break;
+            }
+            gd_render_frame(gif, gif->canvas);
+            result.frames_decoded++;
+            if (gif->frame_index == 0 && recording) {
+                sequence = recording;
+                cache.Put(name, data.data(), sequence);
+                break;
+            }
+            if (gif->frame_index == 0) {
+                recording = std::make_shared<GifFrameSequence>(gif->width, gif->height,
+                    gd_canvas_size(gif), gif->loop_count);
+            }
+            if (recording &&
+                !cache.AddFrame(*recording, gif->canvas, gif->gce.delay * 10, {gif->dx, gif->dy, gif->dw, gif->dh})) {
+                recording.reset();
+            }
+            result.frames_shown++;
+            elapsed += gif->gce.delay * 10 > 0 ? gif->gce.delay * 10 : 10;
+        }
+        gd_close_gif(gif);
+    }
+
+    if (sequence) {
+        auto& frames = sequence->frames();
+        for (size_t i = 0; elapsed < duration_ms; i = (i + 1) % frames.size()) {
+            // Frame pointer swap, nothing to decode
+            volatile const uint8_t* shown = frames[i].data;
+            (void)shown;
+            result.frames_shown++;
+            elapsed += frames[i].delay_ms > 0 ? frames[i].delay_ms : 10;
+        }
+    }
+    result.decode_ms = Now() - start;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <corpus_dir> [sentences]\n", argv[0]);
+        return 1;
+    }
+    int count = argc > 2 ? atoi(argv[2]) : 500;
+
+    std::vector<std::string> emotions = {"neutral", "happy", "laughing", "sad", "thinking", "surprised", "angry", "sleepy"};
+    auto corpus = LoadCorpus(argv[1], emotions);
+    auto sentences = MakeConversation(emotions, count);
+
+    RunResult uncached, cached;
+    for (auto& s : sentences) {
+        auto r = PlayUncached(corpus[s.emotion], s.duration_ms);
+        uncached.decode_ms += r.decode_ms;
+        uncached.frames_decoded += r.frames_decoded;
+        uncached.frames_shown += r.frames_shown;
+    }
+
+    auto& cache = GifFrameCache::GetInstance();
+    for (auto& s : sentences) {
+        auto r = PlayCached(s.emotion, corpus[s.emotion], s.duration_ms);
+        cached.decode_ms += r.decode_ms;
+        cached.frames_decoded += r.frames_decoded;
+        cached.frames_shown += r.frames_shown;
+    }
+
+    auto region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_GIF_CACHE);
+    printf("%d sentences, cache budget %zu KB\n", count, cache.budget() / 1024);
+    printf("%-10s %10s %14s %12s\n", "", "time (ms)", "frames decoded", "frames shown");
+    printf("%-10s %10.1f %14u %12u\n", "uncached", uncached.decode_ms, uncached.frames_decoded, uncached.frames_shown);
+    printf("%-10s %10.1f %14u %12u\n", "cached", cached.decode_ms, cached.frames_decoded, cached.frames_shown);
+    uint32_t lookups = cache.hits() + cache.misses();
+    printf("hits %u, misses %u, hit rate %.1f%%, peak gif_cache region memory %zu KB\n", cache.hits(), cache.misses(),
+        lookups ? cache.hits() * 100.0 / lookups : 0.0, region->peak() / 1024);
+    return 0;
+}
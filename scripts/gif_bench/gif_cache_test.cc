@@ -0,0 +1,108 @@
+/*
+ * Checks GifFrameCache against the gif_cache memory region, with synthetic sequences of
+ * 64 KB frames recorded the way LvglGif records them, through GifFrameCache::AddFrame(). It
+ * checks that:
+ *
+ * 1. A recording that does not fit next to the cached sequences evicts the least recently
+ *    used ones and completes.
+ * 2. Sequences that are playing are not evicted for room, the others are.
+ * 3. A sequence replaced while it plays keeps counting against the region until the player
+ *    releases it, and recordings make room for it.
+ * 4. With only playing sequences left, AddFrame() fails and the recording stops, the region
+ *    never goes over its budget. A recording larger than the budget evicts nothing.
+ *
+ * Usage: gif_cache_test [-v]
+ */
+#include "gif_frame_cache.h"
+#include "arena_allocator.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FRAME_SIZE (64 * 1024)
+
+static std::vector<uint8_t> canvas(FRAME_SIZE, 0x5a);
+// The source pointer identifies the GIF data, any distinct addresses do
+static const char sources[8] = {};
+
+static std::shared_ptr<const GifFrameSequence> Record(const char* key, int frames) {
+    auto& cache = GifFrameCache::GetInstance();
+    auto recording = std::make_shared<GifFrameSequence>(256, 128, FRAME_SIZE, 0);
+    for (int i = 0; i < frames; i++) {
+        if (!cache.AddFrame(*recording, canvas.data(), 100, {0, 0, 256, 128})) {
+            return nullptr;
+        }
+    }
+    cache.Put(key, &sources[key[0] % 8], recording);
+    return recording;
+}
+
+static bool Cached(const char* key) {
+    return GifFrameCache::GetInstance().Get(key, &sources[key[0] % 8]) != nullptr;
+}
+
+static size_t Frames(size_t bytes) {
+    return bytes / FRAME_SIZE;
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    auto& cache = GifFrameCache::GetInstance();
+    auto region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_GIF_CACHE);
+    if (!cache.enabled() || region == nullptr) {
+        Fail("setup", "no gif_cache region");
+        return ReportChecks();
+    }
+    const int kFrames = region->budget() / FRAME_SIZE;
+    const int kThird = kFrames / 3;
+
+    // 1. Three sequences fill the region, a fourth one evicts the oldest
+    const char* test = "evict for recording";
+    Check(Record("A", kThird) && Record("B", kThird) && Record("C", kThird), test, "three sequences fit");
+    Check(Record("D", kThird) != nullptr, test, "fourth sequence recorded");
+    Check(!Cached("A") && Cached("B") && Cached("C") && Cached("D"), test, "least recently used evicted");
+    Check(region->used() <= region->budget(), test, "region within budget");
+    if (verbose) {
+        printf("%d frames fit, region %zu of %zu frames used\n", kFrames, Frames(region->used()), Frames(region->budget()));
+    }
+
+    // 2. B plays while a large recording needs room, C and D go instead
+    test = "playing not evicted";
+    auto playing = cache.Get("B", &sources['B' % 8]);
+    Check(playing != nullptr, test, "B cached");
+    Check(Record("E", kFrames - kThird) != nullptr, test, "recording next to a playing sequence");
+    Check(Cached("B") && !Cached("C") && !Cached("D") && Cached("E"), test, "only sequences not playing evicted");
+
+    // 3. B is recorded again while the old B still plays, the new B makes room by evicting E
+    test = "replaced while playing";
+    Check(Record("B", 1) != nullptr, test, "B replaced");
+    Check(!Cached("E") && Cached("B"), test, "E evicted for the new B");
+    Check(region->used() == (size_t)(kThird + 1) * FRAME_SIZE, test, "old B still counted by the region");
+    playing.reset();
+    Check(region->used() == FRAME_SIZE, test, "old B released when the player lets go");
+
+    // 4. Everything cached is playing, nothing can be evicted for a new recording
+    test = "nothing to evict";
+    Check(Record("E", kFrames - 1) != nullptr, test, "E fills the region");
+    auto e = cache.Get("E", &sources['E' % 8]);
+    auto b = cache.Get("B", &sources['B' % 8]);
+    Check(Record("F", 1) == nullptr, test, "recording stops when the region is full of playing sequences");
+    Check(Cached("E") && Cached("B"), test, "playing sequences kept");
+    GifFrameSequence huge(256, 128, region->budget() + 1, 0);
+    Check(!cache.AddFrame(huge, canvas.data(), 100, {0, 0, 256, 128}) && huge.frames().empty(), test,
+        "more than the budget");
+    Check(region->peak() <= region->budget(), test, "region peak within budget");
+    if (verbose) {
+        printf("region peak %zu of %zu frames\n", Frames(region->peak()), Frames(region->budget()));
+    }
+
+    e.reset();
+    b.reset();
+    cache.Clear();
+    Check(region->used() == 0, "clear", "region empty after clear");
+    return ReportChecks();
+}
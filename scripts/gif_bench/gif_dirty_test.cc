@@ -0,0 +1,132 @@
+/*
+ * Checks the changed areas LvglGif invalidates. Every corpus GIF is decoded for two loops and
+ * every pixel that differs from the previous canvas must lie inside the dirty area gifdec
+ * reports (dx, dy, dw, dh). The loop is then recorded into a GifFrameSequence the same way
+ * LvglGif does and played back, where the dirty area stored with each frame must cover every
+ * pixel that differs from the frame before, the wrap from the last frame to the first included.
+ *
+ * Usage: gif_dirty_test <corpus_dir>
+ */
+#include "gifdec.h"
+#include "gif_frame_cache.h"
+#include "corpus_util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Coverage {
+    uint64_t invalidated = 0;   // Pixels in the dirty areas
+    uint64_t total = 0;         // Pixels if every frame invalidated the whole image
+    int violations = 0;
+};
+
+// Count the pixels that changed outside the dirty rect
+static int CheckDiff(const uint8_t* before, const uint8_t* after, uint16_t width, uint16_t height, int bpp,
+    const GifRect& dirty) {
+    int outside = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t i = (size_t)y * width + x;
+            bool changed;
+            if (bpp == 4) {
+                changed = memcmp(&before[i * 4], &after[i * 4], 4) != 0;
+            } else {
+                // RGB565A8: color plane and alpha plane
+                size_t n = (size_t)width * height;
+                changed = memcmp(&before[i * 2], &after[i * 2], 2) != 0 || before[n * 2 + i] != after[n * 2 + i];
+            }
+            bool inside = x >= dirty.x && x < dirty.x + dirty.w && y >= dirty.y && y < dirty.y + dirty.h;
+            outside += changed && !inside;
+        }
+    }
+    return outside;
+}
+
+static void CheckFile(const std::vector<char>& data, lv_color_format_t cf, Coverage& decoded, Coverage& cached) {
+    int bpp = cf == LV_COLOR_FORMAT_ARGB8888 ? 4 : 3;
+    gd_GIF* gif = gd_open_gif_data_cf(data.data(), cf);
+    if (gif == nullptr) {
+        decoded.violations++;
+        return;
+    }
+    size_t size = gd_canvas_size(gif);
+    std::vector<uint8_t> previous(gif->canvas, gif->canvas + size);
+    std::shared_ptr<GifFrameSequence> recording;
+    bool recorded = false;
+
+    // Two whole loops, so the wrap from the last frame to the first is covered too
+    for (int loop_starts = 0; loop_starts < 3;) {
+        if (gd_get_frame(gif) != 1) {
+            break;
+        }
+        gd_render_frame(gif, gif->canvas);
+        GifRect dirty = {gif->dx, gif->dy, gif->dw, gif->dh};
+        decoded.violations += CheckDiff(previous.data(), gif->canvas, gif->width, gif->height, bpp, dirty);
+        decoded.invalidated += (uint64_t)dirty.w * dirty.h;
+        decoded.total += (uint64_t)gif->width * gif->height;
+        memcpy(previous.data(), gif->canvas, size);
+
+        // Record the first loop like LvglGif::RecordFrame
+        if (gif->frame_index == 0) {
+            loop_starts++;
+            if (recording) {
+                recording->SetFirstFrameDirty(dirty);
+                recorded = true;
+            } else {
+                recording = std::make_shared<GifFrameSequence>(gif->width, gif->height, size, gif->loop_count);
+            }
+        }
+        if (!recorded) {
+            GifRect rect = gif->frame_index == 0 ? GifRect{0, 0, gif->width, gif->height} : dirty;
+            recording->AddFrame(gif->canvas, 10, rect);
+        }
+    }
+
+    if (recorded) {
+        auto& frames = recording->frames();
+        for (size_t i = 0; i < frames.size() * 2; i++) {
+            auto& from = frames[i % frames.size()];
+            auto& to = frames[(i + 1) % frames.size()];
+            cached.violations += CheckDiff(from.data, to.data, gif->width, gif->height, bpp, to.dirty);
+            cached.invalidated += (uint64_t)to.dirty.w * to.dirty.h;
+            cached.total += (uint64_t)gif->width * gif->height;
+        }
+    }
+    gd_close_gif(gif);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <corpus_dir>\n", argv[0]);
+        return 1;
+    }
+    auto names = ListCorpus(argv[1]);
+    if (names.empty()) {
+        fprintf(stderr, "No GIFs in %s, run make_corpus.py first\n", argv[1]);
+        return 1;
+    }
+
+    int failures = 0;
+    printf("%-18s %12s %12s\n", "file", "decoded %", "cached %");
+    for (auto& name : names) {
+        auto data = ReadFile(std::string(argv[1]) + "/" + name);
+        Coverage decoded, cached;
+        for (auto cf : {LV_COLOR_FORMAT_ARGB8888, LV_COLOR_FORMAT_RGB565A8}) {
+            CheckFile(data, cf, decoded, cached);
+        }
+        // Share of the full image area that gets invalidated per frame
+        printf("%-18s %12.1f %12.1f", name.c_str(), decoded.total ? decoded.invalidated * 100.0 / decoded.total : 0,
+            cached.total ? cached.invalidated * 100.0 / cached.total : 0);
+        if (decoded.violations || cached.violations) {
+            printf("  FAIL: %d decoded and %d cached pixels changed outside the dirty area", decoded.violations,
+                cached.violations);
+            failures++;
+        }
+        printf("\n");
+    }
+    printf("%zu files, %d failures\n", names.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+ * LZW decode throughput of gifdec against the reference decoder from before the table-driven
+ * rewrite. Only gd_get_frame is timed, which is the LZW decode plus the disposal of the
+ * previous frame.
+ *
+ * Usage: gif_lzw_bench <corpus_dir> [frames]
+ */
+#include "gifdec.h"
+#include "reference/gifdec_ref.h"
+#include "corpus_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+struct Decoder {
+    gd_GIF* (*open)(const void*, lv_color_format_t);
+    int (*get_frame)(gd_GIF*);
+    void (*rewind)(gd_GIF*);
+    void (*close)(gd_GIF*);
+};
+
+static const Decoder kCurrent = {gd_open_gif_data_cf, gd_get_frame, gd_rewind, gd_close_gif};
+static const Decoder kReference = {ref_gd_open_gif_data_cf, ref_gd_get_frame, ref_gd_rewind, ref_gd_close_gif};
+
+struct Result {
+    double ms = 0;
+    uint64_t pixels = 0;
+};
+
+static double Now() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static Result Run(const Decoder& decoder, const std::vector<char>& data, int frames) {
+    Result result;
+    gd_GIF* gif = decoder.open(data.data(), LV_COLOR_FORMAT_RGB565A8);
+    if (gif == nullptr) {
+        return result;
+    }
+    double start = Now();
+    for (int i = 0; i < frames; i++) {
+        int ret = decoder.get_frame(gif);
+        if (ret == 0) {
+            decoder.rewind(gif);
+            ret = decoder.get_frame(gif);
+        }
+        if (ret != 1) {
+            break;
+        }
+        result.pixels += gif->fw * gif->fh;
+    }
+    result.ms = Now() - start;
+    decoder.close(gif);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <corpus_dir> [frames]\n", argv[0]);
+        return 1;
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : 500;
+    auto names = ListCorpus(argv[1]);
+    if (names.empty()) {
+        fprintf(stderr, "No GIFs in %s, run make_corpus.py first\n", argv[1]);
+        return 1;
+    }
+
+    Result total_ref, total_cur;
+    printf("%-18s %14s %14s %8s\n", "file", "reference MP/s", "current MP/s", "speedup");
+    for (auto& name : names) {
+        auto data = ReadFile(std::string(argv[1]) + "/" + name);
+        auto ref = Run(kReference, data, frames);
+        auto cur = Run(kCurrent, data, frames);
+        printf("%-18s %14.1f %14.1f %7.2fx\n", name.c_str(), ref.pixels / ref.ms / 1000, cur.pixels / cur.ms / 1000,
+            ref.ms / cur.ms);
+        total_ref.ms += ref.ms;
+        total_ref.pixels += ref.pixels;
+        total_cur.ms += cur.ms;
+        total_cur.pixels += cur.pixels;
+    }
+    printf("%-18s %14.1f %14.1f %7.2fx\n", "total", total_ref.pixels / total_ref.ms / 1000,
+        total_cur.pixels / total_cur.ms / 1000, total_ref.ms / total_cur.ms);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Decodes every GIF in the corpus with gifdec and with the reference decoder from before the
+ * table-driven LZW rewrite, and requires bit-exact palette index frames and canvases for every
+ * frame of two loops, in every output color format.
+ *
+ * Usage: gif_lzw_test <corpus_dir>
+ */
+#include "gifdec.h"
+#include "reference/gifdec_ref.h"
+#include "corpus_util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static const lv_color_format_t kFormats[] = {
+    LV_COLOR_FORMAT_ARGB8888, LV_COLOR_FORMAT_RGB565A8, LV_COLOR_FORMAT_RGB565};
+
+// Empty string when both decoders agree, otherwise what differs first
+static std::string CheckFile(const std::vector<char>& data, lv_color_format_t cf) {
+    gd_GIF* gif = gd_open_gif_data_cf(data.data(), cf);
+    gd_GIF* ref = ref_gd_open_gif_data_cf(data.data(), cf);
+    std::string error;
+    if (gif == nullptr || ref == nullptr) {
+        error = gif == ref ? "" : "only one decoder opened the file";
+    } else {
+        int loops = 0;
+        for (int frame = 0; loops < 2 && error.empty(); frame++) {
+            int ret = gd_get_frame(gif);
+            int ref_ret = ref_gd_get_frame(ref);
+            if (ret != ref_ret) {
+                error = "frame " + std::to_string(frame) + ": returned " + std::to_string(ret) + ", reference " +
+                    std::to_string(ref_ret);
+                break;
+            }
+            if (ret != 1) {
+                // Played once, or both failed the same way
+                break;
+            }
+            if (gif->frame_index == 0 && frame > 0) {
+                loops++;
+            }
+            gd_render_frame(gif, gif->canvas);
+            ref_gd_render_frame(ref, ref->canvas);
+            if (memcmp(gif->frame, ref->frame, gif->width * gif->height) != 0) {
+                error = "frame " + std::to_string(frame) + ": palette indexes differ";
+            } else if (memcmp(gif->canvas, ref->canvas, gd_canvas_size(gif)) != 0) {
+                error = "frame " + std::to_string(frame) + ": canvas differs";
+            }
+        }
+    }
+    if (gif) {
+        gd_close_gif(gif);
+    }
+    if (ref) {
+        ref_gd_close_gif(ref);
+    }
+    return error;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <corpus_dir>\n", argv[0]);
+        return 1;
+    }
+    auto names = ListCorpus(argv[1]);
+    if (names.empty()) {
+        fprintf(stderr, "No GIFs in %s, run make_corpus.py first\n", argv[1]);
+        return 1;
+    }
+
+    int failures = 0;
+    for (auto& name : names) {
+        auto data = ReadFile(std::string(argv[1]) + "/" + name);
+        bool ok = true;
+        for (auto cf : kFormats) {
+            auto error = CheckFile(data, cf);
+            if (!error.empty()) {
+                printf("FAIL %s (cf 0x%02x): %s\n", name.c_str(), cf, error.c_str());
+                ok = false;
+            }
+        }
+        if (ok) {
+            printf("ok   %s\n", name.c_str());
+        } else {
+            failures++;
+        }
+    }
+    printf("%zu files, %d failures\n", names.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*
+ * Compares the gifdec output formats. Every GIF in the corpus is decoded in lock step as
+ * ARGB8888, RGB565A8 and RGB565, and the RGB565 canvases are checked against the ARGB8888
+ * canvas converted to RGB565. Per frame it reports the time spent rendering into the canvas
+ * and blending the canvas onto an RGB565 frame buffer the way LVGL does, together with the
+ * bytes both steps touch.
+ *
+ * Usage: gif_render_bench <corpus_dir> [loops]
+ */
+#include "gifdec.h"
+#include "corpus_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Format {
+    const char* name;
+    lv_color_format_t cf;
+    int bpp;    // bytes per pixel of the canvas, A8 plane included
+};
+
+static const Format kFormats[] = {
+    {"ARGB8888", LV_COLOR_FORMAT_ARGB8888, 4},
+    {"RGB565A8", LV_COLOR_FORMAT_RGB565A8, 3},
+    {"RGB565", LV_COLOR_FORMAT_RGB565, 2},
+};
+static const int kFormatCount = sizeof(kFormats) / sizeof(kFormats[0]);
+
+struct Stats {
+    double render_us = 0;
+    double blit_us = 0;
+    uint64_t render_bytes = 0;
+    uint64_t blit_bytes = 0;
+    uint32_t frames = 0;
+};
+
+static double Now() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint16_t To565(const uint8_t* bgra) {
+    return ((bgra[2] & 0xF8) << 8) | ((bgra[1] & 0xFC) << 3) | (bgra[0] >> 3);
+}
+
+static uint16_t Mix565(uint16_t fg, uint16_t bg, uint8_t opa) {
+    uint32_t r = (((fg >> 11) & 0x1F) * opa + ((bg >> 11) & 0x1F) * (255 - opa)) / 255;
+    uint32_t g = (((fg >> 5) & 0x3F) * opa + ((bg >> 5) & 0x3F) * (255 - opa)) / 255;
+    uint32_t b = ((fg & 0x1F) * opa + (bg & 0x1F) * (255 - opa)) / 255;
+    return (r << 11) | (g << 5) | b;
+}
+
+// What the LVGL software renderer does with the image on an RGB565 panel
+static void Blit(const gd_GIF* gif, lv_color_format_t cf, uint16_t* fb) {
+    int n = gif->width * gif->height;
+    if (cf == LV_COLOR_FORMAT_RGB565) {
+        memcpy(fb, gif->canvas, n * 2);
+    } else if (cf == LV_COLOR_FORMAT_RGB565A8) {
+        auto rgb = (const uint16_t*)gif->canvas;
+        auto alpha = gif->canvas + n * 2;
+        for (int i = 0; i < n; i++) {
+            fb[i] = alpha[i] == 0xFF ? rgb[i] : Mix565(rgb[i], fb[i], alpha[i]);
+        }
+    } else {
+        auto bgra = gif->canvas;
+        for (int i = 0; i < n; i++, bgra += 4) {
+            fb[i] = bgra[3] == 0xFF ? To565(bgra) : Mix565(To565(bgra), fb[i], bgra[3]);
+        }
+    }
+}
+
+// Number of pixels in the canvas that differ from the ARGB8888 reference
+static int Compare(const gd_GIF* ref, const gd_GIF* gif) {
+    int n = ref->width * ref->height;
+    auto rgb = (const uint16_t*)gif->canvas;
+    int mismatches = 0;
+    for (int i = 0; i < n; i++) {
+        const uint8_t* bgra = &ref->canvas[i * 4];
+        bool bad = rgb[i] != To565(bgra);
+        if (gif->color_format == LV_COLOR_FORMAT_RGB565A8) {
+            bad |= gif->canvas[n * 2 + i] != bgra[3];
+        }
+        mismatches += bad;
+    }
+    return mismatches;
+}
+
+// Decode the next frame, rewinding GIFs that do not loop
+static bool NextFrame(gd_GIF* gif) {
+    int ret = gd_get_frame(gif);
+    if (ret == 0) {
+        gd_rewind(gif);
+        ret = gd_get_frame(gif);
+    }
+    return ret == 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <corpus_dir> [loops]\n", argv[0]);
+        return 1;
+    }
+    std::string dir = argv[1];
+    int loops = argc > 2 ? atoi(argv[2]) : 20;
+    auto names = ListCorpus(dir);
+    if (names.empty()) {
+        fprintf(stderr, "No GIFs in %s, run make_corpus.py first\n", dir.c_str());
+        return 1;
+    }
+
+    Stats total[kFormatCount];
+    int mismatches = 0;
+    printf("%-16s %-9s %11s %11s %12s %12s\n", "file", "format", "render us", "blit us", "render bytes",
+        "blit bytes");
+    for (auto& name : names) {
+        auto data = ReadFile(dir + "/" + name);
+
+        // Count the frames in one loop, before the three decoders take their share of the gif region
+        int loop_frames = 0;
+        gd_GIF* probe = gd_open_gif_data(data.data());
+        if (probe == nullptr) {
+            fprintf(stderr, "Failed to open %s\n", name.c_str());
+            return 1;
+        }
+        while (gd_get_frame(probe) == 1 && (loop_frames == 0 || probe->frame_index != 0)) {
+            loop_frames++;
+        }
+        gd_close_gif(probe);
+
+        gd_GIF* gifs[kFormatCount];
+        std::vector<uint16_t> fbs[kFormatCount];
+        Stats stats[kFormatCount];
+        for (int i = 0; i < kFormatCount; i++) {
+            gifs[i] = gd_open_gif_data_cf(data.data(), kFormats[i].cf);
+            if (gifs[i] == nullptr) {
+                fprintf(stderr, "Failed to open %s\n", name.c_str());
+                return 1;
+            }
+            fbs[i].assign(gifs[i]->width * gifs[i]->height, 0x841F);
+        }
+
+        for (int frame = 0; frame < loops * loop_frames; frame++) {
+            for (int i = 0; i < kFormatCount; i++) {
+                gd_GIF* gif = gifs[i];
+                double start = Now();
+                if (!NextFrame(gif)) {
+                    fprintf(stderr, "Decode error in %s\n", name.c_str());
+                    return 1;
+                }
+                gd_render_frame(gif, gif->canvas);
+                double rendered = Now();
+                Blit(gif, kFormats[i].cf, fbs[i].data());
+                stats[i].blit_us += Now() - rendered;
+                stats[i].render_us += rendered - start;
+                // Palette indexes read and canvas bytes written for the frame rect
+                stats[i].render_bytes += (uint64_t)gif->fw * gif->fh * (1 + kFormats[i].bpp);
+                // Canvas read plus RGB565 frame buffer written, and read too when blending
+                int fb_bytes = kFormats[i].cf == LV_COLOR_FORMAT_RGB565 ? 2 : 4;
+                stats[i].blit_bytes += (uint64_t)gif->width * gif->height * (kFormats[i].bpp + fb_bytes);
+                stats[i].frames++;
+            }
+            for (int i = 1; i < kFormatCount; i++) {
+                mismatches += Compare(gifs[0], gifs[i]);
+            }
+
+        }
+
+        for (int i = 0; i < kFormatCount; i++) {
+            auto& s = stats[i];
+            printf("%-16s %-9s %11.2f %11.2f %12llu %12llu\n", name.c_str(), kFormats[i].name, s.render_us / s.frames,
+                s.blit_us / s.frames, (unsigned long long)(s.render_bytes / s.frames),
+                (unsigned long long)(s.blit_bytes / s.frames));
+            total[i].render_us += s.render_us;
+            total[i].blit_us += s.blit_us;
+            total[i].render_bytes += s.render_bytes;
+            total[i].blit_bytes += s.blit_bytes;
+            total[i].frames += s.frames;
+            gd_close_gif(gifs[i]);
+        }
+    }
+
+    printf("\nper frame over the corpus\n");
+    printf("%-9s %11s %11s %12s %12s\n", "format", "render us", "blit us", "render bytes", "blit bytes");
+    for (int i = 0; i < kFormatCount; i++) {
+        auto& s = total[i];
+        printf("%-9s %11.2f %11.2f %12llu %12llu\n", kFormats[i].name, s.render_us / s.frames, s.blit_us / s.frames,
+            (unsigned long long)(s.render_bytes / s.frames), (unsigned long long)(s.blit_bytes / s.frames));
+    }
+    printf("\n%d pixels differ from the ARGB8888 reference\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""
+Generate a deterministic corpus of animated GIFs for the gifdec host benchmarks and tests
+
+The files cover what the decoder has to handle in practice: emotion style animations where
+only a small region changes, full frame noise that fills the LZW table (clear codes), full
+tables without clear codes, long strings, truncated image data, small code sizes, interlacing,
+local color tables, transparency, every disposal mode, GIF87a and files without a loop
+extension.
+
+Usage:
+    python scripts/gif_bench/make_corpus.py [output_dir]
+"""
+import math
+import os
+import random
+import struct
+import sys
+
+
+def lzw_encode(pixels, min_code_size, deferred_clear=False):
+    """LZW encode a list of palette indexes, same code size rules as gifenc / gifdec
+
+    With deferred_clear a full table is kept and 12-bit codes go on without a clear code,
+    which the GIF spec allows and some encoders do.
+    """
+    clear = 1 << min_code_size
+    stop = clear + 1
+    out = bytearray()
+    acc = 0
+    acc_bits = 0
+
+    def put(code, size):
+        nonlocal acc, acc_bits
+        acc |= code << acc_bits
+        acc_bits += size
+        while acc_bits >= 8:
+            out.append(acc & 0xFF)
+            acc >>= 8
+            acc_bits -= 8
+
+    key_size = min_code_size + 1
+    table = {}
+    next_code = clear + 2
+    put(clear, key_size)
+    prefix = pixels[0]
+    for p in pixels[1:]:
+        key = (prefix, p)
+        if key in table:
+            prefix = table[key]
+            continue
+        put(prefix, key_size)
+        if next_code < 0x1000:
+            if next_code == (1 << key_size):
+                key_size += 1
+            table[key] = next_code
+            next_code += 1
+        elif not deferred_clear:
+            put(clear, key_size)
+            table = {}
+            next_code = clear + 2
+            key_size = min_code_size + 1
+        prefix = p
+    put(prefix, key_size)
+    put(stop, key_size)
+    if acc_bits > 0:
+        out.append(acc & 0xFF)
+    return bytes(out)
+
+
+def sub_blocks(data):
+    out = bytearray()
+    for i in range(0, len(data), 255):
+        chunk = data[i:i + 255]
+        out.append(len(chunk))
+        out += chunk
+    out.append(0)
+    return bytes(out)
+
+
+def color_table_bits(size):
+    bits = 0
+    while (2 << bits) < size:
+        bits += 1
+    return bits
+
+
+def padded_palette(palette, bits):
+    table = bytearray()
+    for r, g, b in palette:
+        table += bytes((r, g, b))
+    table += bytes(3 * ((2 << bits) - len(palette)))
+    return bytes(table)
+
+
+class GifWriter:
+    def __init__(self, width, height, palette, bgindex=0, version=b"89a", loop=0):
+        self.width = width
+        self.height = height
+        self.bits = color_table_bits(len(palette))
+        self.data = bytearray(b"GIF" + version)
+        self.data += struct.pack("<HHBBB", width, height, 0x80 | (self.bits << 4) | self.bits, bgindex, 0)
+        self.data += padded_palette(palette, self.bits)
+        if loop is not None:
+            self.data += b"\x21\xFF\x0BNETSCAPE2.0\x03\x01" + struct.pack("<H", loop) + b"\x00"
+
+    def frame(self, pixels, x=0, y=0, w=None, h=None, delay=10, disposal=1, transparent=None,
+              interlace=False, local_palette=None, deferred_clear=False, truncate=None):
+        w = w or self.width
+        h = h or self.height
+        assert len(pixels) == w * h
+        packed = (disposal << 2) | (1 if transparent is not None else 0)
+        self.data += struct.pack("<BBBBHBB", 0x21, 0xF9, 4, packed, delay, transparent or 0, 0)
+        flags = 0x40 if interlace else 0
+        bits = self.bits
+        if local_palette is not None:
+            bits = color_table_bits(len(local_palette))
+            flags |= 0x80 | bits
+        self.data += struct.pack("<BHHHHB", 0x2C, x, y, w, h, flags)
+        if local_palette is not None:
+            self.data += padded_palette(local_palette, bits)
+        if interlace:
+            rows = [pixels[r * w:(r + 1) * w] for r in range(h)]
+            order = list(range(0, h, 8)) + list(range(4, h, 8)) + list(range(2, h, 4)) + list(range(1, h, 2))
+            pixels = [p for r in order for p in rows[r]]
+        min_code_size = max(2, bits + 1)
+        self.data.append(min_code_size)
+        data = lzw_encode(pixels, min_code_size, deferred_clear)
+        if truncate is not None:
+            data = data[:int(len(data) * truncate)]
+        self.data += sub_blocks(data)
+
+    def save(self, path):
+        with open(path, "wb") as f:
+            f.write(self.data + b"\x3B")
+
+
+def face_palette(hue):
+    palette = [(0, 0, 0), (255, 255, 255)]
+    for i in range(14):
+        t = i / 13
+        palette.append((int(255 * t), int(hue * (1 - t)), int(128 + 127 * t) & 0xFF))
+    return palette
+
+
+def emotion_gif(path, size, frames, seed):
+    """Face with a static gradient background where only the eyes and mouth move"""
+    rnd = random.Random(seed)
+    gif = GifWriter(size, size, face_palette(rnd.randrange(256)))
+    base = [2 + ((x + y) * 13 // (2 * size)) for y in range(size) for x in range(size)]
+    gif.frame(base, delay=10)
+    ex, ey, ew, eh = size // 5, size // 4, size * 3 // 5, size // 5
+    mx, my, mw, mh = size // 4, size * 3 // 5, size // 2, size // 6
+    for f in range(frames - 1):
+        phase = 2 * math.pi * f / (frames - 1)
+        eyes = []
+        for y in range(eh):
+            for x in range(ew):
+                cx = ew // 4 if x < ew // 2 else ew * 3 // 4
+                r = eh // 2 * (0.3 + 0.7 * abs(math.cos(phase)))
+                eyes.append(0 if (x - cx) ** 2 + (y - eh // 2) ** 2 < r * r else base[(ey + y) * size + ex + x])
+        gif.frame(eyes, ex, ey, ew, eh, delay=8)
+        mouth = []
+        for y in range(mh):
+            for x in range(mw):
+                curve = mh // 2 + int(mh // 3 * math.sin(phase) * math.sin(math.pi * x / mw))
+                mouth.append(1 if abs(y - curve) < 2 else base[(my + y) * size + mx + x])
+        gif.frame(mouth, mx, my, mw, mh, delay=4)
+    gif.save(path)
+
+
+def noise_gif(path, size, frames, seed):
+    """Full frame noise with 256 colors, fills the LZW table and forces clear codes"""
+    rnd = random.Random(seed)
+    palette = [(rnd.randrange(256), rnd.randrange(256), rnd.randrange(256)) for _ in range(256)]
+    gif = GifWriter(size, size, palette)
+    for f in range(frames):
+        pixels = [rnd.randrange(256) for _ in range(size * size)]
+        gif.frame(pixels, delay=5, disposal=2, transparent=7 if f % 2 else None)
+    gif.save(path)
+
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus")
+    os.makedirs(out_dir, exist_ok=True)
+
+    emotions = ["neutral", "happy", "laughing", "sad", "thinking", "surprised", "angry", "sleepy"]
+    for i, name in enumerate(emotions):
+        emotion_gif(os.path.join(out_dir, f"{name}.gif"), 120, 12, i)
+
+    noise_gif(os.path.join(out_dir, "noise_160.gif"), 160, 4, 100)
+
+    # Two colors, smallest code size
+    gif = GifWriter(32, 32, [(0, 0, 0), (255, 255, 255)])
+    for f in range(4):
+        gif.frame([((x >> f) ^ (y >> f)) & 1 for y in range(32) for x in range(32)], delay=20, disposal=f % 4)
+    gif.save(os.path.join(out_dir, "mono_32.gif"))
+
+    # Interlaced frames with a local color table and an odd size
+    gif = GifWriter(61, 47, face_palette(40))
+    gif.frame([(x * y) % 16 for y in range(47) for x in range(61)], interlace=True)
+    gif.frame([(x + y) % 8 for y in range(30) for x in range(20)], 5, 7, 20, 30, interlace=True,
+              local_palette=[(i * 30, 255 - i * 30, 128) for i in range(8)], disposal=3)
+    gif.save(os.path.join(out_dir, "interlaced.gif"))
+
+    # Low entropy noise fills the table long before the frame ends, with and without clear codes
+    rnd = random.Random(7)
+    for name, deferred in (("lzw_clear.gif", False), ("lzw_deferred.gif", True)):
+        gif = GifWriter(200, 200, face_palette(90))
+        for f in range(2):
+            gif.frame([rnd.choice((2, 2, 2, 3, 5)) for _ in range(200 * 200)], deferred_clear=deferred)
+        gif.save(os.path.join(out_dir, name))
+
+    # Large flat areas make long strings, one frame stops half way through its data
+    gif = GifWriter(240, 240, [(0, 0, 0), (255, 0, 0), (0, 255, 0), (0, 0, 255)])
+    gif.frame([(x // 60 + y // 80) % 4 for y in range(240) for x in range(240)])
+    gif.frame([(x // 3 + y // 120) % 4 for y in range(240) for x in range(240)], truncate=0.5)
+    gif.frame([((x * x + y * y) // 1500) % 4 for y in range(100) for x in range(120)], 60, 70, 120, 100)
+    gif.save(os.path.join(out_dir, "long_runs.gif"))
+
+    # A sprite moving over the background, restoring the background behind it every frame
+    gif = GifWriter(96, 64, face_palette(150), bgindex=4)
+    gif.frame([4 + (x // 16) % 2 for y in range(64) for x in range(96)])
+    for f in range(8):
+        gif.frame([0 if (x - 8) ** 2 + (y - 8) ** 2 < 50 else 7 for y in range(16) for x in range(16)],
+                  f * 10, (f * 7) % 48, 16, 16, disposal=2 if f % 3 else 1, transparent=7)
+    gif.save(os.path.join(out_dir, "sprite_dispose.gif"))
+
+    # GIF87a without a loop extension, played once
+    gif = GifWriter(48, 48, face_palette(200), bgindex=3, version=b"87a", loop=None)
+    gif.data += bytes([0x2C]) + struct.pack("<HHHHB", 0, 0, 48, 48, 0)
+    gif.data.append(4)
+    gif.data += sub_blocks(lzw_encode([(x // 6 + y // 6) % 16 for y in range(48) for x in range(48)], 4))
+    gif.save(os.path.join(out_dir, "once_87a.gif"))
+
+    print(f"Corpus written to {out_dir}")
+
+
+if __name__ == "__main__":
+    main()
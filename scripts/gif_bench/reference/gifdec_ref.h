@@ -0,0 +1,21 @@
+/* The reference decoder in gifdec_ref.c, built with ref_ prefixed symbols */
+#ifndef GIFDEC_REF_H
+#define GIFDEC_REF_H
+
+#include "gifdec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+gd_GIF * ref_gd_open_gif_data_cf(const void * data, lv_color_format_t color_format);
+void ref_gd_render_frame(gd_GIF * gif, uint8_t * buffer);
+int ref_gd_get_frame(gd_GIF * gif);
+void ref_gd_rewind(gd_GIF * gif);
+void ref_gd_close_gif(gd_GIF * gif);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* GIFDEC_REF_H */
@@ -0,0 +1,72 @@
+/* Just enough of the LVGL API for gifdec on the host, GIFs are always opened from memory */
+#ifndef GIF_BENCH_LVGL_H
+#define GIF_BENCH_LVGL_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define LV_DRAW_SW_ASM_NONE     0
+#define LV_DRAW_SW_ASM_NEON     1
+#define LV_DRAW_SW_ASM_HELIUM   2
+#define LV_USE_DRAW_SW_ASM      LV_DRAW_SW_ASM_NONE
+
+typedef enum {
+    LV_COLOR_FORMAT_UNKNOWN = 0,
+    LV_COLOR_FORMAT_ARGB8888 = 0x10,
+    LV_COLOR_FORMAT_RGB565 = 0x12,
+    LV_COLOR_FORMAT_RGB565A8 = 0x14,
+} lv_color_format_t;
+
+typedef enum {
+    LV_FS_RES_OK = 0,
+    LV_FS_RES_UNKNOWN,
+} lv_fs_res_t;
+
+typedef enum {
+    LV_FS_MODE_WR = 0x01,
+    LV_FS_MODE_RD = 0x02,
+} lv_fs_mode_t;
+
+typedef enum {
+    LV_FS_SEEK_SET = 0x00,
+    LV_FS_SEEK_CUR = 0x01,
+    LV_FS_SEEK_END = 0x02,
+} lv_fs_whence_t;
+
+typedef struct {
+    void *file_d;
+} lv_fs_file_t;
+
+static inline lv_fs_res_t lv_fs_open(lv_fs_file_t *file, const char *path, lv_fs_mode_t mode)
+{
+    (void)file; (void)path; (void)mode;
+    return LV_FS_RES_UNKNOWN;
+}
+static inline lv_fs_res_t lv_fs_read(lv_fs_file_t *file, void *buf, uint32_t btr, uint32_t *br)
+{
+    (void)file; (void)buf; (void)btr; (void)br;
+    return LV_FS_RES_UNKNOWN;
+}
+static inline lv_fs_res_t lv_fs_seek(lv_fs_file_t *file, uint32_t pos, lv_fs_whence_t whence)
+{
+    (void)file; (void)pos; (void)whence;
+    return LV_FS_RES_UNKNOWN;
+}
+static inline lv_fs_res_t lv_fs_tell(lv_fs_file_t *file, uint32_t *pos)
+{
+    (void)file;
+    *pos = 0;
+    return LV_FS_RES_UNKNOWN;
+}
+static inline lv_fs_res_t lv_fs_close(lv_fs_file_t *file)
+{
+    (void)file;
+    return LV_FS_RES_OK;
+}
+
+#define lv_malloc   malloc
+#define lv_realloc  realloc
+#define lv_free     free
+
+#endif
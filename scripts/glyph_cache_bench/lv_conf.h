@@ -0,0 +1,18 @@
+/* Minimal LVGL configuration for the headless glyph cache benchmark, unset options use the LVGL defaults */
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#define LV_COLOR_DEPTH 16
+
+#define LV_USE_STDLIB_MALLOC    LV_STDLIB_CLIB
+#define LV_USE_STDLIB_STRING    LV_STDLIB_CLIB
+#define LV_USE_STDLIB_SPRINTF   LV_STDLIB_CLIB
+
+#define LV_USE_OS   LV_OS_NONE
+#define LV_USE_LOG  0
+
+/* A 4 bpp CJK font that is decoded into an A8 buffer on every draw, like the CBin fonts */
+#define LV_FONT_SOURCE_HAN_SANS_SC_16_CJK 1
+#define LV_FONT_DEFAULT &lv_font_source_han_sans_sc_16_cjk
+
+#endif /* LV_CONF_H */
@@ -0,0 +1,194 @@
+/*
+ * Headless LVGL benchmark for the glyph cache.
+ *
+ * A long Chinese conversation is streamed into a label a few characters at a time, the
+ * way the assistant's answer arrives with TTS, and the screen is refreshed after every
+ * update. The same stream is rendered with the font drawn directly, which decodes every
+ * glyph again on each refresh, and with the font attached to the GlyphCache, optionally
+ * prefilled with the most frequent characters of the transcript.
+ *
+ * Usage: glyph_cache_bench [-w width] [-h height] [-s chars per update] [-p prefill] [-r repeats]
+ */
+#include "glyph_cache.h"
+#include "arena_allocator.h"
+
+#include <lvgl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static double NowUs() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t TickCb() {
+    return (uint32_t)(NowUs() / 1000);
+}
+
+static void FlushCb(lv_display_t* display, const lv_area_t* area, uint8_t* px_map) {
+    (void)area;
+    (void)px_map;
+    lv_display_flush_ready(display);
+}
+
+// Decoded glyph bitmaps requested by the renderer, counted by wrapping get_glyph_bitmap
+static uint64_t decodes = 0;
+static const void* (*decode_glyph)(lv_font_glyph_dsc_t*, lv_draw_buf_t*) = nullptr;
+
+static const void* CountingGetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    decodes++;
+    return decode_glyph(dsc, draw_buf);
+}
+
+static std::vector<uint32_t> DecodeUtf8(const std::string& text) {
+    std::vector<uint32_t> codepoints;
+    for (uint32_t i = 0; i < text.size();) {
+        codepoints.push_back(lv_text_encoded_next(text.c_str(), &i));
+    }
+    return codepoints;
+}
+
+// Codepoints of the transcript outside ASCII, most frequent first, as gen_hot_glyphs.py ranks them
+static std::vector<uint32_t> RankCodepoints(const std::string& text) {
+    std::map<uint32_t, uint32_t> counts;
+    for (uint32_t c : DecodeUtf8(text)) {
+        if (c > 0x7F) {
+            counts[c]++;
+        }
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> ranked(counts.begin(), counts.end());
+    std::stable_sort(ranked.begin(), ranked.end(), [](auto& a, auto& b) { return a.second > b.second; });
+    std::vector<uint32_t> codepoints;
+    for (auto& item : ranked) {
+        codepoints.push_back(item.first);
+    }
+    return codepoints;
+}
+
+// Each line of the transcript is one message, streamed step characters at a time
+static double Run(const char* name, const lv_font_t* font, const std::vector<std::string>& lines, int step,
+    int repeats, lv_display_t* display) {
+    lv_obj_t* old_screen = lv_screen_active();
+    lv_obj_t* screen = lv_obj_create(nullptr);
+    lv_screen_load(screen);
+    lv_obj_delete(old_screen);
+    lv_obj_t* label = lv_label_create(screen);
+    lv_obj_set_style_text_font(label, font, 0);
+    lv_obj_set_width(label, LV_HOR_RES - 16);
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_obj_align(label, LV_ALIGN_TOP_MID, 0, 8);
+    lv_refr_now(display);
+
+    uint32_t hits = GlyphCache::GetInstance().hits();
+    uint32_t misses = GlyphCache::GetInstance().misses();
+    uint64_t start_decodes = decodes;
+    uint32_t updates = 0;
+    double start = NowUs();
+    for (int r = 0; r < repeats; r++) {
+        for (auto& line : lines) {
+            uint32_t offset = 0;
+            while (offset < line.size()) {
+                for (int i = 0; i < step && offset < line.size(); i++) {
+                    lv_text_encoded_next(line.c_str(), &offset);
+                }
+                lv_label_set_text(label, line.substr(0, offset).c_str());
+                lv_refr_now(display);
+                updates++;
+            }
+        }
+    }
+    double elapsed = NowUs() - start;
+    printf("%-10s %9.1f %12.1f %12llu %8u %8u\n", name, elapsed / 1000, elapsed / updates,
+        (unsigned long long)(decodes - start_decodes), GlyphCache::GetInstance().hits() - hits,
+        GlyphCache::GetInstance().misses() - misses);
+    return elapsed;
+}
+
+static void Usage(const char* prog) {
+    printf("Usage: %s [-w width] [-h height] [-s chars per update] [-p prefill] [-r repeats]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int width = 240, height = 320, step = 4, prefill = 500, repeats = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h:s:p:r:")) != -1) {
+        switch (opt) {
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        case 's': step = atoi(optarg); break;
+        case 'p': prefill = atoi(optarg); break;
+        case 'r': repeats = atoi(optarg); break;
+        default: Usage(argv[0]); return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || step <= 0 || prefill < 0 || repeats <= 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    std::ifstream file(GLYPH_CACHE_BENCH_TRANSCRIPT);
+    std::vector<std::string> lines;
+    std::string all, line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            lines.push_back(line);
+            all += line;
+        }
+    }
+    if (lines.empty()) {
+        printf("Failed to read %s\n", GLYPH_CACHE_BENCH_TRANSCRIPT);
+        return 1;
+    }
+
+    lv_init();
+    lv_tick_set_cb(TickCb);
+
+    size_t buffer_size = (size_t)width * 20 * 2;
+    std::vector<uint8_t> buffer(buffer_size);
+    lv_display_t* display = lv_display_create(width, height);
+    lv_display_set_flush_cb(display, FlushCb);
+    lv_display_set_buffers(display, buffer.data(), nullptr, buffer_size, LV_DISPLAY_RENDER_MODE_PARTIAL);
+
+    // A copy of the builtin font whose decodes are counted, the cache sits in front of it
+    lv_font_t font = lv_font_source_han_sans_sc_16_cjk;
+    decode_glyph = font.get_glyph_bitmap;
+    font.get_glyph_bitmap = CountingGetGlyphBitmap;
+
+    auto& cache = GlyphCache::GetInstance();
+    auto ranked = RankCodepoints(all);
+    printf("%dx%d, %zu messages, %zu distinct glyphs, %d chars per update, %d repeats, %u KB cache\n",
+        width, height, lines.size(), ranked.size(), step, repeats, (unsigned)(cache.budget() / 1024));
+    printf("%-10s %9s %12s %12s %8s %8s\n", "", "total ms", "us/update", "decodes", "hits", "misses");
+
+    double direct = Run("direct", &font, lines, step, repeats, display);
+
+    lv_font_t* cached_font = cache.AttachFont(&font);
+    if (cached_font == nullptr) {
+        printf("Glyph cache is disabled\n");
+        return 1;
+    }
+    double cold = Run("cached", cached_font, lines, step, repeats, display);
+    cache.Clear();
+
+    ranked.resize(std::min(ranked.size(), (size_t)prefill));
+    double t0 = NowUs();
+    size_t added = cache.Prefill(cached_font, ranked.data(), ranked.size());
+    double prefill_ms = (NowUs() - t0) / 1000;
+    double warm = Run("prefilled", cached_font, lines, step, repeats, display);
+
+    printf("\nprefill: %zu glyphs in %.1f ms, %zu bytes\n", added, prefill_ms,
+        MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_GLYPH_CACHE)->used());
+    printf("speedup: cached %.2fx, prefilled %.2fx\n", direct / cold, direct / warm);
+
+    cache.DetachFont(cached_font);
+    lv_display_delete(display);
+    lv_deinit();
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Checks GlyphCache against the glyph_cache memory region, with a font whose A8 glyphs are
+ * generated from their index and have odd sizes, so the heap rounds most entries up:
+ *
+ * 1. The second draw of a glyph copies the bitmap decoded by the first one, and counts one
+ *    miss and one hit.
+ * 2. Drawing more glyphs than the budget holds evicts the least recently used ones. Every
+ *    glyph drawn is cached, so drawing it again does not decode it, and the region never
+ *    goes over its budget.
+ * 3. Threads drawing the same glyphs count every draw as either a hit or a miss.
+ * 4. Detaching the font frees its entries, fonts with static bitmaps are not attached.
+ *
+ * Usage: glyph_cache_test [-v]
+ */
+#include "glyph_cache.h"
+#include "arena_allocator.h"
+#include "host_test.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static std::atomic<uint32_t> decodes(0);
+
+static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    (void)font;
+    (void)letter_next;
+    dsc->box_w = 9 + letter % 7;
+    dsc->box_h = 11 + letter % 5;
+    dsc->format = LV_FONT_GLYPH_FORMAT_A8;
+    dsc->gid.index = letter;
+    return true;
+}
+
+static uint8_t Pixel(uint32_t glyph, size_t i) {
+    return (uint8_t)(glyph * 31 + i);
+}
+
+static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    decodes++;
+    size_t size = (size_t)draw_buf->header.stride * dsc->box_h;
+    for (size_t i = 0; i < size; i++) {
+        draw_buf->data[i] = Pixel(dsc->gid.index, i);
+    }
+    return draw_buf;
+}
+
+// Draws a glyph the way the label renderer does, false if the bitmap is wrong
+static bool Draw(lv_font_t* font, uint32_t letter) {
+    lv_font_glyph_dsc_t dsc;
+    memset(&dsc, 0, sizeof(dsc));
+    font->get_glyph_dsc(font, &dsc, letter, 0);
+    dsc.resolved_font = font;
+    lv_draw_buf_t* draw_buf = lv_draw_buf_create(dsc.box_w, dsc.box_h, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+    bool ok = font->get_glyph_bitmap(&dsc, draw_buf) == draw_buf;
+    for (size_t i = 0; ok && i < (size_t)draw_buf->header.stride * dsc.box_h; i++) {
+        ok = draw_buf->data[i] == Pixel(letter, i);
+    }
+    lv_draw_buf_destroy(draw_buf);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    auto& cache = GlyphCache::GetInstance();
+    auto region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_GLYPH_CACHE);
+    lv_font_t font;
+    memset(&font, 0, sizeof(font));
+    font.get_glyph_dsc = GetGlyphDsc;
+    font.get_glyph_bitmap = GetGlyphBitmap;
+    lv_font_t* cached = cache.AttachFont(&font);
+    if (!cache.enabled() || region == nullptr || cached == nullptr) {
+        Fail("setup", "no glyph_cache region");
+        return ReportChecks();
+    }
+
+    // 1. Decoded once, then copied
+    const char* test = "hit after miss";
+    Check(Draw(cached, 'A') && Draw(cached, 'A'), test, "bitmaps match the font");
+    Check(decodes == 1, test, "decoded once");
+    Check(cache.misses() == 1 && cache.hits() == 1, test, "one miss and one hit");
+
+    // 2. About four times the budget of small glyphs, each drawn twice in a row. The many
+    // entries add up enough rounding to go over the budget if only their sizes were counted
+    test = "budget";
+    uint32_t glyphs = 4 * region->budget() / 200;
+    bool correct = true;
+    bool cached_again = true;
+    bool within_budget = true;
+    for (uint32_t letter = 0x4e00; letter < 0x4e00 + glyphs; letter++) {
+        correct = correct && Draw(cached, letter);
+        uint32_t before = decodes;
+        correct = correct && Draw(cached, letter);
+        cached_again = cached_again && decodes == before;
+        within_budget = within_budget && region->used() <= region->budget();
+    }
+    Check(correct, test, "bitmaps match the font");
+    Check(cached_again, test, "every glyph cached when drawn");
+    Check(within_budget, test, "region within budget");
+    uint32_t before = decodes;
+    Draw(cached, 0x4e00 + glyphs - 1);
+    Check(decodes == before, test, "most recent glyph kept");
+    Draw(cached, 0x4e00);
+    Check(decodes == before + 1, test, "oldest glyph evicted");
+    if (verbose) {
+        printf("%u glyphs drawn, region %zu of %zu bytes used\n", glyphs, region->used(), region->budget());
+    }
+
+    // 3. Draws from several threads, few enough glyphs to stay cached
+    test = "threads";
+    cache.Clear();
+    uint32_t hits = cache.hits();
+    uint32_t misses = cache.misses();
+    const int kThreads = 4, kRounds = 200, kGlyphs = 16;
+    std::atomic<bool> threads_correct(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&]() {
+            for (int r = 0; r < kRounds; r++) {
+                for (uint32_t letter = 'a'; letter < 'a' + kGlyphs; letter++) {
+                    if (!Draw(cached, letter)) {
+                        threads_correct = false;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Check(threads_correct, test, "bitmaps match the font");
+    Check((cache.hits() - hits) + (cache.misses() - misses) == (uint32_t)(kThreads * kRounds * kGlyphs), test,
+        "every draw counted");
+    Check(cache.misses() - misses >= (uint32_t)kGlyphs, test, "every glyph missed once");
+
+    // 4. Detach
+    test = "detach";
+    cache.DetachFont(cached);
+    Check(region->used() == 0, test, "entries freed");
+    font.static_bitmap = 1;
+    Check(cache.AttachFont(&font) == nullptr, test, "static bitmaps not attached");
+
+    return ReportChecks();
+}
@@ -0,0 +1,86 @@
+/* Just enough of the LVGL 9 font and draw buffer API for GlyphCache on the host */
+#ifndef GLYPH_CACHE_TEST_LVGL_H
+#define GLYPH_CACHE_TEST_LVGL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef enum {
+    LV_COLOR_FORMAT_A8 = 0x0E,
+} lv_color_format_t;
+
+#define LV_STRIDE_AUTO 0
+
+typedef enum {
+    LV_FONT_GLYPH_FORMAT_NONE = 0,
+    LV_FONT_GLYPH_FORMAT_A1 = 0x01,
+    LV_FONT_GLYPH_FORMAT_A2 = 0x02,
+    LV_FONT_GLYPH_FORMAT_A3 = 0x03,
+    LV_FONT_GLYPH_FORMAT_A4 = 0x04,
+    LV_FONT_GLYPH_FORMAT_A8 = 0x08,
+    LV_FONT_GLYPH_FORMAT_IMAGE = 0x19,
+} lv_font_glyph_format_t;
+
+typedef struct {
+    uint32_t cf : 8;
+    uint32_t w : 16;
+    uint32_t h : 16;
+    uint32_t stride : 16;
+} lv_image_header_t;
+
+typedef struct {
+    lv_image_header_t header;
+    uint32_t data_size;
+    uint8_t *data;
+} lv_draw_buf_t;
+
+typedef struct _lv_font_t lv_font_t;
+
+typedef struct {
+    const lv_font_t *resolved_font;
+    uint16_t adv_w;
+    uint16_t box_w;
+    uint16_t box_h;
+    lv_font_glyph_format_t format;
+    uint8_t req_raw_bitmap : 1;
+    union {
+        uint32_t index;
+        const void *src;
+    } gid;
+} lv_font_glyph_dsc_t;
+
+struct _lv_font_t {
+    bool (*get_glyph_dsc)(const lv_font_t *, lv_font_glyph_dsc_t *, uint32_t letter, uint32_t letter_next);
+    const void *(*get_glyph_bitmap)(lv_font_glyph_dsc_t *, lv_draw_buf_t *);
+    void (*release_glyph)(const lv_font_t *, lv_font_glyph_dsc_t *);
+    int32_t line_height;
+    uint8_t static_bitmap : 1;
+    const void *dsc;
+    void *user_data;
+};
+
+/* A8 rows are not padded */
+static inline lv_draw_buf_t *lv_draw_buf_create(uint32_t w, uint32_t h, lv_color_format_t cf, uint32_t stride)
+{
+    lv_draw_buf_t *draw_buf = (lv_draw_buf_t *)calloc(1, sizeof(lv_draw_buf_t));
+    if (draw_buf == NULL) {
+        return NULL;
+    }
+    draw_buf->header.cf = cf;
+    draw_buf->header.w = w;
+    draw_buf->header.h = h;
+    draw_buf->header.stride = stride != LV_STRIDE_AUTO ? stride : w;
+    draw_buf->data_size = draw_buf->header.stride * h;
+    draw_buf->data = (uint8_t *)calloc(1, draw_buf->data_size);
+    return draw_buf;
+}
+
+static inline void lv_draw_buf_destroy(lv_draw_buf_t *draw_buf)
+{
+    if (draw_buf != NULL) {
+        free(draw_buf->data);
+        free(draw_buf);
+    }
+}
+
+#endif
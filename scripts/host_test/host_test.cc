@@ -0,0 +1,213 @@
+#include "host_test.h"
+#include "esp_heap_caps.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+bool verbose = false;
+int failures = 0;
+
+void Check(bool ok, const char* test, const char* what) {
+    if (!ok) {
+        Fail(test, what);
+    }
+}
+
+void Fail(const char* test, const char* what) {
+    printf("FAIL %s: %s\n", test, what);
+    failures++;
+}
+
+int ReportChecks() {
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
+
+// Heap shim. Blocks are rounded up like the device heap does, so that the allocated size
+// of a block is not always the requested size, and counted for the tests.
+//
+// A heap given a capacity with heap_caps_test_set_capacity() is a first fit allocator over
+// a buffer of that size, so that allocations fail when it is full and its largest free
+// block shows fragmentation. The other heaps come from malloc and report no sizes
+
+struct BlockHeader {
+    size_t size;
+    size_t offset;      // From the start of the raw block to the payload
+    size_t raw_size;    // The raw block, header and alignment padding included
+};
+
+struct ModelHeap {
+    std::vector<uint8_t> storage;
+    std::map<size_t, size_t> free_blocks;   // Offset to size, in address order
+    size_t free = 0;
+    size_t min_free = 0;
+
+    bool enabled() const { return !storage.empty(); }
+
+    uint8_t* Allocate(size_t size) {
+        size = (size + HEAP_CAPS_TEST_GRANULARITY - 1) / HEAP_CAPS_TEST_GRANULARITY * HEAP_CAPS_TEST_GRANULARITY;
+        for (auto it = free_blocks.begin(); it != free_blocks.end(); ++it) {
+            if (it->second < size) {
+                continue;
+            }
+            size_t offset = it->first;
+            size_t left = it->second - size;
+            free_blocks.erase(it);
+            if (left > 0) {
+                free_blocks[offset + size] = left;
+            }
+            free -= size;
+            min_free = std::min(min_free, free);
+            return storage.data() + offset;
+        }
+        return nullptr;
+    }
+
+    void Free(uint8_t* block, size_t size) {
+        size = (size + HEAP_CAPS_TEST_GRANULARITY - 1) / HEAP_CAPS_TEST_GRANULARITY * HEAP_CAPS_TEST_GRANULARITY;
+        size_t offset = block - storage.data();
+        free += size;
+        auto next = free_blocks.lower_bound(offset);
+        if (next != free_blocks.end() && offset + size == next->first) {
+            size += next->second;
+            next = free_blocks.erase(next);
+        }
+        if (next != free_blocks.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                prev->second += size;
+                return;
+            }
+        }
+        free_blocks[offset] = size;
+    }
+
+    bool Owns(const uint8_t* block) const {
+        return enabled() && block >= storage.data() && block < storage.data() + storage.size();
+    }
+
+    size_t LargestFreeBlock() const {
+        size_t largest = 0;
+        for (auto& [offset, size] : free_blocks) {
+            largest = std::max(largest, size);
+        }
+        return largest;
+    }
+};
+
+static std::mutex heap_mutex;
+static ModelHeap internal_heap;
+static ModelHeap psram_heap;
+size_t heap_caps_test_in_use = 0;
+size_t heap_caps_test_peak = 0;
+size_t heap_caps_test_allocations = 0;
+
+static ModelHeap& HeapFor(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? psram_heap : internal_heap;
+}
+
+static BlockHeader* Header(void* ptr) {
+    return reinterpret_cast<BlockHeader*>(ptr) - 1;
+}
+
+void heap_caps_test_set_capacity(uint32_t caps, size_t capacity) {
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    auto& heap = HeapFor(caps);
+    heap.storage.assign(capacity, 0);
+    heap.free_blocks.clear();
+    if (capacity > 0) {
+        heap.free_blocks[0] = capacity;
+    }
+    heap.free = capacity;
+    heap.min_free = capacity;
+}
+
+void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+    if (alignment < alignof(BlockHeader)) {
+        alignment = alignof(BlockHeader);
+    }
+    size_t block_size = (size + HEAP_CAPS_TEST_GRANULARITY - 1) / HEAP_CAPS_TEST_GRANULARITY * HEAP_CAPS_TEST_GRANULARITY;
+    size_t raw_size = block_size + sizeof(BlockHeader) + alignment;
+
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    auto& heap = HeapFor(caps);
+    auto block = heap.enabled() ? heap.Allocate(raw_size) : static_cast<uint8_t*>(malloc(raw_size));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    uintptr_t payload = (reinterpret_cast<uintptr_t>(block) + sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+    auto ptr = reinterpret_cast<void*>(payload);
+    Header(ptr)->size = block_size;
+    Header(ptr)->offset = payload - reinterpret_cast<uintptr_t>(block);
+    Header(ptr)->raw_size = raw_size;
+
+    heap_caps_test_in_use += block_size;
+    if (heap_caps_test_in_use > heap_caps_test_peak) {
+        heap_caps_test_peak = heap_caps_test_in_use;
+    }
+    heap_caps_test_allocations++;
+    return ptr;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return heap_caps_aligned_alloc(0, size, caps);
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    auto ptr = heap_caps_malloc(n * size, caps);
+    if (ptr != nullptr) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+
+void heap_caps_free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto header = Header(ptr);
+    auto block = static_cast<uint8_t*>(ptr) - header->offset;
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    heap_caps_test_in_use -= header->size;
+    if (internal_heap.Owns(block)) {
+        internal_heap.Free(block, header->raw_size);
+    } else if (psram_heap.Owns(block)) {
+        psram_heap.Free(block, header->raw_size);
+    } else {
+        free(block);
+    }
+}
+
+size_t heap_caps_get_allocated_size(void* ptr) {
+    return Header(ptr)->size;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    return HeapFor(caps).free;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    return HeapFor(caps).min_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    return HeapFor(caps).LargestFreeBlock();
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+    std::lock_guard<std::mutex> lock(heap_mutex);
+    return HeapFor(caps).storage.size();
+}
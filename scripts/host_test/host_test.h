@@ -0,0 +1,24 @@
+/*
+ * Shared by the host tests under scripts/. Each test program counts the checks that fail
+ * and prints more detail with -v:
+ *
+ *   int main(int argc, char** argv) {
+ *       verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+ *       TestSomething();
+ *       return ReportChecks();
+ *   }
+ */
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+extern bool verbose;
+extern int failures;
+
+// Prints "FAIL <test>: <what>" and counts a failure unless ok
+void Check(bool ok, const char* test, const char* what);
+void Fail(const char* test, const char* what);
+
+// Prints the number of failed checks or "All checks passed", returns the exit code of main
+int ReportChecks();
+
+#endif // HOST_TEST_H
@@ -0,0 +1,48 @@
+/* Host replacement for the ESP-IDF heap, implemented in host_test.cc */
+#ifndef HOST_TEST_ESP_HEAP_CAPS_H
+#define HOST_TEST_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MALLOC_CAP_EXEC     (1 << 0)
+#define MALLOC_CAP_32BIT    (1 << 1)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+// Block sizes are rounded up to this, like the device heap rounds them
+#define HEAP_CAPS_TEST_GRANULARITY 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes in blocks that are not freed yet, their peak and the number of allocations
+extern size_t heap_caps_test_in_use;
+extern size_t heap_caps_test_peak;
+extern size_t heap_caps_test_allocations;
+
+// Makes the internal heap, or the PSRAM heap for caps with MALLOC_CAP_SPIRAM, a heap of
+// capacity bytes that fails when full and reports its free size and largest free block.
+// 0 goes back to malloc. Only call it while no block of that heap is allocated
+void heap_caps_test_set_capacity(uint32_t caps, size_t capacity);
+
+void* heap_caps_malloc(size_t size, uint32_t caps);
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps);
+void heap_caps_free(void* ptr);
+size_t heap_caps_get_allocated_size(void* ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_total_size(uint32_t caps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+/* Host replacement for esp_log. Errors and warnings are printed when HOST_TEST_LOG is defined */
+#ifndef HOST_TEST_ESP_LOG_H
+#define HOST_TEST_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOG_DISCARD(fmt, ...) do { if (0) fprintf(stderr, fmt, ##__VA_ARGS__); } while (0)
+
+#ifdef HOST_TEST_LOG
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define ESP_LOGE(tag, fmt, ...) ESP_LOG_DISCARD(fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+#define ESP_LOGI(tag, fmt, ...) ESP_LOG_DISCARD(fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ESP_LOG_DISCARD(fmt, ##__VA_ARGS__)
+
+#endif
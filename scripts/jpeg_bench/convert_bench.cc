@@ -0,0 +1,71 @@
+/*
+ * Megapixels per second of the pixel converters in pixel_convert.c, fast against the
+ * scalar reference, for every input format image_to_jpeg converts.
+ *
+ * Usage: convert_bench [width height [iterations]]
+ */
+#include "pixel_convert.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+// Keeps the compiler from dropping conversions whose output is never read
+static volatile uint8_t sink;
+
+static double MegapixelsPerSecond(const std::function<void()>& convert, size_t pixels, int iterations) {
+    convert();  // Warm up caches
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        convert();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (double)pixels * iterations / seconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 2 ? atoi(argv[1]) : 640;
+    int height = argc > 2 ? atoi(argv[2]) : 480;
+    int iterations = argc > 3 ? atoi(argv[3]) : 200;
+    size_t pixels = (size_t)width * height;
+
+    // Word aligned buffers, as the camera frames and the jpeg region hand out
+    std::vector<uint32_t> src_storage(pixels + 4);
+    std::vector<uint32_t> dst_storage(pixels + 4);
+    auto src = reinterpret_cast<uint8_t*>(src_storage.data());
+    auto dst = reinterpret_cast<uint8_t*>(dst_storage.data());
+    for (size_t i = 0; i < pixels * 3; i++) {
+        src[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    const uint8_t* u = src + pixels;
+    const uint8_t* v = u + pixels / 2;
+
+    struct Case {
+        const char* format;
+        const char* conversion;
+        std::function<void()> fast;
+        std::function<void()> ref;
+    };
+    Case cases[] = {
+        {"RGB565", "-> RGB888", [&] { pixel_convert_rgb565_to_rgb888(src, dst, pixels); },
+         [&] { pixel_convert_rgb565_to_rgb888_ref(src, dst, pixels); }},
+        {"UYVY", "-> YUYV", [&] { pixel_convert_swap16(src, dst, pixels); },
+         [&] { pixel_convert_swap16_ref(src, dst, pixels); }},
+        {"YUV422P", "-> YUYV", [&] { pixel_convert_yuv422p_to_yuyv(src, u, v, dst, pixels); },
+         [&] { pixel_convert_yuv422p_to_yuyv_ref(src, u, v, dst, pixels); }},
+        {"RGB565 BE", "swap", [&] { pixel_convert_swap16(src, dst, pixels); },
+         [&] { pixel_convert_swap16_ref(src, dst, pixels); }},
+    };
+
+    printf("%dx%d, %d iterations\n", width, height, iterations);
+    printf("%-10s %-10s %12s %12s %8s\n", "format", "to", "scalar MP/s", "fast MP/s", "speedup");
+    for (auto& c : cases) {
+        double ref = MegapixelsPerSecond(c.ref, pixels, iterations);
+        double fast = MegapixelsPerSecond(c.fast, pixels, iterations);
+        sink = dst[pixels / 2];
+        printf("%-10s %-10s %12.1f %12.1f %7.2fx\n", c.format, c.conversion, ref, fast, fast / ref);
+    }
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Conformance test for the pixel converters and the encoder input path of image_to_jpeg.
+ *
+ * 1. Every fast converter in pixel_convert.c must produce exactly the bytes of its _ref
+ *    scalar version, for all pixel counts up to 67 and every source / destination
+ *    alignment, without writing past the end of the output.
+ * 2. image_to_jpeg_cb() converts each MCU row as it is encoded. For every input format
+ *    its output must be byte-identical to converting the whole frame with the scalar
+ *    converters and encoding it in one go, for aligned and misaligned sources and for
+ *    heights that are not a multiple of the MCU height.
+ * 3. After the first encode, encoding the same size again must not allocate from the
+ *    jpeg memory region.
+ * 4. A source shorter than one frame of its format is rejected without output.
+ * 5. A frame whose height is not whole MCU rows is encoded in one go even when its input
+ *    and output buffers add up to more than the 2MB jpeg region budget.
+ *
+ * Usage: convert_test
+ */
+#include "image_to_jpeg.h"
+#include "pixel_convert.h"
+#include "esp_jpeg_enc.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern size_t memory_region_used;
+extern size_t memory_region_allocations;
+
+static std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes) {
+        b = (uint8_t)rng();
+    }
+    return bytes;
+}
+
+// Runs fast and reference with the given offsets and compares the outputs and guard bytes
+template <typename Convert, typename Reference>
+static void CheckConverter(const char* name, size_t max_pixels, size_t in_bpp, size_t out_bpp, Convert convert,
+                           Reference reference) {
+    const size_t kGuard = 16;
+    for (size_t pixels = 0; pixels <= max_pixels; pixels++) {
+        for (size_t src_offset = 0; src_offset < 4; src_offset++) {
+            for (size_t dst_offset = 0; dst_offset < 4; dst_offset++) {
+                auto src = RandomBytes(pixels * in_bpp + 8, (uint32_t)(pixels * 16 + src_offset * 4 + dst_offset));
+                std::vector<uint8_t> fast(pixels * out_bpp + 8 + kGuard, 0xA5);
+                std::vector<uint8_t> ref(fast);
+                convert(src.data() + src_offset, fast.data() + dst_offset, pixels);
+                reference(src.data() + src_offset, ref.data() + dst_offset, pixels);
+                if (fast != ref) {
+                    char detail[96];
+                    snprintf(detail, sizeof(detail), "%zu pixels, src offset %zu, dst offset %zu", pixels,
+                             src_offset, dst_offset);
+                    Fail(name, detail);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void CheckConverters() {
+    CheckConverter("swap16", 67, 2, 2, pixel_convert_swap16, pixel_convert_swap16_ref);
+    CheckConverter("rgb565_to_rgb888", 67, 2, 3, pixel_convert_rgb565_to_rgb888, pixel_convert_rgb565_to_rgb888_ref);
+
+    // Planes are laid out back to back in src, pixels must be even
+    auto planar = [](auto convert) {
+        return [convert](const uint8_t* src, uint8_t* dst, size_t pixels) {
+            pixels &= ~(size_t)1;
+            convert(src, src + pixels, src + pixels + pixels / 2, dst, pixels);
+        };
+    };
+    CheckConverter("yuv422p_to_yuyv", 67, 2, 2, planar(pixel_convert_yuv422p_to_yuyv),
+                   planar(pixel_convert_yuv422p_to_yuyv_ref));
+}
+
+struct Format {
+    const char* name;
+    v4l2_pix_fmt_t v4l2;
+    size_t bytes_per_pixel;   // Source bytes per pixel
+};
+
+static const Format kFormats[] = {
+    {"GREY", V4L2_PIX_FMT_GREY, 1},
+    {"YUYV", V4L2_PIX_FMT_YUYV, 2},
+    {"UYVY", V4L2_PIX_FMT_UYVY, 2},
+    {"YUV422P", V4L2_PIX_FMT_YUV422P, 2},
+    {"RGB24", V4L2_PIX_FMT_RGB24, 3},
+    {"RGB565", V4L2_PIX_FMT_RGB565, 2},
+};
+
+// A smooth image with some edges, random bytes would make every format compress the same
+static std::vector<uint8_t> MakeImage(const Format& format, int width, int height) {
+    std::vector<uint8_t> image((size_t)width * height * format.bytes_per_pixel);
+    for (size_t i = 0; i < image.size(); i++) {
+        size_t pixel = i / format.bytes_per_pixel;
+        int x = (int)(pixel % width), y = (int)(pixel / width);
+        image[i] = (uint8_t)(x * 3 + y * 2 + (i % format.bytes_per_pixel) * 70 + ((x / 16 + y / 16) % 2) * 60);
+    }
+    return image;
+}
+
+// The whole frame converted with the scalar converters, as image_to_jpeg did before
+static std::string EncodeReference(const Format& format, const uint8_t* src, int width, int height) {
+    size_t pixels = (size_t)width * height;
+    std::vector<uint8_t> input;
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    switch (format.v4l2) {
+        case V4L2_PIX_FMT_GREY:
+            input.assign(src, src + pixels);
+            cfg.src_type = JPEG_PIXEL_FORMAT_GRAY;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            input.assign(src, src + pixels * 2);
+            cfg.src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+            break;
+        case V4L2_PIX_FMT_UYVY:
+            input.resize(pixels * 2);
+            pixel_convert_swap16_ref(src, input.data(), pixels);
+            cfg.src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+            break;
+        case V4L2_PIX_FMT_YUV422P:
+            input.resize(pixels * 2);
+            pixel_convert_yuv422p_to_yuyv_ref(src, src + pixels, src + pixels + pixels / 2, input.data(), pixels);
+            cfg.src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            input.assign(src, src + pixels * 3);
+            cfg.src_type = JPEG_PIXEL_FORMAT_RGB888;
+            break;
+        default:
+            input.resize(pixels * 3);
+            pixel_convert_rgb565_to_rgb888_ref(src, input.data(), pixels);
+            cfg.src_type = JPEG_PIXEL_FORMAT_RGB888;
+            break;
+    }
+    cfg.width = width;
+    cfg.height = height;
+    cfg.subsampling = cfg.src_type == JPEG_PIXEL_FORMAT_GRAY ? JPEG_SUBSAMPLE_GRAY : JPEG_SUBSAMPLE_420;
+    cfg.quality = 80;
+
+    jpeg_enc_handle_t h = nullptr;
+    if (jpeg_enc_open(&cfg, &h) != JPEG_ERR_OK) {
+        return std::string();
+    }
+    std::vector<uint8_t> out(pixels * 3 + 64 * 1024);
+    int out_len = 0;
+    jpeg_error_t ret = jpeg_enc_process(h, input.data(), (int)input.size(), out.data(), (int)out.size(), &out_len);
+    jpeg_enc_close(h);
+    return ret == JPEG_ERR_OK ? std::string((const char*)out.data(), out_len) : std::string();
+}
+
+static size_t AppendOutput(void* arg, size_t index, const void* data, size_t len) {
+    (void)index;
+    if (data != nullptr && len > 0) {
+        static_cast<std::string*>(arg)->append(static_cast<const char*>(data), len);
+    }
+    return len;
+}
+
+static void CheckEncoder() {
+    static const int kSizes[][2] = {{320, 240}, {240, 320}, {96, 64}, {284, 76}, {160, 8}};
+    for (auto& format : kFormats) {
+        for (auto& size : kSizes) {
+            int width = size[0], height = size[1];
+            auto image = MakeImage(format, width, height);
+            std::string expected = EncodeReference(format, image.data(), width, height);
+
+            // Aligned sources can be encoded in place, misaligned ones are copied
+            for (size_t offset : {0, 1}) {
+                uint8_t* storage = (uint8_t*)aligned_alloc(16, (image.size() + 16 + 15) & ~(size_t)15);
+                memcpy(storage + offset, image.data(), image.size());
+                std::string actual;
+                bool ok = image_to_jpeg_cb(storage + offset, image.size(), width, height, format.v4l2, 80,
+                                           AppendOutput, &actual);
+                free(storage);
+
+                char detail[96];
+                snprintf(detail, sizeof(detail), "%dx%d, source offset %zu", width, height, offset);
+                if (!ok || expected.empty()) {
+                    Fail(format.name, detail);
+                } else if (actual != expected) {
+                    Fail(format.name, (std::string(detail) + ", JPEG differs").c_str());
+                }
+            }
+        }
+    }
+}
+
+static void CheckReuse() {
+    for (auto& format : kFormats) {
+        auto image = MakeImage(format, 320, 240);
+        std::string jpeg;
+        image_to_jpeg_cb(image.data(), image.size(), 320, 240, format.v4l2, 80, AppendOutput, &jpeg);
+        size_t before = memory_region_allocations;
+        image_to_jpeg_cb(image.data(), image.size(), 320, 240, format.v4l2, 80, AppendOutput, &jpeg);
+        if (memory_region_allocations != before) {
+            Fail(format.name, "second encode of the same size allocated");
+        }
+    }
+    image_to_jpeg_release_buffers();
+    if (memory_region_used != 0) {
+        Fail("release", "buffers left in the jpeg region");
+    }
+}
+
+static void CheckShortSource() {
+    for (auto& format : kFormats) {
+        auto image = MakeImage(format, 320, 240);
+        std::string jpeg;
+        bool ok = image_to_jpeg_cb(image.data(), image.size() - 1, 320, 240, format.v4l2, 80, AppendOutput, &jpeg);
+        Check(!ok && jpeg.empty(), format.name, "short source rejected");
+    }
+}
+
+static void CheckLargeFrame() {
+    // 600 lines are not whole 16 line MCU rows: 1.44MB of RGB888 input and 0.78MB of output
+    const Format& format = kFormats[5];
+    auto image = MakeImage(format, 800, 600);
+    std::string expected = EncodeReference(format, image.data(), 800, 600);
+    std::string jpeg;
+    bool ok = image_to_jpeg_cb(image.data(), image.size(), 800, 600, format.v4l2, 80, AppendOutput, &jpeg);
+    Check(ok && jpeg == expected, "large frame", "800x600 RGB565 encoded");
+    image_to_jpeg_release_buffers();
+    Check(memory_region_used == 0, "large frame", "frame buffers freed");
+}
+
+int main() {
+    CheckConverters();
+    CheckEncoder();
+    CheckReuse();
+    CheckShortSource();
+    CheckLargeFrame();
+    return ReportChecks();
+}
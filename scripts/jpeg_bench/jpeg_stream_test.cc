@@ -0,0 +1,174 @@
+/*
+ * Checks strip encoding of screen snapshots against the whole frame path.
+ *
+ * The whole frame path is what LvglDisplay::SnapshotToJpeg did before: a full RGB565
+ * snapshot, byte swapped in place and handed to image_to_jpeg_cb(). The strip path hands
+ * the same screen to image_to_jpeg_rows_cb() one MCU row at a time. Both JPEGs are
+ * decoded and must give the same pixels. Heights that are not a multiple of the MCU height
+ * are encoded as one frame by both paths, and must give the same JPEG. The peak memory of
+ * both paths is reported, counting the snapshot buffer and everything allocated from the
+ * jpeg memory region.
+ *
+ * Usage: jpeg_stream_test
+ */
+#include "image_to_jpeg.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+extern size_t memory_region_used;
+extern size_t memory_region_peak;
+
+struct Screen {
+    int width;
+    int height;
+    std::vector<uint16_t> pixels;   // Native RGB565, as LVGL renders it
+};
+
+// A UI-like screen: gradient background, flat bubbles and thin high contrast strokes like text
+static Screen MakeScreen(int width, int height) {
+    Screen screen{width, height, std::vector<uint16_t>((size_t)width * height)};
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint16_t r = x * 31 / (width > 1 ? width - 1 : 1);
+            uint16_t g = y * 63 / (height > 1 ? height - 1 : 1);
+            uint16_t b = (x + y) & 31;
+            uint16_t c = (r << 11) | (g << 5) | b;
+            if ((y / 24) % 3 == 1 && x > width / 8 && x < width * 3 / 4) {
+                c = 0x95EC & 0xFFFF;
+                if ((y % 24) > 8 && (y % 24) < 16 && ((x / 3) % 4) != 0) {
+                    c = 0x0000;
+                }
+            }
+            screen.pixels[(size_t)y * width + x] = c;
+        }
+    }
+    return screen;
+}
+
+static size_t AppendOutput(void* arg, size_t index, const void* data, size_t len) {
+    (void)index;
+    auto output = static_cast<std::vector<std::string>*>(arg);
+    if (data != nullptr && len > 0) {
+        output->emplace_back(static_cast<const char*>(data), len);
+    }
+    return len;
+}
+
+struct StripSource {
+    const Screen* screen;
+    int next_y;
+    bool in_order;
+};
+
+static bool RenderStrip(void* arg, uint16_t y, uint16_t lines, uint8_t* dst) {
+    auto source = static_cast<StripSource*>(arg);
+    const Screen& screen = *source->screen;
+    source->in_order &= y == source->next_y && lines > 0 && y + lines <= screen.height;
+    source->next_y = y + lines;
+    // Render, then swap bytes, as LvglDisplay::SnapshotToJpeg does per strip
+    auto out = reinterpret_cast<uint16_t*>(dst);
+    const uint16_t* in = &screen.pixels[(size_t)y * screen.width];
+    for (size_t i = 0; i < (size_t)screen.width * lines; i++) {
+        out[i] = __builtin_bswap16(in[i]);
+    }
+    return true;
+}
+
+static std::vector<uint8_t> Decode(const std::string& jpeg, int* width, int* height) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (const unsigned char*)jpeg.data(), jpeg.size());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    std::vector<uint8_t> pixels((size_t)cinfo.output_width * cinfo.output_height * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &pixels[(size_t)cinfo.output_scanline * cinfo.output_width * 3];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return pixels;
+}
+
+static std::string Join(const std::vector<std::string>& chunks) {
+    std::string joined;
+    for (auto& chunk : chunks) {
+        joined += chunk;
+    }
+    return joined;
+}
+
+int main() {
+    // Panels of 280, 135 and 360 lines are not a whole number of 16 line MCU rows and are
+    // encoded as one frame, which must give the same JPEG as the whole frame path
+    static const int kSizes[][2] = {{240, 320}, {320, 240}, {240, 240}, {284, 76}, {128, 8}, {480, 800},
+        {240, 280}, {240, 135}, {360, 360}};
+    int failures = 0;
+
+    printf("%-9s %14s %14s %10s %7s  %s\n", "size", "frame peak", "strip peak", "jpeg bytes", "chunks", "result");
+    for (auto& size : kSizes) {
+        Screen screen = MakeScreen(size[0], size[1]);
+        size_t frame_bytes = screen.pixels.size() * 2;
+
+        // Whole frame: snapshot, swap in place, encode. Kept buffers are dropped first so
+        // that both peaks include them
+        image_to_jpeg_release_buffers();
+        memory_region_peak = memory_region_used;
+        std::vector<uint16_t> snapshot(screen.pixels);
+        for (auto& pixel : snapshot) {
+            pixel = __builtin_bswap16(pixel);
+        }
+        std::vector<std::string> frame_chunks;
+        bool frame_ok = image_to_jpeg_cb((uint8_t*)snapshot.data(), frame_bytes, screen.width, screen.height,
+            V4L2_PIX_FMT_RGB565, 80, AppendOutput, &frame_chunks);
+        size_t frame_peak = frame_bytes + memory_region_peak;
+
+        // Strips straight into the encoder
+        image_to_jpeg_release_buffers();
+        memory_region_peak = memory_region_used;
+        StripSource source{&screen, 0, true};
+        std::vector<std::string> strip_chunks;
+        bool strip_ok = image_to_jpeg_rows_cb(screen.width, screen.height, V4L2_PIX_FMT_RGB565, 80, RenderStrip,
+            &source, AppendOutput, &strip_chunks);
+        size_t strip_peak = memory_region_peak;
+
+        const char* result = "ok";
+        std::string frame_jpeg = Join(frame_chunks);
+        std::string strip_jpeg = Join(strip_chunks);
+        if (!frame_ok || !strip_ok) {
+            result = "encode failed";
+        } else if (!source.in_order || source.next_y != screen.height) {
+            result = "strips out of order";
+        } else {
+            int frame_w, frame_h, strip_w, strip_h;
+            auto frame_pixels = Decode(frame_jpeg, &frame_w, &frame_h);
+            auto strip_pixels = Decode(strip_jpeg, &strip_w, &strip_h);
+            if (frame_w != strip_w || frame_h != strip_h || frame_pixels != strip_pixels) {
+                result = "decoded pixels differ";
+            } else if (screen.height % 16 != 0 && (strip_jpeg != frame_jpeg || strip_chunks.size() != 1)) {
+                result = "not encoded as one frame";
+            } else if (image_to_jpeg_release_buffers(), memory_region_used != 0) {
+                result = "leaked";
+            }
+        }
+        if (strcmp(result, "ok") != 0) {
+            failures++;
+        }
+
+        char name[16];
+        snprintf(name, sizeof(name), "%dx%d", screen.width, screen.height);
+        printf("%-9s %14zu %14zu %10zu %7zu  %s\n", name, frame_peak, strip_peak, strip_jpeg.size(),
+            strip_chunks.size(), result);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+/*
+ * Bytes and milliseconds per photo of image_to_jpeg_crop_cb(), for camera frame sizes
+ * encoded at full resolution, downscaled to a few longest-side limits and centre cropped.
+ * The frame is a synthetic scene with gradients, edges and noise, as a sensor gives.
+ *
+ * Usage: scale_bench [width height [iterations]]
+ */
+#include "image_scale.h"
+#include "image_to_jpeg.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static size_t CountOutput(void* arg, size_t index, const void* data, size_t len) {
+    (void)index;
+    (void)data;
+    *static_cast<size_t*>(arg) += len;
+    return len;
+}
+
+// Gradients, blocks and sensor noise, in YUYV or RGB565
+static std::vector<uint8_t> MakeFrame(v4l2_pix_fmt_t format, int width, int height) {
+    std::mt19937 rng(1);
+    std::vector<uint8_t> frame((size_t)width * height * 2);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int noise = (int)(rng() % 9) - 4;
+            int luma = (x * 255 / width + y * 128 / height + ((x / 40 + y / 40) % 2) * 50 + noise) & 0xFF;
+            uint8_t* p = &frame[((size_t)y * width + x) * 2];
+            if (format == V4L2_PIX_FMT_YUYV) {
+                p[0] = (uint8_t)luma;
+                p[1] = (uint8_t)(x % 2 == 0 ? 128 + (x * 64 / width) : 128 - (y * 64 / height));
+            } else {
+                uint16_t v = (uint16_t)((luma >> 3) << 11 | ((y * 63 / height) << 5) | ((x * 31 / width) & 0x1F));
+                p[0] = (uint8_t)v;
+                p[1] = (uint8_t)(v >> 8);
+            }
+        }
+    }
+    return frame;
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 2 ? atoi(argv[1]) : 1280;
+    int height = argc > 2 ? atoi(argv[2]) : 720;
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+
+    struct Policy {
+        const char* name;
+        uint16_t max_side;
+        bool centre;
+    };
+    const Policy policies[] = {
+        {"full", 0, false},
+        {"max 800", 800, false},
+        {"max 640", 640, false},
+        {"max 480", 480, false},
+        {"max 320", 320, false},
+        {"centre, max 640", 640, true},
+    };
+
+    printf("%dx%d, quality 80, %d iterations\n", width, height, iterations);
+    printf("%-8s %-16s %10s %10s %8s %8s\n", "format", "policy", "size", "bytes", "ms", "bytes %");
+    for (v4l2_pix_fmt_t format : {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_RGB565}) {
+        auto frame = MakeFrame(format, width, height);
+        size_t full_bytes = 0;
+        for (auto& policy : policies) {
+            // The centre crop is the middle half of the width and the height
+            jpeg_crop_t crop = {0, 0, (uint16_t)width, (uint16_t)height};
+            if (policy.centre) {
+                crop = {(uint16_t)(width / 4), (uint16_t)(height / 4), (uint16_t)(width / 2), (uint16_t)(height / 2)};
+            }
+            uint16_t out_width = 0, out_height = 0;
+            image_scale_fit(crop.width, crop.height, policy.max_side, &out_width, &out_height);
+
+            size_t bytes = 0;
+            image_to_jpeg_crop_cb(frame.data(), frame.size(), width, height, format, &crop, out_width, out_height, 80,
+                                  CountOutput, &bytes);  // Warm up the scratch buffers
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                bytes = 0;
+                image_to_jpeg_crop_cb(frame.data(), frame.size(), width, height, format, &crop, out_width, out_height,
+                                      80, CountOutput, &bytes);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+                        iterations;
+            if (full_bytes == 0) {
+                full_bytes = bytes;
+            }
+            char size[16];
+            snprintf(size, sizeof(size), "%ux%u", out_width, out_height);
+            printf("%-8s %-16s %10s %10zu %8.2f %7.1f%%\n", format == V4L2_PIX_FMT_YUYV ? "YUYV" : "RGB565",
+                   policy.name, size, bytes, ms, 100.0 * bytes / full_bytes);
+        }
+    }
+    image_to_jpeg_release_buffers();
+    return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Conformance test for the crop and downscale path of image_to_jpeg.
+ *
+ * 1. image_scale_rows() must produce exactly the bytes of image_scale_rows_ref() for every
+ *    input format, crop, output size and row range, without writing past the rows.
+ * 2. The output is the rounded box average: halving an image averages each 2x2 block,
+ *    a flat image stays flat, an unscaled crop copies the pixels and grey YUYV stays grey.
+ * 3. image_scale_fit() keeps the aspect ratio and never scales up.
+ * 4. image_to_jpeg_crop_cb() scales each MCU row as it is encoded. Its output must be
+ *    byte-identical to scaling the whole frame with the reference and encoding it in one
+ *    go. Without crop and scaling it is image_to_jpeg_cb(). A crop outside the frame fails.
+ * 5. After the first encode, encoding the same crop again must not allocate from the jpeg
+ *    memory region.
+ *
+ * Usage: scale_test
+ */
+#include "image_scale.h"
+#include "image_to_jpeg.h"
+#include "esp_jpeg_enc.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern size_t memory_region_allocations;
+
+struct Format {
+    const char* name;
+    v4l2_pix_fmt_t v4l2;
+    size_t bytes_per_pixel;   // Source bytes per pixel
+    size_t out_bytes_per_pixel;
+};
+
+static const Format kFormats[] = {
+    {"GREY", V4L2_PIX_FMT_GREY, 1, 1},
+    {"YUYV", V4L2_PIX_FMT_YUYV, 2, 3},
+    {"RGB24", V4L2_PIX_FMT_RGB24, 3, 3},
+    {"RGB565", V4L2_PIX_FMT_RGB565, 2, 3},
+};
+
+static std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes) {
+        b = (uint8_t)rng();
+    }
+    return bytes;
+}
+
+// A smooth image with some edges, like a camera frame
+static std::vector<uint8_t> MakeImage(const Format& format, int width, int height) {
+    std::vector<uint8_t> image((size_t)width * height * format.bytes_per_pixel);
+    for (size_t i = 0; i < image.size(); i++) {
+        size_t pixel = i / format.bytes_per_pixel;
+        int x = (int)(pixel % width), y = (int)(pixel / width);
+        image[i] = (uint8_t)(x * 3 + y * 2 + (i % format.bytes_per_pixel) * 70 + ((x / 16 + y / 16) % 2) * 60);
+    }
+    return image;
+}
+
+// The rows of the scaled image, by the reference or by the row scaler in pieces of `step` rows
+static std::vector<uint8_t> Scale(const Format& format, const std::vector<uint8_t>& src, int width, int height,
+                                  jpeg_crop_t crop, int dst_width, int dst_height, bool reference, int step,
+                                  bool* guard_ok = nullptr) {
+    const size_t kGuard = 16;
+    std::vector<uint32_t> acc(image_scale_acc_size(dst_width) / sizeof(uint32_t) + 4, 0xDEADBEEF);
+    image_scaler_t scaler;
+    std::vector<uint8_t> out((size_t)dst_width * dst_height * format.out_bytes_per_pixel + kGuard, 0xA5);
+    if (!image_scale_init(&scaler, src.data(), width, height, format.v4l2, crop.x, crop.y, crop.width, crop.height,
+                          dst_width, dst_height, acc.data())) {
+        return std::vector<uint8_t>();
+    }
+    size_t row_size = (size_t)dst_width * format.out_bytes_per_pixel;
+    for (int y = 0; y < dst_height; y += step) {
+        int lines = std::min(step, dst_height - y);
+        if (reference) {
+            image_scale_rows_ref(&scaler, y, lines, out.data() + y * row_size);
+        } else {
+            image_scale_rows(&scaler, y, lines, out.data() + y * row_size);
+        }
+    }
+    if (guard_ok != nullptr) {
+        *guard_ok = true;
+        for (size_t i = out.size() - kGuard; i < out.size(); i++) {
+            *guard_ok = *guard_ok && out[i] == 0xA5;
+        }
+    }
+    out.resize(out.size() - kGuard);
+    return out;
+}
+
+static void CheckScaler() {
+    struct Case {
+        int width, height;
+        jpeg_crop_t crop;
+        int dst_width, dst_height;
+    };
+    static const Case kCases[] = {
+        {64, 48, {0, 0, 64, 48}, 32, 24},
+        {64, 48, {0, 0, 64, 48}, 64, 48},
+        {64, 48, {0, 0, 64, 48}, 1, 1},
+        {64, 48, {0, 0, 64, 48}, 27, 19},
+        {64, 48, {0, 0, 64, 48}, 63, 47},
+        {64, 48, {5, 3, 33, 21}, 10, 7},
+        {64, 48, {7, 1, 57, 47}, 57, 47},
+        {71, 37, {16, 8, 32, 16}, 17, 11},
+        {71, 37, {1, 0, 70, 37}, 40, 20},
+        {320, 240, {0, 0, 320, 240}, 160, 120},
+        {320, 240, {80, 60, 160, 120}, 100, 75},
+    };
+    uint32_t seed = 1;
+    for (auto& format : kFormats) {
+        for (auto& c : kCases) {
+            auto src = RandomBytes((size_t)c.width * c.height * format.bytes_per_pixel, seed++);
+            auto expected = Scale(format, src, c.width, c.height, c.crop, c.dst_width, c.dst_height, true, c.dst_height);
+            for (int step : {1, 3, 16, 1000}) {
+                bool guard_ok = false;
+                auto actual = Scale(format, src, c.width, c.height, c.crop, c.dst_width, c.dst_height, false, step,
+                                    &guard_ok);
+                char detail[128];
+                snprintf(detail, sizeof(detail), "%dx%d crop %ux%u+%u+%u to %dx%d, %d rows at a time", c.width,
+                         c.height, c.crop.width, c.crop.height, c.crop.x, c.crop.y, c.dst_width, c.dst_height, step);
+                if (expected.empty() || actual != expected) {
+                    Fail(format.name, detail);
+                    break;
+                }
+                if (!guard_ok) {
+                    Fail(format.name, (std::string(detail) + ", wrote past the rows").c_str());
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void CheckAverages() {
+    // Halving RGB24 averages each 2x2 block, rounded
+    const Format& rgb = kFormats[2];
+    auto src = RandomBytes(8 * 6 * 3, 42);
+    auto half = Scale(rgb, src, 8, 6, {0, 0, 8, 6}, 4, 3, false, 3);
+    bool ok = !half.empty();
+    for (int y = 0; ok && y < 3; y++) {
+        for (int x = 0; x < 4; x++) {
+            for (int c = 0; c < 3; c++) {
+                int sum = 0;
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        sum += src[((y * 2 + dy) * 8 + x * 2 + dx) * 3 + c];
+                    }
+                }
+                ok = ok && half[(y * 4 + x) * 3 + c] == (sum + 2) / 4;
+            }
+        }
+    }
+    if (!ok) {
+        Fail("average", "halving is not the 2x2 mean");
+    }
+
+    // An unscaled crop copies the pixels
+    auto crop = Scale(rgb, src, 8, 6, {3, 2, 4, 3}, 4, 3, false, 1);
+    ok = !crop.empty();
+    for (int y = 0; ok && y < 3; y++) {
+        ok = memcmp(&crop[y * 4 * 3], &src[((y + 2) * 8 + 3) * 3], 4 * 3) == 0;
+    }
+    if (!ok) {
+        Fail("average", "unscaled crop differs from the source");
+    }
+
+    // A flat RGB565 image stays flat
+    const Format& rgb565 = kFormats[3];
+    std::vector<uint8_t> flat(50 * 30 * 2);
+    for (size_t i = 0; i < flat.size(); i += 2) {
+        flat[i] = 0x34;
+        flat[i + 1] = 0xA6;   // 0xA634: R 20, G 49, B 20 -> 165 199 165
+    }
+    auto small = Scale(rgb565, flat, 50, 30, {0, 0, 50, 30}, 13, 7, false, 7);
+    ok = !small.empty();
+    for (size_t i = 0; ok && i < small.size(); i += 3) {
+        ok = small[i] == 165 && small[i + 1] == 199 && small[i + 2] == 165;
+    }
+    if (!ok) {
+        Fail("average", "flat RGB565 image changed");
+    }
+
+    // YUYV with neutral chroma is grey
+    const Format& yuyv = kFormats[1];
+    std::vector<uint8_t> grey(32 * 8 * 2);
+    for (size_t i = 0; i < grey.size(); i += 4) {
+        grey[i] = (uint8_t)(i / 4 * 7);
+        grey[i + 1] = 128;
+        grey[i + 2] = (uint8_t)(i / 4 * 7 + 3);
+        grey[i + 3] = 128;
+    }
+    auto rgb_grey = Scale(yuyv, grey, 32, 8, {0, 0, 32, 8}, 11, 3, false, 3);
+    ok = !rgb_grey.empty();
+    for (size_t i = 0; ok && i < rgb_grey.size(); i += 3) {
+        ok = rgb_grey[i] == rgb_grey[i + 1] && rgb_grey[i + 1] == rgb_grey[i + 2];
+    }
+    if (!ok) {
+        Fail("average", "grey YUYV is not grey");
+    }
+}
+
+static void CheckFit() {
+    struct Case {
+        uint16_t width, height, max_side, out_width, out_height;
+    };
+    static const Case kCases[] = {
+        {1280, 720, 640, 640, 360},
+        {720, 1280, 640, 360, 640},
+        {640, 480, 640, 640, 480},
+        {320, 240, 640, 320, 240},
+        {1600, 1200, 500, 500, 375},
+        {1920, 1080, 0, 1920, 1080},
+        {1000, 3, 100, 100, 1},
+    };
+    for (auto& c : kCases) {
+        uint16_t w = 0, h = 0;
+        image_scale_fit(c.width, c.height, c.max_side, &w, &h);
+        if (w != c.out_width || h != c.out_height) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "%ux%u max %u gave %ux%u", c.width, c.height, c.max_side, w, h);
+            Fail("fit", detail);
+        }
+    }
+}
+
+static size_t AppendOutput(void* arg, size_t index, const void* data, size_t len) {
+    (void)index;
+    if (data != nullptr && len > 0) {
+        static_cast<std::string*>(arg)->append(static_cast<const char*>(data), len);
+    }
+    return len;
+}
+
+// The reference scaled frame encoded in one go
+static std::string EncodeReference(const Format& format, const std::vector<uint8_t>& src, int width, int height,
+                                   jpeg_crop_t crop, int dst_width, int dst_height) {
+    auto scaled = Scale(format, src, width, height, crop, dst_width, dst_height, true, dst_height);
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = dst_width;
+    cfg.height = dst_height;
+    cfg.src_type = format.out_bytes_per_pixel == 1 ? JPEG_PIXEL_FORMAT_GRAY : JPEG_PIXEL_FORMAT_RGB888;
+    cfg.subsampling = cfg.src_type == JPEG_PIXEL_FORMAT_GRAY ? JPEG_SUBSAMPLE_GRAY : JPEG_SUBSAMPLE_420;
+    cfg.quality = 80;
+
+    jpeg_enc_handle_t h = nullptr;
+    if (scaled.empty() || jpeg_enc_open(&cfg, &h) != JPEG_ERR_OK) {
+        return std::string();
+    }
+    std::vector<uint8_t> out(scaled.size() + 64 * 1024);
+    int out_len = 0;
+    jpeg_error_t ret = jpeg_enc_process(h, scaled.data(), (int)scaled.size(), out.data(), (int)out.size(), &out_len);
+    jpeg_enc_close(h);
+    return ret == JPEG_ERR_OK ? std::string((const char*)out.data(), out_len) : std::string();
+}
+
+static void CheckEncoder() {
+    struct Case {
+        int width, height;
+        jpeg_crop_t crop;
+        int dst_width, dst_height;
+    };
+    static const Case kCases[] = {
+        {640, 480, {0, 0, 0, 0}, 320, 240},         // Whole frame, height a multiple of the MCU
+        {640, 480, {0, 0, 0, 0}, 213, 160},
+        {640, 480, {160, 120, 320, 240}, 320, 240}, // Centre crop, not scaled
+        {640, 480, {101, 33, 300, 301}, 150, 150},
+        {320, 240, {0, 0, 320, 240}, 100, 75},      // Height not a multiple of the MCU
+    };
+    for (auto& format : kFormats) {
+        for (auto& c : kCases) {
+            auto image = MakeImage(format, c.width, c.height);
+            jpeg_crop_t crop = c.crop.width ? c.crop : jpeg_crop_t{0, 0, (uint16_t)c.width, (uint16_t)c.height};
+            std::string expected = EncodeReference(format, image, c.width, c.height, crop, c.dst_width, c.dst_height);
+            std::string actual;
+            bool ok = image_to_jpeg_crop_cb(image.data(), image.size(), c.width, c.height, format.v4l2, &c.crop,
+                                            c.dst_width, c.dst_height, 80, AppendOutput, &actual);
+            char detail[128];
+            snprintf(detail, sizeof(detail), "%dx%d crop %ux%u+%u+%u to %dx%d", c.width, c.height, crop.width,
+                     crop.height, crop.x, crop.y, c.dst_width, c.dst_height);
+            if (!ok || expected.empty()) {
+                Fail(format.name, detail);
+            } else if (actual != expected) {
+                Fail(format.name, (std::string(detail) + ", JPEG differs").c_str());
+            }
+        }
+
+        // No crop and no scaling is the plain encoder
+        auto image = MakeImage(format, 320, 240);
+        std::string plain, unscaled;
+        image_to_jpeg_cb(image.data(), image.size(), 320, 240, format.v4l2, 80, AppendOutput, &plain);
+        image_to_jpeg_crop_cb(image.data(), image.size(), 320, 240, format.v4l2, nullptr, 320, 240, 80, AppendOutput,
+                              &unscaled);
+        if (plain.empty() || plain != unscaled) {
+            Fail(format.name, "unscaled encode differs from image_to_jpeg_cb");
+        }
+
+        // A crop outside the frame or an output larger than the crop fails
+        jpeg_crop_t outside = {200, 100, 200, 200};
+        jpeg_crop_t small = {0, 0, 100, 100};
+        std::string ignored;
+        if (image_to_jpeg_crop_cb(image.data(), image.size(), 320, 240, format.v4l2, &outside, 100, 100, 80,
+                                  AppendOutput, &ignored) ||
+            image_to_jpeg_crop_cb(image.data(), image.size(), 320, 240, format.v4l2, &small, 200, 200, 80,
+                                  AppendOutput, &ignored)) {
+            Fail(format.name, "invalid crop accepted");
+        }
+    }
+}
+
+static void CheckReuse() {
+    for (auto& format : kFormats) {
+        auto image = MakeImage(format, 640, 480);
+        jpeg_crop_t crop = {80, 0, 480, 480};
+        std::string jpeg;
+        image_to_jpeg_crop_cb(image.data(), image.size(), 640, 480, format.v4l2, &crop, 240, 240, 80, AppendOutput,
+                              &jpeg);
+        size_t before = memory_region_allocations;
+        image_to_jpeg_crop_cb(image.data(), image.size(), 640, 480, format.v4l2, &crop, 240, 240, 80, AppendOutput,
+                              &jpeg);
+        if (memory_region_allocations != before) {
+            Fail(format.name, "second scaled encode of the same size allocated");
+        }
+    }
+    image_to_jpeg_release_buffers();
+}
+
+int main() {
+    CheckScaler();
+    CheckAverages();
+    CheckFit();
+    CheckEncoder();
+    CheckReuse();
+    return ReportChecks();
+}
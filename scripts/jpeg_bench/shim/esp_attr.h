@@ -0,0 +1,3 @@
+#ifndef JPEG_BENCH_ESP_ATTR_H
+#define JPEG_BENCH_ESP_ATTR_H
+#endif
@@ -0,0 +1,45 @@
+/* The parts of esp_new_jpeg's common header used by image_to_jpeg */
+#ifndef JPEG_BENCH_ESP_JPEG_COMMON_H
+#define JPEG_BENCH_ESP_JPEG_COMMON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    JPEG_PIXEL_FORMAT_GRAY,
+    JPEG_PIXEL_FORMAT_RGB888,
+    JPEG_PIXEL_FORMAT_RGBA,
+    JPEG_PIXEL_FORMAT_YCbYCr,
+} jpeg_pixel_format_t;
+
+typedef enum {
+    JPEG_SUBSAMPLE_GRAY,
+    JPEG_SUBSAMPLE_420,
+    JPEG_SUBSAMPLE_422,
+    JPEG_SUBSAMPLE_444,
+} jpeg_subsampling_t;
+
+typedef enum {
+    JPEG_ROTATE_0D,
+    JPEG_ROTATE_90D,
+    JPEG_ROTATE_180D,
+    JPEG_ROTATE_270D,
+} jpeg_rotate_t;
+
+typedef enum {
+    JPEG_ERR_OK = 0,
+    JPEG_ERR_FAIL = -1,
+    JPEG_ERR_NO_MEM = -2,
+    JPEG_ERR_NO_MORE_DATA = -3,
+    JPEG_ERR_INVALID_PARAM = -4,
+    JPEG_ERR_BAD_DATA = -5,
+    JPEG_ERR_UNSUPPORT_FMT = -6,
+    JPEG_ERR_UNSUPPORT_STD = -7,
+} jpeg_error_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
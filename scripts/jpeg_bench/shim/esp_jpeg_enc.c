@@ -0,0 +1,196 @@
+/* esp_new_jpeg encoder API on top of libjpeg, see esp_jpeg_enc.h */
+#include "esp_jpeg_enc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jpeglib.h>
+
+typedef struct {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    struct jpeg_destination_mgr dest;
+    jpeg_enc_config_t config;
+    int components;       // libjpeg input components
+    int bytes_per_pixel;  // esp_new_jpeg input bytes per pixel
+    uint8_t *row;         // YCbYCr input expanded to YCbCr for libjpeg
+    bool started;
+    bool finished;
+    bool overflow;
+} host_jpeg_enc_t;
+
+/* Output goes to the buffer of the current call, running out of it is an error */
+static void init_destination(j_compress_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+static boolean empty_output_buffer(j_compress_ptr cinfo)
+{
+    host_jpeg_enc_t *enc = (host_jpeg_enc_t *)cinfo->client_data;
+    static JOCTET discard[4096];
+    enc->overflow = true;
+    cinfo->dest->next_output_byte = discard;
+    cinfo->dest->free_in_buffer = sizeof(discard);
+    return TRUE;
+}
+
+static void term_destination(j_compress_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+jpeg_error_t jpeg_enc_open(jpeg_enc_config_t *info, jpeg_enc_handle_t *jpeg_enc)
+{
+    if (info->rotate != JPEG_ROTATE_0D) {
+        return JPEG_ERR_UNSUPPORT_FMT;
+    }
+    int components;
+    int bytes_per_pixel;
+    J_COLOR_SPACE color_space;
+    switch (info->src_type) {
+    case JPEG_PIXEL_FORMAT_GRAY:
+        components = 1;
+        bytes_per_pixel = 1;
+        color_space = JCS_GRAYSCALE;
+        break;
+    case JPEG_PIXEL_FORMAT_RGB888:
+        components = 3;
+        bytes_per_pixel = 3;
+        color_space = JCS_RGB;
+        break;
+    case JPEG_PIXEL_FORMAT_YCbYCr:
+        components = 3;
+        bytes_per_pixel = 2;
+        color_space = JCS_YCbCr;
+        break;
+    default:
+        return JPEG_ERR_UNSUPPORT_FMT;
+    }
+
+    host_jpeg_enc_t *enc = calloc(1, sizeof(host_jpeg_enc_t));
+    if (enc == NULL) {
+        return JPEG_ERR_NO_MEM;
+    }
+    enc->config = *info;
+    enc->components = components;
+    enc->bytes_per_pixel = bytes_per_pixel;
+    if (info->src_type == JPEG_PIXEL_FORMAT_YCbYCr) {
+        enc->row = malloc((size_t)info->width * 3);
+        if (enc->row == NULL) {
+            free(enc);
+            return JPEG_ERR_NO_MEM;
+        }
+    }
+    enc->cinfo.err = jpeg_std_error(&enc->jerr);
+    jpeg_create_compress(&enc->cinfo);
+    enc->cinfo.client_data = enc;
+    enc->dest.init_destination = init_destination;
+    enc->dest.empty_output_buffer = empty_output_buffer;
+    enc->dest.term_destination = term_destination;
+    enc->cinfo.dest = &enc->dest;
+
+    enc->cinfo.image_width = info->width;
+    enc->cinfo.image_height = info->height;
+    enc->cinfo.input_components = components;
+    enc->cinfo.in_color_space = color_space;
+    jpeg_set_defaults(&enc->cinfo);
+    jpeg_set_quality(&enc->cinfo, info->quality, TRUE);
+    if (components == 3) {
+        int h = info->subsampling == JPEG_SUBSAMPLE_444 ? 1 : 2;
+        int v = info->subsampling == JPEG_SUBSAMPLE_420 ? 2 : 1;
+        enc->cinfo.comp_info[0].h_samp_factor = h;
+        enc->cinfo.comp_info[0].v_samp_factor = v;
+    }
+    *jpeg_enc = enc;
+    return JPEG_ERR_OK;
+}
+
+static int block_lines(const host_jpeg_enc_t *enc)
+{
+    if (enc->components == 1 || enc->config.subsampling != JPEG_SUBSAMPLE_420) {
+        return 8;
+    }
+    return 16;
+}
+
+int jpeg_enc_get_block_size(jpeg_enc_handle_t jpeg_enc)
+{
+    host_jpeg_enc_t *enc = jpeg_enc;
+    return enc->config.width * block_lines(enc) * enc->bytes_per_pixel;
+}
+
+/* Encode lines rows of in_buf, starting the image on the first call */
+static jpeg_error_t write_rows(host_jpeg_enc_t *enc, const uint8_t *in_buf, int lines, uint8_t *out_buf,
+                               int out_buf_size, int *out_size)
+{
+    enc->dest.next_output_byte = out_buf;
+    enc->dest.free_in_buffer = out_buf_size;
+    enc->overflow = false;
+    if (!enc->started) {
+        jpeg_start_compress(&enc->cinfo, TRUE);
+        enc->started = true;
+    }
+    int stride = enc->config.width * enc->bytes_per_pixel;
+    for (int i = 0; i < lines && enc->cinfo.next_scanline < enc->cinfo.image_height; i++) {
+        JSAMPROW row = (JSAMPROW)(in_buf + (size_t)i * stride);
+        if (enc->row != NULL) {
+            /* Y0 Cb Y1 Cr -> Y0 Cb Cr Y1 Cb Cr */
+            for (int x = 0; x + 1 < enc->config.width; x += 2) {
+                const uint8_t *s = row + x * 2;
+                uint8_t *d = enc->row + x * 3;
+                d[0] = s[0], d[1] = s[1], d[2] = s[3];
+                d[3] = s[2], d[4] = s[1], d[5] = s[3];
+            }
+            row = enc->row;
+        }
+        jpeg_write_scanlines(&enc->cinfo, &row, 1);
+    }
+    if (enc->cinfo.next_scanline == enc->cinfo.image_height) {
+        jpeg_finish_compress(&enc->cinfo);
+        enc->finished = true;
+    }
+    *out_size = out_buf_size - (int)enc->dest.free_in_buffer;
+    return enc->overflow ? JPEG_ERR_NO_MEM : JPEG_ERR_OK;
+}
+
+jpeg_error_t jpeg_enc_process(jpeg_enc_handle_t jpeg_enc, const uint8_t *in_buf, int inbuf_size, uint8_t *out_buf,
+                              int out_buf_size, int *out_size)
+{
+    host_jpeg_enc_t *enc = jpeg_enc;
+    if (enc->started || inbuf_size < enc->config.width * enc->config.height * enc->bytes_per_pixel) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    return write_rows(enc, in_buf, enc->config.height, out_buf, out_buf_size, out_size);
+}
+
+jpeg_error_t jpeg_enc_process_with_block(jpeg_enc_handle_t jpeg_enc, const uint8_t *in_buf, int inbuf_size,
+                                         uint8_t *out_buf, int out_buf_size, int *out_size)
+{
+    host_jpeg_enc_t *enc = jpeg_enc;
+    if (inbuf_size != jpeg_enc_get_block_size(enc)) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    /* How esp_new_jpeg treats a padded last MCU row is not verified. image_to_jpeg only encodes by
+       block when the height is a multiple of the MCU height, fail like a bad parameter otherwise */
+    if (enc->config.height % block_lines(enc) != 0) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    if (enc->finished) {
+        return JPEG_ERR_NO_MORE_DATA;
+    }
+    return write_rows(enc, in_buf, block_lines(enc), out_buf, out_buf_size, out_size);
+}
+
+jpeg_error_t jpeg_enc_close(jpeg_enc_handle_t jpeg_enc)
+{
+    host_jpeg_enc_t *enc = jpeg_enc;
+    if (enc == NULL) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    jpeg_destroy_compress(&enc->cinfo);
+    free(enc->row);
+    free(enc);
+    return JPEG_ERR_OK;
+}
@@ -0,0 +1,56 @@
+/*
+ * esp_new_jpeg encoder API implemented with libjpeg for host builds. Block encoding
+ * behaves like the real encoder: every call takes one MCU row of input and returns the
+ * JPEG data produced so far, the header with the first row and EOI with the last.
+ */
+#ifndef JPEG_BENCH_ESP_JPEG_ENC_H
+#define JPEG_BENCH_ESP_JPEG_ENC_H
+
+#include "esp_jpeg_common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void* jpeg_enc_handle_t;
+
+typedef struct {
+    int width;
+    int height;
+    jpeg_pixel_format_t src_type;
+    jpeg_subsampling_t subsampling;
+    uint8_t quality;
+    jpeg_rotate_t rotate;
+    bool task_enable;
+    uint8_t hfm_task_priority;
+    uint8_t hfm_task_core;
+} jpeg_enc_config_t;
+
+#define DEFAULT_JPEG_ENC_CONFIG() {             \
+    .width = 320,                               \
+    .height = 240,                              \
+    .src_type = JPEG_PIXEL_FORMAT_YCbYCr,       \
+    .subsampling = JPEG_SUBSAMPLE_420,          \
+    .quality = 40,                              \
+    .rotate = JPEG_ROTATE_0D,                   \
+    .task_enable = false,                       \
+    .hfm_task_priority = 13,                    \
+    .hfm_task_core = 1,                         \
+}
+
+jpeg_error_t jpeg_enc_open(jpeg_enc_config_t *info, jpeg_enc_handle_t *jpeg_enc);
+jpeg_error_t jpeg_enc_process(jpeg_enc_handle_t jpeg_enc, const uint8_t *in_buf, int inbuf_size, uint8_t *out_buf,
+                              int out_buf_size, int *out_size);
+int jpeg_enc_get_block_size(jpeg_enc_handle_t jpeg_enc);
+jpeg_error_t jpeg_enc_process_with_block(jpeg_enc_handle_t jpeg_enc, const uint8_t *in_buf, int inbuf_size,
+                                         uint8_t *out_buf, int out_buf_size, int *out_size);
+jpeg_error_t jpeg_enc_close(jpeg_enc_handle_t jpeg_enc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
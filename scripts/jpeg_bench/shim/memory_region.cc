@@ -0,0 +1,143 @@
+// Host replacement for the memory regions in main/memory, allocations are counted and checked
+// against the budget by their requested size
+#include "arena_allocator.h"
+
+#include <cstdlib>
+
+struct BlockHeader {
+    size_t size;
+    size_t offset;  // From the start of the malloc block to the payload
+};
+
+// Totals over all regions, the tests reset the peak between runs
+size_t memory_region_used = 0;
+size_t memory_region_peak = 0;
+size_t memory_region_allocations = 0;
+
+static BlockHeader* Header(void* ptr) {
+    return reinterpret_cast<BlockHeader*>(ptr) - 1;
+}
+
+MemoryRegion::MemoryRegion(const char* name, MemoryPlacement placement, size_t budget)
+    : name_(name), placement_(placement), budget_(budget) {
+}
+
+void* MemoryRegion::Allocate(size_t size, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (budget_ > 0 && used_ + size > budget_) {
+        failures_++;
+        return nullptr;
+    }
+    if (alignment < alignof(BlockHeader)) {
+        alignment = alignof(BlockHeader);
+    }
+    auto block = static_cast<uint8_t*>(malloc(size + sizeof(BlockHeader) + alignment));
+    if (block == nullptr) {
+        failures_++;
+        return nullptr;
+    }
+    uintptr_t payload = (reinterpret_cast<uintptr_t>(block) + sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+    auto ptr = reinterpret_cast<void*>(payload);
+    Header(ptr)->size = size;
+    Header(ptr)->offset = payload - reinterpret_cast<uintptr_t>(block);
+    used_ += size;
+    if (used_ > peak_) {
+        peak_ = used_;
+    }
+    memory_region_used += size;
+    if (memory_region_used > memory_region_peak) {
+        memory_region_peak = memory_region_used;
+    }
+    allocations_++;
+    memory_region_allocations++;
+    return ptr;
+}
+
+void MemoryRegion::Free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ -= Header(ptr)->size;
+    memory_region_used -= Header(ptr)->size;
+    free(static_cast<uint8_t*>(ptr) - Header(ptr)->offset);
+}
+
+void MemoryRegion::Detach(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ -= Header(ptr)->size;
+    memory_region_used -= Header(ptr)->size;
+}
+
+// MemoryArena, the same as main/memory/arena_allocator.cc
+
+MemoryArena::MemoryArena(MemoryRegion& region, size_t capacity) : region_(region) {
+    if (capacity > 0) {
+        Reserve(capacity);
+    }
+}
+
+MemoryArena::~MemoryArena() {
+    Release();
+}
+
+bool MemoryArena::Reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return true;
+    }
+    if (offset_ != 0) {
+        return false;
+    }
+    Release();
+    block_ = (uint8_t*)region_.Allocate(capacity, 16);
+    if (block_ == nullptr) {
+        return false;
+    }
+    capacity_ = capacity;
+    return true;
+}
+
+void* MemoryArena::Allocate(size_t size, size_t alignment) {
+    if (alignment == 0) {
+        alignment = 1;
+    }
+    size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (block_ == nullptr || start + size > capacity_) {
+        return nullptr;
+    }
+    offset_ = start + size;
+    return block_ + start;
+}
+
+void MemoryArena::Release() {
+    if (block_ != nullptr) {
+        region_.Free(block_);
+        block_ = nullptr;
+    }
+    capacity_ = 0;
+    offset_ = 0;
+}
+
+MemoryRegistry::MemoryRegistry() {
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_CAMERA, kPlacementPsram, 0));
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_JPEG, kPlacementPsramPreferred, 2 * 1024 * 1024));
+    regions_.push_back(new MemoryRegion(MEMORY_REGION_JPEG_FRAME, kPlacementPsramPreferred, 0));
+}
+
+MemoryRegistry::~MemoryRegistry() {
+    for (auto region : regions_) {
+        delete region;
+    }
+}
+
+MemoryRegion* MemoryRegistry::GetRegion(const char* name) {
+    for (auto region : regions_) {
+        if (region->name() == name) {
+            return region;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,4 @@
+/* Host build: no target options, the software JPEG encoder is used */
+#ifndef JPEG_BENCH_SDKCONFIG_H
+#define JPEG_BENCH_SDKCONFIG_H
+#endif
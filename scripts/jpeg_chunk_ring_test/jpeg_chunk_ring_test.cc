@@ -0,0 +1,274 @@
+/*
+ * Host simulation of the JPEG upload pipeline of Esp32Camera::Explain().
+ *
+ * A fake encoder thread emits a JPEG stream the way image_to_jpeg_cb() does: one piece
+ * per MCU row, of varying size, then a null piece at the end. It stops when the output
+ * callback takes less than the piece. A fake HTTP sink writes the slots of the ring in
+ * place, slower or faster than the encoder, and may fail after a given number of bytes.
+ * Both sides use JpegChunkRing exactly as Explain() does. The test checks that:
+ *
+ * 1. The uploaded bytes are the encoded bytes, in order, whatever the piece sizes.
+ * 2. Appending, sending and giving slots back allocates nothing, on either thread. The
+ *    slots are allocated once from the camera memory region and reused for every photo.
+ * 3. Memory is bounded: at most slot_count slots wait to be sent, and a slow upload
+ *    makes the encoder wait instead of growing a queue.
+ * 4. An upload failing mid-stream cancels the ring, the encoder stops early and its
+ *    thread joins, also when it was waiting for a slot.
+ * 5. An encoder failure ends the upload without the missing part, and the stream is
+ *    reported incomplete.
+ *
+ * Usage: jpeg_chunk_ring_test [-v]
+ */
+#include "jpeg_chunk_ring.h"
+#include "arena_allocator.h"
+#include "host_test.h"
+#include "esp_heap_caps.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Allocations made by the current thread, counted around the ring calls
+static thread_local size_t thread_allocations = 0;
+
+void* operator new(size_t size) {
+    thread_allocations++;
+    void* ptr = malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+static uint8_t StreamByte(uint32_t seed, size_t offset) {
+    uint32_t x = seed * 2654435761u + (uint32_t)offset * 40503u;
+    x ^= x >> 13;
+    return (uint8_t)(x * 0x5bd1e995u >> 24);
+}
+
+struct EncoderResult {
+    bool ok = false;
+    size_t pieces = 0;
+    size_t bytes = 0;
+    size_t allocations = 0;
+};
+
+// Emits `total` bytes in pieces of min_piece..max_piece bytes like image_to_jpeg_cb(),
+// fail_at stops it with an error after that many bytes
+static void FakeEncoder(JpegChunkRing* ring, uint32_t seed, size_t total, size_t min_piece, size_t max_piece,
+    size_t fail_at, EncoderResult* result) {
+    auto output = [](void* arg, size_t, const void* data, size_t len) -> size_t {
+        auto ring = (JpegChunkRing*)arg;
+        if (data == nullptr) {
+            return 0;
+        }
+        return ring->Append(data, len) ? len : 0;
+    };
+
+    // The piece buffer stands for the encoder's own output buffer, reused for every MCU row
+    std::vector<uint8_t> piece(max_piece);
+    size_t before = thread_allocations;
+    srand(seed);
+    bool ok = true;
+    size_t offset = 0;
+    size_t index = 0;
+    while (offset < total) {
+        if (offset >= fail_at) {
+            ok = false;
+            break;
+        }
+        size_t len = min_piece + (max_piece > min_piece ? (size_t)rand() % (max_piece - min_piece + 1) : 0);
+        len = std::min(len, total - offset);
+        for (size_t i = 0; i < len; i++) {
+            piece[i] = StreamByte(seed, offset + i);
+        }
+        if (output(ring, index++, piece.data(), len) != len) {
+            ok = false;
+            break;
+        }
+        offset += len;
+    }
+    if (ok) {
+        output(ring, index, nullptr, 0);
+    }
+    ring->Finish(ok);
+    result->allocations = thread_allocations - before;
+    result->ok = ok;
+    result->pieces = index;
+    result->bytes = offset;
+}
+
+struct UploadResult {
+    bool write_failed = false;
+    bool content_ok = true;
+    size_t bytes = 0;
+    size_t chunks = 0;
+    size_t allocations = 0;
+};
+
+// Sends the ring in place like Explain(), every write takes write_us and the write
+// after fail_after bytes fails
+static void FakeUpload(JpegChunkRing* ring, uint32_t seed, int write_us, size_t fail_after, UploadResult* result) {
+    size_t before = thread_allocations;
+    const uint8_t* chunk = nullptr;
+    size_t chunk_len = 0;
+    while (ring->Front(chunk, chunk_len)) {
+        if (result->bytes + chunk_len > fail_after) {
+            result->write_failed = true;
+            ring->Cancel();
+            break;
+        }
+        for (size_t i = 0; i < chunk_len; i++) {
+            if (chunk[i] != StreamByte(seed, result->bytes + i)) {
+                result->content_ok = false;
+                break;
+            }
+        }
+        if (write_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(write_us));
+        }
+        result->bytes += chunk_len;
+        result->chunks++;
+        ring->Pop();
+    }
+    result->allocations = thread_allocations - before;
+}
+
+static void TestStreams() {
+    const char* test = "streams";
+    const size_t slot_count = 4;
+    const size_t slot_size = 8 * 1024;
+    JpegChunkRing ring(slot_count, slot_size);
+    Check(ring.valid(), test, "allocated");
+    size_t ring_memory = heap_caps_test_in_use;
+    auto region = MemoryRegistry::GetInstance().GetRegion(MEMORY_REGION_CAMERA);
+    Check(region->used() == slot_count * slot_size, test, "slots accounted to the camera region");
+
+    struct Case {
+        size_t total;
+        size_t min_piece;
+        size_t max_piece;
+        int write_us;
+    };
+    const Case cases[] = {
+        {60 * 1024 + 123, 300, 3000, 200},      // Slow network, the encoder waits
+        {slot_size * 6, 1024, 1024, 0},         // Whole slots only
+        {100 * 1024, 10000, 20000, 50},         // Pieces larger than a slot
+        {700, 700, 700, 0},                     // A single partial slot
+        {0, 1, 1, 0},                           // An empty image
+        {200 * 1024 + 1, 1, 4000, 20},
+    };
+    uint32_t seed = 1;
+    for (auto& c : cases) {
+        ring.Reset();
+        EncoderResult encoded;
+        UploadResult uploaded;
+        std::thread encoder(FakeEncoder, &ring, seed, c.total, c.min_piece, c.max_piece, (size_t)-1, &encoded);
+        FakeUpload(&ring, seed, c.write_us, (size_t)-1, &uploaded);
+        encoder.join();
+
+        Check(encoded.ok && ring.complete(), test, "stream complete");
+        Check(uploaded.bytes == c.total, test, "every byte uploaded");
+        Check(uploaded.content_ok, test, "uploaded bytes match the encoded bytes");
+        Check(uploaded.chunks == (c.total + slot_size - 1) / slot_size, test, "full slots sent");
+        Check(encoded.allocations == 0, test, "no allocation on the encoder thread");
+        Check(uploaded.allocations == 0, test, "no allocation on the upload thread");
+        Check(heap_caps_test_in_use == ring_memory, test, "ring memory constant");
+        if (verbose) {
+            printf("  %u bytes in %u pieces, %u chunks\n", (unsigned)c.total, (unsigned)encoded.pieces,
+                (unsigned)uploaded.chunks);
+        }
+        seed++;
+    }
+
+    auto stats = ring.stats();
+    Check(stats.allocations == 1, test, "slots allocated once");
+    Check(stats.peak_committed <= slot_count, test, "at most slot_count slots waiting");
+    Check(stats.producer_waits > 0, test, "the slow upload paced the encoder");
+    Check(stats.streams == sizeof(cases) / sizeof(cases[0]), test, "streams counted");
+    Check(heap_caps_test_peak == ring_memory, test, "peak memory is the ring");
+    if (verbose) {
+        printf("streams: %u chunks, %u bytes, %u producer waits, peak %u of %u slots, %u bytes of slots\n",
+            stats.chunks, stats.bytes, stats.producer_waits, stats.peak_committed, (unsigned)slot_count,
+            (unsigned)ring_memory);
+    }
+}
+
+static void TestUploadFailure() {
+    const char* test = "upload failure";
+    const size_t total = 300 * 1024;
+    JpegChunkRing ring(4, 4096);
+
+    // The upload fails after 20KB, the encoder is far from done and waiting for a slot
+    EncoderResult encoded;
+    UploadResult uploaded;
+    std::thread encoder(FakeEncoder, &ring, 7, total, 500, 2500, (size_t)-1, &encoded);
+    FakeUpload(&ring, 7, 1000, 20 * 1024, &uploaded);
+    encoder.join();
+    Check(uploaded.write_failed, test, "write failed");
+    Check(!encoded.ok, test, "encoder reports the abort");
+    Check(encoded.bytes < total / 2, test, "encoder stopped early");
+    Check(!ring.complete(), test, "stream incomplete");
+    Check(ring.stats().cancelled == 1, test, "cancel counted");
+    if (verbose) {
+        printf("upload failure: sent %u bytes, encoder stopped after %u of %u bytes\n", (unsigned)uploaded.bytes,
+            (unsigned)encoded.bytes, (unsigned)total);
+    }
+
+    // The connection fails before anything is read, the encoder fills the ring and waits
+    ring.Reset();
+    EncoderResult blocked;
+    std::thread encoder2(FakeEncoder, &ring, 8, total, 1000, 1000, (size_t)-1, &blocked);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ring.Cancel();
+    encoder2.join();
+    Check(!blocked.ok, test, "blocked encoder released");
+    Check(blocked.bytes <= 4 * 4096 + 1000, test, "blocked encoder filled at most the ring");
+
+    // The ring is reused for the next photo
+    ring.Reset();
+    EncoderResult next;
+    UploadResult next_uploaded;
+    std::thread encoder3(FakeEncoder, &ring, 9, 50 * 1024, 100, 3000, (size_t)-1, &next);
+    FakeUpload(&ring, 9, 0, (size_t)-1, &next_uploaded);
+    encoder3.join();
+    Check(next.ok && ring.complete(), test, "next photo complete");
+    Check(next_uploaded.bytes == 50 * 1024 && next_uploaded.content_ok, test, "next photo uploaded");
+    Check(ring.stats().allocations == 1, test, "slots allocated once");
+}
+
+static void TestEncoderFailure() {
+    const char* test = "encoder failure";
+    JpegChunkRing ring(3, 2048);
+    EncoderResult encoded;
+    UploadResult uploaded;
+    std::thread encoder(FakeEncoder, &ring, 11, 64 * 1024, 200, 900, 10 * 1024, &encoded);
+    FakeUpload(&ring, 11, 100, (size_t)-1, &uploaded);
+    encoder.join();
+    Check(!encoded.ok, test, "encoder failed");
+    Check(!uploaded.write_failed, test, "upload ended without error");
+    Check(uploaded.bytes % 2048 == 0 && uploaded.bytes <= encoded.bytes, test, "partial slot not sent");
+    Check(uploaded.content_ok, test, "sent bytes match");
+    Check(!ring.complete(), test, "stream incomplete");
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestStreams();
+    TestUploadFailure();
+    TestEncoderFailure();
+    return ReportChecks();
+}
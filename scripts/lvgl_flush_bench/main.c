@@ -0,0 +1,251 @@
+/*
+ * Headless LVGL benchmark for render / flush overlap.
+ *
+ * The flush callback hands each band to a worker thread that sleeps for the time an
+ * SPI DMA transfer of that size would take and then calls lv_display_flush_ready(),
+ * like the transfer done callback of esp_lvgl_port. The same scene is rendered with
+ * one and with two draw buffers and the time LVGL spends blocked on the transfer is
+ * reported for both.
+ */
+#include <lvgl.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    uint32_t frames;
+    uint32_t flushes;
+    uint64_t refresh_us;
+    uint64_t render_us;
+    uint64_t flush_wait_us;
+    uint64_t transfer_us;
+    uint64_t refresh_start;
+    uint64_t render_start;
+    uint64_t flush_wait_start;
+} bench_stats_t;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    lv_display_t *display;
+    uint32_t pending_us;    /* Transfer time of the band in flight, 0 when idle */
+    bool stop;
+} dma_worker_t;
+
+static int spi_mhz = 40;
+static bench_stats_t stats;
+static dma_worker_t worker;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t tick_cb(void)
+{
+    return (uint32_t)(now_us() / 1000);
+}
+
+static void *dma_worker_task(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&worker.mutex);
+    while (!worker.stop) {
+        if (worker.pending_us == 0) {
+            pthread_cond_wait(&worker.cond, &worker.mutex);
+            continue;
+        }
+        uint32_t duration = worker.pending_us;
+        pthread_mutex_unlock(&worker.mutex);
+
+        usleep(duration);
+
+        pthread_mutex_lock(&worker.mutex);
+        worker.pending_us = 0;
+        /* Only sets a flag, the same call is made from the SPI ISR on the device */
+        lv_display_flush_ready(worker.display);
+    }
+    pthread_mutex_unlock(&worker.mutex);
+    return NULL;
+}
+
+static void flush_cb(lv_display_t *display, const lv_area_t *area, uint8_t *px_map)
+{
+    (void)px_map;
+    uint32_t bytes = lv_area_get_size(area) * 2;
+    uint32_t duration = (uint32_t)((uint64_t)bytes * 8 / spi_mhz);
+    if (duration == 0) {
+        duration = 1;
+    }
+    stats.transfer_us += duration;
+
+    pthread_mutex_lock(&worker.mutex);
+    worker.display = display;
+    worker.pending_us = duration;
+    pthread_cond_signal(&worker.cond);
+    pthread_mutex_unlock(&worker.mutex);
+}
+
+static void event_cb(lv_event_t *e)
+{
+    uint64_t now = now_us();
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+        stats.refresh_start = now;
+        stats.render_start = 0;
+        break;
+    case LV_EVENT_RENDER_START:
+        stats.render_start = now;
+        break;
+    case LV_EVENT_RENDER_READY:
+        if (stats.render_start != 0) {
+            stats.render_us += now - stats.render_start;
+            stats.frames++;
+        }
+        break;
+    case LV_EVENT_REFR_READY:
+        if (stats.render_start != 0) {
+            stats.refresh_us += now - stats.refresh_start;
+        }
+        break;
+    case LV_EVENT_FLUSH_START:
+        stats.flushes++;
+        break;
+    case LV_EVENT_FLUSH_WAIT_START:
+        stats.flush_wait_start = now;
+        break;
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        if (stats.flush_wait_start != 0) {
+            stats.flush_wait_us += now - stats.flush_wait_start;
+            stats.flush_wait_start = 0;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Something close to the emotion screen: a gradient background, a large animated widget and text */
+static void create_scene(lv_obj_t **arc, lv_obj_t **label)
+{
+    lv_obj_t *screen = lv_screen_active();
+    lv_obj_set_style_bg_color(screen, lv_color_hex(0x202040), 0);
+    lv_obj_set_style_bg_grad_color(screen, lv_color_hex(0x4080C0), 0);
+    lv_obj_set_style_bg_grad_dir(screen, LV_GRAD_DIR_VER, 0);
+
+    *arc = lv_arc_create(screen);
+    lv_obj_set_size(*arc, LV_PCT(70), LV_PCT(70));
+    lv_obj_center(*arc);
+    lv_arc_set_range(*arc, 0, 100);
+
+    *label = lv_label_create(screen);
+    lv_obj_set_style_text_font(*label, &lv_font_montserrat_28, 0);
+    lv_obj_align(*label, LV_ALIGN_BOTTOM_MID, 0, -10);
+}
+
+static void run(const char *name, int width, int height, int lines, bool double_buffer, int frame_count)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    size_t buffer_size = (size_t)width * lines * 2;
+    void *buf1 = malloc(buffer_size);
+    void *buf2 = double_buffer ? malloc(buffer_size) : NULL;
+
+    lv_display_t *display = lv_display_create(width, height);
+    lv_display_set_default(display);
+    lv_display_set_flush_cb(display, flush_cb);
+    lv_display_set_buffers(display, buf1, buf2, buffer_size, LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_add_event_cb(display, event_cb, LV_EVENT_ALL, NULL);
+
+    lv_obj_t *arc, *label;
+    create_scene(&arc, &label);
+    lv_refr_now(display);
+    memset(&stats, 0, sizeof(stats));
+
+    uint64_t start = now_us();
+    for (int i = 0; i < frame_count; i++) {
+        lv_arc_set_value(arc, i % 100);
+        lv_label_set_text_fmt(label, "frame %d", i);
+        /* Full screen change every frame, as with a GIF emotion */
+        lv_obj_invalidate(lv_screen_active());
+        lv_refr_now(display);
+    }
+    /* Let the last transfer finish */
+    pthread_mutex_lock(&worker.mutex);
+    while (worker.pending_us != 0) {
+        pthread_mutex_unlock(&worker.mutex);
+        usleep(100);
+        pthread_mutex_lock(&worker.mutex);
+    }
+    pthread_mutex_unlock(&worker.mutex);
+    uint64_t elapsed = now_us() - start;
+
+    uint32_t frames = stats.frames > 0 ? stats.frames : 1;
+    uint64_t hidden_us = stats.transfer_us > stats.flush_wait_us ? stats.transfer_us - stats.flush_wait_us : 0;
+    printf("%-8s %6.1f fps  refresh %6llu us  render %6llu us  wait %6llu us  transfer %6llu us  overlap %3d%%\n",
+        name, frames * 1e6 / elapsed,
+        (unsigned long long)(stats.refresh_us / frames),
+        (unsigned long long)(stats.render_us / frames),
+        (unsigned long long)(stats.flush_wait_us / frames),
+        (unsigned long long)(stats.transfer_us / frames),
+        stats.transfer_us > 0 ? (int)(hidden_us * 100 / stats.transfer_us) : 0);
+
+    lv_display_delete(display);
+    free(buf1);
+    free(buf2);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-w width] [-h height] [-l lines] [-f frames] [-s spi_mhz]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    int width = 240, height = 320, lines = 20, frames = 200;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h:l:f:s:")) != -1) {
+        switch (opt) {
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        case 'l': lines = atoi(optarg); break;
+        case 'f': frames = atoi(optarg); break;
+        case 's': spi_mhz = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || lines <= 0 || frames <= 0 || spi_mhz <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    lv_init();
+    lv_tick_set_cb(tick_cb);
+
+    pthread_mutex_init(&worker.mutex, NULL);
+    pthread_cond_init(&worker.cond, NULL);
+    pthread_create(&worker.thread, NULL, dma_worker_task, NULL);
+
+    printf("%dx%d, %d lines per band, SPI %d MHz, %d frames\n", width, height, lines, spi_mhz, frames);
+    printf("wait is the time LVGL was blocked on a transfer, overlap is the share of transfer time hidden behind rendering\n");
+    run("single", width, height, lines, false, frames);
+    run("double", width, height, lines, true, frames);
+
+    pthread_mutex_lock(&worker.mutex);
+    worker.stop = true;
+    pthread_cond_signal(&worker.cond);
+    pthread_mutex_unlock(&worker.mutex);
+    pthread_join(worker.thread, NULL);
+
+    lv_deinit();
+    return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * Host test of the settings cache in main/settings.cc against an in-memory NVS.
+ *
+ * The fake NVS keeps what was committed apart from what a handle has written, so a write
+ * that is never committed is lost, as it is on the device when power goes. The commit
+ * timer only fires when the test fires it. The test checks that:
+ *
+ * 1. Every key is read from NVS once, present or missing, and writes are read back from RAM.
+ * 2. Changes made within the commit delay end up in one commit per namespace, and setting
+ *    a value the key already has is not a change.
+ * 3. Settings::Flush() and the esp_restart() shutdown handler commit pending changes at
+ *    once and stop the timer.
+ * 4. A failed nvs_open, nvs_set or nvs_commit keeps the changes pending and arms the
+ *    timer again, and the next flush commits them. Changes NVS can never take are dropped.
+ * 5. Erased keys are erased in NVS, and EraseAll() drops the pending changes of its
+ *    namespace.
+ * 6. Settings opened read only change nothing.
+ *
+ * Usage: settings_test
+ */
+#include "settings.h"
+#include "host_test.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include <cstring>
+#include <map>
+#include <string>
+
+// In-memory NVS
+
+struct NvsValue {
+    enum Type { kString, kI32, kU8 } type;
+    std::string str;
+    int32_t number;
+};
+
+using NvsNamespace = std::map<std::string, NvsValue>;
+
+struct NvsHandle {
+    std::string ns;
+    bool writable;
+    NvsNamespace written;   // The namespace as this handle sees it
+};
+
+static struct {
+    std::map<std::string, NvsNamespace> committed;
+    std::map<nvs_handle_t, NvsHandle> handles;
+    nvs_handle_t next_handle = 1;
+    int reads = 0;
+    int commits = 0;
+    // Failures to inject, the open and commit ones fail once
+    esp_err_t open_error = ESP_OK;
+    esp_err_t commit_error = ESP_OK;
+    esp_err_t set_error = ESP_OK;
+} nvs;
+
+static void ResetNvs() {
+    Settings::ClearCache();
+    nvs.committed.clear();
+    nvs.handles.clear();
+    nvs.reads = 0;
+    nvs.commits = 0;
+    nvs.open_error = nvs.commit_error = nvs.set_error = ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (nvs.open_error != ESP_OK) {
+        auto error = nvs.open_error;
+        nvs.open_error = ESP_OK;
+        return error;
+    }
+    auto it = nvs.committed.find(name);
+    if (it == nvs.committed.end() && open_mode == NVS_READONLY) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_handle = nvs.next_handle++;
+    nvs.handles[*out_handle] = {name, open_mode == NVS_READWRITE, nvs.committed[name]};
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    // Writes that were not committed are lost
+    nvs.handles.erase(handle);
+}
+
+static const NvsValue* Find(nvs_handle_t handle, const char* key, NvsValue::Type type) {
+    nvs.reads++;
+    auto& written = nvs.handles.at(handle).written;
+    auto it = written.find(key);
+    return it != written.end() && it->second.type == type ? &it->second : nullptr;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    auto value = Find(handle, key, NvsValue::kString);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value != nullptr) {
+        memcpy(out_value, value->str.c_str(), value->str.size() + 1);
+    }
+    *length = value->str.size() + 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    auto value = Find(handle, key, NvsValue::kI32);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = value->number;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    auto value = Find(handle, key, NvsValue::kU8);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = (uint8_t)value->number;
+    return ESP_OK;
+}
+
+static esp_err_t Set(nvs_handle_t handle, const char* key, NvsValue value) {
+    auto& h = nvs.handles.at(handle);
+    if (!h.writable) {
+        return ESP_FAIL;
+    }
+    if (nvs.set_error != ESP_OK) {
+        return nvs.set_error;
+    }
+    if (strlen(key) > 15) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    h.written[key] = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return Set(handle, key, {NvsValue::kString, value, 0});
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    return Set(handle, key, {NvsValue::kI32, "", value});
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return Set(handle, key, {NvsValue::kU8, "", value});
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    auto& written = nvs.handles.at(handle).written;
+    return written.erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    nvs.handles.at(handle).written.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (nvs.commit_error != ESP_OK) {
+        auto error = nvs.commit_error;
+        nvs.commit_error = ESP_OK;
+        return error;
+    }
+    auto& h = nvs.handles.at(handle);
+    nvs.committed[h.ns] = h.written;
+    nvs.commits++;
+    return ESP_OK;
+}
+
+// Timers and shutdown handlers, run when the test says so
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    bool active;
+};
+
+static esp_timer* commit_timer = nullptr;
+static shutdown_handler_t shutdown_handler = nullptr;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    commit_timer = new esp_timer{*args, false};
+    *out_handle = commit_timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    (void)timeout_us;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    timer->active = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    return timer->active;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    shutdown_handler = handler;
+    return ESP_OK;
+}
+
+static bool TimerArmed() {
+    return commit_timer != nullptr && commit_timer->active;
+}
+
+static void FireTimer() {
+    if (TimerArmed()) {
+        commit_timer->active = false;
+        commit_timer->args.callback(commit_timer->args.arg);
+    }
+}
+
+static const NvsValue* Committed(const char* ns, const char* key) {
+    auto it = nvs.committed.find(ns);
+    if (it == nvs.committed.end()) {
+        return nullptr;
+    }
+    auto value = it->second.find(key);
+    return value != it->second.end() ? &value->second : nullptr;
+}
+
+static bool CommittedInt(const char* ns, const char* key, int32_t expected) {
+    auto value = Committed(ns, key);
+    return value != nullptr && value->type == NvsValue::kI32 && value->number == expected;
+}
+
+// Tests
+
+static void TestReads() {
+    const char* test = "reads";
+    ResetNvs();
+    nvs.committed["audio"]["volume"] = {NvsValue::kI32, "", 70};
+    nvs.committed["wifi"]["ssid"] = {NvsValue::kString, "home", 0};
+
+    Settings audio("audio");
+    Settings wifi("wifi");
+    Check(audio.GetInt("volume") == 70 && audio.GetInt("volume") == 70, test, "stored int");
+    Check(wifi.GetString("ssid") == "home" && wifi.GetString("ssid") == "home", test, "stored string");
+    Check(audio.GetBool("muted", true) && audio.GetBool("muted", true), test, "missing bool gives the default");
+    Check(nvs.reads == 4, test, "every key read from NVS once");
+
+    Settings audio_rw("audio", true);
+    audio_rw.SetInt("volume", 40);
+    Check(Settings("audio").GetInt("volume") == 40, test, "write read back before the commit");
+    Check(nvs.reads == 4, test, "write read back from RAM");
+    Check(Settings("other").GetString("key", "default") == "default", test, "missing namespace gives the default");
+}
+
+static void TestCoalescing() {
+    const char* test = "coalescing";
+    ResetNvs();
+    Settings audio("audio", true);
+    Settings display("display", true);
+    for (int volume = 0; volume <= 100; volume += 10) {
+        audio.SetInt("volume", volume);
+        display.SetInt("brightness", 100 - volume);
+    }
+    display.SetString("theme", "dark");
+    Check(nvs.commits == 0, test, "nothing committed before the delay");
+    Check(TimerArmed(), test, "commit timer armed");
+    FireTimer();
+    Check(nvs.commits == 2, test, "one commit per namespace");
+    Check(CommittedInt("audio", "volume", 100) && CommittedInt("display", "brightness", 0), test, "last values");
+    auto theme = Committed("display", "theme");
+    Check(theme != nullptr && theme->str == "dark", test, "string committed");
+    Check(!TimerArmed(), test, "timer idle when everything is committed");
+
+    audio.SetInt("volume", 100);
+    Check(!TimerArmed(), test, "setting the same value is not a change");
+    audio.SetBool("muted", true);
+    audio.SetBool("muted", false);
+    FireTimer();
+    auto muted = Committed("audio", "muted");
+    Check(nvs.commits == 3 && muted != nullptr && muted->type == NvsValue::kU8 && muted->number == 0, test,
+        "bool committed");
+}
+
+static void TestFlush() {
+    const char* test = "flush";
+    ResetNvs();
+    Settings("board", true).SetInt("sleep_flag", 1);
+    Settings::Flush();
+    Check(CommittedInt("board", "sleep_flag", 1), test, "Flush() commits at once");
+    Check(!TimerArmed(), test, "Flush() stops the timer");
+    Settings::Flush();
+    Check(nvs.commits == 1, test, "flushing nothing commits nothing");
+
+    Settings("board", true).SetInt("sleep_flag", 2);
+    Check(shutdown_handler != nullptr, test, "shutdown handler registered");
+    if (shutdown_handler != nullptr) {
+        shutdown_handler();
+    }
+    Check(CommittedInt("board", "sleep_flag", 2), test, "shutdown handler commits");
+}
+
+static void TestFailures() {
+    const char* test = "failures";
+    ResetNvs();
+    Settings audio("audio", true);
+
+    audio.SetInt("volume", 30);
+    nvs.open_error = ESP_FAIL;
+    Settings::Flush();
+    Check(Committed("audio", "volume") == nullptr, test, "nothing committed when nvs_open fails");
+    Check(TimerArmed(), test, "retry armed after nvs_open failed");
+    Check(audio.GetInt("volume") == 30, test, "value kept while pending");
+    FireTimer();
+    Check(CommittedInt("audio", "volume", 30), test, "committed on retry after nvs_open failed");
+
+    audio.SetInt("volume", 31);
+    nvs.commit_error = ESP_FAIL;
+    Settings::Flush();
+    Check(CommittedInt("audio", "volume", 30), test, "old value kept when nvs_commit fails");
+    Check(TimerArmed(), test, "retry armed after nvs_commit failed");
+    FireTimer();
+    Check(CommittedInt("audio", "volume", 31), test, "committed on retry after nvs_commit failed");
+
+    audio.SetInt("volume", 32);
+    audio.SetInt("bass", 5);
+    nvs.set_error = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    Settings::Flush();
+    Check(CommittedInt("audio", "volume", 31) && Committed("audio", "bass") == nullptr, test,
+        "nothing written when NVS is full");
+    Check(TimerArmed(), test, "retry armed when NVS is full");
+    nvs.set_error = ESP_OK;
+    FireTimer();
+    Check(CommittedInt("audio", "volume", 32) && CommittedInt("audio", "bass", 5), test,
+        "committed once NVS has space");
+
+    // NVS keys are at most 15 characters, this write can never succeed
+    audio.SetInt("a_much_too_long_key", 1);
+    audio.SetInt("volume", 33);
+    Settings::Flush();
+    Check(CommittedInt("audio", "volume", 33), test, "other keys committed next to a bad one");
+    Check(!TimerArmed(), test, "a change NVS cannot take is not retried");
+}
+
+static void TestErase() {
+    const char* test = "erase";
+    ResetNvs();
+    nvs.committed["audio"]["volume"] = {NvsValue::kI32, "", 70};
+    nvs.committed["audio"]["bass"] = {NvsValue::kI32, "", 3};
+    Settings audio("audio", true);
+
+    audio.EraseKey("volume");
+    Check(audio.GetInt("volume", -1) == -1, test, "erased key gives the default");
+    Settings::Flush();
+    Check(Committed("audio", "volume") == nullptr && CommittedInt("audio", "bass", 3), test, "key erased in NVS");
+
+    audio.EraseKey("treble");
+    Settings::Flush();
+    Check(nvs.commits == 2, test, "erasing a missing key commits");
+
+    audio.SetInt("volume", 10);
+    audio.EraseAll();
+    Check(nvs.committed["audio"].empty(), test, "EraseAll() erases the namespace");
+    Check(audio.GetInt("volume", -1) == -1, test, "EraseAll() drops pending changes");
+    int commits = nvs.commits;
+    FireTimer();
+    Settings::Flush();
+    Check(nvs.commits == commits && !TimerArmed(), test, "nothing left to commit after EraseAll()");
+}
+
+static void TestReadOnly() {
+    const char* test = "read only";
+    ResetNvs();
+    Settings audio("audio");
+    audio.SetInt("volume", 10);
+    audio.SetString("name", "x");
+    audio.EraseKey("volume");
+    Check(!TimerArmed(), test, "no change pending");
+    Check(audio.GetInt("volume", -1) == -1, test, "value unchanged");
+}
+
+int main() {
+    TestReads();
+    TestCoalescing();
+    TestFlush();
+    TestFailures();
+    TestErase();
+    TestReadOnly();
+    return ReportChecks();
+}
@@ -0,0 +1,23 @@
+#ifndef SETTINGS_TEST_ESP_ERR_H
+#define SETTINGS_TEST_ESP_ERR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+#define ESP_ERR_NVS_BASE            0x1100
+#define ESP_ERR_NVS_NOT_FOUND       (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_NAME    (ESP_ERR_NVS_BASE + 0x06)
+#define ESP_ERR_NVS_VALUE_TOO_LONG  (ESP_ERR_NVS_BASE + 0x0c)
+
+static inline const char* esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : "error";
+}
+
+#define ESP_ERROR_CHECK(x) do { if ((x) != ESP_OK) { fprintf(stderr, "ESP_ERROR_CHECK failed: %s\n", #x); abort(); } } while (0)
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SETTINGS_TEST_ESP_SYSTEM_H
+#define SETTINGS_TEST_ESP_SYSTEM_H
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+// Keeps the handler, the test calls it to model esp_restart()
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+
+#endif
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Turn task stack telemetry into recommended stack sizes for main/task_stack.h
+
+Input files hold the result of the `self.system.get_stack_report` MCP tool, either
+the bare JSON object or the full MCP response. Reports from several devices can be
+passed at once, the worst case of each task is used.
+
+Usage:
+    python scripts/stack_report.py device1.json device2.json --margin 25
+"""
+import argparse
+import json
+import sys
+
+# FreeRTOS task name -> macro in main/task_stack.h
+TASK_MACROS = {
+    "main_event_loop": "TASK_STACK_MAIN_EVENT_LOOP",
+    "audio_input": "TASK_STACK_AUDIO_INPUT",
+    "audio_output": "TASK_STACK_AUDIO_OUTPUT",
+    "opus_codec": "TASK_STACK_OPUS_CODEC",
+    "audio_communication": "TASK_STACK_AUDIO_COMMUNICATION",
+    "audio_detection": "TASK_STACK_AUDIO_DETECTION",
+    "encode_wake_word": "TASK_STACK_ENCODE_WAKE_WORD",
+    "jpeg_encoder": "TASK_STACK_JPEG_ENCODER",
+    "profiler": "TASK_STACK_PROFILER",
+    "emote_pacer": "TASK_STACK_EMOTE_PACER",
+    "status_probe": "TASK_STACK_STATUS_PROBE",
+    "camera_ring": "TASK_STACK_CAMERA_RING",
+}
+
+
+def load_report(path):
+    with open(path, "r", encoding="utf-8") as f:
+        data = json.load(f)
+    # Unwrap a full MCP tools/call response
+    if "result" in data:
+        data = data["result"]
+    if "content" in data:
+        data = json.loads(data["content"][0]["text"])
+    return data["tasks"]
+
+
+def recommend(used, margin_percent, min_margin, align):
+    size = used + max(used * margin_percent // 100, min_margin)
+    return (size + align - 1) // align * align
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Recommend task stack sizes from recorded usage")
+    parser.add_argument("reports", nargs="+", help="JSON files exported with self.system.get_stack_report")
+    parser.add_argument("--margin", type=int, default=25, help="safety margin in percent of the used stack (default 25)")
+    parser.add_argument("--min-margin", type=int, default=1024, help="minimum safety margin in bytes (default 1024)")
+    parser.add_argument("--align", type=int, default=512, help="round sizes up to this many bytes (default 512)")
+    args = parser.parse_args()
+
+    tasks = {}
+    for path in args.reports:
+        for task in load_report(path):
+            entry = tasks.setdefault(task["name"], {"stack_size": task["stack_size"], "used": 0, "devices": 0})
+            entry["stack_size"] = max(entry["stack_size"], task["stack_size"])
+            entry["used"] = max(entry["used"], task["max_used"])
+            if task["max_used"] > 0:
+                entry["devices"] += 1
+
+    print(f"{'task':<22}{'size':>8}{'used':>8}{'new':>8}{'saved':>8}  devices")
+    total_saved = 0
+    defines = []
+    for name, entry in tasks.items():
+        if entry["used"] == 0:
+            # Never ran on any device, there is nothing to base a recommendation on
+            print(f"{name:<22}{entry['stack_size']:>8}{'-':>8}{'-':>8}{'-':>8}  0")
+            continue
+        new_size = recommend(entry["used"], args.margin, args.min_margin, args.align)
+        saved = entry["stack_size"] - new_size
+        total_saved += saved
+        print(f"{name:<22}{entry['stack_size']:>8}{entry['used']:>8}{new_size:>8}{saved:>8}  {entry['devices']}")
+        if name in TASK_MACROS and new_size != entry["stack_size"]:
+            defines.append(f"#define {TASK_MACROS[name]:<32}{new_size}")
+
+    print(f"\nTotal change: {total_saved} bytes (positive means RAM reclaimed)")
+    if defines:
+        print("\nSuggested main/task_stack.h values:")
+        print("\n".join(defines))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
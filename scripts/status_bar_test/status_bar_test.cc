@@ -0,0 +1,123 @@
+/*
+ * Host test of StatusBarModel, the record of what the LVGL status bar shows.
+ *
+ * LvglDisplay::UpdateStatusBar() runs once a second and only calls the LVGL setters
+ * for values the model reports as changed. The test checks the model rules, then
+ * replays an hour of 1 Hz ticks with the same inputs the display reads (clock,
+ * volume, battery, network) and counts the setters:
+ *
+ * 1. The first value of a field is always applied, an equal value never is, also
+ *    when it comes through another pointer with the same content.
+ * 2. nullptr and "" are the same value, so hidden icons are cleared once.
+ * 3. After Reset() or ResetAll() the next value is applied again.
+ * 4. Over the replayed hour, a setter runs only for a tick where a value changed,
+ *    which is once a minute for the clock, instead of once per field per tick.
+ *
+ * Usage: status_bar_test [-v]
+ */
+#include "status_bar_model.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static void TestRules() {
+    const char* test = "rules";
+    StatusBarModel model;
+    Check(model.Set(StatusBarModel::kBattery, "full"), test, "first value not applied");
+    Check(!model.Set(StatusBarModel::kBattery, "full"), test, "equal value applied");
+
+    // Icons come from different translation units, only the content counts
+    char copy[] = "full";
+    Check(!model.Set(StatusBarModel::kBattery, copy), test, "equal content through another pointer applied");
+    Check(model.Set(StatusBarModel::kBattery, "half"), test, "changed value not applied");
+    Check(model.value(StatusBarModel::kBattery) == "half", test, "value not recorded");
+
+    // Fields are independent
+    Check(model.Set(StatusBarModel::kNetwork, "half"), test, "first value of another field not applied");
+
+    Check(model.Set(StatusBarModel::kMute, nullptr), test, "first nullptr not applied");
+    Check(!model.Set(StatusBarModel::kMute, ""), test, "\"\" after nullptr applied");
+    Check(model.Set(StatusBarModel::kMute, "muted"), test, "icon after nullptr not applied");
+    Check(model.Set(StatusBarModel::kMute, nullptr), test, "nullptr after icon not applied");
+
+    Check(model.SetVisible(StatusBarModel::kLowBattery, false), test, "first visibility not applied");
+    Check(!model.SetVisible(StatusBarModel::kLowBattery, false), test, "equal visibility applied");
+    Check(model.SetVisible(StatusBarModel::kLowBattery, true), test, "changed visibility not applied");
+
+    model.Reset(StatusBarModel::kBattery);
+    Check(model.Set(StatusBarModel::kBattery, "half"), test, "value after Reset() not applied");
+    Check(!model.Set(StatusBarModel::kNetwork, "half"), test, "Reset() touched another field");
+
+    model.ResetAll();
+    Check(model.Set(StatusBarModel::kNetwork, "half"), test, "value after ResetAll() not applied");
+    Check(model.SetVisible(StatusBarModel::kLowBattery, true), test, "visibility after ResetAll() not applied");
+
+    Check(model.setter_calls() == 11, test, "setter_calls miscounted");
+    Check(model.setters_avoided() == 5, test, "setters_avoided miscounted");
+}
+
+// One hour of UpdateStatusBar() ticks while idle
+static void TestIdleHour() {
+    const char* test = "idle hour";
+    StatusBarModel model;
+    int changes = 0;
+    int setters = 0;
+    std::string shown[StatusBarModel::kFieldCount];
+    auto update = [&](StatusBarModel::Field field, const std::string& value) {
+        if (model.Set(field, value.c_str())) {
+            setters++;
+            shown[field] = value;
+        }
+    };
+
+    std::string last[StatusBarModel::kFieldCount];
+    bool first = true;
+    for (int second = 0; second < 3600; second++) {
+        char clock[16];
+        snprintf(clock, sizeof(clock), "%02d:%02d  ", 12 + second / 3600, second / 60 % 60);
+        // Volume muted for ten minutes, battery draining a level every 20 minutes,
+        // the network probe flapping once
+        std::string inputs[StatusBarModel::kFieldCount];
+        inputs[StatusBarModel::kClock] = clock;
+        inputs[StatusBarModel::kMute] = (second >= 600 && second < 1200) ? "muted" : "";
+        inputs[StatusBarModel::kBattery] = second < 1200 ? "full" : second < 2400 ? "three_quarters" : "half";
+        inputs[StatusBarModel::kNetwork] = (second >= 1800 && second < 1810) ? "wifi_weak" : "wifi";
+        inputs[StatusBarModel::kLowBattery] = "";
+
+        for (int field = 0; field < StatusBarModel::kFieldCount; field++) {
+            if (first || inputs[field] != last[field]) {
+                changes++;
+            }
+            last[field] = inputs[field];
+            update((StatusBarModel::Field)field, inputs[field]);
+        }
+        first = false;
+
+        for (int field = 0; field < StatusBarModel::kFieldCount; field++) {
+            if (shown[field] != inputs[field]) {
+                Check(false, test, "widget does not show the latest value");
+                break;
+            }
+        }
+    }
+
+    int ticks = 3600 * StatusBarModel::kFieldCount;
+    Check(setters == changes, test, "setters differ from value changes");
+    Check((int)model.setter_calls() == setters, test, "setter_calls miscounted");
+    Check((int)(model.setter_calls() + model.setters_avoided()) == ticks, test, "updates miscounted");
+    // 5 first values, 59 clock minutes, mute on and off, 2 battery levels, network flap
+    Check(setters == 5 + 59 + 2 + 2 + 2, test, "unexpected setter count");
+    if (verbose) {
+        printf("%s: %d field updates, %u setters, %u avoided\n", test, ticks,
+            (unsigned)model.setter_calls(), (unsigned)model.setters_avoided());
+    }
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestRules();
+    TestIdleHour();
+    return ReportChecks();
+}
@@ -0,0 +1,302 @@
+/*
+ * Host test of the LED strip effects in main/led/strip_effect.cc.
+ *
+ * Effects are rendered to frame arrays, at every millisecond and at the frame times the
+ * effect reports, as CircularStrip renders them. The test checks that:
+ *
+ * 1. The gamma tables are monotonic and every LED value survives a round trip through
+ *    perceptual space, so keyframe colors come out exactly.
+ * 2. Blink and Scroll show the same frames at the same times as the timer callbacks they
+ *    replace, for strips of 1 to 25 LEDs and runs longer than the strip.
+ * 3. Breathe starts at the low color, reaches the high one halfway through its period,
+ *    which is as long as before, and fades monotonically and smoothly in between.
+ * 4. FadeOut starts at the frame it fades, keeps every LED's hue, only gets darker, and is
+ *    black when halving the brightest channel would have been. Then it stops.
+ * 5. Frames only change at the frame times the effect reports, and fades report a frame at
+ *    least every STRIP_EFFECT_FRAME_MS. Static frames report none.
+ * 6. Intervals shorter than a frame are raised to one frame.
+ *
+ * -v prints the breathe frames, and for the effects of the device states, how many frames are
+ * sent to the strip compared to the blocking refreshes of the timer callbacks before.
+ *
+ * Usage: strip_effect_test [-v]
+ */
+#include "strip_effect.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const StripColor kBlack = {0, 0, 0};
+
+static std::vector<StripColor> Render(const StripEffect& effect, int64_t t_ms, int leds) {
+    std::vector<StripColor> frame(leds);
+    effect.Render(t_ms, frame);
+    return frame;
+}
+
+// Frame times as CircularStrip follows them, from 0 up to end_ms
+static std::vector<int64_t> FrameTimes(const StripEffect& effect, int64_t end_ms) {
+    std::vector<int64_t> times = {0};
+    for (int64_t t = effect.GetNextFrameTime(0); t >= 0 && t <= end_ms; t = effect.GetNextFrameTime(t)) {
+        times.push_back(t);
+    }
+    return times;
+}
+
+// Held effects: the frame at every millisecond is the frame of the last frame time
+static bool ChangesOnlyAtFrameTimes(const StripEffect& effect, int leds, int64_t end_ms) {
+    auto times = FrameTimes(effect, end_ms);
+    size_t next = 1;
+    auto shown = Render(effect, 0, leds);
+    for (int64_t t = 1; t <= end_ms; t++) {
+        if (next < times.size() && times[next] == t) {
+            shown = Render(effect, t, leds);
+            next++;
+        } else if (Render(effect, t, leds) != shown) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestGamma() {
+    const char* test = "gamma";
+    bool round_trip = true, decode_monotonic = true, encode_monotonic = true;
+    for (int v = 0; v < 256; v++) {
+        round_trip &= StripEffect::Encode(StripEffect::Decode(v)) == v;
+        decode_monotonic &= v == 0 || StripEffect::Decode(v) > StripEffect::Decode(v - 1);
+    }
+    for (int p = 1; p <= 1023; p++) {
+        int step = StripEffect::Encode(p) - StripEffect::Encode(p - 1);
+        encode_monotonic &= step == 0 || step == 1;
+    }
+    Check(round_trip, test, "every LED value round trips");
+    Check(decode_monotonic, test, "decode strictly increasing");
+    Check(encode_monotonic, test, "encode increasing by at most 1");
+    Check(StripEffect::Decode(0) == 0 && StripEffect::Decode(255) == 1023 && StripEffect::Encode(1023) == 255, test,
+        "full range");
+    // Low LED values get most of the perceptual range, where the eye tells them apart
+    Check(StripEffect::Decode(32) > 1023 / 3, test, "gamma expands the dark end");
+}
+
+static void TestFrame() {
+    const char* test = "frame";
+    std::vector<StripColor> colors = {{1, 2, 3}, {255, 0, 128}, {0, 0, 0}, {32, 4, 4}};
+    auto effect = StripEffect::Frame(colors);
+    Check(Render(effect, 0, 4) == colors && Render(effect, 123456, 4) == colors, test, "colors exactly");
+    Check(effect.GetNextFrameTime(0) < 0, test, "no frames after the first");
+    auto longer = Render(effect, 0, 6);
+    Check(longer[4] == kBlack && longer[5] == kBlack, test, "LEDs past the frame are off");
+}
+
+static void TestBlink() {
+    const char* test = "blink";
+    for (int interval : {20, 100, 500}) {
+        StripColor color = {4, 32, 4};
+        auto effect = StripEffect::Blink(color, interval);
+        bool same = true;
+        for (int64_t t = 0; t < 6 * interval; t++) {
+            // The old callback toggled every interval, starting on
+            bool on = (t / interval) % 2 == 0;
+            auto frame = Render(effect, t, 3);
+            same &= std::all_of(frame.begin(), frame.end(), [&](const StripColor& c) { return c == (on ? color : kBlack); });
+        }
+        Check(same, test, "toggles every interval");
+        auto times = FrameTimes(effect, 6 * interval);
+        bool on_toggles = times.size() == 7;
+        for (size_t i = 0; i < times.size(); i++) {
+            on_toggles &= times[i] == (int64_t)i * interval;
+        }
+        Check(on_toggles, test, "a frame at each toggle only");
+        Check(ChangesOnlyAtFrameTimes(effect, 3, 6 * interval), test, "frames change only at frame times");
+    }
+    Check(StripEffect::Blink({1, 1, 1}, 0).period_ms() == 2 * STRIP_EFFECT_FRAME_MS, test,
+        "interval raised to one frame");
+}
+
+static void TestScroll() {
+    const char* test = "scroll";
+    StripColor low = {0, 0, 0};
+    StripColor high = {4, 4, 32};
+    int interval = 100;
+    for (int leds : {1, 3, 8, 25}) {
+        for (int length : {0, 1, 3, leds - 1, leds, leds + 2}) {
+            auto effect = StripEffect::Scroll(low, high, length, interval, leds);
+            bool same = true;
+            for (int64_t t = 0; t < 3 * leds * interval; t += interval / 4) {
+                // The old callback lit LEDs offset to offset + length - 1
+                int offset = (t / interval) % leds;
+                std::vector<StripColor> expected(leds, low);
+                for (int j = 0; j < length; j++) {
+                    expected[(offset + j) % leds] = high;
+                }
+                same &= Render(effect, t, leds) == expected;
+            }
+            char what[64];
+            snprintf(what, sizeof(what), "%d of %d LEDs move like before", length, leds);
+            Check(same, test, what);
+            snprintf(what, sizeof(what), "%d of %d LEDs change only at frame times", length, leds);
+            Check(ChangesOnlyAtFrameTimes(effect, leds, 2 * leds * interval), test, what);
+            bool steady = length <= 0 || length >= leds;
+            Check(steady == (effect.GetNextFrameTime(0) < 0), test, "frames only while something moves");
+            if (!steady) {
+                auto times = FrameTimes(effect, 2 * leds * interval);
+                bool per_step = true;
+                for (size_t i = 1; i < times.size(); i++) {
+                    per_step &= times[i] - times[i - 1] == interval;
+                }
+                Check(per_step, test, "one frame per step");
+            }
+        }
+    }
+}
+
+static void TestBreathe() {
+    const char* test = "breathe";
+    struct Case {
+        StripColor low, high;
+        int interval;
+    };
+    Case cases[] = {
+        {{0, 0, 0}, {4, 4, 32}, 50},
+        {{4, 4, 4}, {32, 4, 4}, 20},
+        {{10, 200, 0}, {250, 20, 60}, 20},
+        {{0, 0, 0}, {255, 255, 255}, 20},
+    };
+    for (auto& c : cases) {
+        auto effect = StripEffect::Breathe(c.low, c.high, c.interval);
+        int steps = std::max({abs(c.high.red - c.low.red), abs(c.high.green - c.low.green), abs(c.high.blue - c.low.blue)});
+        int period = effect.period_ms();
+        Check(period == 2 * steps * c.interval, test, "period as before");
+        Check(Render(effect, 0, 1)[0] == c.low && Render(effect, period / 2, 1)[0] == c.high &&
+            Render(effect, period, 1)[0] == c.low, test, "keyframe colors exactly");
+
+        auto times = FrameTimes(effect, 2 * period);
+        bool monotonic = true, in_range = true, regular = true;
+        int largest_step = 0;
+        StripColor previous = c.low;
+        for (size_t i = 1; i < times.size(); i++) {
+            regular &= times[i] - times[i - 1] >= 1 && times[i] - times[i - 1] <= STRIP_EFFECT_FRAME_MS;
+            auto color = Render(effect, times[i], 1)[0];
+            bool rising = times[i] % period <= period / 2 && times[i] % period != 0;
+            const uint8_t a[3] = {previous.red, previous.green, previous.blue};
+            const uint8_t b[3] = {color.red, color.green, color.blue};
+            const uint8_t l[3] = {c.low.red, c.low.green, c.low.blue};
+            const uint8_t h[3] = {c.high.red, c.high.green, c.high.blue};
+            for (int ch = 0; ch < 3; ch++) {
+                int towards = rising ? h[ch] - l[ch] : l[ch] - h[ch];
+                monotonic &= towards >= 0 ? b[ch] >= a[ch] : b[ch] <= a[ch];
+                in_range &= b[ch] >= std::min(l[ch], h[ch]) && b[ch] <= std::max(l[ch], h[ch]);
+                largest_step = std::max(largest_step, abs(b[ch] - a[ch]));
+            }
+            previous = color;
+        }
+        Check(regular, test, "a frame at least every frame interval");
+        Check(monotonic, test, "fades monotonically");
+        Check(in_range, test, "between the two colors");
+        // Perceptual fades take larger steps at the bright end, where the eye notices them less
+        Check(largest_step <= 4, test, "smooth, at most 4 per frame");
+        if (verbose) {
+            printf("breathe %3d,%3d,%3d -> %3d,%3d,%3d every %2dms: period %5dms, %3zu frames, largest step %d\n",
+                c.low.red, c.low.green, c.low.blue, c.high.red, c.high.green, c.high.blue, c.interval, period,
+                times.size() / 2, largest_step);
+        }
+    }
+    auto steady = StripEffect::Breathe({5, 5, 5}, {5, 5, 5}, 50);
+    Check(steady.GetNextFrameTime(0) < 0 && Render(steady, 1000, 2)[1] == StripColor({5, 5, 5}), test,
+        "equal colors do not breathe");
+}
+
+static void TestFadeOut() {
+    const char* test = "fade out";
+    std::vector<StripColor> from = {{32, 4, 4}, {4, 32, 4}, {0, 0, 32}, {0, 0, 0}, {255, 128, 0}};
+    int interval = 50;
+    auto effect = StripEffect::FadeOut(from, interval);
+    // The old callback halved every channel per interval: 255 took 8 intervals
+    int duration = 8 * interval;
+    Check(Render(effect, 0, 5) == from, test, "starts at the frame");
+    auto times = FrameTimes(effect, 10 * duration);
+    Check(times.back() == duration, test, "black when halving would have been");
+    Check(effect.GetNextFrameTime(duration) < 0, test, "stops after");
+    Check(Render(effect, duration, 5) == std::vector<StripColor>(5, kBlack) &&
+        Render(effect, 10 * duration, 5) == std::vector<StripColor>(5, kBlack), test, "black at the end");
+
+    bool darker = true, hue = true;
+    auto previous = from;
+    for (size_t i = 1; i < times.size(); i++) {
+        auto frame = Render(effect, times[i], 5);
+        for (size_t led = 0; led < from.size(); led++) {
+            auto& a = previous[led];
+            auto& b = frame[led];
+            darker &= b.red <= a.red && b.green <= a.green && b.blue <= a.blue;
+            hue &= (from[led].red > 0 || b.red == 0) && (from[led].green > 0 || b.green == 0) &&
+                (from[led].blue > 0 || b.blue == 0);
+            // The dominant channel stays dominant
+            hue &= from[led].red < from[led].blue || b.red >= b.blue;
+        }
+        previous = frame;
+    }
+    Check(darker, test, "only gets darker");
+    Check(hue, test, "keeps the hue of every LED");
+
+    auto dark = StripEffect::FadeOut(std::vector<StripColor>(3, kBlack), interval);
+    Check(dark.GetNextFrameTime(0) < 0 && Render(dark, 0, 3) == std::vector<StripColor>(3, kBlack), test,
+        "nothing to fade");
+    Check(StripEffect::FadeOut({{1, 0, 0}}, 1).GetNextFrameTime(0) == STRIP_EFFECT_FRAME_MS, test,
+        "interval raised to one frame");
+}
+
+// What the device states show, see CircularStrip::OnStateChanged
+static void TestStateEffects() {
+    struct Case {
+        const char* name;
+        StripEffect effect;
+        int refreshes_before;   // Blocking refreshes of the old timer callbacks in 10s
+    };
+    const int leds = 25;
+    StripColor low = {4, 4, 32};
+    Case cases[] = {
+        {"starting scroll", StripEffect::Scroll({0, 0, 0}, low, 3, 100, leds), 100},
+        {"configuring blink", StripEffect::Blink(low, 500), 20},
+        {"upgrading blink", StripEffect::Blink({4, 32, 4}, 100), 100},
+        {"breathe", StripEffect::Breathe({0, 0, 0}, low, 50), 200},
+        // Halving 32 down to 0 took 6 ticks
+        {"idle fade out", StripEffect::FadeOut(std::vector<StripColor>(leds, {32, 4, 4}), 50), 6},
+    };
+    for (auto& c : cases) {
+        const int64_t length = 10000;
+        auto times = FrameTimes(c.effect, length);
+        int sent = 0;
+        auto shown = Render(c.effect, 0, leds);
+        for (size_t i = 1; i < times.size(); i++) {
+            auto frame = Render(c.effect, times[i], leds);
+            sent += frame != shown;
+            shown = frame;
+        }
+        // Looping effects send a frame only when it changes, a fade out is smoother than before
+        if (c.effect.period_ms() > 0) {
+            Check(sent <= c.refreshes_before, c.name, "no more frames sent than refreshes before");
+        }
+        if (verbose) {
+            printf("%-18s over %llds: %4zu frames rendered, %4d sent, %4d refreshes before\n", c.name,
+                (long long)length / 1000, times.size(), sent, c.refreshes_before);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestGamma();
+    TestFrame();
+    TestBlink();
+    TestScroll();
+    TestBreathe();
+    TestFadeOut();
+    TestStateEffects();
+    return ReportChecks();
+}
@@ -0,0 +1,183 @@
+/*
+ * Host test of the system profiler aggregation in main/profile_history.cc, with synthetic
+ * uxTaskGetSystemState snapshots of a dual core target. It checks that:
+ *
+ * 1. A task's CPU share is its run time over the elapsed run time of all cores, and the
+ *    shares of the tasks and the IDLE tasks add up to 100% when the counters do.
+ * 2. Run time counters that wrap around between snapshots give the right share.
+ * 3. New tasks, and new tasks reusing a deleted task's handle, are reported with 0%.
+ *    Deleted tasks are not reported.
+ * 4. Shares are capped at 100% and are 0 when no time elapsed.
+ * 5. Tasks are sorted busiest first, in snapshot order when their shares are equal.
+ * 6. The CPU load is what the IDLE tasks leave, on one or two cores.
+ * 7. The history keeps the last SYSTEM_PROFILER_MAX_SAMPLES samples with their busiest
+ *    SYSTEM_PROFILER_TOP_TASKS tasks, and the lowest stack high water mark of every task,
+ *    including the ones that were not among the busiest.
+ *
+ * Usage: system_profiler_test [-v]
+ */
+#include "profile_history.h"
+#include "host_test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Task handles are only compared, any distinct pointers do
+static const char handles[16] = {};
+
+static TaskSnapshot Task(int handle, const char* name, uint32_t run_time, uint32_t stack = 1000) {
+    return {&handles[handle], name, run_time, stack};
+}
+
+static const TaskUsage* Find(const std::vector<TaskUsage>& usage, const char* name) {
+    for (auto& task : usage) {
+        if (task.name == name) {
+            return &task;
+        }
+    }
+    return nullptr;
+}
+
+static int Percent(const std::vector<TaskUsage>& usage, const char* name) {
+    auto task = Find(usage, name);
+    return task != nullptr ? task->cpu_percent : -1;
+}
+
+static void Print(const char* title, const std::vector<TaskUsage>& usage) {
+    if (!verbose) {
+        return;
+    }
+    printf("%s, load %u%%\n", title, ProfileHistory::ComputeCpuLoad(usage));
+    for (auto& task : usage) {
+        printf("  %-16s %3u%%  stack %u\n", task.name.c_str(), task.cpu_percent, task.stack_high_water_mark);
+    }
+}
+
+static void TestShares() {
+    const char* test = "shares";
+    // 1s at a 1MHz run time counter on two cores: 2,000,000 counts of capacity
+    std::vector<TaskSnapshot> prev = {
+        Task(0, "IDLE0", 5000000), Task(1, "IDLE1", 7000000), Task(2, "audio_input", 1000000),
+        Task(3, "opus_codec", 2000000), Task(4, "main", 300000),
+    };
+    std::vector<TaskSnapshot> curr = {
+        Task(0, "IDLE0", 5600000), Task(1, "IDLE1", 7900000), Task(2, "audio_input", 1200000),
+        Task(3, "opus_codec", 2280000), Task(4, "main", 320000),
+    };
+    auto usage = ProfileHistory::ComputeTaskUsage(prev, curr, 1000000, 2);
+    Print("dual core", usage);
+    Check(usage.size() == 5, test, "every task reported");
+    Check(Percent(usage, "IDLE0") == 30 && Percent(usage, "IDLE1") == 45, test, "IDLE shares");
+    Check(Percent(usage, "audio_input") == 10 && Percent(usage, "opus_codec") == 14 && Percent(usage, "main") == 1,
+        test, "task shares");
+    int total = 0;
+    for (auto& task : usage) {
+        total += task.cpu_percent;
+    }
+    Check(total == 100, test, "shares add up to 100%");
+    Check(ProfileHistory::ComputeCpuLoad(usage) == 25, test, "load is what IDLE leaves");
+
+    bool sorted = true;
+    for (size_t i = 1; i < usage.size(); i++) {
+        sorted &= usage[i - 1].cpu_percent >= usage[i].cpu_percent;
+    }
+    Check(sorted && usage[0].name == "IDLE1", test, "busiest first");
+}
+
+static void TestWrapAround() {
+    const char* test = "wrap around";
+    std::vector<TaskSnapshot> prev = {Task(0, "IDLE0", 0xFFFF0000u), Task(1, "wifi", 0xFFFFFF00u)};
+    std::vector<TaskSnapshot> curr = {Task(0, "IDLE0", 0x00060000u), Task(1, "wifi", 0x0000FF00u)};
+    // 0x70000 counts elapsed, IDLE0 ran 0x70000 and wifi 0x10000
+    auto usage = ProfileHistory::ComputeTaskUsage(prev, curr, 0x80000, 1);
+    Print("wrap around", usage);
+    Check(Percent(usage, "IDLE0") == 87, test, "IDLE share across the wrap");
+    Check(Percent(usage, "wifi") == 12, test, "task share across the wrap");
+}
+
+static void TestTaskChanges() {
+    const char* test = "task changes";
+    std::vector<TaskSnapshot> prev = {
+        Task(0, "IDLE0", 1000), Task(1, "ota", 5000), Task(2, "old_task", 900000),
+    };
+    // old_task was deleted and its handle reused by new_task. ota was deleted, wake_word is new
+    std::vector<TaskSnapshot> curr = {
+        Task(0, "IDLE0", 2000), Task(2, "new_task", 100), Task(3, "wake_word", 400),
+    };
+    auto usage = ProfileHistory::ComputeTaskUsage(prev, curr, 1000, 1);
+    Print("task changes", usage);
+    Check(Percent(usage, "wake_word") == 0, test, "new task at 0%");
+    Check(Percent(usage, "new_task") == 0, test, "new task on a reused handle at 0%");
+    Check(Find(usage, "ota") == nullptr && Find(usage, "old_task") == nullptr, test, "deleted tasks not reported");
+    Check(Percent(usage, "IDLE0") == 100, test, "IDLE share");
+}
+
+static void TestLimits() {
+    const char* test = "limits";
+    std::vector<TaskSnapshot> prev = {Task(0, "IDLE0", 0), Task(1, "busy", 0), Task(2, "a", 0), Task(3, "b", 0)};
+    std::vector<TaskSnapshot> curr = {Task(0, "IDLE0", 0), Task(1, "busy", 5000), Task(2, "a", 10), Task(3, "b", 10)};
+    auto usage = ProfileHistory::ComputeTaskUsage(prev, curr, 1000, 1);
+    Check(Percent(usage, "busy") == 100, test, "share capped at 100%");
+    Check(ProfileHistory::ComputeCpuLoad(usage) == 100, test, "load 100% without IDLE time");
+    Check(usage.size() == 4 && usage[1].name == "a" && usage[2].name == "b", test, "equal shares in snapshot order");
+
+    usage = ProfileHistory::ComputeTaskUsage(prev, curr, 0, 2);
+    bool zero = true;
+    for (auto& task : usage) {
+        zero &= task.cpu_percent == 0;
+    }
+    Check(zero, test, "0% when no time elapsed");
+
+    Check(ProfileHistory::ComputeCpuLoad({}) == 100, test, "load without tasks");
+    Check(ProfileHistory::ComputeCpuLoad({{"IDLE0", 60, 0}, {"IDLE1", 50, 0}}) == 0, test, "IDLE over 100%");
+    Check(ProfileHistory::ComputeCpuLoad({{"IDLE", 70, 0}, {"main", 30, 0}}) == 30, test, "single core IDLE");
+}
+
+static void TestHistory() {
+    const char* test = "history";
+    ProfileHistory history;
+    const int kSamples = SYSTEM_PROFILER_MAX_SAMPLES + 5;
+    const int kTasks = SYSTEM_PROFILER_TOP_TASKS + 4;
+    for (int i = 0; i < kSamples; i++) {
+        ProfileSample sample = {};
+        sample.timestamp_ms = i * 5000;
+        for (int t = 0; t < kTasks; t++) {
+            // Task t is busier than task t + 1. The least busy task's stack dips in sample 3
+            uint32_t stack = (t == kTasks - 1 && i == 3) ? 100 : 2000 - i;
+            sample.tasks.push_back({"task" + std::to_string(t), (uint8_t)(kTasks - t), stack});
+        }
+        history.Add(std::move(sample));
+    }
+
+    auto& samples = history.samples();
+    Check(samples.size() == SYSTEM_PROFILER_MAX_SAMPLES, test, "ring size");
+    Check(samples.front().timestamp_ms == (kSamples - SYSTEM_PROFILER_MAX_SAMPLES) * 5000 &&
+        samples.back().timestamp_ms == (kSamples - 1) * 5000, test, "oldest samples dropped");
+    bool top = true;
+    for (auto& sample : samples) {
+        top &= sample.tasks.size() == SYSTEM_PROFILER_TOP_TASKS && sample.tasks[0].name == "task0";
+    }
+    Check(top, test, "busiest tasks kept");
+
+    auto& stacks = history.min_stack_high_water_mark();
+    Check(stacks.size() == kTasks, test, "stack of every task tracked");
+    auto last = stacks.find("task" + std::to_string(kTasks - 1));
+    Check(last != stacks.end() && last->second == 100, test, "low water mark of a task outside the top");
+    auto first = stacks.find("task0");
+    Check(first != stacks.end() && first->second == 2000 - (kSamples - 1), test, "low water mark of a busy task");
+    if (verbose) {
+        printf("%zu samples, %zu tasks with stack marks\n", samples.size(), stacks.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    TestShares();
+    TestWrapAround();
+    TestTaskChanges();
+    TestLimits();
+    TestHistory();
+    return ReportChecks();
+}